@@ -531,6 +531,16 @@ public class ClientApplication {
     /// @todo(me) もう少し一貫した対応策があるかもしれない
     // 現在時刻で上書き
     message.Timestamp = DateTime.Now.Ticks;
+    // 描画方法・実行方法・拡大縮小の品質の決め方はレイアウトと一緒に送る
+    message.RenderingMode = (int)(this.Options.DirectRendering
+        ? RenderingModes.Direct
+        : RenderingModes.Buffered);
+    message.PipelineMode = (int)(this.Options.PipelinedCapture
+        ? PipelineModes.Pipelined
+        : PipelineModes.Serial);
+    message.ScaleQualityMode = (int)(this.Options.AdaptiveScaleQuality
+        ? ScaleQualityModes.Adaptive
+        : ScaleQualityModes.Fixed);
     var initResult = this.Interprocess.InitMessage(this.RuntimeOptions.CurrentProcessID);
     if (!initResult) return false;
     var sendResult = this.Interprocess.SendMessage(message);
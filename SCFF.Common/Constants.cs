@@ -171,6 +171,7 @@ public static class Constants {
     {ImagePixelFormats.UYVY, "UYVY"},
     {ImagePixelFormats.YUY2, "YUY2"},
     {ImagePixelFormats.RGB0, "RGB0"},
+    {ImagePixelFormats.NV12, "NV12"},
     {ImagePixelFormats.SupportedPixelFormatsCount, "SupportedPixelFormatsCount"}
   };
 
@@ -35,6 +35,11 @@ class InternalEntry {
     this.SampleHeight = interprocessEntry.SampleHeight;
     this.SamplePixelFormat = (ImagePixelFormats)interprocessEntry.SamplePixelFormat;
     this.FPS = interprocessEntry.FPS;
+    this.PipelineMode = (PipelineModes)interprocessEntry.PipelineMode;
+    this.PipelineLatencyAverage = interprocessEntry.PipelineLatencyAverage;
+    this.PipelineLatencyMax = interprocessEntry.PipelineLatencyMax;
+    this.PipelineDroppedFrames = interprocessEntry.PipelineDroppedFrames;
+    this.PipelineRepeatedFrames = interprocessEntry.PipelineRepeatedFrames;
   }
   /// @copydoc SCFF::Interprocess::Entry::ProcessID
   public UInt32 ProcessID { get; set; }
@@ -48,6 +53,16 @@ class InternalEntry {
   public ImagePixelFormats SamplePixelFormat { get; set; }
   /// @copydoc SCFF::Interprocess::Entry::FPS
   public double FPS { get; set; }
+  /// @copydoc SCFF::Interprocess::Entry::PipelineMode
+  public PipelineModes PipelineMode { get; set; }
+  /// @copydoc SCFF::Interprocess::Entry::PipelineLatencyAverage
+  public double PipelineLatencyAverage { get; set; }
+  /// @copydoc SCFF::Interprocess::Entry::PipelineLatencyMax
+  public double PipelineLatencyMax { get; set; }
+  /// @copydoc SCFF::Interprocess::Entry::PipelineDroppedFrames
+  public Int64 PipelineDroppedFrames { get; set; }
+  /// @copydoc SCFF::Interprocess::Entry::PipelineRepeatedFrames
+  public Int64 PipelineRepeatedFrames { get; set; }
 }
 
 /// @copydoc SCFF::Interprocess::LayoutParameter
@@ -74,6 +89,7 @@ class InternalLayoutParameter {
     result.Stretch = (Byte)(this.Stretch ? 1 : 0);
     result.KeepAspectRatio = (Byte)(this.KeepAspectRatio ? 1 : 0);
     result.RotateDirection = (int)this.RotateDirection;
+    result.Opacity = this.Opacity;
     return result;
   }
   /// @copydoc SCFF::Interprocess::LayoutParameter::BoundX
@@ -106,6 +122,8 @@ class InternalLayoutParameter {
   public bool KeepAspectRatio { get; set; }
   /// @copydoc SCFF::Interprocess::LayoutParameter::RotateDirection
   public RotateDirections RotateDirection { get; set; }
+  /// @copydoc SCFF::Interprocess::LayoutParameter::Opacity
+  public Byte Opacity { get; set; }
 }
 
 /// @copybrief SCFF::Interprocess::SWScaleConfig
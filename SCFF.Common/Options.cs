@@ -75,6 +75,9 @@ public class Options {
     this.RestoreLastProfile = true;
     this.RestoreMissingWindowWhenOpeningProfile = true;
     this.EnableGPUPreviewRendering = true;
+    this.DirectRendering = false;
+    this.PipelinedCapture = false;
+    this.AdaptiveScaleQuality = false;
   }
 
   //===================================================================
@@ -148,6 +151,12 @@ public class Options {
   public bool RestoreMissingWindowWhenOpeningProfile { get; set; }
   /// GUIクライアントのプレビュー機能でGPUレンダリングを有効にする
   public bool EnableGPUPreviewRendering { get; set; }
+  /// SCFF DSFでサンプルのバッファに直接描画する(フレームごとのコピーを省く)
+  public bool DirectRendering { get; set; }
+  /// SCFF DSFでキャプチャ専用スレッドと変換を並行して行う(遅延は最大で約1フレーム増える)
+  public bool PipelinedCapture { get; set; }
+  /// SCFF DSFで処理が間に合わなければ拡大縮小メソッドを一時的に軽いものに切り替える
+  public bool AdaptiveScaleQuality { get; set; }
 
   //===================================================================
   // アクセサ
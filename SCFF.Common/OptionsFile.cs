@@ -86,6 +86,9 @@ public class OptionsFile : TinyKeyValueFile {
         writer.WriteLine("RestoreMissingWindowWhenOpeningProfile={0}",
                          this.options.RestoreMissingWindowWhenOpeningProfile);
         writer.WriteLine("EnableGPUPreviewRendering={0}", this.options.EnableGPUPreviewRendering);
+        writer.WriteLine("DirectRendering={0}", this.options.DirectRendering);
+        writer.WriteLine("PipelinedCapture={0}", this.options.PipelinedCapture);
+        writer.WriteLine("AdaptiveScaleQuality={0}", this.options.AdaptiveScaleQuality);
         return true;
       }
     } catch (Exception) {
@@ -214,6 +217,15 @@ public class OptionsFile : TinyKeyValueFile {
     if (this.TryGetBool("EnableGPUPreviewRendering", out boolValue)) {
       this.options.EnableGPUPreviewRendering = boolValue;
     }
+    if (this.TryGetBool("DirectRendering", out boolValue)) {
+      this.options.DirectRendering = boolValue;
+    }
+    if (this.TryGetBool("PipelinedCapture", out boolValue)) {
+      this.options.PipelinedCapture = boolValue;
+    }
+    if (this.TryGetBool("AdaptiveScaleQuality", out boolValue)) {
+      this.options.AdaptiveScaleQuality = boolValue;
+    }
 
     return true;
   }
@@ -50,6 +50,7 @@ public class LayoutElement {
 
     this.KeepAspectRatio = true;
     this.RotateDirection = RotateDirections.NoRotate;
+    this.Opacity = 255;
     this.Stretch = true;
     this.SWScaleFlags = SWScaleFlags.Area;
     this.SWScaleIsFilterEnabled = false;
@@ -258,6 +259,11 @@ public class LayoutElement {
     get { return this.rawData.RotateDirection; }
     set { this.rawData.RotateDirection = value; }
   }
+  /// @copydoc SCFF::Common::InternalLayoutParameter::Opacity
+  public Byte Opacity {
+    get { return this.rawData.Opacity; }
+    set { this.rawData.Opacity = value; }
+  }
 
   //=================================================================
   // ResizeMethod
@@ -208,6 +208,11 @@ public partial class Profile {
     result.LayoutType = (int)this.LayoutType;
     result.LayoutElementCount = this.LayoutElements.Count;
     result.Timestamp = this.Timestamp;
+    // 描画方法・実行方法・拡大縮小の品質の決め方はプロファイルではなくOptionsで決める
+    // (SendProfileで上書きされる)
+    result.RenderingMode = (int)RenderingModes.Buffered;
+    result.PipelineMode = (int)PipelineModes.Serial;
+    result.ScaleQualityMode = (int)ScaleQualityModes.Fixed;
     int index = 0;
     foreach (var layoutElement in this.LayoutElements) {
       // Bound*とClipping*以外のデータをコピー
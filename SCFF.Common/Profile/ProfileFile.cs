@@ -72,6 +72,7 @@ public class ProfileFile : TinyKeyValueFile {
           writer.WriteLine("Stretch{0}={1}", index, layoutElement.Stretch);
           writer.WriteLine("KeepAspectRatio{0}={1}", index, layoutElement.KeepAspectRatio);
           writer.WriteLine("RotateDirection{0}={1}", index, (int)layoutElement.RotateDirection);
+          writer.WriteLine("Opacity{0}={1}", index, layoutElement.Opacity);
           // ResizeMethod
           writer.WriteLine("SWScaleFlags{0}={1}", index, (int)layoutElement.SWScaleFlags);
           writer.WriteLine("SWScaleAccurateRnd{0}={1}", index, layoutElement.SWScaleAccurateRnd);
@@ -212,6 +213,10 @@ public class ProfileFile : TinyKeyValueFile {
       if (this.TryGetRotateDirections("RotateDirection" + index, out rotateDirections)) {
         layoutElement.RotateDirection = rotateDirections;
       }
+      // 古いプロファイルには無いので不透明のまま
+      if (this.TryGetInt("Opacity" + index, out intValue)) {
+        layoutElement.Opacity = (Byte)Math.Max(0, Math.Min(255, intValue));
+      }
       // ResizeMethod
       SWScaleFlags swscaleFlags;
       if (this.TryGetSWScaleFlags("SWScaleFlags" + index, out swscaleFlags)) {
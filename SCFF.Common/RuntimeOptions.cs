@@ -147,12 +147,19 @@ public class RuntimeOptions {
     var pixelFormatString =
         Constants.ImagePixelFormatLabels[(ImagePixelFormats)entry.SamplePixelFormat];
 
-    return string.Format("[{0}] {1} ({2} {3}x{4} {5:F0}fps)",
+    var label = string.Format("[{0}] {1} ({2} {3}x{4} {5:F0}fps)",
         entry.ProcessID,
         entry.ProcessName,
         pixelFormatString,
         entry.SampleWidth, entry.SampleHeight,
         entry.FPS);
+    if (entry.PipelineMode != PipelineModes.Pipelined) return label;
+
+    // Pipelinedで増えた遅延を併記する
+    return string.Format("{0} [pipelined {1:F1}/{2:F1}ms dropped:{3} repeated:{4}]",
+        label,
+        entry.PipelineLatencyAverage, entry.PipelineLatencyMax,
+        entry.PipelineDroppedFrames, entry.PipelineRepeatedFrames);
   }
 
   /// 共有メモリアクセスオブジェクトからDirectoryを読み込む
@@ -109,6 +109,27 @@ public partial class MainMenu : UserControl, IBindingOptions {
     App.Options.EnableGPUPreviewRendering = this.EnableGPUPreviewRendering.IsChecked;
   }
 
+  /// DirectRendering: Click
+  /// @param sender 使用しない
+  /// @param e 使用しない
+  private void DirectRendering_Click(object sender, RoutedEventArgs e) {
+    App.Options.DirectRendering = this.DirectRendering.IsChecked;
+  }
+
+  /// PipelinedCapture: Click
+  /// @param sender 使用しない
+  /// @param e 使用しない
+  private void PipelinedCapture_Click(object sender, RoutedEventArgs e) {
+    App.Options.PipelinedCapture = this.PipelinedCapture.IsChecked;
+  }
+
+  /// AdaptiveScaleQuality: Click
+  /// @param sender 使用しない
+  /// @param e 使用しない
+  private void AdaptiveScaleQuality_Click(object sender, RoutedEventArgs e) {
+    App.Options.AdaptiveScaleQuality = this.AdaptiveScaleQuality.IsChecked;
+  }
+
   /// RecentProfile1: Click
   /// @param sender 使用しない
   /// @param e 使用しない
@@ -182,6 +203,9 @@ public partial class MainMenu : UserControl, IBindingOptions {
     this.RestoreMissingWindowWhenOpeningProfile.IsChecked =
         App.Options.RestoreMissingWindowWhenOpeningProfile;
     this.EnableGPUPreviewRendering.IsChecked = App.Options.EnableGPUPreviewRendering;
+    this.DirectRendering.IsChecked = App.Options.DirectRendering;
+    this.PipelinedCapture.IsChecked = App.Options.PipelinedCapture;
+    this.AdaptiveScaleQuality.IsChecked = App.Options.AdaptiveScaleQuality;
     this.CanChangeOptions = true;
   }
 }
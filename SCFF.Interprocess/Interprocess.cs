@@ -69,6 +69,7 @@ public enum ImagePixelFormats {
   UYVY,                       ///< UYVY(16bit)
   YUY2,                       ///< YUY2(16bit)
   RGB0,                       ///< RGB0(32bit)
+  NV12,                       ///< NV12(12bit)
   SupportedPixelFormatsCount  ///< 対応ピクセルフォーマット数
 }
 
@@ -101,6 +102,30 @@ public enum RotateDirections {
   Degrees270    ///< 時計回り270度
 }
 
+/// 描画方法を表す定数
+/// @sa scff_imaging/imaging_types.h
+/// @sa scff_imaging::RenderingModes
+public enum RenderingModes {
+  Buffered = 0, ///< バッファに描画してサンプルにコピー
+  Direct        ///< サンプルのバッファに直接描画
+}
+
+/// キャプチャと変換の実行方法を表す定数
+/// @sa scff_imaging/imaging_types.h
+/// @sa scff_imaging::PipelineModes
+public enum PipelineModes {
+  Serial = 0,   ///< キャプチャと変換を同じスレッドで続けて行う
+  Pipelined     ///< キャプチャ専用スレッドと変換を並行して行う
+}
+
+/// 拡大縮小の品質の決め方を表す定数
+/// @sa scff_imaging/imaging_types.h
+/// @sa scff_imaging::ScaleQualityModes
+public enum ScaleQualityModes {
+  Fixed = 0,    ///< 常にレイアウトパラメータどおりの拡大縮小メソッドを使う
+  Adaptive      ///< 処理が間に合わなければ軽いメソッドに切り替える
+}
+
 /// 共有メモリ(Directory)に格納する構造体のエントリ
 [StructLayout(LayoutKind.Sequential, Pack = 1)]
 public struct Entry {
@@ -118,6 +143,17 @@ public struct Entry {
   public Int32 SamplePixelFormat;
   /// 目標fps
   public Double FPS;
+  /// 現在のキャプチャと変換の実行方法
+  /// @attention PipelineModesを操作に使うこと
+  public Int32 PipelineMode;
+  /// Pipelined: キャプチャ完了から変換開始までの遅延の平均(ミリ秒)
+  public Double PipelineLatencyAverage;
+  /// Pipelined: キャプチャ完了から変換開始までの遅延の最大(ミリ秒)
+  public Double PipelineLatencyMax;
+  /// Pipelined: 変換されずに捨てられたキャプチャの数
+  public Int64 PipelineDroppedFrames;
+  /// Pipelined: 新しいキャプチャが間に合わなかったフレームの数
+  public Int64 PipelineRepeatedFrames;
 }
 
 /// 共有メモリ(Directory)に格納する構造体
@@ -192,6 +228,9 @@ public struct LayoutParameter {
   /// 回転方向
   /// @attention RotateDirectionを操作に使うこと
   public Int32 RotateDirection;
+  /// 不透明度(0:完全に透明 - 255:不透明)
+  /// @warning NullLayout,NativeLayoutでは無視される
+  public Byte Opacity;
 }
 
 /// 共有メモリ(Message)に格納する構造体
@@ -209,6 +248,15 @@ public struct Message {
   /// レイアウトパラメータの配列
   [MarshalAs(UnmanagedType.ByValArray, SizeConst = Interprocess.MaxComplexLayoutElements)]
   public LayoutParameter[] LayoutParameters;
+  /// 描画方法
+  /// @attention RenderingModesを操作に使うこと
+  public Int32 RenderingMode;
+  /// キャプチャと変換の実行方法
+  /// @attention PipelineModesを操作に使うこと
+  public Int32 PipelineMode;
+  /// 拡大縮小の品質の決め方
+  /// @attention ScaleQualityModesを操作に使うこと
+  public Int32 ScaleQualityMode;
 }
 
 /// プロセス間通信を担当するクラス
@@ -230,16 +278,18 @@ public class Interprocess {
   //-------------------------------------------------------------------
 
   /// 共有メモリ名: SCFFエントリを格納するディレクトリ
-  private const string DirectoryName = "scff_v1_directory";
+  /// @attention Entryの構造を変えたらバージョンを上げること
+  private const string DirectoryName = "scff_v2_directory";
 
   /// Directoryの保護用Mutex名
-  private const string DirectoryMutexName = "mutex_scff_v1_directory";
+  private const string DirectoryMutexName = "mutex_scff_v2_directory";
 
   /// 共有メモリ名の接頭辞: SCFFで使うメッセージを格納する
-  private const string MessageNamePrefix = "scff_v1_message_";
+  /// @attention Messageの構造を変えたらバージョンを上げること
+  private const string MessageNamePrefix = "scff_v3_message_";
 
   /// Messageの保護用Mutex名の接頭辞
-  private const string MessageMutexNamePrefix = "mutex_scff_v1_message_";
+  private const string MessageMutexNamePrefix = "mutex_scff_v3_message_";
 
   /// イベント名の接頭辞
   private const string ErrorEventNamePrefix = "scff_v1_error_event_";
@@ -627,6 +677,11 @@ public class Interprocess {
         directory.Entries[i].SampleWidth = 0;
         directory.Entries[i].SampleHeight = 0;
         directory.Entries[i].FPS = 0.0;
+        directory.Entries[i].PipelineMode = 0;
+        directory.Entries[i].PipelineLatencyAverage = 0.0;
+        directory.Entries[i].PipelineLatencyMax = 0.0;
+        directory.Entries[i].PipelineDroppedFrames = 0;
+        directory.Entries[i].PipelineRepeatedFrames = 0;
         Trace.WriteLine("****Interprocess: RemoveEntry SUCCESS");
         break;
       }
@@ -641,6 +696,41 @@ public class Interprocess {
     return true;
   }
 
+  /// 同じプロセスIDのエントリを書き換える
+  /// @param entry 書き換えるエントリ
+  /// @return 書き換えが成功したか
+  public bool UpdateEntry(Entry entry) {
+    // 初期化されていなければ失敗
+    if (!this.IsDirectoryInitialized()) {
+      return false;
+    }
+
+    // 定期的に呼ばれるのでTraceはしない
+
+    // ロック取得
+    this.mutexDirectory.WaitOne();
+
+    // コピー取得
+    Directory directory = this.ReadDirectory();
+
+    bool success = false;
+    for (int i = 0; i < MaxEntry; i++) {
+      if (directory.Entries[i].ProcessID == entry.ProcessID) {
+        directory.Entries[i] = entry;
+        success = true;
+        break;
+      }
+    }
+
+    // 変更を適用
+    this.WriteDirectory(directory);
+
+    // ロック解放
+    this.mutexDirectory.ReleaseMutex();
+
+    return success;
+  }
+
   /// メッセージを受け取る
   /// @pre 事前にInitMessageが実行されている必要がある
   /// @param[out] message 受けとったメッセージ
@@ -58,6 +58,7 @@ typedef struct FFDrawContext {
     uint8_t vsub[MAX_PLANES];  /*< vertical subsampling */
     uint8_t hsub_max;
     uint8_t vsub_max;
+    uint8_t packed_yuv422; /*< 1 + byte offset of luma in packed 4:2:2, or 0 */
 } FFDrawContext;
 
 typedef struct FFDrawColor {
@@ -74,6 +75,13 @@ typedef struct FFDrawColor {
  *
  * Only a limited number of pixel formats are supported, if format is not
  * supported the function will return an error.
+ * Packed 4:2:2 (YUYV422, UYVY422) is handled as one plane of 4-byte
+ * macropixels with hsub = 1; ff_copy_rectangle2(), ff_fill_rectangle() and
+ * ff_blend_rectangle2() still place luma exactly at odd x, while chroma
+ * follows the same rounding as the planar formats. ff_blend_rectangle()
+ * and ff_blend_mask() work on whole macropixels.
+ * NV12 is handled as a luma plane and a 4:2:0 plane of U V pairs
+ * (pixelstep 2), with the same rounding as YUV420P.
  * No flags currently defined.
  * @return  0 for success, < 0 for error
  */
@@ -95,6 +103,20 @@ void ff_copy_rectangle2(FFDrawContext *draw,
                         int dst_x, int dst_y, int src_x, int src_y,
                         int w, int h);
 
+/**
+ * Blend a rectangle from an image into another with a constant opacity.
+ *
+ * Each sample becomes (src * alpha + dst * (255 - alpha)) / 255, rounded
+ * to nearest. alpha = 255 is the same as ff_copy_rectangle2 and
+ * alpha = 0 leaves the destination untouched.
+ * The coordinates must be as even as the subsampling requires.
+ */
+void ff_blend_rectangle2(FFDrawContext *draw,
+                         uint8_t *dst[], int dst_linesize[],
+                         uint8_t *src[], int src_linesize[],
+                         int dst_x, int dst_y, int src_x, int src_y,
+                         int w, int h, int alpha);
+
 /**
  * Fill a rectangle with an uniform color.
  *
@@ -105,6 +127,28 @@ void ff_fill_rectangle(FFDrawContext *draw, FFDrawColor *color,
                        uint8_t *dst[], int dst_linesize[],
                        int dst_x, int dst_y, int w, int h);
 
+/**
+ * Kernel levels for ff_draw_force_simd_level().
+ */
+enum FFDrawSimdLevel {
+    FF_DRAW_SIMD_C = 0,
+    FF_DRAW_SIMD_SSE2,
+    FF_DRAW_SIMD_AVX2,
+};
+
+/**
+ * Select the kernels used by ff_copy_rectangle2(), ff_fill_rectangle() and
+ * ff_blend_rectangle2().
+ *
+ * The best level supported by the CPU and OS is selected automatically;
+ * all levels write exactly the same bytes, so this is only needed to
+ * compare them. Safe to call while other threads draw: each rectangle
+ * is drawn entirely with the kernels selected when it started.
+ * @param level  requested level, lowered to what the CPU supports
+ * @return  the level actually selected
+ */
+int ff_draw_force_simd_level(int level);
+
 /**
  * Blend a rectangle with an uniform color.
  */
@@ -23,6 +23,7 @@
 // 2012/12/02 modified by Alalf
 #include <libavfilter/drawutils.h>
 #include <string.h>
+#include <atomic>
 extern "C" {
 #include <libavutil/avutil.h>
 #include <libavutil/colorspace.h>
@@ -164,6 +165,32 @@ int ff_draw_init(FFDrawContext *draw, enum AVPixelFormat format, unsigned flags)
 
     if (!desc->name)
         return AVERROR(EINVAL);
+    if (format == AV_PIX_FMT_YUYV422 || format == AV_PIX_FMT_UYVY422) {
+        /* one plane of Y0 U Y1 V (or U Y0 V Y1) macropixels */
+        memset(draw, 0, sizeof(*draw));
+        draw->desc          = desc;
+        draw->format        = format;
+        draw->nb_planes     = 1;
+        draw->pixelstep[0]  = 4;
+        draw->comp_mask[0]  = 0xF;
+        draw->hsub[0]       = draw->hsub_max = 1;
+        draw->packed_yuv422 = 1 + (format == AV_PIX_FMT_UYVY422);
+        return 0;
+    }
+    if (format == AV_PIX_FMT_NV12) {
+        /* a luma plane and one plane of interleaved U V at 4:2:0 */
+        memset(draw, 0, sizeof(*draw));
+        draw->desc          = desc;
+        draw->format        = format;
+        draw->nb_planes     = 2;
+        draw->pixelstep[0]  = 1;
+        draw->pixelstep[1]  = 2;
+        draw->comp_mask[0]  = 0x1;
+        draw->comp_mask[1]  = 0x3;
+        draw->hsub[1]       = draw->hsub_max = 1;
+        draw->vsub[1]       = draw->vsub_max = 1;
+        return 0;
+    }
     if (desc->flags & ~(AV_PIX_FMT_FLAG_PLANAR | AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PSEUDOPAL | AV_PIX_FMT_FLAG_ALPHA))
         return AVERROR(ENOSYS);
     for (i = 0; i < desc->nb_components; i++) {
@@ -204,7 +231,21 @@ void ff_draw_color(FFDrawContext *draw, FFDrawColor *color, const uint8_t rgba[4
 
     if (rgba != color->rgba)
         memcpy(color->rgba, rgba, sizeof(color->rgba));
-    if ((draw->desc->flags & AV_PIX_FMT_FLAG_RGB) &&
+    if (draw->packed_yuv422) {
+        const uint8_t y = RGB_TO_Y_CCIR(rgba[0], rgba[1], rgba[2]);
+        const uint8_t u = RGB_TO_U_CCIR(rgba[0], rgba[1], rgba[2], 0);
+        const uint8_t v = RGB_TO_V_CCIR(rgba[0], rgba[1], rgba[2], 0);
+        const int luma = draw->packed_yuv422 - 1;
+
+        color->comp[0].u8[luma]         = y;
+        color->comp[0].u8[luma + 2]     = y;
+        color->comp[0].u8[1 - luma]     = u;
+        color->comp[0].u8[1 - luma + 2] = v;
+    } else if (draw->format == AV_PIX_FMT_NV12) {
+        color->comp[0].u8[0] = RGB_TO_Y_CCIR(rgba[0], rgba[1], rgba[2]);
+        color->comp[1].u8[0] = RGB_TO_U_CCIR(rgba[0], rgba[1], rgba[2], 0);
+        color->comp[1].u8[1] = RGB_TO_V_CCIR(rgba[0], rgba[1], rgba[2], 0);
+    } else if ((draw->desc->flags & AV_PIX_FMT_FLAG_RGB) &&
         ff_fill_rgba_map(rgba_map, draw->format) >= 0) {
         if (draw->nb_planes == 1) {
         for (i = 0; i < 4; i++)
@@ -229,6 +270,598 @@ void ff_draw_color(FFDrawContext *draw, FFDrawColor *color, const uint8_t rgba[4
     }
 }
 
+//---------------------------------------------------------------------
+// SIMD row kernels for ff_copy_rectangle2(), ff_fill_rectangle() and
+// ff_blend_rectangle2(), including the packed 4:2:2 paths.
+// The plain C versions are kept as the reference; every variant writes
+// exactly the same bytes.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DRAWUTILS_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define DRAWUTILS_TARGET_SSE2
+#define DRAWUTILS_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define DRAWUTILS_TARGET_SSE2 __attribute__((target("sse2")))
+#define DRAWUTILS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+/* Planes at least this large (in bytes) are copied with non-temporal
+ * stores, since they would only evict the rest of the cache.
+ * Fills of such planes use the C kernel: the row memcpy() measured
+ * faster than streaming the pattern. */
+#define NON_TEMPORAL_THRESHOLD (1 << 20)
+
+typedef void (*copy_plane_func)(uint8_t *dst, int dst_linesize,
+                                const uint8_t *src, int src_linesize,
+                                int wp, int hp);
+typedef void (*fill_plane_func)(uint8_t *dst, int dst_linesize,
+                                const uint8_t *pixel, int pixelstep,
+                                int wp, int hp);
+typedef void (*blend_plane_func)(uint8_t *dst, int dst_linesize,
+                                 const uint8_t *src, int src_linesize,
+                                 int alpha, int wp, int hp);
+/* Writes only the bytes whose index has the given parity (luma or chroma
+ * of packed 4:2:2) with src, or with pattern[i & 3] if src is NULL,
+ * blended with alpha if it is below 255. The two luma bytes of a pattern
+ * are equal, so dst does not have to start on a macropixel. */
+typedef void (*packed_row_func)(uint8_t *dst, const uint8_t *src,
+                                const uint8_t *pattern, int bytes,
+                                int parity, int alpha);
+
+static void copy_plane_c(uint8_t *dst, int dst_linesize,
+                         const uint8_t *src, int src_linesize,
+                         int wp, int hp)
+{
+    int y;
+
+    for (y = 0; y < hp; y++) {
+        memcpy(dst, src, wp);
+        src += src_linesize;
+        dst += dst_linesize;
+    }
+}
+
+static void fill_plane_c(uint8_t *dst, int dst_linesize,
+                         const uint8_t *pixel, int pixelstep,
+                         int wp, int hp)
+{
+    int x, y;
+    uint8_t *p;
+
+    if (!hp)
+        return;
+    p = dst;
+    /* copy first line from color */
+    for (x = 0; x < wp; x++) {
+        memcpy(p, pixel, pixelstep);
+        p += pixelstep;
+    }
+    wp *= pixelstep;
+    /* copy next lines from first line */
+    p = dst + dst_linesize;
+    for (y = 1; y < hp; y++) {
+        memcpy(p, dst, wp);
+        p += dst_linesize;
+    }
+}
+
+/* (src * alpha + dst * (255 - alpha)) / 255, rounded to nearest.
+ * The sum fits in 16 bits, so the SIMD kernels can use the same formula. */
+static inline unsigned blend_byte(unsigned src, unsigned dst,
+                                  unsigned alpha, unsigned beta)
+{
+    unsigned t = src * alpha + dst * beta + 128;
+
+    return (t + (t >> 8)) >> 8;
+}
+
+static void blend_plane_c(uint8_t *dst, int dst_linesize,
+                          const uint8_t *src, int src_linesize,
+                          int alpha, int wp, int hp)
+{
+    const unsigned beta = 255 - alpha;
+    int x, y;
+
+    for (y = 0; y < hp; y++) {
+        for (x = 0; x < wp; x++)
+            dst[x] = blend_byte(src[x], dst[x], alpha, beta);
+        src += src_linesize;
+        dst += dst_linesize;
+    }
+}
+
+static void packed_row_c(uint8_t *dst, const uint8_t *src,
+                         const uint8_t *pattern, int bytes,
+                         int parity, int alpha)
+{
+    int i;
+
+    for (i = parity; i < bytes; i += 2) {
+        const unsigned v = src ? src[i] : pattern[i & 3];
+        dst[i] = alpha < 255 ? blend_byte(v, dst[i], alpha, 255 - alpha) : v;
+    }
+}
+
+#if defined(DRAWUTILS_X86)
+/**
+ * Build a table where table[i] == pixel[i % pixelstep].
+ * Any 32 bytes starting at table + k (k < pixelstep) are then the color
+ * pattern for a row position whose byte offset modulo pixelstep is k.
+ */
+static void build_fill_table(uint8_t table[64], const uint8_t *pixel,
+                             int pixelstep)
+{
+    int i;
+
+    for (i = 0; i < 64; i++)
+        table[i] = pixel[i % pixelstep];
+}
+
+DRAWUTILS_TARGET_SSE2
+static void copy_row_sse2(uint8_t *dst, const uint8_t *src, int bytes, int nt)
+{
+    int i = 0;
+
+    if (nt) {
+        /* non-temporal stores need an aligned destination */
+        const int head = FFMIN(bytes, (int)((16 - ((uintptr_t)dst & 15)) & 15));
+        memcpy(dst, src, head);
+        i = head;
+        for (; i + 64 <= bytes; i += 64) {
+            const __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+            const __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+            const __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+            const __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+            _mm_stream_si128((__m128i *)(dst + i), a);
+            _mm_stream_si128((__m128i *)(dst + i + 16), b);
+            _mm_stream_si128((__m128i *)(dst + i + 32), c);
+            _mm_stream_si128((__m128i *)(dst + i + 48), d);
+        }
+        for (; i + 16 <= bytes; i += 16)
+            _mm_stream_si128((__m128i *)(dst + i),
+                             _mm_loadu_si128((const __m128i *)(src + i)));
+    } else {
+        for (; i + 64 <= bytes; i += 64) {
+            const __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+            const __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+            const __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+            const __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+            _mm_storeu_si128((__m128i *)(dst + i), a);
+            _mm_storeu_si128((__m128i *)(dst + i + 16), b);
+            _mm_storeu_si128((__m128i *)(dst + i + 32), c);
+            _mm_storeu_si128((__m128i *)(dst + i + 48), d);
+        }
+        for (; i + 16 <= bytes; i += 16)
+            _mm_storeu_si128((__m128i *)(dst + i),
+                             _mm_loadu_si128((const __m128i *)(src + i)));
+    }
+    memcpy(dst + i, src + i, bytes - i);
+}
+
+DRAWUTILS_TARGET_SSE2
+static void copy_plane_sse2(uint8_t *dst, int dst_linesize,
+                            const uint8_t *src, int src_linesize,
+                            int wp, int hp)
+{
+    const int nt = (int64_t)wp * hp >= NON_TEMPORAL_THRESHOLD;
+    int y;
+
+    for (y = 0; y < hp; y++) {
+        copy_row_sse2(dst, src, wp, nt);
+        src += src_linesize;
+        dst += dst_linesize;
+    }
+    if (nt)
+        _mm_sfence();
+}
+
+DRAWUTILS_TARGET_SSE2
+static void fill_row_sse2(uint8_t *dst, const uint8_t *table, int pixelstep,
+                          int bytes)
+{
+    int i = 0;
+    /* 16 is a multiple of pixelstep, so one register covers every store */
+    const __m128i v = _mm_loadu_si128((const __m128i *)table);
+
+    for (; i + 64 <= bytes; i += 64) {
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 16), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 32), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 48), v);
+    }
+    for (; i + 16 <= bytes; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    for (; i < bytes; i++)
+        dst[i] = table[i % pixelstep];
+}
+
+DRAWUTILS_TARGET_SSE2
+static void fill_plane_sse2(uint8_t *dst, int dst_linesize,
+                            const uint8_t *pixel, int pixelstep,
+                            int wp, int hp)
+{
+    const int bytes = wp * pixelstep;
+    uint8_t table[64];
+    int y;
+
+    /* e.g. RGB24: the pattern does not fit in a register */
+    if (16 % pixelstep || (int64_t)bytes * hp >= NON_TEMPORAL_THRESHOLD) {
+        fill_plane_c(dst, dst_linesize, pixel, pixelstep, wp, hp);
+        return;
+    }
+    build_fill_table(table, pixel, pixelstep);
+    for (y = 0; y < hp; y++) {
+        fill_row_sse2(dst, table, pixelstep, bytes);
+        dst += dst_linesize;
+    }
+}
+
+DRAWUTILS_TARGET_AVX2
+static void copy_row_avx2(uint8_t *dst, const uint8_t *src, int bytes, int nt)
+{
+    int i = 0;
+
+    if (nt) {
+        const int head = FFMIN(bytes, (int)((32 - ((uintptr_t)dst & 31)) & 31));
+        memcpy(dst, src, head);
+        i = head;
+        for (; i + 128 <= bytes; i += 128) {
+            const __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+            const __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+            const __m256i c = _mm256_loadu_si256((const __m256i *)(src + i + 64));
+            const __m256i d = _mm256_loadu_si256((const __m256i *)(src + i + 96));
+            _mm256_stream_si256((__m256i *)(dst + i), a);
+            _mm256_stream_si256((__m256i *)(dst + i + 32), b);
+            _mm256_stream_si256((__m256i *)(dst + i + 64), c);
+            _mm256_stream_si256((__m256i *)(dst + i + 96), d);
+        }
+        for (; i + 32 <= bytes; i += 32)
+            _mm256_stream_si256((__m256i *)(dst + i),
+                                _mm256_loadu_si256((const __m256i *)(src + i)));
+    } else {
+        for (; i + 128 <= bytes; i += 128) {
+            const __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+            const __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+            const __m256i c = _mm256_loadu_si256((const __m256i *)(src + i + 64));
+            const __m256i d = _mm256_loadu_si256((const __m256i *)(src + i + 96));
+            _mm256_storeu_si256((__m256i *)(dst + i), a);
+            _mm256_storeu_si256((__m256i *)(dst + i + 32), b);
+            _mm256_storeu_si256((__m256i *)(dst + i + 64), c);
+            _mm256_storeu_si256((__m256i *)(dst + i + 96), d);
+        }
+        for (; i + 32 <= bytes; i += 32)
+            _mm256_storeu_si256((__m256i *)(dst + i),
+                                _mm256_loadu_si256((const __m256i *)(src + i)));
+    }
+    memcpy(dst + i, src + i, bytes - i);
+}
+
+DRAWUTILS_TARGET_AVX2
+static void copy_plane_avx2(uint8_t *dst, int dst_linesize,
+                            const uint8_t *src, int src_linesize,
+                            int wp, int hp)
+{
+    const int nt = (int64_t)wp * hp >= NON_TEMPORAL_THRESHOLD;
+    int y;
+
+    for (y = 0; y < hp; y++) {
+        copy_row_avx2(dst, src, wp, nt);
+        src += src_linesize;
+        dst += dst_linesize;
+    }
+    if (nt)
+        _mm_sfence();
+    _mm256_zeroupper();
+}
+
+DRAWUTILS_TARGET_AVX2
+static void fill_row_avx2(uint8_t *dst, const uint8_t *table, int pixelstep,
+                          int bytes)
+{
+    int i = 0;
+    /* 32 is a multiple of pixelstep, so one register covers every store */
+    const __m256i v = _mm256_loadu_si256((const __m256i *)table);
+
+    for (; i + 128 <= bytes; i += 128) {
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+        _mm256_storeu_si256((__m256i *)(dst + i + 32), v);
+        _mm256_storeu_si256((__m256i *)(dst + i + 64), v);
+        _mm256_storeu_si256((__m256i *)(dst + i + 96), v);
+    }
+    for (; i + 32 <= bytes; i += 32)
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    for (; i < bytes; i++)
+        dst[i] = table[i % pixelstep];
+}
+
+DRAWUTILS_TARGET_AVX2
+static void fill_plane_avx2(uint8_t *dst, int dst_linesize,
+                            const uint8_t *pixel, int pixelstep,
+                            int wp, int hp)
+{
+    const int bytes = wp * pixelstep;
+    uint8_t table[64];
+    int y;
+
+    if (32 % pixelstep || (int64_t)bytes * hp >= NON_TEMPORAL_THRESHOLD) {
+        fill_plane_c(dst, dst_linesize, pixel, pixelstep, wp, hp);
+        return;
+    }
+    build_fill_table(table, pixel, pixelstep);
+    for (y = 0; y < hp; y++) {
+        fill_row_avx2(dst, table, pixelstep, bytes);
+        dst += dst_linesize;
+    }
+    _mm256_zeroupper();
+}
+
+DRAWUTILS_TARGET_SSE2
+static inline __m128i blend_half_sse2(__m128i src, __m128i dst,
+                                      __m128i alpha, __m128i beta)
+{
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(src, alpha),
+                              _mm_mullo_epi16(dst, beta));
+
+    t = _mm_add_epi16(t, bias);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+DRAWUTILS_TARGET_SSE2
+static void blend_plane_sse2(uint8_t *dst, int dst_linesize,
+                             const uint8_t *src, int src_linesize,
+                             int alpha, int wp, int hp)
+{
+    const unsigned beta = 255 - alpha;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i va = _mm_set1_epi16((short)alpha);
+    const __m128i vb = _mm_set1_epi16((short)beta);
+    int x, y;
+
+    for (y = 0; y < hp; y++) {
+        for (x = 0; x + 16 <= wp; x += 16) {
+            const __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+            const __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+            const __m128i lo = blend_half_sse2(_mm_unpacklo_epi8(s, zero),
+                                               _mm_unpacklo_epi8(d, zero),
+                                               va, vb);
+            const __m128i hi = blend_half_sse2(_mm_unpackhi_epi8(s, zero),
+                                               _mm_unpackhi_epi8(d, zero),
+                                               va, vb);
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(lo, hi));
+        }
+        for (; x < wp; x++)
+            dst[x] = blend_byte(src[x], dst[x], alpha, beta);
+        src += src_linesize;
+        dst += dst_linesize;
+    }
+}
+
+DRAWUTILS_TARGET_AVX2
+static inline __m256i blend_half_avx2(__m256i src, __m256i dst,
+                                      __m256i alpha, __m256i beta)
+{
+    const __m256i bias = _mm256_set1_epi16(128);
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(src, alpha),
+                                 _mm256_mullo_epi16(dst, beta));
+
+    t = _mm256_add_epi16(t, bias);
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+DRAWUTILS_TARGET_AVX2
+static void blend_plane_avx2(uint8_t *dst, int dst_linesize,
+                             const uint8_t *src, int src_linesize,
+                             int alpha, int wp, int hp)
+{
+    const unsigned beta = 255 - alpha;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i va = _mm256_set1_epi16((short)alpha);
+    const __m256i vb = _mm256_set1_epi16((short)beta);
+    int x, y;
+
+    for (y = 0; y < hp; y++) {
+        /* unpack and pack both work within 128-bit lanes,
+         * so the bytes come back in their original order */
+        for (x = 0; x + 32 <= wp; x += 32) {
+            const __m256i s = _mm256_loadu_si256((const __m256i *)(src + x));
+            const __m256i d = _mm256_loadu_si256((const __m256i *)(dst + x));
+            const __m256i lo = blend_half_avx2(_mm256_unpacklo_epi8(s, zero),
+                                               _mm256_unpacklo_epi8(d, zero),
+                                               va, vb);
+            const __m256i hi = blend_half_avx2(_mm256_unpackhi_epi8(s, zero),
+                                               _mm256_unpackhi_epi8(d, zero),
+                                               va, vb);
+            _mm256_storeu_si256((__m256i *)(dst + x),
+                                _mm256_packus_epi16(lo, hi));
+        }
+        for (; x < wp; x++)
+            dst[x] = blend_byte(src[x], dst[x], alpha, beta);
+        src += src_linesize;
+        dst += dst_linesize;
+    }
+    _mm256_zeroupper();
+}
+
+DRAWUTILS_TARGET_SSE2
+static void packed_row_sse2(uint8_t *dst, const uint8_t *src,
+                            const uint8_t *pattern, int bytes,
+                            int parity, int alpha)
+{
+    const __m128i mask = _mm_set1_epi16(parity ? (short)0xFF00 : 0x00FF);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i va = _mm_set1_epi16((short)alpha);
+    const __m128i vb = _mm_set1_epi16((short)(255 - alpha));
+    __m128i fill = zero;
+    int i = 0;
+
+    if (!src) {
+        int32_t word;
+        memcpy(&word, pattern, 4);
+        fill = _mm_set1_epi32(word);
+    }
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i s = src ? _mm_loadu_si128((const __m128i *)(src + i)) : fill;
+        if (alpha < 255) {
+            const __m128i lo = blend_half_sse2(_mm_unpacklo_epi8(s, zero),
+                                               _mm_unpacklo_epi8(d, zero),
+                                               va, vb);
+            const __m128i hi = blend_half_sse2(_mm_unpackhi_epi8(s, zero),
+                                               _mm_unpackhi_epi8(d, zero),
+                                               va, vb);
+            s = _mm_packus_epi16(lo, hi);
+        }
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_or_si128(_mm_and_si128(s, mask),
+                                      _mm_andnot_si128(mask, d)));
+    }
+    packed_row_c(dst + i, src ? src + i : NULL, pattern, bytes - i,
+                 parity, alpha);
+}
+
+DRAWUTILS_TARGET_AVX2
+static void packed_row_avx2(uint8_t *dst, const uint8_t *src,
+                            const uint8_t *pattern, int bytes,
+                            int parity, int alpha)
+{
+    const __m256i mask = _mm256_set1_epi16(parity ? (short)0xFF00 : 0x00FF);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i va = _mm256_set1_epi16((short)alpha);
+    const __m256i vb = _mm256_set1_epi16((short)(255 - alpha));
+    __m256i fill = zero;
+    int i = 0;
+
+    if (!src) {
+        int32_t word;
+        memcpy(&word, pattern, 4);
+        fill = _mm256_set1_epi32(word);
+    }
+    for (; i + 32 <= bytes; i += 32) {
+        const __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i s = src ? _mm256_loadu_si256((const __m256i *)(src + i)) : fill;
+        if (alpha < 255) {
+            const __m256i lo = blend_half_avx2(_mm256_unpacklo_epi8(s, zero),
+                                               _mm256_unpacklo_epi8(d, zero),
+                                               va, vb);
+            const __m256i hi = blend_half_avx2(_mm256_unpackhi_epi8(s, zero),
+                                               _mm256_unpackhi_epi8(d, zero),
+                                               va, vb);
+            s = _mm256_packus_epi16(lo, hi);
+        }
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm256_or_si256(_mm256_and_si256(s, mask),
+                                            _mm256_andnot_si256(mask, d)));
+    }
+    _mm256_zeroupper();
+    packed_row_c(dst + i, src ? src + i : NULL, pattern, bytes - i,
+                 parity, alpha);
+}
+
+static void cpuid(int info[4], int leaf)
+{
+#if defined(_MSC_VER)
+    __cpuidex(info, leaf, 0);
+#else
+    unsigned a = 0, b = 0, c = 0, d = 0;
+    __cpuid_count(leaf, 0, a, b, c, d);
+    info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+#endif
+}
+
+static uint64_t xgetbv0(void)
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned a = 0, d = 0;
+    __asm__ volatile("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return ((uint64_t)d << 32) | a;
+#endif
+}
+#endif  /* DRAWUTILS_X86 */
+
+/** Highest kernel level supported by this CPU and OS. */
+static int detect_simd_level(void)
+{
+    int level = FF_DRAW_SIMD_C;
+#if defined(DRAWUTILS_X86)
+    int info[4];
+    int max_leaf;
+
+    cpuid(info, 0);
+    max_leaf = info[0];
+    if (max_leaf < 1)
+        return level;
+    cpuid(info, 1);
+    if (!(info[3] & (1 << 26)))     /* SSE2 */
+        return level;
+    level = FF_DRAW_SIMD_SSE2;
+    /* AVX2 also needs the OS to save the YMM registers (OSXSAVE + AVX) */
+    if (max_leaf >= 7 &&
+        (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+        (xgetbv0() & 6) == 6) {
+        cpuid(info, 7);
+        if (info[1] & (1 << 5))     /* AVX2 */
+            level = FF_DRAW_SIMD_AVX2;
+    }
+#endif
+    return level;
+}
+
+/** One set of kernels; a rectangle is drawn entirely with one set. */
+typedef struct DrawKernels {
+    copy_plane_func copy_plane;
+    fill_plane_func fill_plane;
+    blend_plane_func blend_plane;
+    packed_row_func packed_row;
+} DrawKernels;
+
+static const DrawKernels kernels_c = {
+    copy_plane_c, fill_plane_c, blend_plane_c, packed_row_c
+};
+#if defined(DRAWUTILS_X86)
+static const DrawKernels kernels_sse2 = {
+    copy_plane_sse2, fill_plane_sse2, blend_plane_sse2, packed_row_sse2
+};
+static const DrawKernels kernels_avx2 = {
+    copy_plane_avx2, fill_plane_avx2, blend_plane_avx2, packed_row_avx2
+};
+#endif
+
+/* Swapped as a whole, so drawing threads never see a half-switched set. */
+static std::atomic<const DrawKernels *> kernels(&kernels_c);
+
+int ff_draw_force_simd_level(int level)
+{
+    const DrawKernels *selected = &kernels_c;
+
+    level = FFMAX(FF_DRAW_SIMD_C, FFMIN(level, detect_simd_level()));
+    switch (level) {
+#if defined(DRAWUTILS_X86)
+    case FF_DRAW_SIMD_AVX2:
+        selected = &kernels_avx2;
+        break;
+    case FF_DRAW_SIMD_SSE2:
+        selected = &kernels_sse2;
+        break;
+#endif
+    default:
+        break;
+    }
+    kernels.store(selected, std::memory_order_release);
+    return level;
+}
+
+/* Pick the best kernels once, while the module is loaded. */
+static const int initial_simd_level = ff_draw_force_simd_level(FF_DRAW_SIMD_AVX2);
+//---------------------------------------------------------------------
+
 static uint8_t *pointer_at(FFDrawContext *draw, uint8_t *data[], int linesize[],
                            int plane, int x, int y)
 {
@@ -237,25 +870,102 @@ static uint8_t *pointer_at(FFDrawContext *draw, uint8_t *data[], int linesize[],
            (x >> draw->hsub[plane]) * draw->pixelstep[plane];
 }
 
+/**
+ * Copy (src), fill (pattern) or blend a rectangle of packed 4:2:2 whose
+ * x or width is odd, so that whole macropixels can not be used.
+ * Luma is written for exactly the pixels [dst_x; dst_x+w[, chroma for the
+ * macropixels ff_copy_rectangle2() would write in a planar format.
+ */
+static void packed_yuv422_rectangle(FFDrawContext *draw,
+                                    uint8_t *dst, int dst_linesize,
+                                    const uint8_t *src, int src_linesize,
+                                    const uint8_t *pattern,
+                                    int dst_x, int dst_y, int src_x, int src_y,
+                                    int w, int h, int alpha)
+{
+    const int luma = draw->packed_yuv422 - 1;
+    const int chroma_bytes = FF_CEIL_RSHIFT(w, 1) * 4;
+    uint8_t *dl = dst + dst_y * dst_linesize + dst_x * 2;
+    uint8_t *dc = dst + dst_y * dst_linesize + (dst_x >> 1) * 4;
+    const uint8_t *sl = NULL, *sc = NULL;
+    const packed_row_func packed_row =
+        kernels.load(std::memory_order_acquire)->packed_row;
+    int y;
+
+    if (src) {
+        sl = src + src_y * src_linesize + src_x * 2;
+        sc = src + src_y * src_linesize + (src_x >> 1) * 4;
+    }
+    for (y = 0; y < h; y++) {
+        /* chroma starts on a macropixel, luma on the pixel itself */
+        packed_row(dc, sc, pattern, chroma_bytes, 1 - luma, alpha);
+        packed_row(dl, sl, pattern, w * 2, luma, alpha);
+        dl += dst_linesize;
+        dc += dst_linesize;
+        if (src) {
+            sl += src_linesize;
+            sc += src_linesize;
+        }
+    }
+}
+
 void ff_copy_rectangle2(FFDrawContext *draw,
                         uint8_t *dst[], int dst_linesize[],
                         uint8_t *src[], int src_linesize[],
                         int dst_x, int dst_y, int src_x, int src_y,
                         int w, int h)
 {
-    int plane, y, wp, hp;
+    const copy_plane_func copy_plane =
+        kernels.load(std::memory_order_acquire)->copy_plane;
+    int plane, wp, hp;
     uint8_t *p, *q;
 
+    if (draw->packed_yuv422 && ((dst_x | src_x | w) & 1)) {
+        packed_yuv422_rectangle(draw, dst[0], dst_linesize[0],
+                                src[0], src_linesize[0], NULL,
+                                dst_x, dst_y, src_x, src_y, w, h, 255);
+        return;
+    }
     for (plane = 0; plane < draw->nb_planes; plane++) {
         p = pointer_at(draw, src, src_linesize, plane, src_x, src_y);
         q = pointer_at(draw, dst, dst_linesize, plane, dst_x, dst_y);
         wp = FF_CEIL_RSHIFT(w, draw->hsub[plane]) * draw->pixelstep[plane];
         hp = FF_CEIL_RSHIFT(h, draw->vsub[plane]);
-        for (y = 0; y < hp; y++) {
-            memcpy(q, p, wp);
-            p += src_linesize[plane];
-            q += dst_linesize[plane];
-        }
+        copy_plane(q, dst_linesize[plane], p, src_linesize[plane], wp, hp);
+    }
+}
+
+void ff_blend_rectangle2(FFDrawContext *draw,
+                         uint8_t *dst[], int dst_linesize[],
+                         uint8_t *src[], int src_linesize[],
+                         int dst_x, int dst_y, int src_x, int src_y,
+                         int w, int h, int alpha)
+{
+    const blend_plane_func blend_plane =
+        kernels.load(std::memory_order_acquire)->blend_plane;
+    int plane, wp, hp;
+    uint8_t *p, *q;
+
+    if (alpha <= 0)
+        return;
+    if (alpha >= 255) {
+        ff_copy_rectangle2(draw, dst, dst_linesize, src, src_linesize,
+                           dst_x, dst_y, src_x, src_y, w, h);
+        return;
+    }
+    if (draw->packed_yuv422 && ((dst_x | src_x | w) & 1)) {
+        packed_yuv422_rectangle(draw, dst[0], dst_linesize[0],
+                                src[0], src_linesize[0], NULL,
+                                dst_x, dst_y, src_x, src_y, w, h, alpha);
+        return;
+    }
+    for (plane = 0; plane < draw->nb_planes; plane++) {
+        p = pointer_at(draw, src, src_linesize, plane, src_x, src_y);
+        q = pointer_at(draw, dst, dst_linesize, plane, dst_x, dst_y);
+        wp = FF_CEIL_RSHIFT(w, draw->hsub[plane]) * draw->pixelstep[plane];
+        hp = FF_CEIL_RSHIFT(h, draw->vsub[plane]);
+        blend_plane(q, dst_linesize[plane], p, src_linesize[plane],
+                    alpha, wp, hp);
     }
 }
 
@@ -263,28 +973,25 @@ void ff_fill_rectangle(FFDrawContext *draw, FFDrawColor *color,
                        uint8_t *dst[], int dst_linesize[],
                        int dst_x, int dst_y, int w, int h)
 {
-    int plane, x, y, wp, hp;
-    uint8_t *p0, *p;
+    const fill_plane_func fill_plane =
+        kernels.load(std::memory_order_acquire)->fill_plane;
+    int plane, wp, hp;
+    uint8_t *p0;
 
+    if (draw->packed_yuv422 && ((dst_x | w) & 1)) {
+        packed_yuv422_rectangle(draw, dst[0], dst_linesize[0], NULL, 0,
+                                color->comp[0].u8,
+                                dst_x, dst_y, 0, 0, w, h, 255);
+        return;
+    }
     for (plane = 0; plane < draw->nb_planes; plane++) {
         p0 = pointer_at(draw, dst, dst_linesize, plane, dst_x, dst_y);
         wp = FF_CEIL_RSHIFT(w, draw->hsub[plane]);
         hp = FF_CEIL_RSHIFT(h, draw->vsub[plane]);
         if (!hp)
             return;
-        p = p0;
-        /* copy first line from color */
-        for (x = 0; x < wp; x++) {
-            memcpy(p, color->comp[plane].u8, draw->pixelstep[plane]);
-            p += draw->pixelstep[plane];
-        }
-        wp *= draw->pixelstep[plane];
-        /* copy next lines from first line */
-        p = p0 + dst_linesize[plane];
-        for (y = 1; y < hp; y++) {
-            memcpy(p, p0, wp);
-            p += dst_linesize[plane];
-        }
+        fill_plane(p0, dst_linesize[plane],
+                   color->comp[plane].u8, draw->pixelstep[plane], wp, hp);
     }
 }
 
@@ -329,6 +1036,14 @@ static int component_used(FFDrawContext *draw, int plane, int comp)
     return (draw->comp_mask[plane] >> comp) & 1;
 }
 
+/* Number of planes holding color, i.e. without the alpha plane. */
+static unsigned color_planes(FFDrawContext *draw)
+{
+    if (draw->format == AV_PIX_FMT_NV12)
+        return 2;
+    return (draw->nb_planes - 1) | 1;
+}
+
 /* If alpha is in the [ 0 ; 0x1010101 ] range,
    then alpha * value is in the [ 0 ; 0xFFFFFFFF ] range,
    and >> 24 gives a correct rounding. */
@@ -359,18 +1074,20 @@ void ff_blend_rectangle(FFDrawContext *draw, FFDrawColor *color,
                         int dst_w, int dst_h,
                         int x0, int y0, int w, int h)
 {
+    const fill_plane_func fill_plane =
+        kernels.load(std::memory_order_acquire)->fill_plane;
     unsigned alpha, nb_planes, nb_comp, plane, comp;
     int w_sub, h_sub, x_sub, y_sub, left, right, top, bottom, y;
+    int edges_only;
     uint8_t *p0, *p;
 
-    /* TODO optimize if alpha = 0xFF */
     clip_interval(dst_w, &x0, &w, NULL);
     clip_interval(dst_h, &y0, &h, NULL);
     if (w <= 0 || h <= 0 || !color->rgba[3])
         return;
     /* 0x10203 * alpha + 2 is in the [ 2 ; 0x1010101 - 2 ] range */
     alpha = 0x10203 * color->rgba[3] + 0x2;
-    nb_planes = (draw->nb_planes - 1) | 1; /* eliminate alpha */
+    nb_planes = color_planes(draw); /* eliminate alpha */
     for (plane = 0; plane < nb_planes; plane++) {
         nb_comp = draw->pixelstep[plane];
         p0 = pointer_at(draw, dst, dst_linesize, plane, x0, y0);
@@ -380,6 +1097,17 @@ void ff_blend_rectangle(FFDrawContext *draw, FFDrawColor *color,
         y_sub = y0;
         subsampling_bounds(draw->hsub[plane], &x_sub, &w_sub, &left, &right);
         subsampling_bounds(draw->vsub[plane], &y_sub, &h_sub, &top, &bottom);
+        /* An opaque color replaces the fully covered samples exactly, so
+         * they are filled at once and only the partially covered edges are
+         * blended. Planes with unused bytes (e.g. RGB0) keep the slow path
+         * since the fill would overwrite them. */
+        edges_only = color->rgba[3] == 0xFF && w_sub > 0 && h_sub > 0 &&
+                     draw->comp_mask[plane] == (1 << nb_comp) - 1;
+        if (edges_only)
+            fill_plane(p0 + (top ? dst_linesize[plane] : 0) +
+                       (left ? nb_comp : 0),
+                       dst_linesize[plane], color->comp[plane].u8, nb_comp,
+                       w_sub, h_sub);
         for (comp = 0; comp < nb_comp; comp++) {
             if (!component_used(draw, plane, comp))
                 continue;
@@ -391,9 +1119,19 @@ void ff_blend_rectangle(FFDrawContext *draw, FFDrawColor *color,
                 p += dst_linesize[plane];
             }
             for (y = 0; y < h_sub; y++) {
-                blend_line(p, color->comp[plane].u8[comp], alpha,
-                           draw->pixelstep[plane], w_sub,
-                           draw->hsub[plane], left, right);
+                if (edges_only) {
+                    if (left)
+                        blend_line(p, color->comp[plane].u8[comp], alpha,
+                                   nb_comp, 0, draw->hsub[plane], left, 0);
+                    if (right)
+                        blend_line(p + (!!left + w_sub) * nb_comp,
+                                   color->comp[plane].u8[comp], alpha,
+                                   nb_comp, 0, draw->hsub[plane], 0, right);
+                } else {
+                    blend_line(p, color->comp[plane].u8[comp], alpha,
+                               draw->pixelstep[plane], w_sub,
+                               draw->hsub[plane], left, right);
+                }
                 p += dst_linesize[plane];
             }
             if (bottom)
@@ -469,7 +1207,7 @@ void ff_blend_mask(FFDrawContext *draw, FFDrawColor *color,
     /* alpha is in the [ 0 ; 0x10203 ] range,
        alpha * mask is in the [ 0 ; 0x1010101 - 4 ] range */
     alpha = (0x10307 * color->rgba[3] + 0x3) >> 8;
-    nb_planes = (draw->nb_planes - 1) | 1; /* eliminate alpha */
+    nb_planes = color_planes(draw); /* eliminate alpha */
     for (plane = 0; plane < nb_planes; plane++) {
         nb_comp = draw->pixelstep[plane];
         p0 = pointer_at(draw, dst, dst_linesize, plane, x0, y0);
@@ -0,0 +1,287 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_bench/scff_bench.cc
+/// scff_imagingコアライブラリ(ヘッドレスビルド)のベンチマーク
+/// - 合成した入力でScale/Compositor/drawutilsの1フレームあたりの時間を計る
+/// - キャプチャやDirectShowに依存しないのでWindows以外でも実行できる
+/// - 使い方: scff_bench [フレーム数]
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#include <libavfilter/drawutils.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "scff_imaging/avpicture_image.h"
+#include "scff_imaging/avpicture_with_fill_image.h"
+#include "scff_imaging/background_region.h"
+#include "scff_imaging/compositor.h"
+#include "scff_imaging/imaging_types.h"
+#include "scff_imaging/scale.h"
+#include "scff_imaging/scale_stripe_plan.h"
+#include "scff_imaging/utilities.h"
+#include "scff_imaging/worker_pool.h"
+
+namespace {
+
+/// 出力イメージのピクセルフォーマット
+const struct {
+  const char *name;
+  scff_imaging::ImagePixelFormats format;
+} kFormats[] = {
+  {"I420", scff_imaging::ImagePixelFormats::kI420},
+  {"NV12", scff_imaging::ImagePixelFormats::kNV12},
+  {"UYVY", scff_imaging::ImagePixelFormats::kUYVY},
+  {"RGB0", scff_imaging::ImagePixelFormats::kRGB0}
+};
+
+/// 開始時刻からの経過時間(mSec)をframe_countで割る
+double GetFrameTime(std::chrono::high_resolution_clock::time_point start,
+                    int frame_count) {
+  const auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() /
+         frame_count;
+}
+
+/// 画面らしいパターンで入力イメージを作る
+bool CreateInput(int width, int height,
+                 scff_imaging::AVPictureWithFillImage *input) {
+  if (input->Create(scff_imaging::ImagePixelFormats::kRGB0, width, height) !=
+          scff_imaging::ErrorCodes::kNoError) {
+    return false;
+  }
+  scff_imaging::utilities::FillDesktopPattern(input->avpicture(),
+                                              width, height);
+  return true;
+}
+
+/// Scale(キャプチャ1枚分の拡大縮小とピクセルフォーマット変換)
+/// - serial: 分割しない
+/// - striped: WorkerPoolでストライプに分割して並列処理する
+int BenchScale(int frame_count) {
+  const struct {
+    int src_width;
+    int src_height;
+    int dst_width;
+    int dst_height;
+  } kSizes[] = {
+    {1920, 1080, 1920, 1080},
+    {1920, 1080, 1280, 720},
+    {3840, 2160, 1280, 720},
+    {1366, 768, 1920, 1080}
+  };
+
+  const int processor_count =
+      static_cast<int>(std::thread::hardware_concurrency());
+  const int worker_count =
+      std::min(std::max(processor_count - 1, 1),
+               scff_imaging::ScaleStripePlan::kMaxStripeCount - 1);
+  scff_imaging::WorkerPool pool(worker_count);
+
+  scff_imaging::SWScaleConfig config;
+  config.flags = scff_imaging::SWScaleFlags::kBicubic;
+  config.accurate_rnd = false;
+  config.is_filter_enabled = false;
+  config.luma_gblur = 0.0F;
+  config.chroma_gblur = 0.0F;
+  config.luma_sharpen = 0.0F;
+  config.chroma_sharpen = 0.0F;
+  config.chroma_hshift = 0.0F;
+  config.chroma_vshift = 0.0F;
+
+  int ng_count = 0;
+  for (const auto &size : kSizes) {
+    scff_imaging::AVPictureWithFillImage input;
+    if (!CreateInput(size.src_width, size.src_height, &input)) {
+      ng_count++;
+      continue;
+    }
+    for (const auto &format : kFormats) {
+      scff_imaging::AVPictureImage output;
+      output.Create(format.format, size.dst_width, size.dst_height);
+
+      double frame_times[2] = {0.0, 0.0};
+      int stripe_count = 1;
+      for (int striped = 0; striped < 2; striped++) {
+        scff_imaging::Scale scale(config, striped ? &pool : nullptr,
+                                  nullptr, false);
+        scale.SetInputImage(&input);
+        scale.SetOutputImage(&output);
+        if (scale.Init() != scff_imaging::ErrorCodes::kNoError) {
+          ng_count++;
+          continue;
+        }
+        if (striped) stripe_count = scale.stripe_count();
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < frame_count; frame++) {
+          if (scale.Run() != scff_imaging::ErrorCodes::kNoError) {
+            ng_count++;
+            break;
+          }
+        }
+        frame_times[striped] = GetFrameTime(start, frame_count);
+      }
+      printf("Scale[%dx%d->%dx%d %s bicubic]:"
+             " serial=%.2fmSec striped=%.2fmSec stripes=%d\n",
+             size.src_width, size.src_height,
+             size.dst_width, size.dst_height, format.name,
+             frame_times[0], frame_times[1], stripe_count);
+    }
+  }
+  return ng_count;
+}
+
+/// Compositor(ComplexLayoutの合成部分)
+/// - 1920x1080の出力に全画面の要素、重なったワイプ2枚、半透明な要素1枚
+int BenchCompositor(int frame_count) {
+  const int kWidth = 1920;
+  const int kHeight = 1080;
+  const int kElementCount = 4;
+  const scff_imaging::ImageRect kRects[kElementCount] = {
+    {0, 0, kWidth, kHeight},
+    {1280, 720, 480, 270},
+    {1440, 810, 320, 180},
+    {64, 64, 640, 360}
+  };
+  const int kOpacities[kElementCount] = {255, 255, 255, 160};
+
+  int ng_count = 0;
+  for (const auto &format : kFormats) {
+    scff_imaging::AVPictureImage output;
+    output.Create(format.format, kWidth, kHeight);
+    scff_imaging::AVPictureImage elements[kElementCount];
+    AVPicture *element_pictures[kElementCount];
+    for (int i = 0; i < kElementCount; i++) {
+      elements[i].Create(format.format, kRects[i].width, kRects[i].height);
+      element_pictures[i] = elements[i].avpicture();
+    }
+
+    scff_imaging::Compositor compositor;
+    if (!compositor.Init(output.av_pixel_format(), kWidth, kHeight,
+                         kElementCount, kRects, kOpacities)) {
+      ng_count++;
+      continue;
+    }
+    // 取り除かれずに残った要素の順に並べ直す
+    AVPicture *composed[kElementCount];
+    for (int i = 0; i < compositor.element_count(); i++) {
+      composed[i] = element_pictures[compositor.source_index(i)];
+    }
+
+    double frame_times[2] = {0.0, 0.0};
+    for (int persistent = 0; persistent < 2; persistent++) {
+      const auto start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < frame_count; frame++) {
+        compositor.Compose(output.avpicture(), composed, persistent != 0);
+      }
+      frame_times[persistent] = GetFrameTime(start, frame_count);
+    }
+    printf("Compositor[%dx%d %s elements:%d]:"
+           " direct=%.2fmSec buffered=%.2fmSec\n",
+           kWidth, kHeight, format.name, compositor.element_count(),
+           frame_times[0], frame_times[1]);
+  }
+  return ng_count;
+}
+
+/// drawutils(塗りつぶし・コピー・半透明合成)をカーネルの段階ごとに比較する
+int BenchDrawUtils(int frame_count) {
+  const char *kLevelNames[] = {"C", "SSE2", "AVX2"};
+  const int kWidth = 1920;
+  const int kHeight = 1080;
+
+  int ng_count = 0;
+  for (const auto &format : kFormats) {
+    scff_imaging::AVPictureImage source;
+    scff_imaging::AVPictureImage output;
+    source.Create(format.format, kWidth, kHeight);
+    output.Create(format.format, kWidth, kHeight);
+    const AVPixelFormat av_format = output.av_pixel_format();
+
+    FFDrawContext context;
+    FFDrawColor color;
+    uint8_t rgba[4] = {12, 34, 56, 255};
+    if (ff_draw_init(&context, av_format, 0) < 0) {
+      ng_count++;
+      continue;
+    }
+    ff_draw_color(&context, &color, rgba);
+
+    for (int level = FF_DRAW_SIMD_C; level <= FF_DRAW_SIMD_AVX2; level++) {
+      if (ff_draw_force_simd_level(level) != level) {
+        continue;
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < frame_count; frame++) {
+        ff_fill_rectangle(&context, &color,
+                          output.avpicture()->data,
+                          output.avpicture()->linesize,
+                          0, 0, kWidth, kHeight);
+      }
+      const double fill = GetFrameTime(start, frame_count);
+      start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < frame_count; frame++) {
+        ff_copy_rectangle2(&context,
+                           output.avpicture()->data,
+                           output.avpicture()->linesize,
+                           source.avpicture()->data,
+                           source.avpicture()->linesize,
+                           0, 0, 0, 0, kWidth, kHeight);
+      }
+      const double copy = GetFrameTime(start, frame_count);
+      start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < frame_count; frame++) {
+        ff_blend_rectangle2(&context,
+                            output.avpicture()->data,
+                            output.avpicture()->linesize,
+                            source.avpicture()->data,
+                            source.avpicture()->linesize,
+                            0, 0, 0, 0, kWidth, kHeight, 128);
+      }
+      const double blend = GetFrameTime(start, frame_count);
+      printf("DrawUtils[%s %dx%d %s]:"
+             " fill=%.3fmSec copy=%.3fmSec blend=%.3fmSec\n",
+             format.name, kWidth, kHeight, kLevelNames[level],
+             fill, copy, blend);
+    }
+  }
+  ff_draw_force_simd_level(FF_DRAW_SIMD_AVX2);
+  return ng_count;
+}
+}   // namespace
+
+int main(int argc, char *argv[]) {
+  // フレーム数(省略時は100)
+  int frame_count = 100;
+  if (argc >= 2) {
+    frame_count = std::max(atoi(argv[1]), 1);
+  }
+
+  int ng_count = 0;
+  ng_count += BenchScale(frame_count);
+  ng_count += BenchCompositor(frame_count);
+  ng_count += BenchDrawUtils(frame_count);
+  printf("scff_bench: %s\n", ng_count == 0 ? "OK" : "NG");
+  return ng_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
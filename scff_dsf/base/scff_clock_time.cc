@@ -21,6 +21,8 @@
 #include "base/scff_clock_time.h"
 
 #include "base/debug.h"
+#include "scff_imaging/clock.h"
+#include "scff_imaging/frame_scheduler.h"
 
 //=====================================================================
 // SCFFClockTime
@@ -35,11 +37,21 @@ SCFFClockTime::SCFFClockTime()
       system_cursor_(-1LL),           // ありえない値
       frame_counter_(-1LL),           // ありえない値
       last_(-1LL),                    // ありえない値
-      last_end_(-1LL) {               // ありえない値
+      last_end_(-1LL),                // ありえない値
+      wait_clock_(nullptr),
+      wait_scheduler_(nullptr) {
   // nop
 }
 
 SCFFClockTime::~SCFFClockTime() {
+  if (wait_scheduler_ != nullptr) {
+    delete wait_scheduler_;
+    wait_scheduler_ = nullptr;
+  }
+  if (wait_clock_ != nullptr) {
+    delete wait_clock_;
+    wait_clock_ = nullptr;
+  }
   if (system_clock_ != nullptr) {
     system_clock_->Release();
     system_clock_ = nullptr;
@@ -83,6 +95,13 @@ void SCFFClockTime::Reset(double fps, CSource* parent) {
     graph_clock_ = system_clock_;
   }
 
+  // Sleep用のスケジューラを作成
+  if (wait_scheduler_ == nullptr) {
+    wait_clock_ = new scff_imaging::SystemClock;
+    wait_scheduler_ = new scff_imaging::FrameScheduler(wait_clock_);
+  }
+  wait_scheduler_->Reset(fps);
+
   target_frame_interval_ = static_cast<REFERENCE_TIME>(UNITS / fps);
   graph_clock_->GetTime(&zero_);
   frame_counter_ = 0LL;
@@ -164,8 +183,6 @@ void SCFFClockTime::Sleep(REFERENCE_TIME filter_zero) {
   // 現在のストリームタイムを取得
   const REFERENCE_TIME now_in_stream = GetNow(filter_zero);
   const REFERENCE_TIME sleep_interval = last_end_ - now_in_stream;
-  const DWORD sleep_interval_msec = static_cast<DWORD>(
-      (sleep_interval * MILLISECONDS) / UNITS);
 
   if (last_end_ < now_in_stream) {
     // Sleepするべき時間がすでに過ぎてしまった
@@ -173,7 +190,9 @@ void SCFFClockTime::Sleep(REFERENCE_TIME filter_zero) {
   } else {
     // Sleepしないとフレームを生成しすぎる
     //    = フレーム終了まで待つ
-    ASSERT(sleep_interval_msec < 10000);   //10秒以上はさすがにバグだろう
-    ::Sleep(sleep_interval_msec);
+    ASSERT(sleep_interval < 10 * UNITS);   //10秒以上はさすがにバグだろう
+    // ::Sleepだとミリ秒単位に切り捨てられるのでスケジューラで待つ
+    ASSERT(wait_scheduler_ != nullptr);
+    wait_scheduler_->WaitUntil(wait_clock_->Now() + sleep_interval);
   }
 }
@@ -24,6 +24,11 @@
 #include <streams.h>
 #include <cstdint>
 
+namespace scff_imaging {
+class SystemClock;
+class FrameScheduler;
+}   // namespace scff_imaging
+
 /// タイムスタンプとSleep時間を計算するためのクラス
 /// - 特にFFMpegでは全てのメディアタイムスタンプが無視されるため、
 ///   FillBufferの速度を自分で調整しなければならない
@@ -79,6 +84,11 @@ class SCFFClockTime {
 
   /// 直前のGetTimestampのend
   REFERENCE_TIME last_end_;
+
+  /// Sleep用の時計
+  scff_imaging::SystemClock *wait_clock_;
+  /// Sleep用のスケジューラ(スリープ＋スピンで待つ)
+  scff_imaging::FrameScheduler *wait_scheduler_;
 };
 
 #endif  // SCFF_DSF_BASE_SCFF_CLOCK_TIME_H_
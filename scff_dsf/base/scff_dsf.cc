@@ -48,6 +48,9 @@ static const GUID kMediaSubtypeYUY2 = MEDIASUBTYPE_YUY2;
 /// @warning リトルエンディアンであることに注意
 static const GUID kMediaSubtypeRGB0 = MEDIASUBTYPE_RGB32;
 
+/// メディアサブタイプGUID: NV12
+static const GUID kMediaSubtypeNV12 = MEDIASUBTYPE_NV12;
+
 /// メディアタイプ: Video
 static const AMOVIESETUP_MEDIATYPE kMediaTypes[] = {
   {&MEDIATYPE_Video, &kMediaSubtypeI420},
@@ -56,6 +59,7 @@ static const AMOVIESETUP_MEDIATYPE kMediaTypes[] = {
   {&MEDIATYPE_Video, &kMediaSubtypeUYVY},
   {&MEDIATYPE_Video, &kMediaSubtypeYUY2},
   {&MEDIATYPE_Video, &kMediaSubtypeRGB0},
+  {&MEDIATYPE_Video, &kMediaSubtypeNV12},
 };
 
 /// ピン: 出力ピンは必ず１個存在する
@@ -24,6 +24,7 @@
 
 #include "base/debug.h"
 #include "base/constants.h"
+#include "scff_imaging/clock.h"
 
 //=====================================================================
 // SCFFMonitor
@@ -32,13 +33,23 @@
 SCFFMonitor::SCFFMonitor()
     : process_id_(GetCurrentProcessId()),
       last_polling_clock_(-1),          // ありえない値
+      last_report_clock_(-1),           // ありえない値
       last_message_timestamp_(-1LL),    // ありえない値
-      last_layout_error_state_(false) { // 初期Splash状態はエラーではない
+      last_layout_error_state_(false),  // 初期Splash状態はエラーではない
+      // Engineの初期値と合わせる
+      last_rendering_mode_(scff_interprocess::RenderingModes::kBuffered),
+      last_pipeline_mode_(scff_interprocess::PipelineModes::kSerial),
+      last_scale_quality_mode_(scff_interprocess::ScaleQualityModes::kFixed) {
   DbgLog((kLogMemory, kTrace, TEXT("NEW SCFFMonitor")));
+  ZeroMemory(&entry_, sizeof(entry_));
 }
 
 SCFFMonitor::~SCFFMonitor() {
   DbgLog((kLogMemory, kTrace, TEXT("DELETE SCFFMonitor")));
+  while (!pending_requests_.empty()) {
+    ReleaseRequest(pending_requests_.front());
+    pending_requests_.pop();
+  }
   interprocess_.RemoveEntry(process_id_);
 }
 
@@ -51,22 +62,26 @@ bool SCFFMonitor::Init(scff_imaging::ImagePixelFormats pixel_format,
   ASSERT(success_directory && success_message && success_shutdown_event);
 
   // エントリの追加
-  scff_interprocess::Entry entry;
-  entry.process_id = process_id_;
+  // (統計を書き込むときに使いまわすのでメンバに保持しておく)
+  ZeroMemory(&entry_, sizeof(entry_));
+  entry_.process_id = process_id_;
   GetModuleBaseNameA(
       GetCurrentProcess(),
       nullptr,
-      entry.process_name,
+      entry_.process_name,
       scff_interprocess::kMaxPath);
   /// @attention enum->int32_t
-  entry.sample_image_pixel_format = static_cast<int32_t>(pixel_format);
-  entry.sample_width = width;
-  entry.sample_height = height;
-  entry.fps = fps;
-  interprocess_.AddEntry(entry);
+  entry_.sample_image_pixel_format = static_cast<int32_t>(pixel_format);
+  entry_.sample_width = width;
+  entry_.sample_height = height;
+  entry_.fps = fps;
+  /// @attention enum->int32_t
+  entry_.pipeline_mode = static_cast<int32_t>(last_pipeline_mode_);
+  interprocess_.AddEntry(entry_);
 
   // タイムスタンプを念のため更新
   last_polling_clock_ = -1;
+  last_report_clock_ = -1;
   last_message_timestamp_ = -1;
 
   return true;
@@ -212,6 +227,62 @@ void ConvertLayoutParameter(
       break;
     }
   }
+
+  output->opacity = input.opacity;
+}
+
+/// モジュール間のRenderingModesの変換
+scff_imaging::RenderingModes ConvertRenderingMode(
+    scff_interprocess::RenderingModes input) {
+  // enumは無理にキャストせずswitchで変換
+  switch (input) {
+    case scff_interprocess::RenderingModes::kBuffered: {
+      return scff_imaging::RenderingModes::kBuffered;
+    }
+    case scff_interprocess::RenderingModes::kDirect: {
+      return scff_imaging::RenderingModes::kDirect;
+    }
+    default: {
+      ASSERT(false);
+      return scff_imaging::RenderingModes::kBuffered;
+    }
+  }
+}
+
+/// モジュール間のPipelineModesの変換
+scff_imaging::PipelineModes ConvertPipelineMode(
+    scff_interprocess::PipelineModes input) {
+  // enumは無理にキャストせずswitchで変換
+  switch (input) {
+    case scff_interprocess::PipelineModes::kSerial: {
+      return scff_imaging::PipelineModes::kSerial;
+    }
+    case scff_interprocess::PipelineModes::kPipelined: {
+      return scff_imaging::PipelineModes::kPipelined;
+    }
+    default: {
+      ASSERT(false);
+      return scff_imaging::PipelineModes::kSerial;
+    }
+  }
+}
+
+/// モジュール間のScaleQualityModesの変換
+scff_imaging::ScaleQualityModes ConvertScaleQualityMode(
+    scff_interprocess::ScaleQualityModes input) {
+  // enumは無理にキャストせずswitchで変換
+  switch (input) {
+    case scff_interprocess::ScaleQualityModes::kFixed: {
+      return scff_imaging::ScaleQualityModes::kFixed;
+    }
+    case scff_interprocess::ScaleQualityModes::kAdaptive: {
+      return scff_imaging::ScaleQualityModes::kAdaptive;
+    }
+    default: {
+      ASSERT(false);
+      return scff_imaging::ScaleQualityModes::kFixed;
+    }
+  }
 }
 
 /// MessageからLayoutParameterへの変換
@@ -226,6 +297,11 @@ void MessageToLayoutParameter(
 }   // namespace
 
 scff_imaging::Request* SCFFMonitor::CreateRequest() {
+  // 前回のメッセージから作ったリクエストが残っていれば先に返す
+  if (!pending_requests_.empty()) {
+    return PopPendingRequest();
+  }
+
   // 前回のCreateRequestからの経過時間(Sec)
   const clock_t now = clock();
   const double erapsed_time_from_last_polling =
@@ -261,6 +337,53 @@ scff_imaging::Request* SCFFMonitor::CreateRequest() {
   // タイムスタンプを進めておく
   last_message_timestamp_ = message.timestamp;
 
+  //-----------------------------------------------------------------
+  // SetRenderingModeRequest
+  //-----------------------------------------------------------------
+  /// @warning int32_t->enum
+  const scff_interprocess::RenderingModes rendering_mode =
+      static_cast<scff_interprocess::RenderingModes>(message.rendering_mode);
+  if (rendering_mode != last_rendering_mode_) {
+    DbgLog((kLogTrace, kTraceInfo,
+            TEXT("SCFFMonitor: SetRenderingModeRequest arrived(%d)."),
+            message.rendering_mode));
+    last_rendering_mode_ = rendering_mode;
+    // レイアウトより先に切り替える
+    pending_requests_.push(new scff_imaging::SetRenderingModeRequest(
+        ConvertRenderingMode(rendering_mode)));
+  }
+
+  //-----------------------------------------------------------------
+  // SetPipelineModeRequest
+  //-----------------------------------------------------------------
+  /// @warning int32_t->enum
+  const scff_interprocess::PipelineModes pipeline_mode =
+      static_cast<scff_interprocess::PipelineModes>(message.pipeline_mode);
+  if (pipeline_mode != last_pipeline_mode_) {
+    DbgLog((kLogTrace, kTraceInfo,
+            TEXT("SCFFMonitor: SetPipelineModeRequest arrived(%d)."),
+            message.pipeline_mode));
+    last_pipeline_mode_ = pipeline_mode;
+    pending_requests_.push(new scff_imaging::SetPipelineModeRequest(
+        ConvertPipelineMode(pipeline_mode)));
+  }
+
+  //-----------------------------------------------------------------
+  // SetScaleQualityModeRequest
+  //-----------------------------------------------------------------
+  /// @warning int32_t->enum
+  const scff_interprocess::ScaleQualityModes scale_quality_mode =
+      static_cast<scff_interprocess::ScaleQualityModes>(
+          message.scale_quality_mode);
+  if (scale_quality_mode != last_scale_quality_mode_) {
+    DbgLog((kLogTrace, kTraceInfo,
+            TEXT("SCFFMonitor: SetScaleQualityModeRequest arrived(%d)."),
+            message.scale_quality_mode));
+    last_scale_quality_mode_ = scale_quality_mode;
+    pending_requests_.push(new scff_imaging::SetScaleQualityModeRequest(
+        ConvertScaleQualityMode(scale_quality_mode)));
+  }
+
   //-----------------------------------------------------------------
   /// @warning int32_t->enum
   scff_interprocess::LayoutTypes layout_type =
@@ -274,7 +397,8 @@ scff_imaging::Request* SCFFMonitor::CreateRequest() {
     DbgLog((kLogTrace, kTraceInfo,
             TEXT("SCFFMonitor: ResetLayoutRequest arrived(%lld)."),
             message.timestamp));
-    return new scff_imaging::ResetLayoutRequest();
+    pending_requests_.push(new scff_imaging::ResetLayoutRequest());
+    return PopPendingRequest();
   }
 
   //-----------------------------------------------------------------
@@ -294,9 +418,50 @@ scff_imaging::Request* SCFFMonitor::CreateRequest() {
   for (int i = 0; i < message.layout_element_count; i++) {
     MessageToLayoutParameter(message, i, &(parameters[i]));
   }
-  return new scff_imaging::SetLayoutRequest(
+  pending_requests_.push(new scff_imaging::SetLayoutRequest(
       message.layout_element_count,
-      parameters);
+      parameters));
+  return PopPendingRequest();
+}
+
+void SCFFMonitor::ReportPipelineStats(
+    const scff_imaging::PipelineStats &stats) {
+  const clock_t now = clock();
+  const double erapsed_time_from_last_report =
+      static_cast<double>(now - last_report_clock_) / CLOCKS_PER_SEC;
+  /// @attention 浮動小数点数の比較
+  if (last_report_clock_ != -1 &&
+      erapsed_time_from_last_report < kSCFFMonitorPollingInterval) {
+    return;
+  }
+  last_report_clock_ = now;
+
+  /// @attention enum->int32_t
+  entry_.pipeline_mode = static_cast<int32_t>(last_pipeline_mode_);
+  if (last_pipeline_mode_ == scff_interprocess::PipelineModes::kPipelined &&
+      stats.count > 0LL) {
+    // kPipelinedで増えた遅延をクライアントから見えるようにする
+    const double kUnitsPerMillisecond =
+        static_cast<double>(scff_imaging::kClockUnitsPerMillisecond);
+    entry_.pipeline_latency_average =
+        stats.sum / kUnitsPerMillisecond / stats.count;
+    entry_.pipeline_latency_max = stats.max / kUnitsPerMillisecond;
+    entry_.pipeline_dropped_frames = stats.dropped_frames;
+    entry_.pipeline_repeated_frames = stats.repeated_frames;
+  } else {
+    entry_.pipeline_latency_average = 0.0;
+    entry_.pipeline_latency_max = 0.0;
+    entry_.pipeline_dropped_frames = 0LL;
+    entry_.pipeline_repeated_frames = 0LL;
+  }
+  interprocess_.UpdateEntry(entry_);
+}
+
+scff_imaging::Request* SCFFMonitor::PopPendingRequest() {
+  ASSERT(!pending_requests_.empty());
+  scff_imaging::Request *request = pending_requests_.front();
+  pending_requests_.pop();
+  return request;
 }
 
 void SCFFMonitor::ReleaseRequest(scff_imaging::Request *request) {
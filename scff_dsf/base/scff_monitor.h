@@ -23,6 +23,7 @@
 
 #include <cstdint>
 #include <ctime>
+#include <queue>
 
 #include "scff_interprocess/interprocess.h"
 #include "scff_imaging/imaging.h"
@@ -42,11 +43,19 @@ class SCFFMonitor {
   /// 現在のEngineのレイアウトのエラーコードをmonitorに渡す
   void CheckLayoutError(scff_imaging::ErrorCodes layout_error_code);
   /// リクエストがあるかどうか調べ、あれば実体を、なければnullptrを返す
+  /// @attention 1つのメッセージから複数のリクエストができた場合は
+  ///            ポーリング間隔を待たずに次の呼び出しで残りを返す
   scff_imaging::Request* CreateRequest();
   /// 使い終わったリクエストを解放する
   void ReleaseRequest(scff_imaging::Request *request);
+  /// パイプライン実行時の統計をエントリに書き込む
+  /// @attention 書き込みはkSCFFMonitorPollingInterval秒に1回にまとめる
+  void ReportPipelineStats(const scff_imaging::PipelineStats &stats);
 
  private:
+  /// まだ返していないリクエストを先頭から1つ取り出す
+  scff_imaging::Request* PopPendingRequest();
+
   /// プロセスID
   const DWORD process_id_;
 
@@ -55,12 +64,27 @@ class SCFFMonitor {
 
   /// 内部時刻を保持するための変数
   clock_t last_polling_clock_;
+  /// 最後にエントリを書き込んだ時刻
+  clock_t last_report_clock_;
+
+  /// Directoryに登録したエントリ
+  scff_interprocess::Entry entry_;
 
   /// 最後に受信したSCFFMessageのタイムスタンプ
   int64_t last_message_timestamp_;
 
   /// 前回チェックした際にエラー状態になっていたか
   bool last_layout_error_state_;
+
+  /// 最後に要求した描画方法
+  scff_interprocess::RenderingModes last_rendering_mode_;
+  /// 最後に要求したキャプチャと変換の実行方法
+  scff_interprocess::PipelineModes last_pipeline_mode_;
+  /// 最後に要求した拡大縮小の品質の決め方
+  scff_interprocess::ScaleQualityModes last_scale_quality_mode_;
+
+  /// まだ返していないリクエスト
+  std::queue<scff_imaging::Request*> pending_requests_;
 };
 
 #endif  // SCFF_DSF_BASE_SCFF_MONITOR_H_
@@ -27,6 +27,7 @@
 #include "base/debug.h"
 #include "base/scff_source.h"
 #include "base/scff_monitor.h"
+#include "base/scff_sample_render_target.h"
 
 //=====================================================================
 // SCFFOutputPin
@@ -59,7 +60,7 @@ SCFFOutputPin::~SCFFOutputPin() {
 //---------------------------------------------------------------------
 
 /// - 以後ピンに渡されるmedia_typeは必ず以下になることが保障される:
-///   - biCompression:  I420/IYUV/YV12/UYVY/YUY2/RGB0
+///   - biCompression:  I420/IYUV/YV12/UYVY/YUY2/RGB0/NV12
 ///   - biBitCount:     12/16/32
 ///   - biWidth:        width_
 ///   - biHeight:       height_
@@ -208,13 +209,15 @@ HRESULT SCFFOutputPin::CheckMediaType(const CMediaType *media_type) {
   const GUID UYVY_guid = MEDIASUBTYPE_UYVY;
   const GUID YUY2_guid = MEDIASUBTYPE_YUY2;
   const GUID RGB0_guid = MEDIASUBTYPE_RGB32;
+  const GUID NV12_guid = MEDIASUBTYPE_NV12;
 
   if (subtype != I420_guid &&
       subtype != IYUV_guid &&
       subtype != YV12_guid &&
       subtype != UYVY_guid &&
       subtype != YUY2_guid &&
-      subtype != RGB0_guid) {
+      subtype != RGB0_guid &&
+      subtype != NV12_guid) {
     return E_INVALIDARG;
   }
 
@@ -342,6 +345,7 @@ HRESULT SCFFOutputPin::SetMediaType(const CMediaType *media_type) {
   const GUID UYVY_guid = MEDIASUBTYPE_UYVY;
   const GUID YUY2_guid = MEDIASUBTYPE_YUY2;
   const GUID RGB0_guid = MEDIASUBTYPE_RGB32;
+  const GUID NV12_guid = MEDIASUBTYPE_NV12;
   if (subtype == I420_guid) {
     pixel_format_ = scff_imaging::ImagePixelFormats::kI420;
   } else if (subtype == IYUV_guid) {
@@ -354,6 +358,8 @@ HRESULT SCFFOutputPin::SetMediaType(const CMediaType *media_type) {
     pixel_format_ = scff_imaging::ImagePixelFormats::kYUY2;
   } else if (subtype == RGB0_guid) {
     pixel_format_ = scff_imaging::ImagePixelFormats::kRGB0;
+  } else if (subtype == NV12_guid) {
+    pixel_format_ = scff_imaging::ImagePixelFormats::kNV12;
   } else {
     ASSERT(false);
     pixel_format_ = scff_imaging::ImagePixelFormats::kI420;
@@ -470,7 +476,13 @@ HRESULT SCFFOutputPin::DoBufferProcessingLoop(void) {
           video_info->bmiHeader);
 
   // Engineを作成
-  scff_imaging::Engine engine(pixel_format, width_, height_, fps_);
+  // バッファに描画して前回の内容を使いまわす(kDirectへはSCFFMonitor経由で
+  // 切り替える)
+  // レイアウトは論理プロセッサ数に応じて並列処理する
+  scff_imaging::Engine engine(
+      pixel_format, width_, height_, fps_,
+      scff_imaging::RenderingModes::kBuffered,
+      scff_imaging::WorkerPool::GetDefaultWorkerCount());
   const scff_imaging::ErrorCodes error = engine.Init();
   ASSERT(error == scff_imaging::ErrorCodes::kNoError);
 
@@ -504,6 +516,9 @@ HRESULT SCFFOutputPin::DoBufferProcessingLoop(void) {
       engine.Accept(request);
       monitor.ReleaseRequest(request);
 
+      // kPipelinedで増えた遅延などをクライアントに公開する
+      monitor.ReportPipelineStats(engine.GetPipelineStats());
+
       // サンプルに開始時間と終了時間を設定
       HRESULT result_fill_buffer;
       {
@@ -591,15 +606,13 @@ HRESULT SCFFOutputPin::FillBufferWithImagingEngine(
   VIDEOINFOHEADER *video_info =
     reinterpret_cast<VIDEOINFOHEADER*>(m_mt.pbFormat);
 
-  // サンプルのサイズを設定してポインタを取得
-  BYTE *data = nullptr;
-  DWORD data_size = 0;
-  sample->GetPointer(&data);
-  data_size = sample->GetSize();
-  sample->SetActualDataLength(data_size);
+  // サンプルのバッファを描画先にしてサイズを設定
+  SCFFSampleRenderTarget render_target(sample);
+  CheckPointer(render_target.buffer(), E_UNEXPECTED);
+  sample->SetActualDataLength(render_target.buffer_size());
 
   // sampleにデータを書き込み
-  engine.CopyCurrentImage(data, data_size);
+  engine.RenderCurrentImage(&render_target);
 
   /// @attention SetTimeおよびSetSyncは外部で行っている
 
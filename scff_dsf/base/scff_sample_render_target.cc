@@ -0,0 +1,50 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file base/scff_sample_render_target.cc
+/// SCFFSampleRenderTargetの定義
+
+#include "base/scff_sample_render_target.h"
+
+//=====================================================================
+// SCFFSampleRenderTarget
+//=====================================================================
+
+SCFFSampleRenderTarget::SCFFSampleRenderTarget(IMediaSample *sample)
+    : scff_imaging::RenderTarget(),
+      data_(nullptr),
+      data_size_(0) {
+  ASSERT(sample != nullptr);
+  const HRESULT result = sample->GetPointer(&data_);
+  if (FAILED(result)) {
+    data_ = nullptr;
+    return;
+  }
+  data_size_ = sample->GetSize();
+}
+
+SCFFSampleRenderTarget::~SCFFSampleRenderTarget() {
+  // nop
+}
+
+uint8_t* SCFFSampleRenderTarget::buffer() const {
+  return data_;
+}
+
+int SCFFSampleRenderTarget::buffer_size() const {
+  return static_cast<int>(data_size_);
+}
@@ -0,0 +1,51 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file base/scff_sample_render_target.h
+/// SCFFSampleRenderTargetの宣言
+
+#ifndef SCFF_DSF_BASE_SCFF_SAMPLE_RENDER_TARGET_H_
+#define SCFF_DSF_BASE_SCFF_SAMPLE_RENDER_TARGET_H_
+
+#include <streams.h>
+
+#include "scff_imaging/render_target.h"
+
+/// IMediaSampleのバッファをscff_imaging::Engineの描画先にするためのクラス
+/// @attention sampleの参照カウントは操作しない
+class SCFFSampleRenderTarget : public scff_imaging::RenderTarget {
+ public:
+  /// コンストラクタ
+  explicit SCFFSampleRenderTarget(IMediaSample *sample);
+  /// デストラクタ
+  ~SCFFSampleRenderTarget();
+
+  //-------------------------------------------------------------------
+  /// @copydoc scff_imaging::RenderTarget::buffer
+  uint8_t* buffer() const;
+  /// @copydoc scff_imaging::RenderTarget::buffer_size
+  int buffer_size() const;
+  //-------------------------------------------------------------------
+
+ private:
+  /// サンプルのバッファ
+  BYTE *data_;
+  /// サンプルのバッファのサイズ
+  long data_size_;   // NOLINT
+};
+
+#endif  // SCFF_DSF_BASE_SCFF_SAMPLE_RENDER_TARGET_H_
@@ -22,11 +22,14 @@
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 }
 
 #include "scff_imaging/debug.h"
 #include "scff_imaging/imaging_types.h"
 #include "scff_imaging/utilities.h"
+#include "scff_imaging/render_target.h"
 
 namespace scff_imaging {
 
@@ -36,13 +39,20 @@ namespace scff_imaging {
 
 AVPictureImage::AVPictureImage()
     : Image(),
-      avpicture_(nullptr) {
+      avpicture_(nullptr),
+      is_render_target_(false),
+      is_view_(false) {
   /// @attention avpicture_そのものの構築はCreateで行う
 }
 
 AVPictureImage::~AVPictureImage() {
   if (!IsEmpty()) {
-    avpicture_free(avpicture_);
+    if (is_render_target_ || is_view_) {
+      // バッファはレンダーターゲット(親イメージ)のものなので解放しない
+      delete avpicture_;
+    } else {
+      avpicture_free(avpicture_);
+    }
   }
 }
 
@@ -72,7 +82,118 @@ ErrorCodes AVPictureImage::Create(ImagePixelFormats pixel_format,
   return ErrorCodes::kNoError;
 }
 
+ErrorCodes AVPictureImage::CreateForRenderTarget(
+    ImagePixelFormats pixel_format, int width, int height) {
+  // pixel_format, width, heightを設定する
+  ErrorCodes error_create = Image::Create(pixel_format, width, height);
+  if (error_create != ErrorCodes::kNoError) {
+    return error_create;
+  }
+
+  // 描画用AVPictureを作成(実体はAttachで関連付ける)
+  AVPicture *avpicture = new AVPicture();
+  if (avpicture == nullptr) {
+    return ErrorCodes::kAVPictureImageOutOfMemoryError;
+  }
+  avpicture_ = avpicture;
+  is_render_target_ = true;
+
+  return ErrorCodes::kNoError;
+}
+
+ErrorCodes AVPictureImage::Attach(RenderTarget *render_target) {
+  ASSERT(is_render_target_);
+  ASSERT(!IsEmpty());
+
+  // レンダーターゲットのバッファが足りているか
+  const int size = utilities::CalculateImageSize(*this);
+  if (render_target == nullptr ||
+      render_target->buffer() == nullptr ||
+      render_target->buffer_size() < size) {
+    return ErrorCodes::kAVPictureImageInvalidRenderTargetError;
+  }
+
+  // バッファとAVPictureを関連付け
+  // (avpicture_fillはavpicture_layoutと同じ配置になる)
+  const int result_fill =
+      avpicture_fill(avpicture_, render_target->buffer(),
+                     av_pixel_format(),
+                     width(), height());
+  if (result_fill != size) {
+    return ErrorCodes::kAVPictureImageInvalidRenderTargetError;
+  }
+
+  return ErrorCodes::kNoError;
+}
+
+ErrorCodes AVPictureImage::CreateForView(
+    ImagePixelFormats pixel_format, int width, int height) {
+  // pixel_format, width, heightを設定する
+  ErrorCodes error_create = Image::Create(pixel_format, width, height);
+  if (error_create != ErrorCodes::kNoError) {
+    return error_create;
+  }
+
+  // 描画用AVPictureを作成(実体はAttachViewで関連付ける)
+  AVPicture *avpicture = new AVPicture();
+  if (avpicture == nullptr) {
+    return ErrorCodes::kAVPictureImageOutOfMemoryError;
+  }
+  avpicture_ = avpicture;
+  is_view_ = true;
+
+  return ErrorCodes::kNoError;
+}
+
+ErrorCodes AVPictureImage::AttachView(const AVPictureImage &parent,
+                                      int x, int y) {
+  ASSERT(is_view_);
+  ASSERT(!IsEmpty());
+
+  // 親イメージに収まっていて、色差のサンプルの境界から始まっているか
+  const AVPixFmtDescriptor *descriptor =
+      av_pix_fmt_desc_get(av_pixel_format());
+  const int align_x = 1 << descriptor->log2_chroma_w;
+  const int align_y = 1 << descriptor->log2_chroma_h;
+  if (parent.IsEmpty() ||
+      parent.pixel_format() != pixel_format() ||
+      !utilities::Contains(0, 0, parent.width(), parent.height(),
+                           x, y, width(), height()) ||
+      x % align_x != 0 || y % align_y != 0) {
+    return ErrorCodes::kAVPictureImageInvalidViewError;
+  }
+
+  // 各プレーンの先頭を(x,y)までずらす
+  // 色差の間引き単位の倍数なのでプレーンごとのバイト数はちょうど割り切れる
+  const AVPicture *parent_avpicture = parent.avpicture();
+  const int plane_count = av_pix_fmt_count_planes(av_pixel_format());
+  for (int plane = 0; plane < AV_NUM_DATA_POINTERS; plane++) {
+    if (plane >= plane_count) {
+      avpicture_->data[plane] = nullptr;
+      avpicture_->linesize[plane] = 0;
+      continue;
+    }
+    const int shift =
+        (plane == 1 || plane == 2) ? descriptor->log2_chroma_h : 0;
+    avpicture_->linesize[plane] = parent_avpicture->linesize[plane];
+    avpicture_->data[plane] =
+        parent_avpicture->data[plane] +
+        (y >> shift) * parent_avpicture->linesize[plane] +
+        av_image_get_linesize(av_pixel_format(), x, plane);
+  }
+
+  return ErrorCodes::kNoError;
+}
+
 AVPicture* AVPictureImage::avpicture() const {
   return avpicture_;
 }
+
+bool AVPictureImage::is_render_target() const {
+  return is_render_target_;
+}
+
+bool AVPictureImage::is_view() const {
+  return is_view_;
+}
 }   // namespace scff_imaging
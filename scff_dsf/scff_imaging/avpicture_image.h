@@ -26,6 +26,8 @@
 
 namespace scff_imaging {
 
+class RenderTarget;
+
 /// AVPicture(ffmpeg)の実体を管理するクラス
 class AVPictureImage: public Image {
  public:
@@ -42,12 +44,40 @@ class AVPictureImage: public Image {
   ErrorCodes Create(ImagePixelFormats pixel_format, int width, int height);
   //-------------------------------------------------------------------
 
+  /// 外部のレンダーターゲットに描画するためのAVPictureを作成する
+  /// @attention 実体は確保しないので描画前に必ずAttachすること
+  ErrorCodes CreateForRenderTarget(ImagePixelFormats pixel_format,
+                                   int width, int height);
+  /// レンダーターゲットのバッファをAVPictureに関連付ける
+  /// @pre CreateForRenderTargetで作成済み
+  /// @attention バッファの所有権はレンダーターゲットが持つ
+  ErrorCodes Attach(RenderTarget *render_target);
+
+  /// 親イメージの一部を指すAVPicture(ビュー)を作成する
+  /// @attention 実体は確保しないので描画前に必ずAttachViewすること
+  ErrorCodes CreateForView(ImagePixelFormats pixel_format,
+                           int width, int height);
+  /// 親イメージの(x,y)を左上とする範囲をAVPictureに関連付ける
+  /// - 各プレーンの先頭を親イメージ内にずらし、linesizeは親のものを使う
+  /// - x,yは色差の間引き単位の倍数であること
+  /// @pre CreateForViewで作成済み
+  /// @attention 親イメージのバッファが変わったら関連付けなおすこと
+  ErrorCodes AttachView(const AVPictureImage &parent, int x, int y);
+
   /// Getter: AVPictureへのポインタ
   AVPicture* avpicture() const;
+  /// Getter: 外部のレンダーターゲットに描画するイメージか
+  bool is_render_target() const;
+  /// Getter: 親イメージの一部を指すイメージか
+  bool is_view() const;
 
  private:
   /// AVPictureへのポインタ
   AVPicture *avpicture_;
+  /// 外部のレンダーターゲットに描画するイメージか
+  bool is_render_target_;
+  /// 親イメージの一部を指すイメージか
+  bool is_view_;
 
   // コピー＆代入禁止
   DISALLOW_COPY_AND_ASSIGN(AVPictureImage);
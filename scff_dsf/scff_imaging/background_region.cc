@@ -0,0 +1,258 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/background_region.cc
+/// scff_imaging::BackgroundRegionの定義
+
+#include "scff_imaging/background_region.h"
+
+#include <algorithm>
+
+namespace {
+
+/// valueをalignの倍数に切り上げる
+int AlignUp(int value, int align) {
+  return (value + align - 1) / align * align;
+}
+
+/// valueをalignの倍数に切り捨てる
+int AlignDown(int value, int align) {
+  return value / align * align;
+}
+
+/// X方向の区間
+struct Span {
+  int left;
+  int right;
+  bool operator<(const Span &other) const {
+    return left < other.left;
+  }
+};
+}   // namespace
+
+namespace scff_imaging {
+
+bool GetCoveredRect(const ImageRect &element, int width, int height,
+                    int align_x, int align_y, ImageRect *covered) {
+  const int left = AlignUp(std::max(element.x, 0), align_x);
+  const int top = AlignUp(std::max(element.y, 0), align_y);
+  int right = std::min(element.x + element.width, width);
+  int bottom = std::min(element.y + element.height, height);
+  // 出力イメージの端は端数があってもそのまま
+  // ただし原点がそろっていない要素は最後の色差を書かないのでそろえる
+  if (right < width || element.x % align_x != 0) {
+    right = AlignDown(right, align_x);
+  }
+  if (bottom < height || element.y % align_y != 0) {
+    bottom = AlignDown(bottom, align_y);
+  }
+  if (left >= right || top >= bottom) {
+    return false;
+  }
+  covered->x = left;
+  covered->y = top;
+  covered->width = right - left;
+  covered->height = bottom - top;
+  return true;
+}
+
+void SubtractRects(const ImageRect &area,
+                   int cover_count, const ImageRect covers[],
+                   std::vector<ImageRect> *rects) {
+  rects->clear();
+  const int area_right = area.x + area.width;
+  const int area_bottom = area.y + area.height;
+  if (area.width <= 0 || area.height <= 0) {
+    return;
+  }
+
+  // 覆う矩形をareaの中に切り詰める
+  std::vector<ImageRect> clipped;
+  std::vector<int> edges;
+  edges.push_back(area.y);
+  edges.push_back(area_bottom);
+  for (int i = 0; i < cover_count; i++) {
+    const int left = std::max(covers[i].x, area.x);
+    const int top = std::max(covers[i].y, area.y);
+    const int right = std::min(covers[i].x + covers[i].width, area_right);
+    const int bottom = std::min(covers[i].y + covers[i].height, area_bottom);
+    if (left >= right || top >= bottom) continue;
+    const ImageRect cover = {left, top, right - left, bottom - top};
+    clipped.push_back(cover);
+    edges.push_back(top);
+    edges.push_back(bottom);
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  // 帯の中では各矩形は帯全体を覆うか、まったく覆わないかのどちらか
+  std::vector<Span> spans;
+  int previous_band_begin = 0;
+  for (size_t band = 0; band + 1 < edges.size(); band++) {
+    const int top = edges[band];
+    const int bottom = edges[band + 1];
+
+    spans.clear();
+    for (size_t i = 0; i < clipped.size(); i++) {
+      if (clipped[i].y <= top && bottom <= clipped[i].y + clipped[i].height) {
+        const Span span = {clipped[i].x, clipped[i].x + clipped[i].width};
+        spans.push_back(span);
+      }
+    }
+    std::sort(spans.begin(), spans.end());
+
+    const int band_begin = static_cast<int>(rects->size());
+    int x = area.x;
+    for (size_t i = 0; i <= spans.size(); i++) {
+      const int gap_right = (i < spans.size()) ? spans[i].left : area_right;
+      if (x < gap_right) {
+        // 直前の帯に同じ区間があれば下に延ばす
+        bool extended = false;
+        for (int j = previous_band_begin; j < band_begin; j++) {
+          ImageRect &above = (*rects)[j];
+          if (above.x == x && above.width == gap_right - x &&
+              above.y + above.height == top) {
+            above.height += bottom - top;
+            extended = true;
+            break;
+          }
+        }
+        if (!extended) {
+          const ImageRect gap = {x, top, gap_right - x, bottom - top};
+          rects->push_back(gap);
+        }
+      }
+      if (i < spans.size()) {
+        x = std::max(x, spans[i].right);
+      }
+    }
+
+    // 下に延ばした矩形も次の帯で延ばせるように範囲に含める
+    int next_band_begin = static_cast<int>(rects->size());
+    for (int j = previous_band_begin; j < band_begin; j++) {
+      if ((*rects)[j].y + (*rects)[j].height == bottom) {
+        next_band_begin = std::min(next_band_begin, j);
+      }
+    }
+    previous_band_begin = next_band_begin;
+  }
+}
+
+void BuildVisibleRects(int width, int height, int align_x, int align_y,
+                       int element_count, const ImageRect elements[],
+                       const bool opaque[],
+                       std::vector<ImageRect> visible_rects[]) {
+  // 上の要素から順に見ていき、見えている不透明な要素を覆う矩形に加える
+  // (見えない部分はすでに上の要素に覆われているので、要素全体を加えてよい)
+  std::vector<ImageRect> covers;
+  for (int i = element_count - 1; i >= 0; i--) {
+    const ImageRect &element = elements[i];
+    std::vector<ImageRect> &visible = visible_rects[i];
+    visible.clear();
+    if (element.width <= 0 || element.height <= 0) {
+      continue;
+    }
+    const int cover_count = static_cast<int>(covers.size());
+    const ImageRect *cover_array = covers.empty() ? nullptr : &(covers[0]);
+    if (element.x % align_x == 0 && element.y % align_y == 0) {
+      // 覆う矩形の境界もそろっているので、切り出しても色差の位置はずれない
+      SubtractRects(element, cover_count, cover_array, &visible);
+    } else {
+      // 要素の色差を含むように外側にそろえて調べる
+      const int left = AlignDown(element.x, align_x);
+      const int top = AlignDown(element.y, align_y);
+      const int right =
+          std::min(AlignUp(element.x + element.width, align_x), width);
+      const int bottom =
+          std::min(AlignUp(element.y + element.height, align_y), height);
+      const ImageRect expanded = {left, top, right - left, bottom - top};
+      SubtractRects(expanded, cover_count, cover_array, &visible);
+      if (!visible.empty()) {
+        visible.assign(1, element);
+      }
+    }
+
+    ImageRect cover;
+    if (!visible.empty() && opaque[i] &&
+        GetCoveredRect(element, width, height, align_x, align_y, &cover)) {
+      covers.push_back(cover);
+    }
+  }
+}
+
+//=====================================================================
+// scff_imaging::BackgroundRegion
+//=====================================================================
+
+BackgroundRegion::BackgroundRegion()
+    : filled_buffer_count_(0),
+      next_evicted_index_(0) {
+  // nop
+}
+
+BackgroundRegion::~BackgroundRegion() {
+  // nop
+}
+
+void BackgroundRegion::Build(int width, int height, int align_x, int align_y,
+                             int element_count, const ImageRect elements[]) {
+  ResetFilled();
+
+  // 要素の内側にそろえることで、背景の矩形は外側にそろうことになる
+  std::vector<ImageRect> covers;
+  for (int i = 0; i < element_count; i++) {
+    ImageRect cover;
+    if (GetCoveredRect(elements[i], width, height, align_x, align_y, &cover)) {
+      covers.push_back(cover);
+    }
+  }
+  const ImageRect area = {0, 0, width, height};
+  SubtractRects(area, static_cast<int>(covers.size()),
+                covers.empty() ? nullptr : &(covers[0]), &rects_);
+}
+
+bool BackgroundRegion::MarkFilled(const void *buffer) {
+  for (int i = 0; i < filled_buffer_count_; i++) {
+    if (filled_buffers_[i] == buffer) {
+      return false;
+    }
+  }
+  if (filled_buffer_count_ < kMaxFilledBufferCount) {
+    filled_buffers_[filled_buffer_count_++] = buffer;
+  } else {
+    // バッファの数が多すぎる場合は古いものから忘れる
+    filled_buffers_[next_evicted_index_] = buffer;
+    next_evicted_index_ = (next_evicted_index_ + 1) % kMaxFilledBufferCount;
+  }
+  return true;
+}
+
+void BackgroundRegion::ResetFilled() {
+  filled_buffer_count_ = 0;
+  next_evicted_index_ = 0;
+}
+
+//-------------------------------------------------------------------
+
+int BackgroundRegion::rect_count() const {
+  return static_cast<int>(rects_.size());
+}
+
+const ImageRect& BackgroundRegion::rect(int index) const {
+  return rects_[index];
+}
+}   // namespace scff_imaging
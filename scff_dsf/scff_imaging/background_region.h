@@ -0,0 +1,133 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/background_region.h
+/// scff_imaging::BackgroundRegionの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_BACKGROUND_REGION_H_
+#define SCFF_DSF_SCFF_IMAGING_BACKGROUND_REGION_H_
+
+#include <vector>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// イメージ上の矩形
+struct ImageRect {
+  /// 左上のX座標
+  int x;
+  /// 左上のY座標
+  int y;
+  /// 幅
+  int width;
+  /// 高さ
+  int height;
+};
+
+/// 要素を描画したときに全プレーンで必ず上書きされる範囲を求める
+/// - 要素を出力イメージ内に切り詰め、内側に向かってalign_x/align_yの倍数にそろえる
+///   (色差が間引かれている場合に、要素の境界の色差を覆われる側に含めないため)
+/// - 出力イメージの右端・下端は、要素の原点がそろっていれば端数があってもそのまま
+/// @retval true coveredに範囲を格納した
+/// @retval false 必ず上書きされる範囲はない
+bool GetCoveredRect(const ImageRect &element, int width, int height,
+                    int align_x, int align_y, ImageRect *covered);
+
+/// areaのうちcoversのどれにも覆われない部分を重なりのない矩形の集合として求める
+/// - 覆う矩形の上下端で横長の帯に分け、帯ごとに覆われていない区間を求める
+/// - 上の帯と同じ区間は下に延ばしてまとめる
+/// @param area 対象の矩形
+/// @param cover_count 覆う矩形の数
+/// @param covers 覆う矩形
+/// @param[out] rects 覆われない部分(消去してから格納する)
+void SubtractRects(const ImageRect &area,
+                   int cover_count, const ImageRect covers[],
+                   std::vector<ImageRect> *rects);
+
+/// 後の要素ほど上に描画される要素の並びについて、各要素の見える部分を求める
+/// - 要素が書き換えるバイトがすべて上の不透明な要素に上書きされるなら隠れている
+/// - 原点がalign_x/align_yの倍数の要素は見える部分だけに切り出す
+///   (それ以外は色差の位置がずれないように、一部でも見えていれば全体にする)
+/// @param width 出力イメージの幅
+/// @param height 出力イメージの高さ
+/// @param align_x 色差の間引き単位(X方向)
+/// @param align_y 色差の間引き単位(Y方向)
+/// @param element_count 要素の数
+/// @param elements 要素の矩形(大きさ0の要素は常に隠れている)
+/// @param opaque 要素が下を完全に覆うか(半透明でないか)
+/// @param[out] visible_rects 要素ごとの見える部分(隠れていれば空)
+void BuildVisibleRects(int width, int height, int align_x, int align_y,
+                       int element_count, const ImageRect elements[],
+                       const bool opaque[],
+                       std::vector<ImageRect> visible_rects[]);
+
+/// 出力イメージのうちどの要素にも覆われない背景の領域
+/// - 背景を矩形の集合として事前に求めておき、毎フレームの塗りつぶしを減らす
+/// - 出力イメージのバッファが内容を保持する場合は、
+///   バッファごとに一度だけ塗りつぶせばよいように記録する
+class BackgroundRegion {
+ public:
+  /// 塗りつぶし済みとして記録できるバッファの最大数
+  static const int kMaxFilledBufferCount = 4;
+
+  /// コンストラクタ
+  BackgroundRegion();
+  /// デストラクタ
+  ~BackgroundRegion();
+
+  /// 背景の矩形を求める(塗りつぶし済みの記録も消去する)
+  /// - 要素はGetCoveredRectで切り詰めてから背景から取り除く
+  ///   (色差が間引かれている場合に、要素の境界の色差を背景側にも含めるため)
+  /// @param width 出力イメージの幅
+  /// @param height 出力イメージの高さ
+  /// @param align_x 矩形の境界をそろえる単位(X方向)
+  /// @param align_y 矩形の境界をそろえる単位(Y方向)
+  /// @param element_count 要素の数
+  /// @param elements 要素の矩形
+  void Build(int width, int height, int align_x, int align_y,
+             int element_count, const ImageRect elements[]);
+
+  /// バッファを塗りつぶす必要があるか調べて、塗りつぶし済みとして記録する
+  /// @param buffer バッファを識別するポインタ
+  /// @retval true まだ塗りつぶしていない(この後必ず塗りつぶすこと)
+  /// @retval false 塗りつぶし済み
+  bool MarkFilled(const void *buffer);
+  /// 塗りつぶし済みの記録を消去する
+  void ResetFilled();
+
+  /// Getter: 背景の矩形の数
+  int rect_count() const;
+  /// Getter: 背景の矩形
+  const ImageRect& rect(int index) const;
+
+ private:
+  /// 背景の矩形(重なりなし)
+  std::vector<ImageRect> rects_;
+  /// 塗りつぶし済みのバッファ
+  const void *filled_buffers_[kMaxFilledBufferCount];
+  /// 塗りつぶし済みのバッファの数
+  int filled_buffer_count_;
+  /// 記録があふれたときに次に上書きする位置
+  int next_evicted_index_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(BackgroundRegion);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_BACKGROUND_REGION_H_
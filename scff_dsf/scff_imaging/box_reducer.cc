@@ -0,0 +1,193 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/box_reducer.cc
+/// scff_imaging::BoxReducerの定義
+
+#include "scff_imaging/box_reducer.h"
+
+#include <algorithm>
+
+#include "scff_imaging/debug.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+    defined(__SSE2__)
+#define SCFF_BOX_REDUCER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/// 出力1行分を縮小する
+/// @param top 入力の上の行
+/// @param bottom 入力の下の行(入力の高さが奇数の最後の行ではtopと同じ)
+/// @param x 書き込みを始める出力のピクセル
+void ReduceSpanPortable(const uint8_t *top, const uint8_t *bottom,
+                        int input_width, uint8_t *output,
+                        int x, int output_width) {
+  for (; x < output_width; x++) {
+    const int left = x * 2 * 4;
+    // 幅が奇数なら最後のピクセルを繰り返す
+    const int right = std::min(x * 2 + 1, input_width - 1) * 4;
+    for (int byte = 0; byte < 4; byte++) {
+      output[x * 4 + byte] = static_cast<uint8_t>(
+          (top[left + byte] + top[right + byte] +
+           bottom[left + byte] + bottom[right + byte] + 2) >> 2);
+    }
+  }
+}
+
+#if defined(SCFF_BOX_REDUCER_SSE2)
+/// 出力1行分を出力4ピクセル単位で縮小する
+/// @return SSE2で書き込まなかった最初の出力のピクセル
+int ReduceSpanSSE2(const uint8_t *top, const uint8_t *bottom,
+                   int input_width, uint8_t *output, int output_width) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i rounding = _mm_set1_epi16(2);
+  int x = 0;
+  // 入力8ピクセルがそろっている範囲だけを処理する
+  for (; x + 4 <= output_width && x * 2 + 8 <= input_width; x += 4) {
+    const __m128i t0 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + x * 8));
+    const __m128i t1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + x * 8 + 16));
+    const __m128i b0 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + x * 8));
+    const __m128i b1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + x * 8 + 16));
+
+    // 16bitに広げて上下を足す(各レジスタは2ピクセル分)
+    const __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(t0, zero),
+                                      _mm_unpacklo_epi8(b0, zero));
+    const __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(t0, zero),
+                                      _mm_unpackhi_epi8(b0, zero));
+    const __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(t1, zero),
+                                      _mm_unpacklo_epi8(b1, zero));
+    const __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(t1, zero),
+                                      _mm_unpackhi_epi8(b1, zero));
+
+    // 左右のピクセルを足す([0,2]+[1,3]と[4,6]+[5,7])
+    const __m128i q01 = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23),
+                                      _mm_unpackhi_epi64(s01, s23));
+    const __m128i q23 = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67),
+                                      _mm_unpackhi_epi64(s45, s67));
+    const __m128i r01 = _mm_srli_epi16(_mm_add_epi16(q01, rounding), 2);
+    const __m128i r23 = _mm_srli_epi16(_mm_add_epi16(q23, rounding), 2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x * 4),
+                     _mm_packus_epi16(r01, r23));
+  }
+  return x;
+}
+#endif  // defined(SCFF_BOX_REDUCER_SSE2)
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::BoxReducer
+//=====================================================================
+
+int BoxReducer::GetPassCount(int input_width, int input_height,
+                             int output_width, int output_height) {
+  if (output_width <= 0 || output_height <= 0) {
+    return 0;
+  }
+  int pass_count = 0;
+  int width = input_width;
+  int height = input_height;
+  while (pass_count < kMaxPassCount &&
+         width > output_width * 2 && height > output_height * 2) {
+    width = GetReducedSize(width);
+    height = GetReducedSize(height);
+    ++pass_count;
+  }
+  return pass_count;
+}
+
+int BoxReducer::GetReducedSize(int size) {
+  return (size + 1) / 2;
+}
+
+BoxReducer::BoxReducer()
+    : input_width_(0),
+      input_height_(0) {
+  // nop
+}
+
+BoxReducer::~BoxReducer() {
+  // nop
+}
+
+bool BoxReducer::Init(int input_width, int input_height) {
+  Clear();
+  if (input_width <= 0 || input_height <= 0) {
+    return false;
+  }
+  input_width_ = input_width;
+  input_height_ = input_height;
+  return true;
+}
+
+void BoxReducer::Clear() {
+  input_width_ = 0;
+  input_height_ = 0;
+}
+
+void BoxReducer::Reduce(const AVPicture &input, AVPicture *output,
+                        int y, int height) const {
+  ReduceRows(input, output, y, height, true);
+}
+
+void BoxReducer::ReducePortable(const AVPicture &input, AVPicture *output,
+                                int y, int height) const {
+  ReduceRows(input, output, y, height, false);
+}
+
+void BoxReducer::ReduceRows(const AVPicture &input, AVPicture *output,
+                            int y, int height, bool simd) const {
+  ASSERT(is_valid());
+  ASSERT(0 <= y && y + height <= output_height());
+  const int width = output_width();
+  for (int output_y = y; output_y < y + height; output_y++) {
+    // 高さが奇数なら最後の行を繰り返す
+    const int top_y = output_y * 2;
+    const int bottom_y = std::min(top_y + 1, input_height_ - 1);
+    const uint8_t *top = input.data[0] + top_y * input.linesize[0];
+    const uint8_t *bottom = input.data[0] + bottom_y * input.linesize[0];
+    uint8_t *line = output->data[0] + output_y * output->linesize[0];
+    int x = 0;
+#if defined(SCFF_BOX_REDUCER_SSE2)
+    if (simd) {
+      x = ReduceSpanSSE2(top, bottom, input_width_, line, width);
+    }
+#endif
+    ReduceSpanPortable(top, bottom, input_width_, line, x, width);
+  }
+}
+
+bool BoxReducer::is_valid() const {
+  return input_width_ > 0;
+}
+
+int BoxReducer::output_width() const {
+  return GetReducedSize(input_width_);
+}
+
+int BoxReducer::output_height() const {
+  return GetReducedSize(input_height_);
+}
+}   // namespace scff_imaging
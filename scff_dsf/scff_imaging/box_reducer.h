@@ -0,0 +1,93 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/box_reducer.h
+/// scff_imaging::BoxReducerの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_BOX_REDUCER_H_
+#define SCFF_DSF_SCFF_IMAGING_BOX_REDUCER_H_
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// RGB0(32bit)を縦横1/2に縮小する(2x2ピクセルの平均)
+/// - 大きく縮小する場合にSWScaleの前で繰り返し使い(ピラミッド)、
+///   SWScaleには残りの2倍以内の縮小だけをさせる
+/// - 幅・高さが奇数の場合は右端・下端のピクセルを繰り返したものとして
+///   平均する(縮小後の大きさは切り上げ)
+/// - バイトごとに平均するのでRGB0/BGR0のどちらでもよい
+/// - SSE2が使える場合は出力4ピクセル単位でまとめて縮小する
+///   (結果はSSE2を使わない場合と完全に一致する)
+class BoxReducer {
+ public:
+  /// 1/2の縮小を繰り返す回数の最大
+  static const int kMaxPassCount = 4;
+
+  /// 縦横とも2倍を超えて縮小する間、1/2の縮小を繰り返す回数を求める
+  /// @return 0ならピラミッドは使わない
+  static int GetPassCount(int input_width, int input_height,
+                          int output_width, int output_height);
+  /// 1/2に縮小した後の大きさ(端数は切り上げ)
+  static int GetReducedSize(int size);
+
+  /// コンストラクタ
+  BoxReducer();
+  /// デストラクタ
+  ~BoxReducer();
+
+  /// 入力の大きさを設定する
+  /// @retval true    縮小できる大きさ
+  /// @retval false   大きさが不正
+  bool Init(int input_width, int input_height);
+  /// 縮小をやめる(Initするまでis_validはfalse)
+  void Clear();
+
+  /// 出力の行[y, y + height)を入力から求めて書き込む
+  void Reduce(const AVPicture &input, AVPicture *output,
+              int y, int height) const;
+  /// SIMDを使わずに縮小する(検証用)
+  void ReducePortable(const AVPicture &input, AVPicture *output,
+                      int y, int height) const;
+
+  /// Getter: Initに成功したか
+  bool is_valid() const;
+  /// Getter: 出力の幅
+  int output_width() const;
+  /// Getter: 出力の高さ
+  int output_height() const;
+
+ private:
+  /// 出力の行[y, y + height)を縮小する
+  void ReduceRows(const AVPicture &input, AVPicture *output,
+                  int y, int height, bool simd) const;
+
+  /// 入力の幅
+  int input_width_;
+  /// 入力の高さ
+  int input_height_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(BoxReducer);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_BOX_REDUCER_H_
@@ -0,0 +1,165 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/capture_queue.cc
+/// scff_imaging::CaptureQueueの定義
+
+#include "scff_imaging/capture_queue.h"
+
+#include <chrono>
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::CaptureQueue
+//=====================================================================
+
+CaptureQueue::CaptureQueue(int slot_count)
+    : slot_count_(slot_count),
+      capacity_(slot_count - 2),
+      queue_head_(0),
+      queue_size_(0),
+      held_slot_(-1),
+      stopped_(false),
+      dropped_count_(0) {
+  for (int i = 0; i < kMaxSlotCount; i++) {
+    states_[i] = SlotStates::kFree;
+    captured_times_[i] = 0;
+    queue_[i] = -1;
+  }
+}
+
+CaptureQueue::~CaptureQueue() {
+  // nop
+}
+
+//-------------------------------------------------------------------
+// キャプチャ側
+//-------------------------------------------------------------------
+
+int CaptureQueue::AcquireWriteSlot() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < slot_count_; i++) {
+    if (states_[i] == SlotStates::kFree) {
+      states_[i] = SlotStates::kWriting;
+      return i;
+    }
+  }
+
+  // 空きがない: 変換が追いついていないので最も古い変換待ちを捨てる
+  // (書き込み中と変換中は高々1つずつなので変換待ちは必ずある)
+  int64_t captured_time = 0;
+  const int slot = PopFrontLocked(&captured_time);
+  states_[slot] = SlotStates::kWriting;
+  ++dropped_count_;
+  return slot;
+}
+
+void CaptureQueue::Push(int slot, int64_t captured_time) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_size_ == capacity_) {
+      // あふれた分は最も古いものから捨てる
+      int64_t dropped_time = 0;
+      const int dropped_slot = PopFrontLocked(&dropped_time);
+      states_[dropped_slot] = SlotStates::kFree;
+      ++dropped_count_;
+    }
+    states_[slot] = SlotStates::kQueued;
+    captured_times_[slot] = captured_time;
+    queue_[(queue_head_ + queue_size_) % slot_count_] = slot;
+    ++queue_size_;
+  }
+  queued_.notify_one();
+}
+
+void CaptureQueue::Discard(int slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  states_[slot] = SlotStates::kFree;
+}
+
+//-------------------------------------------------------------------
+// 変換側
+//-------------------------------------------------------------------
+
+bool CaptureQueue::Pop(int timeout_milliseconds, int *slot,
+                       int64_t *captured_time) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  queued_.wait_for(lock,
+                   std::chrono::milliseconds(timeout_milliseconds),
+                   [this] { return stopped_ || queue_size_ > 0; });
+  if (stopped_ || queue_size_ == 0) {
+    return false;
+  }
+
+  // 前回のスロットを空きに戻してから新しいスロットを保持する
+  if (held_slot_ != -1) {
+    states_[held_slot_] = SlotStates::kFree;
+  }
+  held_slot_ = PopFrontLocked(captured_time);
+  states_[held_slot_] = SlotStates::kReading;
+  *slot = held_slot_;
+  return true;
+}
+
+int CaptureQueue::held_slot() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return held_slot_;
+}
+
+//-------------------------------------------------------------------
+
+void CaptureQueue::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  queued_.notify_all();
+}
+
+void CaptureQueue::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < kMaxSlotCount; i++) {
+    states_[i] = SlotStates::kFree;
+    captured_times_[i] = 0;
+  }
+  queue_head_ = 0;
+  queue_size_ = 0;
+  held_slot_ = -1;
+  stopped_ = false;
+  dropped_count_ = 0;
+}
+
+int64_t CaptureQueue::dropped_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_count_;
+}
+
+int CaptureQueue::slot_count() const {
+  return slot_count_;
+}
+
+//-------------------------------------------------------------------
+
+int CaptureQueue::PopFrontLocked(int64_t *captured_time) {
+  const int slot = queue_[queue_head_];
+  queue_head_ = (queue_head_ + 1) % slot_count_;
+  --queue_size_;
+  *captured_time = captured_times_[slot];
+  return slot;
+}
+}   // namespace scff_imaging
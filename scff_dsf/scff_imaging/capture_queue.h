@@ -0,0 +1,129 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/capture_queue.h
+/// scff_imaging::CaptureQueueの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_CAPTURE_QUEUE_H_
+#define SCFF_DSF_SCFF_IMAGING_CAPTURE_QUEUE_H_
+
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// キャプチャ結果を格納するスロットをキャプチャ側から変換側へ受け渡す有限キュー
+/// - スロットは「空き」「書き込み中」「変換待ち」「変換中」のいずれか
+/// - キャプチャ側は待たない: 空きがなければ最も古い変換待ちを捨てて再利用する
+/// - 変換側は次のPopまでスロットを保持するので、新しいキャプチャが
+///   間に合わなかった場合は同じスロットをもう一度変換できる
+/// @attention キャプチャ側・変換側はそれぞれ1スレッドに限る
+class CaptureQueue {
+ public:
+  /// スロットの最大数
+  static const int kMaxSlotCount = 8;
+
+  /// コンストラクタ
+  /// @param slot_count スロットの数(書き込み中と変換中の分を含むので3以上)
+  explicit CaptureQueue(int slot_count);
+  /// デストラクタ
+  ~CaptureQueue();
+
+  //-------------------------------------------------------------------
+  // キャプチャ側
+  //-------------------------------------------------------------------
+  /// 書き込むスロットを取得する
+  int AcquireWriteSlot();
+  /// 書き込みが終わったスロットを変換待ちにする
+  /// @param captured_time キャプチャが完了した時刻
+  void Push(int slot, int64_t captured_time);
+  /// 書き込みに失敗したスロットを空きに戻す
+  void Discard(int slot);
+
+  //-------------------------------------------------------------------
+  // 変換側
+  //-------------------------------------------------------------------
+  /// 最も古い変換待ちのスロットを取得する
+  /// - 取得できたら前回Popしたスロットは空きに戻る
+  /// @param timeout_milliseconds 変換待ちがない場合に待つ時間
+  /// @param[out] slot 取得したスロット
+  /// @param[out] captured_time スロットのキャプチャが完了した時刻
+  /// @retval true 取得できた
+  /// @retval false タイムアウトまたはStop済み
+  bool Pop(int timeout_milliseconds, int *slot, int64_t *captured_time);
+  /// 前回Popしたスロット(まだなければ-1)
+  int held_slot() const;
+
+  //-------------------------------------------------------------------
+  /// 待機中のPopを起こし、以降のPopを失敗させる
+  void Stop();
+  /// 全てのスロットを空きに戻し、Stopを解除する
+  void Reset();
+
+  /// Getter: 変換されずに捨てられたキャプチャの数
+  int64_t dropped_count() const;
+  /// Getter: スロットの数
+  int slot_count() const;
+
+ private:
+  /// スロットの状態
+  enum class SlotStates {
+    kFree,
+    kWriting,
+    kQueued,
+    kReading
+  };
+
+  /// 変換待ちの先頭を取り除く(ロック済みであること)
+  int PopFrontLocked(int64_t *captured_time);
+
+  /// スロットの数
+  const int slot_count_;
+  /// 変換待ちの最大数
+  const int capacity_;
+
+  /// ロック
+  mutable std::mutex mutex_;
+  /// 変換待ちが追加された
+  std::condition_variable queued_;
+
+  /// スロットの状態
+  SlotStates states_[kMaxSlotCount];
+  /// スロットのキャプチャが完了した時刻
+  int64_t captured_times_[kMaxSlotCount];
+  /// 変換待ちのスロット(古い順のリングバッファ)
+  int queue_[kMaxSlotCount];
+  /// 変換待ちの先頭
+  int queue_head_;
+  /// 変換待ちの数
+  int queue_size_;
+  /// 変換側が保持しているスロット
+  int held_slot_;
+  /// Stop済み
+  bool stopped_;
+  /// 変換されずに捨てられたキャプチャの数
+  int64_t dropped_count_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(CaptureQueue);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_CAPTURE_QUEUE_H_
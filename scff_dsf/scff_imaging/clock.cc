@@ -0,0 +1,128 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/clock.cc
+/// scff_imaging::SystemClockの定義
+
+#include "scff_imaging/clock.h"
+
+#include <atomic>
+#if defined(SCFF_IMAGING_HEADLESS)
+#include <chrono>
+#include <thread>
+#else
+#include <Windows.h>
+#include <mmsystem.h>
+#endif
+
+namespace {
+
+/// パフォーマンスカウンタの周波数(0なら未取得)
+std::atomic<int64_t> g_counter_frequency(0);
+
+/// パフォーマンスカウンタの周波数を取得する
+int64_t GetCounterFrequency() {
+  int64_t frequency = g_counter_frequency.load(std::memory_order_relaxed);
+  if (frequency != 0LL) {
+    return frequency;
+  }
+#if defined(SCFF_IMAGING_HEADLESS)
+  // steady_clockの1秒あたりのカウント数
+  typedef std::chrono::steady_clock::period Period;
+  frequency = static_cast<int64_t>(Period::den / Period::num);
+#else
+  LARGE_INTEGER large_frequency;
+  frequency = 1LL;
+  if (QueryPerformanceFrequency(&large_frequency) &&
+      large_frequency.QuadPart > 0) {
+    frequency = large_frequency.QuadPart;
+  }
+#endif
+  // 何度取得しても同じ値なので競合しても問題ない
+  g_counter_frequency.store(frequency, std::memory_order_relaxed);
+  return frequency;
+}
+}   // namespace
+
+namespace scff_imaging {
+
+int64_t GetMonotonicClockTime() {
+#if defined(SCFF_IMAGING_HEADLESS)
+  const int64_t counter = static_cast<int64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#else
+  LARGE_INTEGER large_counter;
+  QueryPerformanceCounter(&large_counter);
+  const int64_t counter = large_counter.QuadPart;
+#endif
+  // オーバーフローしないように秒とそれ以下に分けて計算する
+  const int64_t frequency = GetCounterFrequency();
+  const int64_t seconds = counter / frequency;
+  const int64_t remainder = counter % frequency;
+  return seconds * kClockUnitsPerSecond +
+         (remainder * kClockUnitsPerSecond) / frequency;
+}
+
+//=====================================================================
+// scff_imaging::SystemClock
+//=====================================================================
+
+SystemClock::SystemClock()
+    : Clock(),
+      period_changed_(false) {
+#if !defined(SCFF_IMAGING_HEADLESS)
+  // ::Sleepの分解能を上げる(デフォルトは15.6mSec程度)
+  period_changed_ = (timeBeginPeriod(1) == TIMERR_NOERROR);
+#endif
+}
+
+SystemClock::~SystemClock() {
+#if !defined(SCFF_IMAGING_HEADLESS)
+  if (period_changed_) {
+    timeEndPeriod(1);
+  }
+#endif
+}
+
+int64_t SystemClock::Now() {
+  return GetMonotonicClockTime();
+}
+
+void SystemClock::SleepFor(int64_t duration) {
+  if (duration <= 0LL) {
+    return;
+  }
+  // 1mSec未満は切り捨て(FrameScheduler側でスピンして補う)
+#if defined(SCFF_IMAGING_HEADLESS)
+  std::this_thread::sleep_for(
+      std::chrono::milliseconds(duration / kClockUnitsPerMillisecond));
+#else
+  ::Sleep(static_cast<DWORD>(duration / kClockUnitsPerMillisecond));
+#endif
+}
+
+void SystemClock::Relax() {
+  // 同じプロセッサで待っているスレッドがあれば譲る
+#if defined(SCFF_IMAGING_HEADLESS)
+  std::this_thread::yield();
+#else
+  if (!SwitchToThread()) {
+    YieldProcessor();
+  }
+#endif
+}
+}   // namespace scff_imaging
@@ -0,0 +1,94 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/clock.h
+/// scff_imaging::Clock, scff_imaging::SystemClockの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_CLOCK_H_
+#define SCFF_DSF_SCFF_IMAGING_CLOCK_H_
+
+#include <cstdint>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// 1秒あたりのクロックの単位数(=100nSec単位, REFERENCE_TIMEと同じ)
+const int64_t kClockUnitsPerSecond = 10000000LL;
+/// 1ミリ秒あたりのクロックの単位数
+const int64_t kClockUnitsPerMillisecond = kClockUnitsPerSecond / 1000LL;
+
+/// SystemClock::Nowと同じ時計の現在時刻(単調増加, 100nSec)
+/// @attention どのスレッドからでもSystemClockなしで呼び出せる
+int64_t GetMonotonicClockTime();
+
+/// FrameSchedulerが利用する時計のインターフェース
+/// @attention 単位はすべて100nSec
+class Clock {
+ public:
+  /// 仮想デストラクタ
+  virtual ~Clock() {
+    // nop
+  }
+
+  /// 現在時刻(単調増加)
+  virtual int64_t Now() = 0;
+  /// 指定された時間だけスレッドを眠らせる
+  /// @attention OSのタイマ分解能によっては指定よりも長く眠る
+  virtual void SleepFor(int64_t duration) = 0;
+  /// スピン待機中に一回ずつ呼ばれる
+  virtual void Relax() = 0;
+
+ protected:
+  /// コンストラクタ
+  Clock() {
+    // nop
+  }
+
+ private:
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(Clock);
+};
+
+/// QueryPerformanceCounterを利用した時計
+/// @attention 生存期間中はOSのタイマ分解能を1mSecに上げる
+class SystemClock : public Clock {
+ public:
+  /// コンストラクタ
+  SystemClock();
+  /// デストラクタ
+  ~SystemClock();
+
+  //-------------------------------------------------------------------
+  /// @copydoc Clock::Now
+  int64_t Now();
+  /// @copydoc Clock::SleepFor
+  void SleepFor(int64_t duration);
+  /// @copydoc Clock::Relax
+  void Relax();
+  //-------------------------------------------------------------------
+
+ private:
+  /// timeBeginPeriodに成功したか
+  bool period_changed_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(SystemClock);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_CLOCK_H_
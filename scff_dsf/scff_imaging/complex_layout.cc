@@ -20,11 +20,57 @@
 
 #include "scff_imaging/complex_layout.h"
 
+#include <algorithm>
+
 #include "scff_imaging/debug.h"
 #include "scff_imaging/utilities.h"
 #include "scff_imaging/screen_capture.h"
+#include "scff_imaging/rotate.h"
 #include "scff_imaging/scale.h"
 #include "scff_imaging/padding.h"
+#include "scff_imaging/worker_pool.h"
+#include "scff_imaging/trace.h"
+
+namespace {
+
+/// レイアウト要素を拡大縮小した後に描画する矩形を求める
+/// - アスペクト比の保持などによる余白(仮想パディング)の分だけ小さくなる
+/// - アスペクト比は回転後の大きさで計算する
+void CalculateElementRect(const scff_imaging::LayoutParameter &parameter,
+                          scff_imaging::ImageRect *rect) {
+  int rotated_width = parameter.clipping_width;
+  int rotated_height = parameter.clipping_height;
+  scff_imaging::utilities::GetRotatedSize(parameter.rotate_direction,
+                                          parameter.clipping_width,
+                                          parameter.clipping_height,
+                                          &rotated_width, &rotated_height);
+
+  // 仮想パディングサイズの計算
+  int virtual_padding_top = 0;
+  int virtual_padding_bottom = 0;
+  int virtual_padding_left = 0;
+  int virtual_padding_right = 0;
+  scff_imaging::utilities::CalculatePaddingSize(
+      parameter.bound_width,
+      parameter.bound_height,
+      rotated_width,
+      rotated_height,
+      parameter.stretch,
+      parameter.keep_aspect_ratio,
+      &virtual_padding_top, &virtual_padding_bottom,
+      &virtual_padding_left, &virtual_padding_right);
+
+  // 描画する原点の座標を計算
+  rect->x = parameter.bound_x + virtual_padding_left;
+  rect->y = parameter.bound_y + virtual_padding_top;
+
+  // パディング分だけサイズを小さくする
+  rect->width =
+      parameter.bound_width - (virtual_padding_left + virtual_padding_right);
+  rect->height =
+      parameter.bound_height - (virtual_padding_top + virtual_padding_bottom);
+}
+}   // namespace
 
 namespace scff_imaging {
 
@@ -34,25 +80,33 @@ namespace scff_imaging {
 
 ComplexLayout::ComplexLayout(
     int element_count,
-    const LayoutParameter (&parameters)[kMaxProcessorSize])
-    : Layout(),
+    const LayoutParameter (&parameters)[kMaxProcessorSize],
+    WorkerPool *worker_pool,
+    ScalerCache *scaler_cache,
+    int slot_count,
+    bool enable_scale_quality_levels)
+    : StagedLayout(slot_count),
       element_count_(element_count),
+      enable_scale_quality_levels_(enable_scale_quality_levels),
+      worker_pool_(worker_pool),
+      scaler_cache_(scaler_cache),
+      transfer_in_element_(true),
       screen_capture_(nullptr) {
   DbgLog((kLogMemory, kTrace,
-          TEXT("ComplexLayout: NEW(%d)"),
-          element_count));
+          TEXT("ComplexLayout: NEW(%d, %d)"),
+          element_count, slot_count));
   // 配列の初期化
   for (int i = 0; i < kMaxProcessorSize; i++) {
     parameters_[i] = parameters[i];
+    rotate_[i] = nullptr;
     scale_[i] = nullptr;
-    element_x_[i] = -1;    // ありえない値
-    element_y_[i] = -1;    // ありえない値
+    element_errors_[i] = ErrorCodes::kNoError;
+    scale_in_place_[i] = false;
   }
   // 明示的に初期化していない
-  // captured_image_[kMaxProcessorSize]
+  // captured_image_[kMaxSlotCount][kMaxProcessorSize]
+  // rotated_image_[kMaxProcessorSize]
   // converted_image_[kMaxProcessorSize]
-  // draw_context_
-  // background_color_
 }
 
 ComplexLayout::~ComplexLayout() {
@@ -64,50 +118,68 @@ ComplexLayout::~ComplexLayout() {
     delete screen_capture_;
   }
   for (int i = 0; i < kMaxProcessorSize; i++) {
+    if (rotate_[i] != nullptr) {
+      delete rotate_[i];
+    }
     if (scale_[i] != nullptr) {
       delete scale_[i];
     }
   }
 }
 
-ErrorCodes ComplexLayout::InitByIndex(int index) {
-  ASSERT(0 <= index && index < element_count_);
-  if (!utilities::Contains(0, 0,
-                           GetOutputImage()->width(),
-                           GetOutputImage()->height(),
-                           parameters_[index].bound_x,
-                           parameters_[index].bound_y,
-                           parameters_[index].bound_width,
-                           parameters_[index].bound_height)) {
-    return ErrorCodes::kComplexLayoutBoundError;
+ErrorCodes ComplexLayout::CullHiddenElements() {
+  const int output_width = GetOutputImage()->width();
+  const int output_height = GetOutputImage()->height();
+
+  ImageRect element_rects[kMaxProcessorSize];
+  int opacities[kMaxProcessorSize];
+  for (int i = 0; i < element_count_; i++) {
+    // 隠れる要素も含めて範囲外の要素はエラー扱い
+    if (!utilities::Contains(0, 0, output_width, output_height,
+                             parameters_[i].bound_x,
+                             parameters_[i].bound_y,
+                             parameters_[i].bound_width,
+                             parameters_[i].bound_height)) {
+      return ErrorCodes::kComplexLayoutBoundError;
+    }
+    CalculateElementRect(parameters_[i], &(element_rects[i]));
+    opacities[i] = parameters_[i].opacity;
   }
 
-  // 仮想パディングサイズの計算
-  int virtual_padding_top = 0;
-  int virtual_padding_bottom = 0;
-  int virtual_padding_left = 0;
-  int virtual_padding_right = 0;
-  utilities::CalculatePaddingSize(
-      parameters_[index].bound_width,
-      parameters_[index].bound_height,
-      parameters_[index].clipping_width,
-      parameters_[index].clipping_height,
-      parameters_[index].stretch,
-      parameters_[index].keep_aspect_ratio,
-      &virtual_padding_top, &virtual_padding_bottom,
-      &virtual_padding_left, &virtual_padding_right);
+  // 合成の初期化(隠れた要素と完全に透明な要素は取り除かれる)
+  if (!compositor_.Init(GetOutputImage()->av_pixel_format(),
+                        output_width, output_height,
+                        element_count_, element_rects, opacities)) {
+    return ErrorCodes::kComplexLayoutInvalidPixelFormatError;
+  }
 
-  // 描画する原点の座標を計算
-  element_x_[index] = parameters_[index].bound_x + virtual_padding_left;
-  element_y_[index] = parameters_[index].bound_y + virtual_padding_top;
+  // 隠れた要素はキャプチャも拡大縮小もしないように取り除く
+  const int visible_count = compositor_.element_count();
+  for (int i = 0; i < visible_count; i++) {
+    // source_indexは昇順なので前から詰めればよい
+    parameters_[i] = parameters_[compositor_.source_index(i)];
+  }
+  if (visible_count < element_count_) {
+    DbgLog((kLogTrace, kTraceInfo,
+            TEXT("ComplexLayout: %d of %d elements are hidden"),
+            element_count_ - visible_count, element_count_));
+  }
+  element_count_ = visible_count;
 
-  // パディング分だけサイズを小さくする
-  const int element_width =
-      parameters_[index].bound_width -
-          (virtual_padding_left + virtual_padding_right);
-  const int element_height =
-      parameters_[index].bound_height -
-          (virtual_padding_top + virtual_padding_bottom);
+  return ErrorCodes::kNoError;
+}
+
+bool ComplexLayout::CanScaleInPlace(int index) const {
+  // 不透明で、他の要素や背景と書き換えるバイトが重ならない要素だけ
+  return compositor_.IsIsolated(index);
+}
+
+ErrorCodes ComplexLayout::InitByIndex(int index) {
+  ASSERT(0 <= index && index < element_count_);
+
+  const ImageRect &element_rect = compositor_.element_rect(index);
+  const int element_width = element_rect.width;
+  const int element_height = element_rect.height;
 
   //-------------------------------------------------------------------
   // 初期化の順番はイメージ→プロセッサの順
@@ -115,16 +187,44 @@ ErrorCodes ComplexLayout::InitByIndex(int index) {
   // Image
   //-------------------------------------------------------------------
   // ScreenCaptureから取得した変換処理前のイメージ
-  const ErrorCodes error_captured_image =
-      captured_image_[index].Create(ImagePixelFormats::kRGB0,
-                                    parameters_[index].clipping_width,
-                                    parameters_[index].clipping_height);
-  if (error_captured_image != ErrorCodes::kNoError) {
-    return error_captured_image;
+  for (int slot = 0; slot < slot_count(); slot++) {
+    const ErrorCodes error_captured_image =
+        captured_image_[slot][index].Create(
+            ImagePixelFormats::kRGB0,
+            parameters_[index].clipping_width,
+            parameters_[index].clipping_height);
+    if (error_captured_image != ErrorCodes::kNoError) {
+      return error_captured_image;
+    }
+  }
+
+  // Rotateで回転した後のイメージ
+  const bool rotate =
+      parameters_[index].rotate_direction != RotateDirections::kNoRotate;
+  if (rotate) {
+    int rotated_width = 0;
+    int rotated_height = 0;
+    utilities::GetRotatedSize(parameters_[index].rotate_direction,
+                              parameters_[index].clipping_width,
+                              parameters_[index].clipping_height,
+                              &rotated_width, &rotated_height);
+    const ErrorCodes error_rotated_image =
+        rotated_image_[index].Create(ImagePixelFormats::kRGB0,
+                                     rotated_width,
+                                     rotated_height);
+    if (error_rotated_image != ErrorCodes::kNoError) {
+      return error_rotated_image;
+    }
   }
 
   // SWScaleで拡大縮小ピクセルフォーマット変換を行った後のイメージ
-  const ErrorCodes error_converted_image =
+  // 直接拡大縮小できる要素は合成用のイメージもコピーも使わない
+  scale_in_place_[index] = CanScaleInPlace(index);
+  const ErrorCodes error_converted_image = scale_in_place_[index] ?
+        converted_image_[index].CreateForView(
+            GetOutputImage()->pixel_format(),
+            element_width,
+            element_height) :
         converted_image_[index].Create(GetOutputImage()->pixel_format(),
                                        element_width,
                                        element_height);
@@ -134,10 +234,37 @@ ErrorCodes ComplexLayout::InitByIndex(int index) {
   //-------------------------------------------------------------------
   // Processor
   //-------------------------------------------------------------------
+  // 回転
+  // キャプチャ結果はメモリ上で上下反転している場合がある
+  if (rotate) {
+    Rotate *rotate_processor = new Rotate(
+        parameters_[index].rotate_direction,
+        !utilities::IsTopdownPixelFormat(GetOutputImage()->pixel_format()));
+    rotate_processor->SetInputImage(&(captured_image_[0][index]));
+    rotate_processor->SetOutputImage(&(rotated_image_[index]));
+    const ErrorCodes error_rotate_init = rotate_processor->Init();
+    if (error_rotate_init != ErrorCodes::kNoError) {
+      delete rotate_processor;
+      return error_rotate_init;
+    }
+    rotate_[index] = rotate_processor;
+  }
+
   // 拡大縮小ピクセルフォーマット変換
-  Scale *scale = new Scale(parameters_[index].swscale_config);
-  scale->SetInputImage(&(captured_image_[index]));
+  // 要素ごとに並列処理するのでScale自体は分割しない
+  Scale *scale = new Scale(parameters_[index].swscale_config, nullptr,
+                           scaler_cache_, enable_scale_quality_levels_);
+  scale->SetInputImage(rotate ? &(rotated_image_[index]) :
+                                &(captured_image_[0][index]));
   scale->SetOutputImage(&(converted_image_[index]));
+  // 入力が変化しなければ前回の拡大縮小結果を合成に使いまわす
+  // (直接拡大縮小する要素ではバッファに残っている前回の結果をそのまま使う)
+  // 一部だけが変化した場合は変化した行に関係する部分だけを拡大縮小する
+  // 出力イメージのバッファが内容を保持しない場合、直接拡大縮小する要素には
+  // 前回の結果が残っていないので毎回全体を拡大縮小する
+  const bool reuse_output = !scale_in_place_[index] || persistent_output();
+  scale->SetSkipUnchangedInput(reuse_output);
+  scale->SetIncrementalUpdate(reuse_output);
   const ErrorCodes error_scale_init = scale->Init();
   if (error_scale_init != ErrorCodes::kNoError) {
     delete scale;
@@ -149,6 +276,89 @@ ErrorCodes ComplexLayout::InitByIndex(int index) {
   return ErrorCodes::kNoError;
 }
 
+void ComplexLayout::RunByIndex(int index) {
+  SCFF_TRACE_SCOPE("ComplexLayout::RunByIndex");
+  ASSERT(0 <= index && index < element_count_);
+
+  // キャプチャ結果をOutputImageに書き込んでから(回転して)Scaleを利用して変換
+  // 同じ要素のイメージしか触らないので要素間の同期は不要
+  if (transfer_in_element_) {
+    screen_capture_->Transfer(index);
+  }
+  if (rotate_[index] != nullptr) {
+    element_errors_[index] = rotate_[index]->Run();
+    if (element_errors_[index] != ErrorCodes::kNoError) {
+      return;
+    }
+  }
+  element_errors_[index] = scale_[index]->Run();
+}
+
+void ComplexLayout::SwapCapturedImages(int slot, bool capture,
+                                       bool convert) {
+  ASSERT(0 <= slot && slot < slot_count());
+  for (int i = 0; i < element_count_; i++) {
+    if (capture) {
+      screen_capture_->SwapOutputImage(&(captured_image_[slot][i]), i);
+    }
+    if (convert) {
+      if (rotate_[i] != nullptr) {
+        rotate_[i]->SwapInputImage(&(captured_image_[slot][i]));
+      } else {
+        scale_[i]->SwapInputImage(&(captured_image_[slot][i]));
+      }
+    }
+  }
+}
+
+ErrorCodes ComplexLayout::ScaleAndCompose(bool transfer) {
+  // 直接拡大縮小する要素のビューを今回の出力イメージのバッファに関連付ける
+  for (int i = 0; i < element_count_; i++) {
+    if (!scale_in_place_[i]) {
+      continue;
+    }
+    const ImageRect &element_rect = compositor_.element_rect(i);
+    const ErrorCodes error_view =
+        converted_image_[i].AttachView(*GetOutputImage(),
+                                       element_rect.x, element_rect.y);
+    if (error_view != ErrorCodes::kNoError) {
+      return error_view;
+    }
+  }
+
+  // 要素ごとに(キャプチャ後の処理と)変換
+  transfer_in_element_ = transfer;
+  if (worker_pool_ != nullptr) {
+    for (int i = element_count_ - 1; i >= 0; i--) {
+      worker_pool_->Submit([this, i] { RunByIndex(i); });
+    }
+    // 合成の前に全要素の完了を待つ
+    worker_pool_->Join();
+  } else {
+    // すこしでもCacheヒット率をあげるべく逆順に
+    for (int i = element_count_ - 1; i >= 0; i--) {
+      RunByIndex(i);
+    }
+  }
+  for (int i = 0; i < element_count_; i++) {
+    if (element_errors_[i] != ErrorCodes::kNoError) {
+      return element_errors_[i];
+    }
+  }
+
+  // 背景と、直接拡大縮小しなかった要素を合成
+  SCFF_TRACE_SCOPE("ComplexLayout::Compose");
+  AVPicture *elements[kMaxProcessorSize];
+  for (int i = 0; i < element_count_; i++) {
+    elements[i] =
+        scale_in_place_[i] ? nullptr : converted_image_[i].avpicture();
+  }
+  compositor_.Compose(GetOutputImage()->avpicture(), elements,
+                      persistent_output());
+
+  return ErrorCodes::kNoError;
+}
+
 //-------------------------------------------------------------------
 
 ErrorCodes ComplexLayout::Init() {
@@ -161,6 +371,12 @@ ErrorCodes ComplexLayout::Init() {
     return ErrorOccured(ErrorCodes::kComplexLayoutInvalidPixelFormatError);
   }
 
+  // 合成を初期化して、上の要素に完全に隠れる要素を取り除く
+  const ErrorCodes error_cull = CullHiddenElements();
+  if (error_cull != ErrorCodes::kNoError) {
+    return ErrorOccured(error_cull);
+  }
+
   // 要素を初期化
   for (int i = 0; i < element_count_; i++) {
     const ErrorCodes error_element = InitByIndex(i);
@@ -178,7 +394,7 @@ ErrorCodes ComplexLayout::Init() {
       !utilities::IsTopdownPixelFormat(GetOutputImage()->pixel_format()),
       element_count_, parameters_);
   for (int i = 0; i < element_count_; i++) {
-    screen_capture->SetOutputImage(&(captured_image_[i]), i);
+    screen_capture->SetOutputImage(&(captured_image_[0][i]), i);
   }
   const ErrorCodes error_screen_capture = screen_capture->Init();
   if (error_screen_capture != ErrorCodes::kNoError) {
@@ -188,65 +404,99 @@ ErrorCodes ComplexLayout::Init() {
   screen_capture_ = screen_capture;
   //-------------------------------------------------------------------
 
-  // 描画用コンテキストの初期化
-  const int error_init =
-      ff_draw_init(&draw_context_,
-                   GetOutputImage()->av_pixel_format(),
-                   0);
-  ASSERT(error_init == 0);
-
-  // 真っ黒に設定
-  uint8_t rgba_background_color[4] = {0};
-  ff_draw_color(&draw_context_,
-                &background_color_,
-                rgba_background_color);
-
   return InitDone();
 }
 
 ErrorCodes ComplexLayout::Run() {
+  SCFF_TRACE_SCOPE("ComplexLayout::Run");
   if (GetCurrentError() != ErrorCodes::kNoError) {
     // 何かエラーが発生している場合は何もしない
     return GetCurrentError();
   }
 
+  // スロット0を使って同じスレッドでキャプチャと変換を行う
+  SwapCapturedImages(0, true, true);
+
   // まとめてスクリーンキャプチャ
-  const ErrorCodes error_screen_capture = screen_capture_->Run();
+  // オンスクリーンDCを触るBitBltまでは逐次で行う
+  const ErrorCodes error_screen_capture = screen_capture_->Capture();
   if (error_screen_capture != ErrorCodes::kNoError) {
     return ErrorOccured(error_screen_capture);
   }
 
-  // Scaleを利用して変換
-  // すこしでもCacheヒット率をあげるべく逆順に
+  // 要素ごとのキャプチャ後の処理も変換と一緒に並列で行う
+  const ErrorCodes error_convert = ScaleAndCompose(true);
+  if (error_convert != ErrorCodes::kNoError) {
+    return ErrorOccured(error_convert);
+  }
+
+  // エラー発生なし
+  return GetCurrentError();
+}
+
+ErrorCodes ComplexLayout::RunCapture(int slot) {
+  SCFF_TRACE_SCOPE("ComplexLayout::RunCapture");
+  ASSERT(0 <= slot && slot < slot_count());
+  if (GetCurrentError() != ErrorCodes::kNoError) {
+    // 何かエラーが発生している場合は何もしない
+    return GetCurrentError();
+  }
+
+  // worker_pool_は変換側のスレッドが使うのでここでは逐次処理する
+  SwapCapturedImages(slot, true, false);
+  const ErrorCodes error_screen_capture = screen_capture_->Capture();
+  if (error_screen_capture != ErrorCodes::kNoError) {
+    return error_screen_capture;
+  }
   for (int i = element_count_ - 1; i >= 0; i--) {
-    const ErrorCodes error_scale = scale_[i]->Run();
-    if (error_scale != ErrorCodes::kNoError) {
-      return ErrorOccured(error_scale);
-    }
+    screen_capture_->Transfer(i);
   }
 
-  // 背景描画
-  ff_fill_rectangle(&draw_context_, &background_color_,
-                    GetOutputImage()->avpicture()->data,
-                    GetOutputImage()->avpicture()->linesize,
-                    0, 0,
-                    GetOutputImage()->width(),
-                    GetOutputImage()->height());
+  return ErrorCodes::kNoError;
+}
+
+ErrorCodes ComplexLayout::RunConvert(int slot) {
+  SCFF_TRACE_SCOPE("ComplexLayout::RunConvert");
+  ASSERT(0 <= slot && slot < slot_count());
+  if (GetCurrentError() != ErrorCodes::kNoError) {
+    // 何かエラーが発生している場合は何もしない
+    return GetCurrentError();
+  }
+
+  // キャプチャ後の処理はRunCaptureで済んでいる
+  SwapCapturedImages(slot, false, true);
+  return ScaleAndCompose(false);
+}
+
+int ComplexLayout::scale_quality_level_count() const {
+  // 要素ごとに段階の数が違う場合は一番多いものに合わせる
+  // (少ない要素はSetQualityLevelで最後の段階に丸められる)
+  int level_count = 1;
+  for (int i = 0; i < element_count_; i++) {
+    if (scale_[i] != nullptr) {
+      level_count = std::max(level_count, scale_[i]->quality_level_count());
+    }
+  }
+  return level_count;
+}
 
-  // 要素を順番に描画
+void ComplexLayout::SetScaleQualityLevel(int level) {
   for (int i = 0; i < element_count_; i++) {
-    ff_copy_rectangle2(&draw_context_,
-                       GetOutputImage()->avpicture()->data,
-                       GetOutputImage()->avpicture()->linesize,
-                       converted_image_[i].avpicture()->data,
-                       converted_image_[i].avpicture()->linesize,
-                       element_x_[i], element_y_[i],
-                       0, 0,
-                       converted_image_[i].width(),
-                       converted_image_[i].height());
+    if (scale_[i] != nullptr) {
+      scale_[i]->SetQualityLevel(level);
+    }
   }
+}
 
-  // エラー発生なし
-  return GetCurrentError();
+UnchangedFrameStats ComplexLayout::GetUnchangedFrameStats() const {
+  UnchangedFrameStats stats = {0LL, 0LL, 0LL};
+  for (int i = 0; i < element_count_; i++) {
+    if (scale_[i] != nullptr) {
+      stats.hits += scale_[i]->skipped_count();
+      stats.misses += scale_[i]->scaled_count();
+      stats.partial_misses += scale_[i]->partially_scaled_count();
+    }
+  }
+  return stats;
 }
 }   // namespace scff_imaging
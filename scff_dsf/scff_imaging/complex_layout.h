@@ -21,25 +21,36 @@
 #ifndef SCFF_DSF_SCFF_IMAGING_COMPLEX_LAYOUT_H_
 #define SCFF_DSF_SCFF_IMAGING_COMPLEX_LAYOUT_H_
 
-#include <libavfilter/drawutils.h>
-
 #include "scff_imaging/common.h"
 #include "scff_imaging/layout.h"
 #include "scff_imaging/avpicture_with_fill_image.h"
+#include "scff_imaging/compositor.h"
 
 namespace scff_imaging {
 
 class ScreenCapture;
+class Rotate;
 class Scale;
 class Padding;
+class WorkerPool;
+class ScalerCache;
 
 /// 複数のスクリーンキャプチャ領域を取り扱い可能なレイアウト
-class ComplexLayout : public Layout {
+class ComplexLayout : public StagedLayout {
  public:
   /// コンストラクタ
+  /// @param worker_pool 要素ごとの処理を並列実行するプール(nullptrなら逐次実行)
+  /// @param scaler_cache SwsContextを借りるキャッシュ(nullptrなら毎回作成)
+  /// @param slot_count キャプチャ結果を保持するスロットの数
+  /// @param enable_scale_quality_levels 拡大縮小の品質段階を切り替え可能にする
+  /// @attention worker_poolはRunまたはRunConvertを呼び出すスレッドだけが使う
   ComplexLayout(
       int element_count,
-      const LayoutParameter (&parameters)[kMaxProcessorSize]);
+      const LayoutParameter (&parameters)[kMaxProcessorSize],
+      WorkerPool *worker_pool,
+      ScalerCache *scaler_cache,
+      int slot_count,
+      bool enable_scale_quality_levels);
   /// デストラクタ
   ~ComplexLayout();
 
@@ -49,39 +60,79 @@ class ComplexLayout : public Layout {
   /// @copydoc Processor::Run
   ErrorCodes Run();
   //-------------------------------------------------------------------
+  /// @copydoc StagedLayout::RunCapture
+  ErrorCodes RunCapture(int slot);
+  /// @copydoc StagedLayout::RunConvert
+  ErrorCodes RunConvert(int slot);
+  /// @copydoc StagedLayout::scale_quality_level_count
+  int scale_quality_level_count() const;
+  /// @copydoc StagedLayout::SetScaleQualityLevel
+  void SetScaleQualityLevel(int level);
+  /// @copydoc StagedLayout::GetUnchangedFrameStats
+  UnchangedFrameStats GetUnchangedFrameStats() const;
+  //-------------------------------------------------------------------
 
  private:
+  /// 合成を初期化して、上の要素に完全に隠れる要素を取り除く
+  /// @attention 要素の初期化前に呼び出すこと
+  ErrorCodes CullHiddenElements();
+  /// 要素を出力イメージに直接拡大縮小してよいか
+  /// - 要素が書き換えるバイトを他の要素や背景が書き換えない場合のみ
+  /// - バッファが内容を保持しなければ、直接拡大縮小する要素は毎回全体を描画する
+  /// @attention CullHiddenElementsの後に呼び出すこと
+  bool CanScaleInPlace(int index) const;
   /// インデックスを指定して初期化
   ErrorCodes InitByIndex(int index);
+  /// インデックスを指定してキャプチャ後の処理と変換を行う
+  /// @attention インデックスごとに別スレッドから呼び出してよい
+  void RunByIndex(int index);
+  /// 全要素のScaleを実行して合成する
+  /// @param transfer trueならScaleの前にキャプチャ後の処理も行う
+  ErrorCodes ScaleAndCompose(bool transfer);
+  /// スロットのキャプチャ結果をScreenCapture/Rotate/Scaleの入出力にする
+  void SwapCapturedImages(int slot, bool capture, bool convert);
 
   //-------------------------------------------------------------------
   // Processor
   //-------------------------------------------------------------------
   /// スクリーンキャプチャ
   ScreenCapture *screen_capture_;
+  /// 回転(回転しない要素ではnullptr)
+  Rotate *rotate_[kMaxProcessorSize];
   /// 拡大縮小ピクセルフォーマット変換
   Scale *scale_[kMaxProcessorSize];
   //-------------------------------------------------------------------
   // Image
   //-------------------------------------------------------------------
-  /// ScreenCaptureから取得した変換処理前のイメージ
-  AVPictureWithFillImage captured_image_[kMaxProcessorSize];
+  /// ScreenCaptureから取得した変換処理前のイメージ(スロットごと)
+  AVPictureWithFillImage captured_image_[kMaxSlotCount][kMaxProcessorSize];
+  /// Rotateで回転した後のイメージ(回転しない要素では空)
+  AVPictureWithFillImage rotated_image_[kMaxProcessorSize];
   /// SWScaleで拡大縮小ピクセルフォーマット変換を行った後のイメージ
+  /// (直接拡大縮小する要素では出力イメージの一部を指すビュー)
   AVPictureImage converted_image_[kMaxProcessorSize];
   //-------------------------------------------------------------------
 
-  /// 描画用コンテキスト
-  FFDrawContext draw_context_;
-  /// 背景カラー
-  FFDrawColor background_color_;
+  /// 背景と要素の合成(要素の矩形と見える部分も保持する)
+  Compositor compositor_;
+  /// 要素を合成せず出力イメージに直接拡大縮小するか
+  bool scale_in_place_[kMaxProcessorSize];
+
+  /// 要素ごとのRunByIndexの結果
+  ErrorCodes element_errors_[kMaxProcessorSize];
+  /// RunByIndexでキャプチャ後の処理も行うか
+  bool transfer_in_element_;
 
-  /// レイアウト要素拡大縮小後の新しい原点のX座標
-  int element_x_[kMaxProcessorSize];
-  /// レイアウト要素拡大縮小後の新しい原点のY座標
-  int element_y_[kMaxProcessorSize];
+  /// 要素ごとの処理を並列実行するプール(所有しない)
+  WorkerPool *worker_pool_;
+  /// SwsContextを借りるキャッシュ(所有しない)
+  ScalerCache *scaler_cache_;
 
   /// レイアウト要素の数
-  const int element_count_;
+  /// @attention Initで隠れた要素を取り除いた数になる
+  int element_count_;
+  /// 拡大縮小の品質段階を切り替えられるようにするか
+  const bool enable_scale_quality_levels_;
 
   /// レイアウトパラメータ
   LayoutParameter parameters_[kMaxProcessorSize];
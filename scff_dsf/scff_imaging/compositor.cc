@@ -0,0 +1,248 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/compositor.cc
+/// scff_imaging::Compositorの定義
+
+#include "scff_imaging/compositor.h"
+
+#include "scff_imaging/debug.h"
+
+namespace {
+
+/// 2つの矩形が重なるか
+bool Overlaps(const scff_imaging::ImageRect &a,
+              const scff_imaging::ImageRect &b) {
+  return a.x < b.x + b.width && b.x < a.x + a.width &&
+         a.y < b.y + b.height && b.y < a.y + a.height;
+}
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::Compositor
+//=====================================================================
+
+Compositor::Compositor()
+    : has_translucent_element_(false),
+      width_(0),
+      height_(0),
+      element_count_(0) {
+  // 配列の初期化
+  for (int i = 0; i < kMaxProcessorSize; i++) {
+    source_indices_[i] = -1;  // ありえない値
+    element_rects_[i].x = 0;
+    element_rects_[i].y = 0;
+    element_rects_[i].width = 0;
+    element_rects_[i].height = 0;
+    opacities_[i] = 0;
+  }
+  // 明示的に初期化していない
+  // draw_context_
+  // background_color_
+}
+
+Compositor::~Compositor() {
+  // nop
+}
+
+bool Compositor::Init(AVPixelFormat av_pixel_format, int width, int height,
+                      int element_count, const ImageRect element_rects[],
+                      const int opacities[]) {
+  ASSERT(element_count <= kMaxProcessorSize);
+
+  // 描画用コンテキストの初期化
+  if (ff_draw_init(&draw_context_, av_pixel_format, 0) < 0) {
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  const int align_x = 1 << draw_context_.hsub_max;
+  const int align_y = 1 << draw_context_.vsub_max;
+
+  // 完全に透明な要素は何も描画しないので大きさ0として扱う
+  ImageRect rects[kMaxProcessorSize];
+  bool opaque[kMaxProcessorSize];
+  for (int i = 0; i < element_count; i++) {
+    rects[i] = element_rects[i];
+    opaque[i] = opacities[i] >= 255;
+    if (opacities[i] <= 0) {
+      rects[i].width = 0;
+      rects[i].height = 0;
+    }
+  }
+  std::vector<ImageRect> visible_rects[kMaxProcessorSize];
+  BuildVisibleRects(width, height, align_x, align_y,
+                    element_count, rects, opaque, visible_rects);
+
+  // 隠れた要素は合成しないように取り除く
+  element_count_ = 0;
+  for (int i = 0; i < element_count; i++) {
+    if (visible_rects[i].empty()) {
+      continue;
+    }
+    source_indices_[element_count_] = i;
+    element_rects_[element_count_] = element_rects[i];
+    opacities_[element_count_] = opacities[i];
+    visible_rects_[element_count_].swap(visible_rects[i]);
+    element_count_++;
+  }
+  for (int i = element_count_; i < kMaxProcessorSize; i++) {
+    source_indices_[i] = -1;
+    visible_rects_[i].clear();
+  }
+
+  // 真っ黒に設定
+  uint8_t rgba_background_color[4] = {0};
+  ff_draw_color(&draw_context_,
+                &background_color_,
+                rgba_background_color);
+
+  // 背景の領域を求める
+  // 色差の間引き単位にそろえるので、要素の境界の色差は常に要素側で上書きされる
+  // 不透明でない要素は背景を覆わない
+  ImageRect opaque_rects[kMaxProcessorSize];
+  int opaque_count = 0;
+  has_translucent_element_ = false;
+  for (int i = 0; i < element_count_; i++) {
+    if (opacities_[i] < 255) {
+      has_translucent_element_ = true;
+      continue;
+    }
+    opaque_rects[opaque_count] = element_rects_[i];
+    opaque_count++;
+  }
+  background_region_.Build(width, height, align_x, align_y,
+                           opaque_count, opaque_rects);
+
+  return true;
+}
+
+bool Compositor::IsIsolated(int index) const {
+  ASSERT(0 <= index && index < element_count_);
+  if (opacities_[index] < 255) {
+    return false;
+  }
+
+  // 要素が書き換えるバイトが要素の矩形に収まるか
+  // (原点と大きさが色差の間引き単位にそろっているか、出力イメージの端まで)
+  const ImageRect &element_rect = element_rects_[index];
+  const int align_x = 1 << draw_context_.hsub_max;
+  const int align_y = 1 << draw_context_.vsub_max;
+  ImageRect covered;
+  if (!GetCoveredRect(element_rect, width_, height_,
+                      align_x, align_y, &covered) ||
+      covered.x != element_rect.x || covered.y != element_rect.y ||
+      covered.width != element_rect.width ||
+      covered.height != element_rect.height) {
+    return false;
+  }
+
+  // 他の要素が合成時に書き換えるバイトと重ならないか
+  // (下の要素は後から上書きしてしまい、上の半透明な要素は毎回重ねて合成される)
+  // 背景は不透明な要素の矩形を除いて求めているので重ならない
+  for (int j = 0; j < element_count_; j++) {
+    if (j == index) {
+      continue;
+    }
+    for (size_t k = 0; k < visible_rects_[j].size(); k++) {
+      // 色差が書き換わる範囲まで外側に広げる
+      const ImageRect &rect = visible_rects_[j][k];
+      ImageRect touched;
+      touched.x = rect.x - rect.x % align_x;
+      touched.y = rect.y - rect.y % align_y;
+      touched.width =
+          (rect.x + rect.width + align_x - 1) / align_x * align_x - touched.x;
+      touched.height =
+          (rect.y + rect.height + align_y - 1) / align_y * align_y - touched.y;
+      if (Overlaps(touched, element_rect)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void Compositor::Compose(AVPicture *output, AVPicture *const elements[],
+                         bool persistent_output) {
+  // 背景描画
+  // 不透明な要素に覆われない部分だけを塗りつぶす
+  // バッファが内容を保持する場合(kBuffered)はバッファごとに最初の一度だけでよい
+  // (半透明な要素があると前回の合成結果が残るので毎回塗りつぶす)
+  // kDirectのサンプルのバッファは下流で書き換えられることがあるので毎回塗りつぶす
+  if (!persistent_output || has_translucent_element_ ||
+      background_region_.MarkFilled(output->data[0])) {
+    for (int i = 0; i < background_region_.rect_count(); i++) {
+      const ImageRect &rect = background_region_.rect(i);
+      ff_fill_rectangle(&draw_context_, &background_color_,
+                        output->data, output->linesize,
+                        rect.x, rect.y, rect.width, rect.height);
+    }
+  }
+
+  // 要素を順番に、上の要素に隠れていない部分だけ描画
+  // 不透明な要素はそのままコピーし、それ以外は下の要素や背景と合成する
+  // 出力イメージに直接描画した要素は描画済み
+  for (int i = 0; i < element_count_; i++) {
+    AVPicture *element = elements[i];
+    if (element == nullptr) {
+      continue;
+    }
+    const int opacity = opacities_[i];
+    const ImageRect &element_rect = element_rects_[i];
+    for (size_t j = 0; j < visible_rects_[i].size(); j++) {
+      const ImageRect &rect = visible_rects_[i][j];
+      if (opacity >= 255) {
+        ff_copy_rectangle2(&draw_context_,
+                           output->data, output->linesize,
+                           element->data, element->linesize,
+                           rect.x, rect.y,
+                           rect.x - element_rect.x, rect.y - element_rect.y,
+                           rect.width, rect.height);
+      } else {
+        ff_blend_rectangle2(&draw_context_,
+                            output->data, output->linesize,
+                            element->data, element->linesize,
+                            rect.x, rect.y,
+                            rect.x - element_rect.x, rect.y - element_rect.y,
+                            rect.width, rect.height,
+                            opacity);
+      }
+    }
+  }
+}
+
+int Compositor::element_count() const {
+  return element_count_;
+}
+
+int Compositor::source_index(int index) const {
+  ASSERT(0 <= index && index < element_count_);
+  return source_indices_[index];
+}
+
+const ImageRect& Compositor::element_rect(int index) const {
+  ASSERT(0 <= index && index < element_count_);
+  return element_rects_[index];
+}
+
+const std::vector<ImageRect>& Compositor::visible_rects(int index) const {
+  ASSERT(0 <= index && index < element_count_);
+  return visible_rects_[index];
+}
+}   // namespace scff_imaging
@@ -0,0 +1,114 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/compositor.h
+/// scff_imaging::Compositorの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_COMPOSITOR_H_
+#define SCFF_DSF_SCFF_IMAGING_COMPOSITOR_H_
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#include <libavfilter/drawutils.h>
+
+#include <vector>
+
+#include "scff_imaging/common.h"
+#include "scff_imaging/imaging_types.h"
+#include "scff_imaging/background_region.h"
+
+namespace scff_imaging {
+
+/// 拡大縮小済みの要素を重ねて出力イメージに合成する
+/// - 背景はどの不透明な要素にも覆われない部分だけを塗りつぶす
+/// - 要素は上の要素に隠れていない部分だけをコピー(不透明)またはブレンドする
+/// - キャプチャやスレッドに依存しないので、ヘッドレスビルドでも使える
+class Compositor {
+ public:
+  /// コンストラクタ
+  Compositor();
+  /// デストラクタ
+  ~Compositor();
+
+  /// 初期化
+  /// - 上の要素に完全に隠れる要素と完全に透明な要素は取り除く
+  /// @param av_pixel_format 出力イメージのピクセルフォーマット
+  /// @param width 出力イメージの幅
+  /// @param height 出力イメージの高さ
+  /// @param element_count 要素の数(後の要素ほど上に描画される)
+  /// @param element_rects 要素を描画する矩形(出力イメージの座標)
+  /// @param opacities 要素の不透明度(0:完全に透明 - 255:不透明)
+  /// @retval false DrawUtilsが使えないピクセルフォーマット
+  bool Init(AVPixelFormat av_pixel_format, int width, int height,
+            int element_count, const ImageRect element_rects[],
+            const int opacities[]);
+
+  /// 要素が書き換えるバイトを他の要素や背景が書き換えないか
+  /// - 要素が不透明で、原点と大きさが色差の間引き単位にそろっていて
+  ///   (または出力イメージの端まで)、他の要素の見える部分と重ならない場合のみ
+  /// - trueなら要素を出力イメージに直接描画しても合成結果は変わらない
+  bool IsIsolated(int index) const;
+
+  /// 背景と要素を出力イメージに合成する
+  /// @param output 出力イメージ
+  /// @param elements 要素ごとのイメージ(nullptrなら出力イメージに描画済み)
+  /// @param persistent_output 出力イメージのバッファが次の合成まで内容を保持するか
+  ///                          (trueなら背景はバッファごとに一度だけ塗りつぶす)
+  void Compose(AVPicture *output, AVPicture *const elements[],
+               bool persistent_output);
+
+  /// Getter: 取り除かれずに残った要素の数
+  int element_count() const;
+  /// Getter: 残った要素のInitに渡したときのインデックス
+  int source_index(int index) const;
+  /// Getter: 残った要素を描画する矩形
+  const ImageRect& element_rect(int index) const;
+  /// Getter: 残った要素のうち上の要素に隠れていない部分
+  const std::vector<ImageRect>& visible_rects(int index) const;
+
+ private:
+  /// 描画用コンテキスト
+  FFDrawContext draw_context_;
+  /// 背景カラー
+  FFDrawColor background_color_;
+  /// 不透明な要素に覆われない背景の領域
+  BackgroundRegion background_region_;
+  /// 下の要素や背景と合成する(半透明な)要素があるか
+  bool has_translucent_element_;
+
+  /// 出力イメージの幅
+  int width_;
+  /// 出力イメージの高さ
+  int height_;
+  /// 残った要素の数
+  int element_count_;
+  /// 残った要素のInitに渡したときのインデックス
+  int source_indices_[kMaxProcessorSize];
+  /// 残った要素を描画する矩形
+  ImageRect element_rects_[kMaxProcessorSize];
+  /// 残った要素の不透明度
+  int opacities_[kMaxProcessorSize];
+  /// 残った要素のうち上の要素に隠れていない部分
+  std::vector<ImageRect> visible_rects_[kMaxProcessorSize];
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(Compositor);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_COMPOSITOR_H_
@@ -17,12 +17,16 @@
 
 /// @file scff_imaging/debug.h
 /// Debug用マクロなどの宣言
-/// @todo(me) ASSERTとDbgLog利用のためだけに
-///           DirectShowBaseclassesに依存ができるのは気持ち悪い
+/// @attention ヘッドレスビルドではDirectShow BaseClassesの代わりに
+///            scff_imaging/platform.hの定義を使う
 
 #ifndef SCFF_DSF_SCFF_IMAGING_DEBUG_H_
 #define SCFF_DSF_SCFF_IMAGING_DEBUG_H_
 
+#if defined(SCFF_IMAGING_HEADLESS)
+#include "scff_imaging/platform.h"
+#else
 #include "base/debug.h"
+#endif
 
 #endif  // SCFF_DSF_SCFF_IMAGING_DEBUG_H_
@@ -27,6 +27,13 @@
 #include "scff_imaging/complex_layout.h"
 #include "scff_imaging/request.h"
 #include "scff_imaging/utilities.h"
+#include "scff_imaging/render_target.h"
+#include "scff_imaging/clock.h"
+#include "scff_imaging/frame_scheduler.h"
+#include "scff_imaging/worker_pool.h"
+#include "scff_imaging/scaler_cache.h"
+#include "scff_imaging/capture_queue.h"
+#include "scff_imaging/trace.h"
 
 extern OSVERSIONINFO g_osInfo;
 
@@ -63,6 +70,100 @@ void Clear(scff_imaging::AVPictureImage *image) {
                     image->width(),
                     image->height());
 }
+
+/// 起床誤差の分布をログに出力する
+void LogWakeErrorStats(const scff_imaging::WakeErrorStats &stats) {
+  if (stats.count == 0LL) {
+    return;
+  }
+  /// @todo(me) %lldではなく%"PRId64"が適切だがコンパイルエラーになる
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Wake Error(count:%lld min:%lld mean:%lld max:%lld)"),
+          stats.count, stats.min, stats.sum / stats.count, stats.max));
+  for (int i = 0; i < scff_imaging::WakeErrorStats::kBucketCount; i++) {
+    DbgLog((kLogTiming, kTraceInfo,
+            TEXT("Engine: Wake Error(< %lld): %lld"),
+            scff_imaging::FrameScheduler::GetBucketUpperBound(i),
+            stats.buckets[i]));
+  }
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Late Frames(%lld) Skipped Frames(%lld)"),
+          stats.late_frames, stats.skipped_frames));
+}
+
+/// パイプライン実行時の統計を0クリアする
+void ClearPipelineStats(scff_imaging::PipelineStats *stats) {
+  stats->count = 0LL;
+  stats->sum = 0LL;
+  stats->min = 0LL;
+  stats->max = 0LL;
+  stats->dropped_frames = 0LL;
+  stats->repeated_frames = 0LL;
+}
+
+/// 拡大縮小を省略した回数をログに出力する
+void LogUnchangedFrameStats(const scff_imaging::UnchangedFrameStats &stats) {
+  const int64_t total = stats.hits + stats.misses;
+  if (total == 0LL) {
+    return;
+  }
+  /// @todo(me) %lldではなく%"PRId64"が適切だがコンパイルエラーになる
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Unchanged Frames(hits:%lld misses:%lld partial:%lld rate:%lld%%)"),
+          stats.hits, stats.misses, stats.partial_misses,
+          stats.hits * 100LL / total));
+}
+
+/// SwsContextのキャッシュの統計をログに出力する
+void LogScalerCacheStats(const scff_imaging::ScalerCacheStats &stats) {
+  /// @todo(me) %lldではなく%"PRId64"が適切だがコンパイルエラーになる
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Scaler Cache(hits:%lld misses:%lld evictions:%lld idle:%d)"),
+          stats.context_hits, stats.context_misses, stats.context_evictions,
+          stats.idle_context_count));
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Scaler Cache Filters(hits:%lld misses:%lld count:%d)"),
+          stats.filter_hits, stats.filter_misses, stats.filter_count));
+}
+
+/// パイプラインによって増えた遅延をログに出力する
+void LogPipelineStats(const scff_imaging::PipelineStats &stats) {
+  if (stats.count == 0LL) {
+    return;
+  }
+  const int64_t kUnitsPerMicrosecond =
+      scff_imaging::kClockUnitsPerMillisecond / 1000LL;
+  /// @todo(me) %lldではなく%"PRId64"が適切だがコンパイルエラーになる
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Pipeline Latency(count:%lld min:%lldus mean:%lldus max:%lldus)"),
+          stats.count,
+          stats.min / kUnitsPerMicrosecond,
+          stats.sum / stats.count / kUnitsPerMicrosecond,
+          stats.max / kUnitsPerMicrosecond));
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Pipeline Dropped Frames(%lld) Repeated Frames(%lld)"),
+          stats.dropped_frames, stats.repeated_frames));
+}
+
+#if defined(SCFF_IMAGING_TRACE)
+/// 計測結果を一時フォルダのChrome trace-event形式のファイルに出力する
+/// - %TEMP%\scff_dsf_trace_(PID).json (chrome://tracingで読み込む)
+void DumpTrace() {
+  char temp_path[MAX_PATH];
+  const DWORD length = GetTempPathA(MAX_PATH, temp_path);
+  if (length == 0 || length >= MAX_PATH) {
+    return;
+  }
+  const std::string path =
+      std::string(temp_path) + "scff_dsf_trace_" +
+      std::to_string(static_cast<unsigned long long>(GetCurrentProcessId())) +
+      ".json";
+  const bool result = scff_imaging::trace::WriteChromeTraceFile(path.c_str());
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Dump Trace(%hs): %d"),
+          path.c_str(), result));
+}
+#endif  // defined(SCFF_IMAGING_TRACE)
 }   // namespace
 
 namespace scff_imaging {
@@ -72,25 +173,44 @@ namespace scff_imaging {
 //=====================================================================
 
 Engine::Engine(ImagePixelFormats output_pixel_format,
-               int output_width, int output_height, double output_fps)
+               int output_width, int output_height, double output_fps,
+               RenderingModes rendering_mode, int worker_count)
     : CAMThread(),
       Layout(),
-      need_clear_front_image_(false),
-      need_clear_back_image_(false),
+      last_copied_generation_(0),
       output_pixel_format_(output_pixel_format),
       output_width_(output_width),
       output_height_(output_height),
       output_fps_(output_fps),
+      worker_count_(worker_count),
       layout_(nullptr),
+      worker_pool_(nullptr),
+      scaler_cache_(nullptr),
+      capture_queue_(nullptr),
+      pipeline_clock_(nullptr),
+      capture_exiting_(false),
       layout_error_code_(ErrorCodes::kProcessorUninitializedError),
-      last_update_image_(ImageIndexes::kFront) {
+      layout_request_(RequestTypes::kResetLayout),
+      rendering_mode_(rendering_mode),
+      pipeline_mode_(PipelineModes::kSerial),
+      scale_quality_mode_(ScaleQualityModes::kFixed) {
   DbgLog((kLogMemory, kTrace,
-          TEXT("Engine: NEW(%d, %d, %d, %.1f)"),
-          output_pixel_format, output_width, output_height, output_fps));
+          TEXT("Engine: NEW(%d, %d, %d, %.1f, %d, %d)"),
+          output_pixel_format, output_width, output_height, output_fps,
+          rendering_mode, worker_count));
+  // 配列の初期化
+  for (int i = 0; i < TripleBuffer::kBufferCount; i++) {
+    need_clear_images_[i] = false;
+  }
+  ClearPipelineStats(&pipeline_stats_);
+  unchanged_frame_stats_.hits = 0LL;
+  unchanged_frame_stats_.misses = 0LL;
+  unchanged_frame_stats_.partial_misses = 0LL;
   // 明示的に初期化していない
-  // front_image_
-  // back_image_
+  // scale_quality_
+  // images_[TripleBuffer::kBufferCount]
   // splash_image_
+  // target_image_
 }
 
 Engine::~Engine() {
@@ -101,6 +221,16 @@ Engine::~Engine() {
   CallWorker(static_cast<DWORD>(RequestTypes::kStop));
   CallWorker(static_cast<DWORD>(RequestTypes::kResetLayout));
   CallWorker(static_cast<DWORD>(RequestTypes::kExit));
+
+  // レイアウトが全て破棄されてからワーカープールとキャッシュを破棄
+  if (worker_pool_ != nullptr) {
+    delete worker_pool_;
+    worker_pool_ = nullptr;
+  }
+  if (scaler_cache_ != nullptr) {
+    delete scaler_cache_;
+    scaler_cache_ = nullptr;
+  }
 }
 
 //---------------------------------------------------------------------
@@ -117,21 +247,24 @@ ErrorCodes Engine::Init() {
   //-------------------------------------------------------------------
   // Image
   //-------------------------------------------------------------------
-  // フロントイメージ
-  const ErrorCodes error_front_image =
-      front_image_.Create(output_pixel_format_,
+  // 描画方法は後から切り替えられるので両方用意しておく
+  // レンダーターゲット描画用イメージ
+  const ErrorCodes error_target_image =
+      target_image_.CreateForRenderTarget(output_pixel_format_,
+                                          output_width_,
+                                          output_height_);
+  if (error_target_image != ErrorCodes::kNoError) {
+    return ErrorOccured(error_target_image);
+  }
+  // トリプルバッファ用イメージ
+  for (int i = 0; i < TripleBuffer::kBufferCount; i++) {
+    const ErrorCodes error_image =
+        images_[i].Create(output_pixel_format_,
                           output_width_,
                           output_height_);
-  if (error_front_image != ErrorCodes::kNoError) {
-    return ErrorOccured(error_front_image);
-  }
-  // バックイメージ
-  const ErrorCodes error_back_image =
-      back_image_.Create(output_pixel_format_,
-                         output_width_,
-                         output_height_);
-  if (error_back_image != ErrorCodes::kNoError) {
-    return ErrorOccured(error_back_image);
+    if (error_image != ErrorCodes::kNoError) {
+      return ErrorOccured(error_image);
+    }
   }
   // スプラッシュイメージ
   const ErrorCodes error_splash_image =
@@ -143,8 +276,9 @@ ErrorCodes Engine::Init() {
   }
 
   // すべてのイメージをクリア
-  Clear(&front_image_);
-  Clear(&back_image_);
+  for (int i = 0; i < TripleBuffer::kBufferCount; i++) {
+    Clear(&(images_[i]));
+  }
   Clear(&splash_image_);
 
   // 一時的にスプラッシュスクリーンプロセッサを作ってイメージを生成しておく
@@ -165,6 +299,12 @@ ErrorCodes Engine::Init() {
   // nop
   //-------------------------------------------------------------------
 
+  // ワーカープール作成
+  worker_pool_ = new WorkerPool(worker_count_);
+  // SwsContextのキャッシュ作成
+  scaler_cache_ = new ScalerCache(ScalerCache::kDefaultContextCapacity,
+                                  ScalerCache::kDefaultFilterCapacity);
+
   // スレッド作成
   Create();
   CallWorker(static_cast<DWORD>(RequestTypes::kResetLayout));
@@ -202,6 +342,7 @@ ErrorCodes Engine::Accept(Request *request) {
 
 /// @attention エラー発生中に追加の処理を行うのはEngineだけ
 ErrorCodes Engine::CopyCurrentImage(BYTE *sample, DWORD data_size) {
+  SCFF_TRACE_SCOPE("Engine::CopyCurrentImage");
   /// @attention processorのポインタがnullptrであることはエラーではない
 
   // Engine自体にエラーが発生していたら0クリア
@@ -213,41 +354,101 @@ ErrorCodes Engine::CopyCurrentImage(BYTE *sample, DWORD data_size) {
 
   // layout_にエラーが発生していたらスプラッシュを書く
   if (GetCurrentLayoutError() != ErrorCodes::kNoError) {
-    ASSERT(data_size == utilities::CalculateImageSize(splash_image_));
-    avpicture_layout(splash_image_.avpicture(),
-                     splash_image_.av_pixel_format(),
-                     splash_image_.width(),
-                     splash_image_.height(),
-                     sample, data_size);
+    CopySplashImage(sample, data_size);
     return GetCurrentError();
   }
 
-  // sampleにコピー
-  if (last_update_image_ == ImageIndexes::kFront) {
-    ASSERT(data_size == utilities::CalculateImageSize(front_image_));
-    avpicture_layout(front_image_.avpicture(),
-                     front_image_.av_pixel_format(),
-                     front_image_.width(),
-                     front_image_.height(),
-                     sample, data_size);
-  } else if (last_update_image_ == ImageIndexes::kBack) {
-    ASSERT(data_size == utilities::CalculateImageSize(back_image_));
-    avpicture_layout(back_image_.avpicture(),
-                     back_image_.av_pixel_format(),
-                     back_image_.width(),
-                     back_image_.height(),
-                     sample, data_size);
+  // 最新の完成済みフレームを取得
+  // (次のCopyCurrentImageまでキャプチャスレッドに書き換えられることはない)
+  uint64_t generation = 0;
+  const int index = triple_buffer_.AcquireLatest(&generation);
+  if (generation == last_copied_generation_) {
+    DbgLog((kLogTiming, kTrace,
+            TEXT("Engine: Same Frame Copied(%llu)"),
+            generation));
   }
+  last_copied_generation_ = generation;
+
+  // sampleにコピー
+  const AVPictureImage &current_image = images_[index];
+  ASSERT(data_size == utilities::CalculateImageSize(current_image));
+  avpicture_layout(current_image.avpicture(),
+                   current_image.av_pixel_format(),
+                   current_image.width(),
+                   current_image.height(),
+                   sample, data_size);
 
   return GetCurrentError();
 }
 
+ErrorCodes Engine::RenderCurrentImage(RenderTarget *render_target) {
+  SCFF_TRACE_SCOPE("Engine::RenderCurrentImage");
+  ASSERT(render_target != nullptr);
+  BYTE *sample = render_target->buffer();
+  const DWORD data_size = static_cast<DWORD>(render_target->buffer_size());
+
+  // バッファリングしている場合、またはエラー発生中はコピーで済ませる
+  // (描画方法はAcceptから同期的に切り替わるのでここで変わることはない)
+  if (GetRenderingMode() == RenderingModes::kBuffered ||
+      GetCurrentError() != ErrorCodes::kNoError ||
+      GetCurrentLayoutError() != ErrorCodes::kNoError) {
+    return CopyCurrentImage(sample, data_size);
+  }
+
+  // レンダーターゲットのバッファをそのまま出力イメージにする
+  const ErrorCodes error_attach = target_image_.Attach(render_target);
+  if (error_attach != ErrorCodes::kNoError) {
+    DbgLog((kLogError, kError,
+            TEXT("Engine: Cannot Attach RenderTarget(%d)"),
+            error_attach));
+    ZeroMemory(sample, data_size);
+    return GetCurrentError();
+  }
+
+  // レイアウトの再構築はAcceptから同期的に行われるので
+  // 同じスレッドから呼ばれている限りロックは必要ない
+  /// @attention すべてのレイアウトは出力イメージ全体を毎回描画するので
+  ///            サンプルのバッファをクリアする必要はない
+  layout_->SwapOutputImage(&target_image_);
+  if (capture_queue_ != nullptr) {
+    // キャプチャスレッドが用意したスロットを変換する
+    // 新しいキャプチャが間に合わなければ前回のスロットをもう一度変換する
+    int slot = -1;
+    int64_t captured_time = 0;
+    if (capture_queue_->Pop(0, &slot, &captured_time)) {
+      RecordPipelineLatency(captured_time);
+    } else {
+      slot = capture_queue_->held_slot();
+      CAutoLock lock(&m_WorkerLock);
+      ++pipeline_stats_.repeated_frames;
+    }
+    if (slot == -1) {
+      // まだ一度もキャプチャされていない
+      CopySplashImage(sample, data_size);
+      return GetCurrentError();
+    }
+    Convert(slot);
+  } else {
+    Run();
+  }
+
+  // 描画に失敗したらスプラッシュを書く
+  if (GetCurrentLayoutError() != ErrorCodes::kNoError) {
+    return CopyCurrentImage(sample, data_size);
+  }
+
+  return GetCurrentError();
+}
 
 //-------------------------------------------------------------------
 // リクエストハンドラ
 //-------------------------------------------------------------------
 
 void Engine::ResetLayout() {
+  {
+    CAutoLock lock(&m_WorkerLock);
+    layout_request_ = RequestTypes::kResetLayout;
+  }
   /// @attention enum->DWORD
   CallWorker(static_cast<DWORD>(RequestTypes::kStop));
   CallWorker(static_cast<DWORD>(RequestTypes::kResetLayout));
@@ -255,6 +456,10 @@ void Engine::ResetLayout() {
 }
 
 void Engine::SetNativeLayout() {
+  {
+    CAutoLock lock(&m_WorkerLock);
+    layout_request_ = RequestTypes::kSetNativeLayout;
+  }
   /// @attention enum->DWORD
   CallWorker(static_cast<DWORD>(RequestTypes::kStop));
   CallWorker(static_cast<DWORD>(RequestTypes::kSetNativeLayout));
@@ -262,12 +467,71 @@ void Engine::SetNativeLayout() {
 }
 
 void Engine::SetComplexLayout() {
+  {
+    CAutoLock lock(&m_WorkerLock);
+    layout_request_ = RequestTypes::kSetComplexLayout;
+  }
   /// @attention enum->DWORD
   CallWorker(static_cast<DWORD>(RequestTypes::kStop));
   CallWorker(static_cast<DWORD>(RequestTypes::kSetComplexLayout));
   CallWorker(static_cast<DWORD>(RequestTypes::kRun));
 }
 
+void Engine::SetPipelineMode(PipelineModes pipeline_mode) {
+  DbgLog((kLogTrace, kTraceInfo,
+          TEXT("Engine: Set Pipeline Mode(%d)"),
+          pipeline_mode));
+
+  /// @attention enum->DWORD
+  CallWorker(static_cast<DWORD>(RequestTypes::kStop));
+  RequestTypes layout_request = RequestTypes::kResetLayout;
+  {
+    CAutoLock lock(&m_WorkerLock);
+    pipeline_mode_ = pipeline_mode;
+    layout_request = layout_request_;
+  }
+  // スロットの数が変わるので現在のレイアウトを作り直す
+  CallWorker(static_cast<DWORD>(layout_request));
+  CallWorker(static_cast<DWORD>(RequestTypes::kRun));
+}
+
+void Engine::SetRenderingMode(RenderingModes rendering_mode) {
+  DbgLog((kLogTrace, kTraceInfo,
+          TEXT("Engine: Set Rendering Mode(%d)"),
+          rendering_mode));
+
+  /// @attention enum->DWORD
+  CallWorker(static_cast<DWORD>(RequestTypes::kStop));
+  RequestTypes layout_request = RequestTypes::kResetLayout;
+  {
+    CAutoLock lock(&m_WorkerLock);
+    rendering_mode_ = rendering_mode;
+    layout_request = layout_request_;
+  }
+  // 出力イメージと出力が前回の内容を保持するかが変わるので
+  // 現在のレイアウトを作り直す
+  CallWorker(static_cast<DWORD>(layout_request));
+  CallWorker(static_cast<DWORD>(RequestTypes::kRun));
+}
+
+void Engine::SetScaleQualityMode(ScaleQualityModes scale_quality_mode) {
+  DbgLog((kLogTrace, kTraceInfo,
+          TEXT("Engine: Set Scale Quality Mode(%d)"),
+          scale_quality_mode));
+
+  /// @attention enum->DWORD
+  CallWorker(static_cast<DWORD>(RequestTypes::kStop));
+  RequestTypes layout_request = RequestTypes::kResetLayout;
+  {
+    CAutoLock lock(&m_WorkerLock);
+    scale_quality_mode_ = scale_quality_mode;
+    layout_request = layout_request_;
+  }
+  // 品質段階ごとのSwsContextを用意するので現在のレイアウトを作り直す
+  CallWorker(static_cast<DWORD>(layout_request));
+  CallWorker(static_cast<DWORD>(RequestTypes::kRun));
+}
+
 void Engine::SetLayoutParameters(
     int element_count,
     const LayoutParameter (&parameters)[kMaxProcessorSize]) {
@@ -296,12 +560,19 @@ void Engine::DoResetLayout() {
 
   // 解放+0クリア
   if (layout_ != nullptr) {
+    LogUnchangedFrameStats(layout_->GetUnchangedFrameStats());
     delete layout_;
     layout_ = nullptr;
+    LogScalerCacheStats(scaler_cache_->GetStats());
   }
+  // レイアウトがない間はスキップしても品質段階を変えない
+  scale_quality_.Reset(1, 0LL);
   // 未初期化
   CAutoLock lock(&m_WorkerLock);
   layout_error_code_ = ErrorCodes::kProcessorUninitializedError;
+  unchanged_frame_stats_.hits = 0LL;
+  unchanged_frame_stats_.misses = 0LL;
+  unchanged_frame_stats_.partial_misses = 0LL;
 }
 
 void Engine::DoSetNativeLayout() {
@@ -309,8 +580,12 @@ void Engine::DoSetNativeLayout() {
   DoResetLayout();
 
   //-------------------------------------------------------------------
-  NativeLayout *native_layout = new NativeLayout(parameters_[0]);
-  native_layout->SetOutputImage(&front_image_);
+  NativeLayout *native_layout =
+      new NativeLayout(parameters_[0], worker_pool_, scaler_cache_,
+                       GetLayoutSlotCount(),
+                       GetLayoutEnableScaleQualityLevels());
+  native_layout->SetOutputImage(GetDefaultOutputImage());
+  native_layout->set_persistent_output(IsPersistentOutput());
   const ErrorCodes error_layout = native_layout->Init();
   if (error_layout != ErrorCodes::kNoError) {
     // 失敗
@@ -319,6 +594,7 @@ void Engine::DoSetNativeLayout() {
   } else {
     // 成功
     layout_ = native_layout;
+    ResetScaleQuality();
     LayoutInitDone();
   }
 }
@@ -329,8 +605,11 @@ void Engine::DoSetComplexLayout() {
 
   //-------------------------------------------------------------------
   ComplexLayout *complex_layout =
-      new ComplexLayout(element_count_, parameters_);
-  complex_layout->SetOutputImage(&front_image_);
+      new ComplexLayout(element_count_, parameters_, worker_pool_,
+                        scaler_cache_, GetLayoutSlotCount(),
+                        GetLayoutEnableScaleQualityLevels());
+  complex_layout->SetOutputImage(GetDefaultOutputImage());
+  complex_layout->set_persistent_output(IsPersistentOutput());
   const ErrorCodes error_layout = complex_layout->Init();
   if (error_layout != ErrorCodes::kNoError) {
     // 失敗
@@ -339,71 +618,48 @@ void Engine::DoSetComplexLayout() {
   } else {
     // 成功
     layout_ = complex_layout;
+    ResetScaleQuality();
     LayoutInitDone();
   }
 }
 
 void Engine::DoLoop() {
-  // システムクロックを取得
-  IReferenceClock *system_clock = nullptr;
-  HRESULT result_system_clock = CoCreateInstance(
-    CLSID_SystemClock,
-    NULL, // nullptr
-    CLSCTX_INPROC_SERVER,
-    IID_IReferenceClock,
-    reinterpret_cast<void**>(&system_clock));
-  ASSERT(result_system_clock == S_OK);
-  ASSERT(system_clock != nullptr);
-
-  // 初期化
-  DWORD request;
-  const REFERENCE_TIME output_frame_interval =
-      static_cast<REFERENCE_TIME>(UNITS / output_fps_);
-  REFERENCE_TIME zero = 0LL;
-  system_clock->GetTime(&zero);
-  REFERENCE_TIME now = zero;
-  int64_t frame_counter = 0LL;
+  // 締め切りを管理するスケジューラを作成
+  SystemClock system_clock;
+  FrameScheduler scheduler(&system_clock);
+  scheduler.Reset(output_fps_);
 
+  DWORD request;
   do {
     while (!CheckRequest(&request)) {
+      if (capture_queue_ != nullptr) {
+        // フレームの間隔はキャプチャスレッドが管理する
+        UpdatePipelined();
+        continue;
+      }
+
       Update();
-      system_clock->GetTime(&now);
-      now -= zero;
-
-      // 想定フレームを計算＋フレームカウンタ更新
-      REFERENCE_TIME tmp_start = frame_counter * output_frame_interval;
-      REFERENCE_TIME tmp_end = tmp_start + output_frame_interval;
-      ++frame_counter;
-
-      // すでに現在時刻が次の想定フレームの中にある場合
-      //    = フレームスキップが絶対発生する
-      if (tmp_end + output_frame_interval < now) {
-        int skip_count = 0;
-        do {
-          // 想定フレームを再計算＋フレームカウンタ更新
-          tmp_start = frame_counter * output_frame_interval;
-          tmp_end = tmp_start + output_frame_interval;
-          ++frame_counter;
-          ++skip_count;
-        } while (tmp_end < now);
-        // 現在時刻がフレームの終了時よりも前になるまでスキップ
+
+      // フレームの締め切りまで待つ
+      int skip_count = 0;
+      bool on_time = true;
+      {
+        SCFF_TRACE_SCOPE("Engine::WaitNextFrame");
+        on_time = scheduler.WaitNextFrame(&skip_count);
+      }
+      if (skip_count > 0) {
+        // 現在時刻がフレームの終了時よりも前になるまでスキップした
         DbgLog((kLogError, kErrorWarn,
                 TEXT("Engine: Frame Skip Occured(%d)"),
                 skip_count));
+        // 処理時間だけでは見えないクリアや待機の遅れも品質段階に反映する
+        if (scale_quality_.RecordSkippedFrames(skip_count)) {
+          ApplyScaleQualityLevel();
+        }
       }
-
-      // Sleep時間を計算
-      const REFERENCE_TIME sleep_interval = tmp_end - now;
-      const DWORD sleep_interval_msec =
-          static_cast<DWORD>((sleep_interval * MILLISECONDS) / UNITS);
-
-      if (tmp_end < now) {
-        // Sleepするべき時間がすでに過ぎてしまった
+      if (!on_time) {
+        // 待つべき時間がすでに過ぎてしまった
         DbgLog((kLogError, kErrorWarn, TEXT("Engine: Drop Frame")));
-      } else {
-        // Sleepしないとフレームを生成しすぎる
-        //    = フレーム終了まで待つ
-        ::Sleep(sleep_interval_msec);
       }
     }
 
@@ -413,14 +669,94 @@ void Engine::DoLoop() {
     }
   } while (request != static_cast<DWORD>(RequestTypes::kStop));
 
-  // システムクロック解放
-  if (system_clock != nullptr) {
-    system_clock->Release();
-    system_clock = nullptr;
+  // 起床誤差の分布を出力
+  LogWakeErrorStats(scheduler.wake_error_stats());
+}
+
+void Engine::StartPipeline() {
+  if (layout_ == nullptr ||
+      layout_->slot_count() < StagedLayout::kMaxSlotCount ||
+      GetCurrentLayoutError() != ErrorCodes::kNoError) {
+    // シリアル実行用のレイアウトまたはエラー発生中
+    return;
   }
+  ASSERT(capture_queue_ == nullptr);
+
+  DbgLog((kLogTrace, kTraceInfo,
+          TEXT("Engine: Start Pipeline(%d slots)"),
+          layout_->slot_count()));
+
+  capture_queue_ = new CaptureQueue(layout_->slot_count());
+  pipeline_clock_ = new SystemClock();
+  {
+    CAutoLock lock(&m_WorkerLock);
+    ClearPipelineStats(&pipeline_stats_);
+  }
+  capture_exiting_.store(false);
+  capture_thread_ = std::thread([this] { CaptureLoop(); });
+}
+
+void Engine::StopPipeline() {
+  if (capture_queue_ == nullptr) {
+    return;
+  }
+
+  capture_exiting_.store(true);
+  capture_queue_->Stop();
+  capture_thread_.join();
+
+  PipelineStats stats;
+  {
+    CAutoLock lock(&m_WorkerLock);
+    pipeline_stats_.dropped_frames = capture_queue_->dropped_count();
+    stats = pipeline_stats_;
+  }
+  LogPipelineStats(stats);
+
+  delete capture_queue_;
+  capture_queue_ = nullptr;
+  delete pipeline_clock_;
+  pipeline_clock_ = nullptr;
+}
+
+void Engine::CaptureLoop() {
+  SCFF_TRACE_THREAD_NAME("Engine Capture");
+  FrameScheduler scheduler(pipeline_clock_);
+  scheduler.Reset(output_fps_);
+
+  while (!capture_exiting_.load()) {
+    if (GetCurrentLayoutError() == ErrorCodes::kNoError) {
+      // 変換側が持っていないスロットにキャプチャする
+      const int slot = capture_queue_->AcquireWriteSlot();
+      const ErrorCodes error = layout_->RunCapture(slot);
+      if (error != ErrorCodes::kNoError) {
+        capture_queue_->Discard(slot);
+        LayoutErrorOccured(error);
+      } else {
+        capture_queue_->Push(slot, pipeline_clock_->Now());
+      }
+    }
+
+    // フレームの締め切りまで待つ
+    int skip_count = 0;
+    {
+      SCFF_TRACE_SCOPE("Engine::WaitNextCapture");
+      scheduler.WaitNextFrame(&skip_count);
+    }
+    if (skip_count > 0) {
+      DbgLog((kLogError, kErrorWarn,
+              TEXT("Engine: Capture Skip Occured(%d)"),
+              skip_count));
+    }
+  }
+
+  // 起床誤差の分布を出力
+  LogWakeErrorStats(scheduler.wake_error_stats());
+  SCFF_TRACE_THREAD_EXIT();
 }
 
 DWORD Engine::ThreadProc() {
+  SCFF_TRACE_THREAD_NAME("Engine");
   HRESULT result = ERROR;
   RequestTypes request = RequestTypes::kInvalid;
 
@@ -446,12 +782,22 @@ DWORD Engine::ThreadProc() {
         break;
       }
       case RequestTypes::kRun: {
+        // kDirectの場合でもキャプチャスレッドはReplyまでに用意しておく
+        StartPipeline();
         Reply(NOERROR);
-        DoLoop();
+        // kDirectの場合はRenderCurrentImageで描画するのでループしない
+        if (GetRenderingMode() == RenderingModes::kBuffered) {
+          DoLoop();
+        }
         break;
       }
       case RequestTypes::kStop:
       case RequestTypes::kExit: {
+        StopPipeline();
+#if defined(SCFF_IMAGING_TRACE)
+        // レイアウトを変更するたびにそれまでの計測結果を出力する
+        DumpTrace();
+#endif
         Reply(NOERROR);
         break;
       }
@@ -463,42 +809,186 @@ DWORD Engine::ThreadProc() {
 
 ErrorCodes Engine::Run() {
   ASSERT(layout_ != nullptr);
+  const int64_t start = GetMonotonicClockTime();
   const ErrorCodes error = layout_->Run();
   if (error != ErrorCodes::kNoError) {
     /// @attention layout_でエラーが発生してもEngine自体はエラー状態ではない
     LayoutErrorOccured(error);
+  } else {
+    AdaptScaleQuality(GetMonotonicClockTime() - start);
+    RecordUnchangedFrameStats();
   }
   return GetCurrentError();
 }
 
 void Engine::Update() {
+  SCFF_TRACE_SCOPE("Engine::Update");
   if (GetCurrentLayoutError() != ErrorCodes::kNoError) {
     return;
   }
 
-  if (last_update_image_ == ImageIndexes::kFront) {
-    layout_->SwapOutputImage(&back_image_);
-    {
-      CAutoLock lock(&m_WorkerLock);
-      if (need_clear_back_image_) {
-        Clear(&back_image_);
-        need_clear_back_image_ = false;
-      }
+  // 書き込み側が所有しているイメージに描画する
+  const int index = triple_buffer_.write_index();
+  layout_->SwapOutputImage(&(images_[index]));
+  {
+    CAutoLock lock(&m_WorkerLock);
+    if (need_clear_images_[index]) {
+      Clear(&(images_[index]));
+      need_clear_images_[index] = false;
     }
-    Run();
-    last_update_image_ = ImageIndexes::kBack;
-  } else if (last_update_image_ == ImageIndexes::kBack) {
-    layout_->SwapOutputImage(&front_image_);
-    {
-      CAutoLock lock(&m_WorkerLock);
-      if (need_clear_front_image_) {
-        Clear(&front_image_);
-        need_clear_front_image_ = false;
-      }
+  }
+  Run();
+
+  // 描画に成功したフレームだけを公開する
+  if (GetCurrentLayoutError() == ErrorCodes::kNoError) {
+    triple_buffer_.Publish();
+  }
+}
+
+void Engine::UpdatePipelined() {
+  // 新しいキャプチャを最大1フレーム分待つ
+  // 間に合わなければ前回公開したフレームをそのまま使ってもらう
+  const int timeout_milliseconds =
+      static_cast<int>(1000.0 / output_fps_) + 1;
+  int slot = -1;
+  int64_t captured_time = 0;
+  bool popped = false;
+  {
+    SCFF_TRACE_SCOPE("Engine::WaitCapture");
+    popped = capture_queue_->Pop(timeout_milliseconds, &slot, &captured_time);
+  }
+  if (!popped) {
+    CAutoLock lock(&m_WorkerLock);
+    ++pipeline_stats_.repeated_frames;
+    return;
+  }
+  SCFF_TRACE_SCOPE("Engine::UpdatePipelined");
+  if (GetCurrentLayoutError() != ErrorCodes::kNoError) {
+    return;
+  }
+  RecordPipelineLatency(captured_time);
+
+  // 書き込み側が所有しているイメージに描画する
+  const int index = triple_buffer_.write_index();
+  layout_->SwapOutputImage(&(images_[index]));
+  {
+    CAutoLock lock(&m_WorkerLock);
+    if (need_clear_images_[index]) {
+      Clear(&(images_[index]));
+      need_clear_images_[index] = false;
     }
-    Run();
-    last_update_image_ = ImageIndexes::kFront;
   }
+  Convert(slot);
+
+  // 描画に成功したフレームだけを公開する
+  if (GetCurrentLayoutError() == ErrorCodes::kNoError) {
+    triple_buffer_.Publish();
+  }
+}
+
+ErrorCodes Engine::Convert(int slot) {
+  ASSERT(layout_ != nullptr);
+  const int64_t start = GetMonotonicClockTime();
+  const ErrorCodes error = layout_->RunConvert(slot);
+  if (error != ErrorCodes::kNoError) {
+    /// @attention layout_でエラーが発生してもEngine自体はエラー状態ではない
+    LayoutErrorOccured(error);
+  } else {
+    // キャプチャは別スレッドなので変換にかかった時間だけを見る
+    AdaptScaleQuality(GetMonotonicClockTime() - start);
+    RecordUnchangedFrameStats();
+  }
+  return GetCurrentError();
+}
+
+void Engine::RecordPipelineLatency(int64_t captured_time) {
+  const int64_t latency = pipeline_clock_->Now() - captured_time;
+  const int64_t dropped_frames = capture_queue_->dropped_count();
+  CAutoLock lock(&m_WorkerLock);
+  pipeline_stats_.dropped_frames = dropped_frames;
+  if (pipeline_stats_.count == 0LL || latency < pipeline_stats_.min) {
+    pipeline_stats_.min = latency;
+  }
+  if (pipeline_stats_.count == 0LL || latency > pipeline_stats_.max) {
+    pipeline_stats_.max = latency;
+  }
+  pipeline_stats_.sum += latency;
+  ++pipeline_stats_.count;
+}
+
+void Engine::AdaptScaleQuality(int64_t processing_time) {
+  if (!scale_quality_.Record(processing_time)) {
+    return;
+  }
+  /// @todo(me) %lldではなく%"PRId64"が適切だがコンパイルエラーになる
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Scale Quality Processing Time(%lldus)"),
+          processing_time / (kClockUnitsPerMillisecond / 1000LL)));
+  ApplyScaleQualityLevel();
+}
+
+void Engine::ApplyScaleQualityLevel() {
+  // 作成済みのSwsContextを切り替えるだけなので次のフレームで詰まることはない
+  layout_->SetScaleQualityLevel(scale_quality_.level());
+  DbgLog((kLogTiming, kTraceInfo,
+          TEXT("Engine: Scale Quality Level(%d)"),
+          scale_quality_.level()));
+}
+
+void Engine::RecordUnchangedFrameStats() {
+  const UnchangedFrameStats stats = layout_->GetUnchangedFrameStats();
+  CAutoLock lock(&m_WorkerLock);
+  unchanged_frame_stats_ = stats;
+}
+
+void Engine::CopySplashImage(BYTE *sample, DWORD data_size) {
+  ASSERT(data_size == utilities::CalculateImageSize(splash_image_));
+  avpicture_layout(splash_image_.avpicture(),
+                   splash_image_.av_pixel_format(),
+                   splash_image_.width(),
+                   splash_image_.height(),
+                   sample, data_size);
+}
+
+RenderingModes Engine::GetRenderingMode() {
+  CAutoLock lock(&m_WorkerLock);
+  return rendering_mode_;
+}
+
+AVPictureImage* Engine::GetDefaultOutputImage() {
+  if (GetRenderingMode() == RenderingModes::kDirect) {
+    return &target_image_;
+  }
+  return &(images_[triple_buffer_.write_index()]);
+}
+
+int Engine::GetLayoutSlotCount() {
+  CAutoLock lock(&m_WorkerLock);
+  if (pipeline_mode_ == PipelineModes::kPipelined) {
+    // 書き込み中・変換待ち・変換中の3つ
+    return StagedLayout::kMaxSlotCount;
+  }
+  return 1;
+}
+
+bool Engine::IsPersistentOutput() {
+  // kDirectではレンダーターゲットのバッファが毎回入れ替わり、
+  // 以前に描画した内容が残っている保証がない
+  return GetRenderingMode() == RenderingModes::kBuffered;
+}
+
+bool Engine::GetLayoutEnableScaleQualityLevels() {
+  CAutoLock lock(&m_WorkerLock);
+  return scale_quality_mode_ == ScaleQualityModes::kAdaptive;
+}
+
+void Engine::ResetScaleQuality() {
+  ASSERT(layout_ != nullptr);
+  // 品質段階を用意していないレイアウトでは段階の数が1になるので何もしない
+  scale_quality_.Reset(
+      layout_->scale_quality_level_count(),
+      static_cast<int64_t>(kClockUnitsPerSecond / output_fps_));
+  layout_->SetScaleQualityLevel(scale_quality_.level());
 }
 
 ErrorCodes Engine::LayoutInitDone() {
@@ -508,8 +998,9 @@ ErrorCodes Engine::LayoutInitDone() {
     layout_error_code_ = ErrorCodes::kNoError;
 
     // 次回更新時に一回クリアする
-    need_clear_front_image_ = true;
-    need_clear_back_image_ = true;
+    for (int i = 0; i < TripleBuffer::kBufferCount; i++) {
+      need_clear_images_[i] = true;
+    }
   }
   return layout_error_code_;
 }
@@ -532,4 +1023,14 @@ ErrorCodes Engine::GetCurrentLayoutError() {
   return layout_error_code_;
 }
 
+PipelineStats Engine::GetPipelineStats() {
+  CAutoLock lock(&m_WorkerLock);
+  return pipeline_stats_;
+}
+
+UnchangedFrameStats Engine::GetUnchangedFrameStats() {
+  CAutoLock lock(&m_WorkerLock);
+  return unchanged_frame_stats_;
+}
+
 }   // namespace scff_imaging
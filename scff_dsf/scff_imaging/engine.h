@@ -21,18 +21,50 @@
 #ifndef SCFF_DSF_SCFF_IMAGING_ENGINE_H_
 #define SCFF_DSF_SCFF_IMAGING_ENGINE_H_
 
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
 #include "scff_imaging/common.h"
 #include "scff_imaging/layout.h"
+#include "scff_imaging/triple_buffer.h"
+#include "scff_imaging/scale_quality_controller.h"
 
 /// 画像処理を行うクラスをまとめたネームスペース
 namespace scff_imaging {
 
+class RenderTarget;
+class WorkerPool;
+class ScalerCache;
+class CaptureQueue;
+class Clock;
+
+/// パイプライン実行時の統計
+struct PipelineStats {
+  /// 遅延の計測回数
+  int64_t count;
+  /// キャプチャ完了から変換開始までの遅延の合計(100nSec)
+  int64_t sum;
+  /// 遅延の最小値(100nSec)
+  int64_t min;
+  /// 遅延の最大値(100nSec)
+  int64_t max;
+  /// 変換されずに捨てられたキャプチャの数
+  int64_t dropped_frames;
+  /// 新しいキャプチャが間に合わなかったフレームの数
+  int64_t repeated_frames;
+};
+
 /// 画像処理スレッドを管理する
 class Engine : public CAMThread, public Layout {
  public:
   /// コンストラクタ
+  /// @param rendering_mode 描画方法の初期値(SetRenderingModeで切り替えられる)
+  /// @param worker_count レイアウトを並列処理するワーカースレッドの数
+  ///                     (ComplexLayoutは要素ごと、NativeLayoutはストライプごと)
   Engine(ImagePixelFormats output_pixel_format,
-         int output_width, int output_height, double output_fps);
+         int output_width, int output_height, double output_fps,
+         RenderingModes rendering_mode, int worker_count);
   /// デストラクタ
   ~Engine();
 
@@ -45,6 +77,12 @@ class Engine : public CAMThread, public Layout {
 
   /// カレントイメージをサンプルにコピー
   ErrorCodes CopyCurrentImage(BYTE *sample, DWORD data_size);
+  /// カレントイメージをレンダーターゲットに描画
+  /// - kBuffered: CopyCurrentImageと同じ
+  /// - kDirect: 呼び出したスレッドでレイアウトを実行し、
+  ///            レンダーターゲットのバッファに直接描画する
+  /// @attention Acceptと同じスレッドから呼び出すこと
+  ErrorCodes RenderCurrentImage(RenderTarget *render_target);
 
   //-------------------------------------------------------------------
   // ダブルディスパッチ用
@@ -55,6 +93,15 @@ class Engine : public CAMThread, public Layout {
   void SetNativeLayout();
   /// 現在のレイアウトを新しいComplexLayoutに設定する
   void SetComplexLayout();
+  /// キャプチャと変換の実行方法を切り替える
+  /// @attention 現在のレイアウトはスロット数を変えて作り直される
+  void SetPipelineMode(PipelineModes pipeline_mode);
+  /// 描画方法を切り替える
+  /// @attention 現在のレイアウトは出力イメージを変えて作り直される
+  void SetRenderingMode(RenderingModes rendering_mode);
+  /// 拡大縮小の品質の決め方を切り替える
+  /// @attention 現在のレイアウトは品質段階の有無を変えて作り直される
+  void SetScaleQualityMode(ScaleQualityModes scale_quality_mode);
   //-------------------------------------------------------------------
   /// スレッド間で共有: レイアウトパラメータの設定
   void SetLayoutParameters(
@@ -62,6 +109,10 @@ class Engine : public CAMThread, public Layout {
       const LayoutParameter (&parameters)[kMaxProcessorSize]);
   /// レイアウトプロセッサに異常が発生している場合NoError以外を返す
   ErrorCodes GetCurrentLayoutError();
+  /// 直近のパイプライン実行時の統計を取得する
+  PipelineStats GetPipelineStats();
+  /// 現在のレイアウトで拡大縮小を省略した回数を取得する
+  UnchangedFrameStats GetUnchangedFrameStats();
   //-------------------------------------------------------------------
 
  private:
@@ -87,6 +138,12 @@ class Engine : public CAMThread, public Layout {
   void DoSetComplexLayout();
   /// バッファにキャプチャ結果を格納する
   void DoLoop();
+  /// キャプチャスレッドを開始する(kPipelinedのみ)
+  void StartPipeline();
+  /// キャプチャスレッドを停止して統計を出力する
+  void StopPipeline();
+  /// キャプチャスレッドの処理
+  void CaptureLoop();
 
   /// CAMThread::ThreadProc()の実装
   DWORD ThreadProc();
@@ -96,22 +153,63 @@ class Engine : public CAMThread, public Layout {
 
   /// バッファを更新
   void Update();
+  /// キャプチャ済みのスロットを変換してバッファを更新(kPipelinedのみ)
+  void UpdatePipelined();
+  /// キャプチャ済みのスロットを現在の出力イメージに変換
+  ErrorCodes Convert(int slot);
+  /// 変換を開始したスロットの遅延を統計に追加
+  void RecordPipelineLatency(int64_t captured_time);
+  /// レイアウトの処理時間に応じて拡大縮小の品質段階を切り替える(kAdaptiveのみ)
+  void AdaptScaleQuality(int64_t processing_time);
+  /// 現在の品質段階をレイアウトに適用する
+  void ApplyScaleQualityLevel();
+  /// レイアウトが拡大縮小を省略した回数を共有用の統計に写す
+  void RecordUnchangedFrameStats();
+
+  /// スプラッシュをサンプルにコピー
+  void CopySplashImage(BYTE *sample, DWORD data_size);
 
-  /// 更新中のバッファを表すインデックス
-  /// @attention あえてLockしない
-  enum class ImageIndexes {
-    kFront,
-    kBack,
-  } last_update_image_;
+  /// 現在の描画方法
+  RenderingModes GetRenderingMode();
+  /// レイアウトの初期化時に設定する出力イメージ
+  AVPictureImage* GetDefaultOutputImage();
+  /// レイアウトの初期化時に設定するスロットの数
+  int GetLayoutSlotCount();
+  /// 出力イメージのバッファが次の描画まで内容を保持しているか
+  bool IsPersistentOutput();
+  /// レイアウトの初期化時に拡大縮小の品質段階を用意するか
+  bool GetLayoutEnableScaleQualityLevels();
+  /// 新しいレイアウトに合わせて拡大縮小の品質段階の管理をやり直す
+  void ResetScaleQuality();
 
   /// レイアウト
-  Layout *layout_;
+  StagedLayout *layout_;
+  /// レイアウトを並列処理するワーカープール
+  WorkerPool *worker_pool_;
+  /// レイアウトを作り直してもSwsContextを使いまわすためのキャッシュ
+  ScalerCache *scaler_cache_;
+
+  //-------------------------------------------------------------------
+  // パイプライン(キャプチャスレッドとの間で共有)
+  //-------------------------------------------------------------------
+  /// キャプチャ済みスロットのキュー(パイプライン停止中はnullptr)
+  CaptureQueue *capture_queue_;
+  /// 遅延計測用の時計(パイプライン停止中はnullptr)
+  Clock *pipeline_clock_;
+  /// キャプチャスレッド
+  std::thread capture_thread_;
+  /// キャプチャスレッドの終了要求
+  std::atomic<bool> capture_exiting_;
+  //-------------------------------------------------------------------
 
   //-------------------------------------------------------------------
   // スレッド間で共有
-  // front/back_image_はあえてロックしない
+  // images_はtriple_buffer_によってロックフリーで受け渡す
   //-------------------------------------------------------------------
 
+  /// images_の受け渡しを管理するトリプルバッファ
+  TripleBuffer triple_buffer_;
+
   /// 唯一レイアウトエラーコードをkNoErrorにできる関数
   /// @attention Initが成功したらこちら
   ErrorCodes LayoutInitDone();
@@ -126,24 +224,40 @@ class Engine : public CAMThread, public Layout {
   LayoutParameter parameters_[kMaxProcessorSize];
   /// レイアウトのエラーコード
   ErrorCodes layout_error_code_;
+  /// 現在のレイアウトを設定したリクエスト(作り直し用)
+  RequestTypes layout_request_;
+  /// 描画方法
+  RenderingModes rendering_mode_;
+  /// キャプチャと変換の実行方法
+  PipelineModes pipeline_mode_;
+  /// パイプライン実行時の統計
+  PipelineStats pipeline_stats_;
+  /// 拡大縮小の品質の決め方
+  ScaleQualityModes scale_quality_mode_;
+  /// 現在のレイアウトで拡大縮小を省略した回数
+  UnchangedFrameStats unchanged_frame_stats_;
 
   //===================================================================
 
+  /// 拡大縮小の品質段階の管理(レイアウトを実行するスレッドのみ)
+  ScaleQualityController scale_quality_;
+
   //-------------------------------------------------------------------
   // Image
   //-------------------------------------------------------------------
-  /// フロントイメージ
-  AVPictureImage front_image_;
-  /// バックイメージ
-  AVPictureImage back_image_;
+  /// トリプルバッファ用イメージ
+  AVPictureImage images_[TripleBuffer::kBufferCount];
   /// スプラッシュイメージ
   AVPictureImage splash_image_;
+  /// レンダーターゲット描画用イメージ(kDirectで使う)
+  AVPictureImage target_image_;
   //-------------------------------------------------------------------
 
-  /// フロントイメージの消去が必要
-  bool need_clear_front_image_;
-  /// バックイメージの消去が必要
-  bool need_clear_back_image_;
+  /// トリプルバッファ用イメージの消去が必要
+  bool need_clear_images_[TripleBuffer::kBufferCount];
+
+  /// 最後にサンプルにコピーしたフレームの世代
+  uint64_t last_copied_generation_;
 
   /// イメージのピクセルフォーマット
   const ImagePixelFormats output_pixel_format_;
@@ -153,6 +267,8 @@ class Engine : public CAMThread, public Layout {
   const int output_height_;
   /// fps
   const double output_fps_;
+  /// ワーカースレッドの数
+  const int worker_count_;
 
   // コピー＆代入禁止
   DISALLOW_COPY_AND_ASSIGN(Engine);
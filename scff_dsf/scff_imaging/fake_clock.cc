@@ -0,0 +1,86 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/fake_clock.cc
+/// scff_imaging::FakeClockの定義
+
+#include "scff_imaging/fake_clock.h"
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::FakeClock
+//=====================================================================
+
+FakeClock::FakeClock(int64_t sleep_granularity,
+                     int64_t sleep_overshoot,
+                     int64_t relax_step)
+    : Clock(),
+      now_(0LL),
+      sleep_granularity_(sleep_granularity),
+      sleep_overshoot_(sleep_overshoot),
+      relax_step_(relax_step),
+      pending_oversleep_(0LL),
+      sleep_count_(0LL),
+      relax_count_(0LL) {
+  // nop
+}
+
+FakeClock::~FakeClock() {
+  // nop
+}
+
+int64_t FakeClock::Now() {
+  return now_;
+}
+
+void FakeClock::SleepFor(int64_t duration) {
+  ++sleep_count_;
+  if (duration <= 0LL) {
+    return;
+  }
+  // 分解能単位に切り上げてから寝過ごし分を加える
+  int64_t actual = duration;
+  if (sleep_granularity_ > 0LL) {
+    actual = ((duration + sleep_granularity_ - 1) / sleep_granularity_) *
+             sleep_granularity_;
+  }
+  now_ += actual + sleep_overshoot_ + pending_oversleep_;
+  pending_oversleep_ = 0LL;
+}
+
+void FakeClock::Relax() {
+  ++relax_count_;
+  now_ += relax_step_;
+}
+
+void FakeClock::Advance(int64_t duration) {
+  now_ += duration;
+}
+
+void FakeClock::AddOversleep(int64_t duration) {
+  pending_oversleep_ += duration;
+}
+
+int64_t FakeClock::sleep_count() const {
+  return sleep_count_;
+}
+
+int64_t FakeClock::relax_count() const {
+  return relax_count_;
+}
+}   // namespace scff_imaging
@@ -0,0 +1,87 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/fake_clock.h
+/// scff_imaging::FakeClockの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_FAKE_CLOCK_H_
+#define SCFF_DSF_SCFF_IMAGING_FAKE_CLOCK_H_
+
+#include <cstdint>
+
+#include "scff_imaging/common.h"
+#include "scff_imaging/clock.h"
+
+namespace scff_imaging {
+
+/// テスト用の時計
+/// - 時刻はSleepFor/Relax/Advanceでのみ進む(実時間とは無関係)
+/// - SleepForはOSのタイマ分解能を模倣して切り上げ+寝過ごしを加える
+class FakeClock : public Clock {
+ public:
+  /// コンストラクタ
+  /// @param sleep_granularity  SleepForの分解能(100nSec)
+  /// @param sleep_overshoot    SleepForで余分に眠る時間(100nSec)
+  /// @param relax_step         Relax一回で進む時間(100nSec)
+  /// @attention relax_stepが0だとスピン待機が終わらない
+  FakeClock(int64_t sleep_granularity,
+            int64_t sleep_overshoot,
+            int64_t relax_step);
+  /// デストラクタ
+  ~FakeClock();
+
+  //-------------------------------------------------------------------
+  /// @copydoc Clock::Now
+  int64_t Now();
+  /// @copydoc Clock::SleepFor
+  void SleepFor(int64_t duration);
+  /// @copydoc Clock::Relax
+  void Relax();
+  //-------------------------------------------------------------------
+
+  /// 時刻を進める(処理時間の模倣)
+  void Advance(int64_t duration);
+  /// 次のSleepForだけ余分に眠らせる(プリエンプションの模倣)
+  void AddOversleep(int64_t duration);
+
+  /// Getter: SleepForが呼ばれた回数
+  int64_t sleep_count() const;
+  /// Getter: Relaxが呼ばれた回数
+  int64_t relax_count() const;
+
+ private:
+  /// 現在時刻
+  int64_t now_;
+  /// SleepForの分解能
+  const int64_t sleep_granularity_;
+  /// SleepForで余分に眠る時間
+  const int64_t sleep_overshoot_;
+  /// Relax一回で進む時間
+  const int64_t relax_step_;
+  /// 次のSleepForだけ余分に眠る時間
+  int64_t pending_oversleep_;
+  /// SleepForが呼ばれた回数
+  int64_t sleep_count_;
+  /// Relaxが呼ばれた回数
+  int64_t relax_count_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(FakeClock);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_FAKE_CLOCK_H_
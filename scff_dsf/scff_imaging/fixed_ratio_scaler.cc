@@ -0,0 +1,615 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/fixed_ratio_scaler.cc
+/// scff_imaging::FixedRatioScalerの定義
+
+#include "scff_imaging/fixed_ratio_scaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "scff_imaging/debug.h"
+#include "scff_imaging/unscaled_converter.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+    defined(__SSE2__)
+#define SCFF_FIXED_RATIO_SCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/// 色差を縦にも間引く(出力を2行ずつ処理する)ピクセルフォーマットか
+inline bool Is420(AVPixelFormat pixel_format) {
+  return pixel_format == AV_PIX_FMT_YUV420P ||
+         pixel_format == AV_PIX_FMT_NV12;
+}
+
+//---------------------------------------------------------------------
+// 面積平均の重み
+// - 出力ピクセルは縮小率kOutputPixels個ごとに同じ重みを繰り返す
+//   (この中での位置をphaseと呼ぶ)
+// - 出力1ピクセルは入力2ピクセル以内に収まるので、2タップで表せる
+// - 2タップの重みの合計はどちらの縮小率でもkInputPixelsになる
+//---------------------------------------------------------------------
+
+/// 縮小率kInputPixels:kOutputPixelsの面積平均の重み
+template <int kInputPixels, int kOutputPixels>
+struct AreaTaps;
+
+/// 2:1: 入力2ピクセルの平均
+template <>
+struct AreaTaps<2, 1> {
+  /// 繰り返しの先頭から1タップ目の入力ピクセルまでの距離
+  static int offset(int /*phase*/) { return 0; }
+  /// 1タップ目の重み
+  static int weight0(int /*phase*/) { return 1; }
+  /// 2タップ目の重み
+  static int weight1(int /*phase*/) { return 1; }
+};
+
+/// 3:2: 出力1ピクセルは入力1.5ピクセル分なので(2, 1)/3と(1, 2)/3
+template <>
+struct AreaTaps<3, 2> {
+  /// 繰り返しの先頭から1タップ目の入力ピクセルまでの距離
+  static int offset(int phase) { return phase; }
+  /// 1タップ目の重み
+  static int weight0(int phase) { return 2 - phase; }
+  /// 2タップ目の重み
+  static int weight1(int phase) { return 1 + phase; }
+};
+
+/// 出力の位置(x/y)に対応する1タップ目の入力の位置
+template <int kInputPixels, int kOutputPixels>
+inline int FirstTap(int position) {
+  typedef AreaTaps<kInputPixels, kOutputPixels> Taps;
+  return (position / kOutputPixels) * kInputPixels +
+         Taps::offset(position % kOutputPixels);
+}
+
+/// 出力の1行(4:2:0では2行)を求めるのに使う入力の行と縦方向の重み
+struct SourceRows {
+  /// 1タップ目の入力の行
+  const uint8_t *src0[2];
+  /// 2タップ目の入力の行
+  const uint8_t *src1[2];
+  /// 1タップ目の重み
+  int weight0[2];
+  /// 2タップ目の重み
+  int weight1[2];
+};
+
+/// 出力の行[output_y, output_y + row_count)のSourceRowsを求める
+template <int kInputPixels, int kOutputPixels>
+void GetSourceRows(const AVPicture &input, int output_y, int row_count,
+                   SourceRows *rows) {
+  typedef AreaTaps<kInputPixels, kOutputPixels> Taps;
+  for (int row = 0; row < row_count; row++) {
+    const int y = output_y + row;
+    const int input_y = FirstTap<kInputPixels, kOutputPixels>(y);
+    rows->src0[row] = input.data[0] + input_y * input.linesize[0];
+    rows->src1[row] = rows->src0[row] + input.linesize[0];
+    rows->weight0[row] = Taps::weight0(y % kOutputPixels);
+    rows->weight1[row] = Taps::weight1(y % kOutputPixels);
+  }
+}
+
+//---------------------------------------------------------------------
+// YUVへの変換
+// - 重み付きの和(重みの合計はkInputPixelsの2乗)に、重みの合計で割った
+//   係数(1<<(15 + shift)が1.0)を掛けて求める
+// - 色差は出力のピクセルの和(2ピクセルか4ピクセル)から求めるので、
+//   シフト量を1か2増やす
+//---------------------------------------------------------------------
+
+/// 重み付きの和からYUVの1成分を求める
+/// @param offset 16(輝度)または128(色差)
+/// @param shift 係数の1.0に相当するシフト量
+inline uint8_t ToComponent(const int sum[3], const int *coefficients,
+                           int offset, int shift) {
+  return static_cast<uint8_t>(
+      (coefficients[0] * sum[0] +
+       coefficients[1] * sum[1] +
+       coefficients[2] * sum[2] +
+       (offset << shift) + (1 << (shift - 1))) >> shift);
+}
+
+/// 出力1ピクセル分の入力2x2ピクセルの重み付きの和(バイトごと)
+template <int kInputPixels, int kOutputPixels>
+inline void AreaSum(const SourceRows &rows, int row, int x, int sum[3]) {
+  typedef AreaTaps<kInputPixels, kOutputPixels> Taps;
+  const int phase_x = x % kOutputPixels;
+  const int offset = FirstTap<kInputPixels, kOutputPixels>(x) * 4;
+  const uint8_t *pixel0 = rows.src0[row] + offset;
+  const uint8_t *pixel1 = rows.src1[row] + offset;
+  const int weight_x0 = Taps::weight0(phase_x);
+  const int weight_x1 = Taps::weight1(phase_x);
+  for (int i = 0; i < 3; i++) {
+    sum[i] =
+        rows.weight0[row] *
+            (weight_x0 * pixel0[i] + weight_x1 * pixel0[i + 4]) +
+        rows.weight1[row] *
+            (weight_x0 * pixel1[i] + weight_x1 * pixel1[i + 4]);
+  }
+}
+
+/// 出力の1行(4:2:0では2行)の[x0, x1)を縮小しながら変換する
+/// - 出力の横2ピクセル(4:2:0では2x2ピクセル)ずつ処理する
+template <int kInputPixels, int kOutputPixels, AVPixelFormat kOutputFormat>
+void ScaleSpanPortable(const SourceRows &rows, AVPicture *output,
+                       int output_y, int x0, int x1,
+                       const int *coefficients, int shift) {
+  const bool k420 = Is420(kOutputFormat);
+  const int kRowCount = k420 ? 2 : 1;
+  // UYVYならU Y0 V Y1、YUY2ならY0 U Y1 V
+  const int kLumaOffset = kOutputFormat == AV_PIX_FMT_UYVY422 ? 1 : 0;
+  const int kChromaOffset = 1 - kLumaOffset;
+  const int chroma_shift = shift + (k420 ? 2 : 1);
+  const int *luma = coefficients;
+  const int *u = coefficients + 3;
+  const int *v = coefficients + 6;
+
+  for (int x = x0; x < x1; x += 2) {
+    // 出力の2(x2)ピクセル分の和とその合計
+    int sum[2][2][3];
+    int chroma_sum[3] = {0, 0, 0};
+    for (int row = 0; row < kRowCount; row++) {
+      for (int i = 0; i < 2; i++) {
+        AreaSum<kInputPixels, kOutputPixels>(rows, row, x + i, sum[row][i]);
+        for (int c = 0; c < 3; c++) {
+          chroma_sum[c] += sum[row][i][c];
+        }
+      }
+    }
+
+    if (k420) {
+      for (int row = 0; row < kRowCount; row++) {
+        uint8_t *dst_y = output->data[0] +
+                         (output_y + row) * output->linesize[0] + x;
+        dst_y[0] = ToComponent(sum[row][0], luma, 16, shift);
+        dst_y[1] = ToComponent(sum[row][1], luma, 16, shift);
+      }
+      const int chroma_y = output_y / 2;
+      if (kOutputFormat == AV_PIX_FMT_NV12) {
+        // U V U V ...
+        uint8_t *dst_uv = output->data[1] + chroma_y * output->linesize[1] + x;
+        dst_uv[0] = ToComponent(chroma_sum, u, 128, chroma_shift);
+        dst_uv[1] = ToComponent(chroma_sum, v, 128, chroma_shift);
+      } else {
+        output->data[1][chroma_y * output->linesize[1] + x / 2] =
+            ToComponent(chroma_sum, u, 128, chroma_shift);
+        output->data[2][chroma_y * output->linesize[2] + x / 2] =
+            ToComponent(chroma_sum, v, 128, chroma_shift);
+      }
+    } else {
+      uint8_t *macropixel =
+          output->data[0] + output_y * output->linesize[0] + x * 2;
+      macropixel[kLumaOffset] = ToComponent(sum[0][0], luma, 16, shift);
+      macropixel[kLumaOffset + 2] = ToComponent(sum[0][1], luma, 16, shift);
+      macropixel[kChromaOffset] =
+          ToComponent(chroma_sum, u, 128, chroma_shift);
+      macropixel[kChromaOffset + 2] =
+          ToComponent(chroma_sum, v, 128, chroma_shift);
+    }
+  }
+}
+
+#if defined(SCFF_FIXED_RATIO_SCALER_SSE2)
+/// 入力4ピクセル(16バイト)の2行を16bitに広げて縦の重みを掛けて足す
+/// @param[out] low 1,2ピクセル目
+/// @param[out] high 3,4ピクセル目
+inline void VerticalSum4(const uint8_t *src0, const uint8_t *src1,
+                         __m128i weight0, __m128i weight1,
+                         __m128i *low, __m128i *high) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i pixels0 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0));
+  const __m128i pixels1 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1));
+  *low = _mm_add_epi16(
+      _mm_mullo_epi16(_mm_unpacklo_epi8(pixels0, zero), weight0),
+      _mm_mullo_epi16(_mm_unpacklo_epi8(pixels1, zero), weight1));
+  *high = _mm_add_epi16(
+      _mm_mullo_epi16(_mm_unpackhi_epi8(pixels0, zero), weight0),
+      _mm_mullo_epi16(_mm_unpackhi_epi8(pixels1, zero), weight1));
+}
+
+/// 入力2ピクセル(8バイト)の2行を16bitに広げて縦の重みを掛けて足す
+inline __m128i VerticalSum2(const uint8_t *src0, const uint8_t *src1,
+                            __m128i weight0, __m128i weight1) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i pixels0 =
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src0));
+  const __m128i pixels1 =
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src1));
+  return _mm_add_epi16(
+      _mm_mullo_epi16(_mm_unpacklo_epi8(pixels0, zero), weight0),
+      _mm_mullo_epi16(_mm_unpacklo_epi8(pixels1, zero), weight1));
+}
+
+/// 出力8ピクセル分の重み付きの和(16bit, 2ピクセルずつ4つ)
+/// - srcは出力の先頭ピクセルの1タップ目の入力
+template <int kInputPixels, int kOutputPixels>
+struct AreaSum8;
+
+/// 2:1: 入力16ピクセルを2ピクセルずつ足す
+template <>
+struct AreaSum8<2, 1> {
+  static void Run(const uint8_t *src0, const uint8_t *src1,
+                  __m128i weight0, __m128i weight1, __m128i sum[4]) {
+    for (int i = 0; i < 4; i++) {
+      __m128i low;
+      __m128i high;
+      VerticalSum4(src0 + i * 16, src1 + i * 16, weight0, weight1,
+                   &low, &high);
+      sum[i] = _mm_add_epi16(_mm_unpacklo_epi64(low, high),
+                             _mm_unpackhi_epi64(low, high));
+    }
+  }
+};
+
+/// 3:2: 入力6ピクセル(v0..v5)から出力4ピクセルを求める
+/// - (2v0 + v1, v1 + 2v2, 2v3 + v4, v4 + 2v5)
+template <>
+struct AreaSum8<3, 2> {
+  static void Run(const uint8_t *src0, const uint8_t *src1,
+                  __m128i weight0, __m128i weight1, __m128i sum[4]) {
+    for (int i = 0; i < 2; i++) {
+      __m128i v01;
+      __m128i v23;
+      VerticalSum4(src0 + i * 24, src1 + i * 24, weight0, weight1,
+                   &v01, &v23);
+      const __m128i v45 = VerticalSum2(src0 + i * 24 + 16,
+                                       src1 + i * 24 + 16,
+                                       weight0, weight1);
+      sum[i * 2] = _mm_add_epi16(
+          _mm_slli_epi16(_mm_unpacklo_epi64(v01, v23), 1),
+          _mm_unpackhi_epi64(v01, v01));
+      sum[i * 2 + 1] = _mm_add_epi16(
+          _mm_slli_epi16(_mm_unpackhi_epi64(v23, v45), 1),
+          _mm_unpacklo_epi64(v45, v45));
+    }
+  }
+};
+
+/// 係数(3バイト分)を2ピクセル分の16bit値に並べる(4バイト目の係数は0)
+__m128i LoadCoefficients(const int *coefficients) {
+  return _mm_set_epi16(0, static_cast<int16_t>(coefficients[2]),
+                       static_cast<int16_t>(coefficients[1]),
+                       static_cast<int16_t>(coefficients[0]),
+                       0, static_cast<int16_t>(coefficients[2]),
+                       static_cast<int16_t>(coefficients[1]),
+                       static_cast<int16_t>(coefficients[0]));
+}
+
+/// 2ピクセルずつの和(2つ)の4ピクセル分からYUVの1成分(32bit)を求める
+/// @param bias オフセット(16か128)と丸め
+inline __m128i ToComponents4(__m128i sum01, __m128i sum23,
+                             __m128i coefficients, __m128i bias,
+                             __m128i shift) {
+  // _mm_madd_epi16の結果はピクセルごとに2つの部分和になる
+  const __m128 low =
+      _mm_castsi128_ps(_mm_madd_epi16(sum01, coefficients));
+  const __m128 high =
+      _mm_castsi128_ps(_mm_madd_epi16(sum23, coefficients));
+  const __m128i even = _mm_castps_si128(
+      _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+  const __m128i odd = _mm_castps_si128(
+      _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+  return _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), bias),
+                       shift);
+}
+
+/// 2ピクセルずつの和(2つ)を横に隣り合う2ピクセルずつ足す
+inline __m128i SumPairs(__m128i sum01, __m128i sum23) {
+  return _mm_add_epi16(_mm_unpacklo_epi64(sum01, sum23),
+                       _mm_unpackhi_epi64(sum01, sum23));
+}
+
+/// 32bit値(4つ)を2組まとめて8bitにする(下位8バイト)
+inline __m128i PackTo8(__m128i value0, __m128i value1) {
+  const __m128i words = _mm_packs_epi32(value0, value1);
+  return _mm_packus_epi16(words, words);
+}
+
+/// ScaleSpanPortableを出力8ピクセルずつまとめて処理する
+/// - 8ピクセルにそろわない右端はScaleSpanPortableで処理する
+template <int kInputPixels, int kOutputPixels, AVPixelFormat kOutputFormat>
+void ScaleSpanSSE2(const SourceRows &rows, AVPicture *output,
+                   int output_y, int x0, int x1,
+                   const int *coefficients, int shift) {
+  const bool k420 = Is420(kOutputFormat);
+  const int kRowCount = k420 ? 2 : 1;
+  const int chroma_shift = shift + (k420 ? 2 : 1);
+  const __m128i luma = LoadCoefficients(coefficients);
+  const __m128i u = LoadCoefficients(coefficients + 3);
+  const __m128i v = LoadCoefficients(coefficients + 6);
+  const __m128i luma_bias =
+      _mm_set1_epi32((16 << shift) + (1 << (shift - 1)));
+  const __m128i chroma_bias =
+      _mm_set1_epi32((128 << chroma_shift) + (1 << (chroma_shift - 1)));
+  const __m128i luma_shift = _mm_cvtsi32_si128(shift);
+  const __m128i chroma_shift_count = _mm_cvtsi32_si128(chroma_shift);
+  __m128i weight0[2];
+  __m128i weight1[2];
+  for (int row = 0; row < kRowCount; row++) {
+    weight0[row] = _mm_set1_epi16(static_cast<int16_t>(rows.weight0[row]));
+    weight1[row] = _mm_set1_epi16(static_cast<int16_t>(rows.weight1[row]));
+  }
+
+  int x = x0;
+  for (; x + 8 <= x1; x += 8) {
+    const int offset = FirstTap<kInputPixels, kOutputPixels>(x) * 4;
+    __m128i sum[2][4];
+    __m128i luma8[2];
+    for (int row = 0; row < kRowCount; row++) {
+      AreaSum8<kInputPixels, kOutputPixels>::Run(
+          rows.src0[row] + offset, rows.src1[row] + offset,
+          weight0[row], weight1[row], sum[row]);
+      luma8[row] = PackTo8(
+          ToComponents4(sum[row][0], sum[row][1], luma, luma_bias,
+                        luma_shift),
+          ToComponents4(sum[row][2], sum[row][3], luma, luma_bias,
+                        luma_shift));
+    }
+
+    // 出力の2(x2)ピクセルずつの和
+    __m128i pairs[2];
+    for (int i = 0; i < 2; i++) {
+      __m128i sum01 = sum[0][i * 2];
+      __m128i sum23 = sum[0][i * 2 + 1];
+      if (k420) {
+        sum01 = _mm_add_epi16(sum01, sum[1][i * 2]);
+        sum23 = _mm_add_epi16(sum23, sum[1][i * 2 + 1]);
+      }
+      pairs[i] = SumPairs(sum01, sum23);
+    }
+    const __m128i u4 = ToComponents4(pairs[0], pairs[1], u, chroma_bias,
+                                     chroma_shift_count);
+    const __m128i v4 = ToComponents4(pairs[0], pairs[1], v, chroma_bias,
+                                     chroma_shift_count);
+    // U0 V0 U1 V1 ...(NV12とUYVY/YUY2で使う)
+    const __m128i interleaved_uv8 = PackTo8(_mm_unpacklo_epi32(u4, v4),
+                                            _mm_unpackhi_epi32(u4, v4));
+
+    if (k420) {
+      for (int row = 0; row < kRowCount; row++) {
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i*>(
+                output->data[0] + (output_y + row) * output->linesize[0] + x),
+            luma8[row]);
+      }
+      const int chroma_y = output_y / 2;
+      if (kOutputFormat == AV_PIX_FMT_NV12) {
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i*>(
+                output->data[1] + chroma_y * output->linesize[1] + x),
+            interleaved_uv8);
+      } else {
+        const __m128i uv8 = PackTo8(u4, v4);
+        *reinterpret_cast<int32_t*>(
+            output->data[1] + chroma_y * output->linesize[1] + x / 2) =
+            _mm_cvtsi128_si32(uv8);
+        *reinterpret_cast<int32_t*>(
+            output->data[2] + chroma_y * output->linesize[2] + x / 2) =
+            _mm_cvtsi128_si32(_mm_srli_si128(uv8, 4));
+      }
+    } else {
+      // 輝度と交互に並べる
+      const __m128i packed =
+          kOutputFormat == AV_PIX_FMT_UYVY422 ?
+              _mm_unpacklo_epi8(interleaved_uv8, luma8[0]) :
+              _mm_unpacklo_epi8(luma8[0], interleaved_uv8);
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(
+              output->data[0] + output_y * output->linesize[0] + x * 2),
+          packed);
+    }
+  }
+
+  ScaleSpanPortable<kInputPixels, kOutputPixels, kOutputFormat>(
+      rows, output, output_y, x, x1, coefficients, shift);
+}
+#endif  // defined(SCFF_FIXED_RATIO_SCALER_SSE2)
+
+/// 縮小率kInputPixels:kOutputPixelsで縮小しながらkOutputFormatに変換する
+/// @param width 出力の幅(偶数)
+/// @param y 出力の行(4:2:0では偶数)
+/// @param height 出力の行数(4:2:0では偶数)
+/// @param simd SSE2が使えれば使うか
+template <int kInputPixels, int kOutputPixels, AVPixelFormat kOutputFormat>
+void ScaleRows(const AVPicture &input, AVPicture *output,
+               int width, int y, int height,
+               const int *coefficients, int shift, bool simd) {
+  const int kRowCount = Is420(kOutputFormat) ? 2 : 1;
+  for (int output_y = y; output_y < y + height; output_y += kRowCount) {
+    SourceRows rows;
+    GetSourceRows<kInputPixels, kOutputPixels>(input, output_y, kRowCount,
+                                               &rows);
+#if defined(SCFF_FIXED_RATIO_SCALER_SSE2)
+    if (simd) {
+      ScaleSpanSSE2<kInputPixels, kOutputPixels, kOutputFormat>(
+          rows, output, output_y, 0, width, coefficients, shift);
+      continue;
+    }
+#endif
+    ScaleSpanPortable<kInputPixels, kOutputPixels, kOutputFormat>(
+        rows, output, output_y, 0, width, coefficients, shift);
+  }
+}
+
+/// 実体化したカーネルの一覧
+typedef void (*ScaleRowsFunction)(const AVPicture &input, AVPicture *output,
+                                  int width, int y, int height,
+                                  const int *coefficients, int shift,
+                                  bool simd);
+const struct {
+  int input_ratio;
+  int output_ratio;
+  AVPixelFormat output_pixel_format;
+  ScaleRowsFunction function;
+} kKernels[] = {
+  {2, 1, AV_PIX_FMT_YUV420P, &ScaleRows<2, 1, AV_PIX_FMT_YUV420P>},
+  {2, 1, AV_PIX_FMT_UYVY422, &ScaleRows<2, 1, AV_PIX_FMT_UYVY422>},
+  {2, 1, AV_PIX_FMT_YUYV422, &ScaleRows<2, 1, AV_PIX_FMT_YUYV422>},
+  {2, 1, AV_PIX_FMT_NV12, &ScaleRows<2, 1, AV_PIX_FMT_NV12>},
+  {3, 2, AV_PIX_FMT_YUV420P, &ScaleRows<3, 2, AV_PIX_FMT_YUV420P>},
+  {3, 2, AV_PIX_FMT_UYVY422, &ScaleRows<3, 2, AV_PIX_FMT_UYVY422>},
+  {3, 2, AV_PIX_FMT_YUYV422, &ScaleRows<3, 2, AV_PIX_FMT_YUYV422>},
+  {3, 2, AV_PIX_FMT_NV12, &ScaleRows<3, 2, AV_PIX_FMT_NV12>}
+};
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::FixedRatioScaler
+//=====================================================================
+
+FixedRatioScaler::FixedRatioScaler()
+    : kernel_(nullptr),
+      output_pixel_format_(AV_PIX_FMT_NONE),
+      input_ratio_(0),
+      output_ratio_(0),
+      width_(0),
+      height_(0),
+      coefficient_shift_(0) {
+  memset(coefficients_, 0, sizeof(coefficients_));
+}
+
+FixedRatioScaler::~FixedRatioScaler() {
+  // nop
+}
+
+bool FixedRatioScaler::Init(AVPixelFormat input_pixel_format,
+                            AVPixelFormat output_pixel_format,
+                            int input_width, int input_height,
+                            int output_width, int output_height) {
+  Clear();
+
+  // 色差の間引き
+  if (output_width <= 0 || output_height <= 0 || output_width % 2 != 0 ||
+      (Is420(output_pixel_format) && output_height % 2 != 0)) {
+    return false;
+  }
+  int coefficients[9];
+  if (!UnscaledConverter::GetCoefficients(input_pixel_format,
+                                          coefficients)) {
+    return false;
+  }
+
+  const int kernel_count = sizeof(kKernels) / sizeof(kKernels[0]);
+  for (int i = 0; i < kernel_count; i++) {
+    const auto &kernel = kKernels[i];
+    // 縦横とも同じ縮小率で、入力がちょうど縮小率の倍数であること
+    if (kernel.output_pixel_format != output_pixel_format ||
+        output_width % kernel.output_ratio != 0 ||
+        output_height % kernel.output_ratio != 0 ||
+        input_width * kernel.output_ratio !=
+            output_width * kernel.input_ratio ||
+        input_height * kernel.output_ratio !=
+            output_height * kernel.input_ratio) {
+      continue;
+    }
+
+    // 係数を重みの合計で割っておく
+    // (16bitに収まる範囲でできるだけ精度を残すようにシフト量を選ぶ)
+    const int weight_sum = kernel.input_ratio * kernel.input_ratio;
+    int max_coefficient = 0;
+    for (int j = 0; j < 9; j++) {
+      max_coefficient = std::max(max_coefficient, abs(coefficients[j]));
+    }
+    int shift = 0;
+    while ((max_coefficient << (shift + 1)) / weight_sum < (1 << 15)) {
+      ++shift;
+    }
+    for (int j = 0; j < 9; j++) {
+      coefficients_[j] = static_cast<int>(floor(
+          static_cast<double>(coefficients[j]) * (1 << shift) / weight_sum +
+          0.5));
+    }
+    coefficient_shift_ = 15 + shift;
+
+    kernel_ = kernel.function;
+    output_pixel_format_ = output_pixel_format;
+    input_ratio_ = kernel.input_ratio;
+    output_ratio_ = kernel.output_ratio;
+    width_ = output_width;
+    height_ = output_height;
+    return true;
+  }
+  return false;
+}
+
+void FixedRatioScaler::Clear() {
+  kernel_ = nullptr;
+  output_pixel_format_ = AV_PIX_FMT_NONE;
+  input_ratio_ = 0;
+  output_ratio_ = 0;
+  width_ = 0;
+  height_ = 0;
+  coefficient_shift_ = 0;
+}
+
+void FixedRatioScaler::Convert(const AVPicture &input, AVPicture *output,
+                               int y, int height) const {
+  ASSERT(is_valid());
+  ASSERT(0 <= y && y + height <= height_);
+  ASSERT(y % row_alignment() == 0 && height % row_alignment() == 0);
+  kernel_(input, output, width_, y, height,
+          coefficients_, coefficient_shift_, true);
+}
+
+void FixedRatioScaler::ConvertPortable(const AVPicture &input,
+                                       AVPicture *output,
+                                       int y, int height) const {
+  ASSERT(is_valid());
+  ASSERT(0 <= y && y + height <= height_);
+  ASSERT(y % row_alignment() == 0 && height % row_alignment() == 0);
+  kernel_(input, output, width_, y, height,
+          coefficients_, coefficient_shift_, false);
+}
+
+void FixedRatioScaler::GetInputRows(int y, int height,
+                                    int *input_y, int *input_height) const {
+  ASSERT(is_valid());
+  // 出力の行[y, y + height)が面積で覆う入力の行(端数は切り上げ)
+  *input_y = y * input_ratio_ / output_ratio_;
+  const int input_end =
+      ((y + height) * input_ratio_ + output_ratio_ - 1) / output_ratio_;
+  *input_height = input_end - *input_y;
+}
+
+bool FixedRatioScaler::is_valid() const {
+  return kernel_ != nullptr;
+}
+
+int FixedRatioScaler::row_alignment() const {
+  return Is420(output_pixel_format_) ? 2 : 1;
+}
+
+int FixedRatioScaler::input_ratio() const {
+  return input_ratio_;
+}
+
+int FixedRatioScaler::output_ratio() const {
+  return output_ratio_;
+}
+}   // namespace scff_imaging
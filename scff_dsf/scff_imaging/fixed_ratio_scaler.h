@@ -0,0 +1,110 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/fixed_ratio_scaler.h
+/// scff_imaging::FixedRatioScalerの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_FIXED_RATIO_SCALER_H_
+#define SCFF_DSF_SCFF_IMAGING_FIXED_RATIO_SCALER_H_
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// よく使う固定の縮小率でRGB0(32bit)を縮小しながらYUVに変換する
+/// - 縮小率は縦横とも2:1(2560x1440->1280x720など)か
+///   3:2(1920x1080->1280x720など)
+/// - 縮小は面積平均(2:1ではbilinearとも同じ)で、縮小したRGBの和から
+///   UnscaledConverterと同じ係数で直接YUVを求める
+/// - 出力はYUV420P(I420/IYUV/YV12)とNV12とUYVY/YUY2で、色差は出力の
+///   2x2(4:2:2では2x1)ピクセル分の面積平均
+/// - 縮小率と出力ピクセルフォーマットをテンプレート引数にしたカーネルを
+///   組み合わせごとに実体化してあり、Initで選んだものを使う
+/// - SSE2が使える場合は出力8ピクセル単位でまとめて変換する
+///   (結果はSSE2を使わない場合と完全に一致する)
+class FixedRatioScaler {
+ public:
+  /// コンストラクタ
+  FixedRatioScaler();
+  /// デストラクタ
+  ~FixedRatioScaler();
+
+  /// 対応するカーネルを選ぶ
+  /// @param input_pixel_format AV_PIX_FMT_BGR0またはAV_PIX_FMT_RGB0
+  /// @retval true    対応するカーネルがある
+  /// @retval false   対応していない(縮小率が縦横で異なる場合も)
+  bool Init(AVPixelFormat input_pixel_format,
+            AVPixelFormat output_pixel_format,
+            int input_width, int input_height,
+            int output_width, int output_height);
+  /// カーネルを使うのをやめる(Initするまでis_validはfalse)
+  void Clear();
+
+  /// 出力の行[y, y + height)を入力から求めて書き込む
+  /// @attention YUV420P/NV12ではyとheightは偶数であること
+  void Convert(const AVPicture &input, AVPicture *output,
+               int y, int height) const;
+  /// SIMDを使わずに変換する(検証用)
+  void ConvertPortable(const AVPicture &input, AVPicture *output,
+                       int y, int height) const;
+  /// 出力の行[y, y + height)を求めるのに必要な入力の行を求める
+  void GetInputRows(int y, int height,
+                    int *input_y, int *input_height) const;
+
+  /// Getter: Initに成功したか
+  bool is_valid() const;
+  /// Getter: 出力の縦方向の色差の間引き単位(行数)
+  int row_alignment() const;
+  /// Getter: 縮小率の入力側のピクセル数
+  int input_ratio() const;
+  /// Getter: 縮小率の出力側のピクセル数
+  int output_ratio() const;
+
+ private:
+  /// 縮小率・出力ピクセルフォーマットごとのカーネル
+  typedef void (*Kernel)(const AVPicture &input, AVPicture *output,
+                         int width, int y, int height,
+                         const int *coefficients, int shift, bool simd);
+
+  /// 選んだカーネル
+  Kernel kernel_;
+  /// 出力ピクセルフォーマット
+  AVPixelFormat output_pixel_format_;
+  /// 縮小率の入力側のピクセル数
+  int input_ratio_;
+  /// 縮小率の出力側のピクセル数
+  int output_ratio_;
+  /// 出力の幅
+  int width_;
+  /// 出力の高さ
+  int height_;
+  /// 入力ピクセルのバイトごとの係数を重みの合計で割ったもの
+  /// (Y, U, Vの順に3バイト分ずつ)
+  int coefficients_[9];
+  /// coefficients_の1.0に相当するシフト量
+  int coefficient_shift_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(FixedRatioScaler);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_FIXED_RATIO_SCALER_H_
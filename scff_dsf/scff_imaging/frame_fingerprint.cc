@@ -0,0 +1,252 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/frame_fingerprint.cc
+/// scff_imaging::FrameFingerprintの定義
+
+#include "scff_imaging/frame_fingerprint.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+    defined(__SSE2__)
+#define SCFF_FINGERPRINT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/// 16バイトごとに変化させる鍵の初期値(64bitレーンごと)
+const uint64_t kInitialKey0 = 0x9E3779B97F4A7C15ULL;
+const uint64_t kInitialKey1 = 0xC2B2AE3D27D4EB4FULL;
+/// 16バイトごとに鍵に足す値(奇数)
+const uint64_t kKeyStep0 = 0x165667B19E3779F9ULL;
+const uint64_t kKeyStep1 = 0x27D4EB2F165667C5ULL;
+/// アキュムレータの初期値
+const uint64_t kInitialAccumulator0 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kInitialAccumulator1 = 0x94D049BB133111EBULL;
+
+/// 64bitの値をよく混ぜる(MurmurHash3のfmix64)
+uint64_t Mix64(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xFF51AFD7ED558CCDULL;
+  value ^= value >> 33;
+  value *= 0xC4CEB9FE1A85EC53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+/// アキュムレータからブロックのハッシュを求める
+uint64_t Finalize(uint64_t accumulator0, uint64_t accumulator1,
+                  int width_bytes, int rows) {
+  const uint64_t size =
+      (static_cast<uint64_t>(width_bytes) << 32) ^
+      static_cast<uint64_t>(rows);
+  return Mix64(accumulator0 ^ Mix64(accumulator1 + size));
+}
+
+/// 16バイト分を1レーンずつ処理する
+/// - x = data ^ key
+/// - accumulator += (xの下位32bit * xの上位32bit) + もう一方のレーンのdata
+/// - key += step
+inline void AccumulatePortable(const uint8_t *chunk,
+                               uint64_t (&accumulator)[2],
+                               uint64_t (&key)[2]) {
+  uint64_t data[2];
+  memcpy(data, chunk, sizeof(data));
+  for (int lane = 0; lane < 2; lane++) {
+    const uint64_t x = data[lane] ^ key[lane];
+    accumulator[lane] += (x & 0xFFFFFFFFULL) * (x >> 32) + data[1 - lane];
+  }
+  key[0] += kKeyStep0;
+  key[1] += kKeyStep1;
+}
+
+#if defined(SCFF_FINGERPRINT_SSE2)
+/// 64bitレーン2つの値からレジスタを作る
+/// (_mm_set_epi64xは32bit版のコンパイラによっては使えないため)
+inline __m128i Set64x2(uint64_t lane1, uint64_t lane0) {
+  return _mm_set_epi32(static_cast<int>(lane1 >> 32),
+                       static_cast<int>(lane1),
+                       static_cast<int>(lane0 >> 32),
+                       static_cast<int>(lane0));
+}
+
+/// AccumulatePortableと同じ計算を2レーンまとめて行う
+inline void AccumulateSSE2(__m128i data, __m128i *accumulator,
+                           __m128i *key, __m128i step) {
+  const __m128i x = _mm_xor_si128(data, *key);
+  // 各レーンの上位32bitを下位に移して掛け合わせる
+  const __m128i x_high = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 3, 0, 1));
+  const __m128i product = _mm_mul_epu32(x, x_high);
+  // 64bitレーンを入れ替えたdata
+  const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+  *accumulator = _mm_add_epi64(*accumulator,
+                               _mm_add_epi64(product, swapped));
+  *key = _mm_add_epi64(*key, step);
+}
+#endif  // defined(SCFF_FINGERPRINT_SSE2)
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::FrameFingerprint
+//=====================================================================
+
+FrameFingerprint::FrameFingerprint()
+    : width_bytes_(0),
+      height_(0) {
+  // nop
+}
+
+FrameFingerprint::~FrameFingerprint() {
+  // nop
+}
+
+//-------------------------------------------------------------------
+
+uint64_t FrameFingerprint::HashBlockPortable(const uint8_t *data, int stride,
+                                             int width_bytes, int rows) {
+  uint64_t accumulator[2] = {kInitialAccumulator0, kInitialAccumulator1};
+  uint64_t key[2] = {kInitialKey0, kInitialKey1};
+  const int body_bytes = width_bytes & ~15;
+  for (int y = 0; y < rows; y++) {
+    const uint8_t *row = data + y * stride;
+    for (int x = 0; x < body_bytes; x += 16) {
+      AccumulatePortable(row + x, accumulator, key);
+    }
+    if (body_bytes < width_bytes) {
+      // 端数は0で埋めて16バイトにする
+      uint8_t tail[16] = {0};
+      memcpy(tail, row + body_bytes, width_bytes - body_bytes);
+      AccumulatePortable(tail, accumulator, key);
+    }
+  }
+  return Finalize(accumulator[0], accumulator[1], width_bytes, rows);
+}
+
+uint64_t FrameFingerprint::HashBlock(const uint8_t *data, int stride,
+                                     int width_bytes, int rows) {
+#if defined(SCFF_FINGERPRINT_SSE2)
+  __m128i accumulator = Set64x2(kInitialAccumulator1, kInitialAccumulator0);
+  __m128i key = Set64x2(kInitialKey1, kInitialKey0);
+  const __m128i step = Set64x2(kKeyStep1, kKeyStep0);
+  const int body_bytes = width_bytes & ~15;
+  for (int y = 0; y < rows; y++) {
+    const uint8_t *row = data + y * stride;
+    int x = 0;
+    // 64バイト(キャッシュライン1本分)ずつ
+    for (; x + 64 <= body_bytes; x += 64) {
+      const __m128i *chunk = reinterpret_cast<const __m128i*>(row + x);
+      AccumulateSSE2(_mm_loadu_si128(chunk + 0), &accumulator, &key, step);
+      AccumulateSSE2(_mm_loadu_si128(chunk + 1), &accumulator, &key, step);
+      AccumulateSSE2(_mm_loadu_si128(chunk + 2), &accumulator, &key, step);
+      AccumulateSSE2(_mm_loadu_si128(chunk + 3), &accumulator, &key, step);
+    }
+    for (; x < body_bytes; x += 16) {
+      const __m128i *chunk = reinterpret_cast<const __m128i*>(row + x);
+      AccumulateSSE2(_mm_loadu_si128(chunk), &accumulator, &key, step);
+    }
+    if (body_bytes < width_bytes) {
+      // 端数は0で埋めて16バイトにする
+      uint8_t tail[16] = {0};
+      memcpy(tail, row + body_bytes, width_bytes - body_bytes);
+      AccumulateSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tail)),
+                     &accumulator, &key, step);
+    }
+  }
+  uint64_t lanes[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+  return Finalize(lanes[0], lanes[1], width_bytes, rows);
+#else
+  return HashBlockPortable(data, stride, width_bytes, rows);
+#endif
+}
+
+//-------------------------------------------------------------------
+
+void FrameFingerprint::Compute(const uint8_t *data, int stride,
+                               int width_bytes, int height) {
+  const int block_count = (height + kRowsPerBlock - 1) / kRowsPerBlock;
+  // 大きさが変わらない限り再確保は起きない
+  block_hashes_.resize(block_count);
+  for (int i = 0; i < block_count; i++) {
+    const int y = i * kRowsPerBlock;
+    const int rows = (height - y < kRowsPerBlock) ? height - y : kRowsPerBlock;
+    block_hashes_[i] = HashBlock(data + y * stride, stride, width_bytes, rows);
+  }
+  width_bytes_ = width_bytes;
+  height_ = height;
+}
+
+void FrameFingerprint::Clear() {
+  width_bytes_ = 0;
+  height_ = 0;
+  block_hashes_.clear();
+}
+
+bool FrameFingerprint::Equals(const FrameFingerprint &other) const {
+  if (!is_valid() || !other.is_valid() ||
+      width_bytes_ != other.width_bytes_ ||
+      height_ != other.height_) {
+    return false;
+  }
+  return block_hashes_ == other.block_hashes_;
+}
+
+bool FrameFingerprint::IsRangeChanged(const FrameFingerprint &other,
+                                      int y, int height) const {
+  if (!is_valid() || !other.is_valid() ||
+      width_bytes_ != other.width_bytes_ ||
+      height_ != other.height_) {
+    return true;
+  }
+  const int begin = std::max(y, 0);
+  const int end = std::min(y + height, height_);
+  if (begin >= end) {
+    return false;
+  }
+  for (int i = begin / kRowsPerBlock; i <= (end - 1) / kRowsPerBlock; i++) {
+    if (block_hashes_[i] != other.block_hashes_[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FrameFingerprint::Swap(FrameFingerprint *other) {
+  std::swap(width_bytes_, other->width_bytes_);
+  std::swap(height_, other->height_);
+  block_hashes_.swap(other->block_hashes_);
+}
+
+//-------------------------------------------------------------------
+
+bool FrameFingerprint::is_valid() const {
+  return height_ > 0;
+}
+
+int FrameFingerprint::block_count() const {
+  return static_cast<int>(block_hashes_.size());
+}
+
+uint64_t FrameFingerprint::block_hash(int index) const {
+  return block_hashes_[index];
+}
+}   // namespace scff_imaging
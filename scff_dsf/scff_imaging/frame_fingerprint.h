@@ -0,0 +1,92 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/frame_fingerprint.h
+/// scff_imaging::FrameFingerprintの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_FRAME_FINGERPRINT_H_
+#define SCFF_DSF_SCFF_IMAGING_FRAME_FINGERPRINT_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// イメージの内容が前回と同じかどうかを安く調べるための指紋
+/// - 1プレーンを縦kRowsPerBlock行ごとのブロックに分け、
+///   ブロックごとに64bitのハッシュを持つ
+/// - ハッシュはSSE2が使える場合は16バイト単位でまとめて計算する
+///   (結果はSSE2を使わない場合と完全に一致する)
+/// @attention ハッシュなので内容が違っても一致する可能性は0ではない
+///            (ブロックあたり約2^-64)
+class FrameFingerprint {
+ public:
+  /// 1ブロックあたりの行数
+  static const int kRowsPerBlock = 16;
+
+  /// コンストラクタ
+  FrameFingerprint();
+  /// デストラクタ
+  ~FrameFingerprint();
+
+  /// 指紋を計算する
+  /// @param data 先頭行の先頭
+  /// @param stride 1行あたりのバイト数
+  /// @param width_bytes 1行のうちハッシュに含めるバイト数
+  /// @param height 行数
+  void Compute(const uint8_t *data, int stride, int width_bytes, int height);
+  /// 指紋を無効にする(どの指紋とも一致しなくなる)
+  void Clear();
+
+  /// 同じ大きさのイメージから計算されていて、すべてのブロックが一致するか
+  bool Equals(const FrameFingerprint &other) const;
+  /// 行[y, y + height)を含むブロックのどれかがotherと一致しないか
+  /// - 大きさが違う場合や、どちらかが計算済みでない場合は常にtrue
+  bool IsRangeChanged(const FrameFingerprint &other, int y, int height) const;
+  /// 指紋の中身を交換する(メモリの再確保を避けるため)
+  void Swap(FrameFingerprint *other);
+
+  /// Getter: 指紋が計算済みか
+  bool is_valid() const;
+  /// Getter: ブロックの数
+  int block_count() const;
+  /// Getter: ブロックのハッシュ
+  uint64_t block_hash(int index) const;
+
+  /// rows行分のハッシュを計算する(SSE2が使えれば使う)
+  static uint64_t HashBlock(const uint8_t *data, int stride,
+                            int width_bytes, int rows);
+  /// rows行分のハッシュをSIMDを使わずに計算する(検証用)
+  static uint64_t HashBlockPortable(const uint8_t *data, int stride,
+                                    int width_bytes, int rows);
+
+ private:
+  /// 計算に使ったイメージの1行のバイト数
+  int width_bytes_;
+  /// 計算に使ったイメージの行数
+  int height_;
+  /// ブロックごとのハッシュ
+  std::vector<uint64_t> block_hashes_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(FrameFingerprint);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_FRAME_FINGERPRINT_H_
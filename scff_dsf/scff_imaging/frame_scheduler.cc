@@ -0,0 +1,238 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/frame_scheduler.cc
+/// scff_imaging::FrameSchedulerの定義
+
+#include "scff_imaging/frame_scheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#include "scff_imaging/clock.h"
+
+namespace {
+
+/// ヒストグラムの区間の上限(100nSec)
+/// 50us, 100us, 250us, 500us, 1ms, 2ms, 5ms, それ以上
+const int64_t kBucketUpperBounds[scff_imaging::WakeErrorStats::kBucketCount] = {
+  500LL,
+  1000LL,
+  2500LL,
+  5000LL,
+  10000LL,
+  20000LL,
+  50000LL,
+  std::numeric_limits<int64_t>::max()
+};
+
+/// スリープの前倒し量の初期値(2mSec)
+const int64_t kInitialSleepMargin = 20000LL;
+/// スピンのために最低限確保する前倒し量(200uSec)
+const int64_t kMinSleepMargin = 2000LL;
+/// 前倒し量の上限(20mSec)
+/// - 実際にはフレーム間隔の1/4も上限になる(FrameScheduler::GetMaxSleepMargin)
+const int64_t kMaxSleepMargin = 200000LL;
+/// 直近の最大の寝過ごし量が2番目のこの倍数を超えたら外れ値として除く
+const int64_t kOversleepOutlierRatio = 2LL;
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::FrameScheduler
+//=====================================================================
+
+FrameScheduler::FrameScheduler(Clock *clock)
+    : clock_(clock),
+      frame_interval_(-1.0),    // ありえない値
+      zero_(-1LL),              // ありえない値
+      frame_counter_(-1LL),     // ありえない値
+      sleep_margin_(kInitialSleepMargin),
+      oversleep_history_index_(0),
+      oversleep_history_count_(0) {
+  // 配列の初期化
+  for (int i = 0; i < kOversleepHistorySize; i++) {
+    oversleep_history_[i] = 0LL;
+  }
+  Reset(1.0);
+}
+
+FrameScheduler::~FrameScheduler() {
+  // nop
+}
+
+void FrameScheduler::Reset(double fps) {
+  frame_interval_ = static_cast<double>(kClockUnitsPerSecond) / fps;
+  zero_ = clock_->Now();
+  frame_counter_ = 0LL;
+  if (sleep_margin_ > GetMaxSleepMargin()) {
+    sleep_margin_ = GetMaxSleepMargin();
+  }
+
+  wake_error_stats_.count = 0LL;
+  wake_error_stats_.sum = 0LL;
+  wake_error_stats_.min = 0LL;
+  wake_error_stats_.max = 0LL;
+  for (int i = 0; i < WakeErrorStats::kBucketCount; i++) {
+    wake_error_stats_.buckets[i] = 0LL;
+  }
+  wake_error_stats_.late_frames = 0LL;
+  wake_error_stats_.skipped_frames = 0LL;
+}
+
+bool FrameScheduler::WaitNextFrame(int *skip_count) {
+  const int64_t now = clock_->Now();
+
+  // 想定フレームの締め切りを計算＋フレームカウンタ更新
+  ++frame_counter_;
+  int64_t deadline = GetFrameDeadline(frame_counter_);
+
+  // すでに現在時刻が次の想定フレームの中にある場合
+  //    = フレームスキップが絶対発生する
+  int skipped = 0;
+  if (deadline + static_cast<int64_t>(frame_interval_) < now) {
+    // 現在時刻がフレームの締め切りよりも前になるまでスキップ
+    do {
+      ++frame_counter_;
+      ++skipped;
+      deadline = GetFrameDeadline(frame_counter_);
+    } while (deadline < now);
+  }
+  wake_error_stats_.skipped_frames += skipped;
+  if (skip_count != nullptr) {
+    *skip_count = skipped;
+  }
+
+  if (deadline < now) {
+    // 待つべき時間がすでに過ぎてしまった
+    ++wake_error_stats_.late_frames;
+    return false;
+  }
+
+  WaitUntil(deadline);
+  return true;
+}
+
+int64_t FrameScheduler::WaitUntil(int64_t deadline) {
+  int64_t now = clock_->Now();
+
+  // 寝過ごし分だけ前倒ししてスリープ
+  const int64_t sleep_duration = deadline - now - sleep_margin_;
+  if (sleep_duration > 0LL) {
+    clock_->SleepFor(sleep_duration);
+    const int64_t woke = clock_->Now();
+    UpdateSleepMargin((woke - now) - sleep_duration);
+    now = woke;
+  }
+
+  // 残りはスピンで待つ
+  while (now < deadline) {
+    clock_->Relax();
+    now = clock_->Now();
+  }
+
+  const int64_t wake_error = now - deadline;
+  RecordWakeError(wake_error);
+  return wake_error;
+}
+
+const WakeErrorStats& FrameScheduler::wake_error_stats() const {
+  return wake_error_stats_;
+}
+
+int64_t FrameScheduler::sleep_margin() const {
+  return sleep_margin_;
+}
+
+int64_t FrameScheduler::GetBucketUpperBound(int index) {
+  if (index < 0 || index >= WakeErrorStats::kBucketCount) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return kBucketUpperBounds[index];
+}
+
+//-------------------------------------------------------------------
+
+int64_t FrameScheduler::GetMaxSleepMargin() const {
+  // フレーム間隔のほとんどをスピンで待つとコアを1つ使い切ってしまう
+  return std::min(kMaxSleepMargin,
+                  static_cast<int64_t>(frame_interval_ / 4.0));
+}
+
+int64_t FrameScheduler::GetFrameDeadline(int64_t frame_counter) const {
+  // 誤差が蓄積しないように毎回基準時刻から計算する
+  return zero_ + static_cast<int64_t>(frame_counter * frame_interval_);
+}
+
+void FrameScheduler::RecordWakeError(int64_t wake_error) {
+  if (wake_error_stats_.count == 0LL) {
+    wake_error_stats_.min = wake_error;
+    wake_error_stats_.max = wake_error;
+  } else {
+    if (wake_error < wake_error_stats_.min) wake_error_stats_.min = wake_error;
+    if (wake_error > wake_error_stats_.max) wake_error_stats_.max = wake_error;
+  }
+  ++wake_error_stats_.count;
+  wake_error_stats_.sum += wake_error;
+
+  for (int i = 0; i < WakeErrorStats::kBucketCount; i++) {
+    if (wake_error < kBucketUpperBounds[i]) {
+      ++wake_error_stats_.buckets[i];
+      break;
+    }
+  }
+}
+
+void FrameScheduler::UpdateSleepMargin(int64_t oversleep) {
+  oversleep_history_[oversleep_history_index_] = oversleep;
+  oversleep_history_index_ =
+      (oversleep_history_index_ + 1) % kOversleepHistorySize;
+  if (oversleep_history_count_ < kOversleepHistorySize) {
+    ++oversleep_history_count_;
+  }
+
+  // 寝過ごしはばらつくので直近の最大値を前倒し量にする
+  // ただしプリエンプションなどによる一度きりの大きな寝過ごし
+  // (2番目の値の2倍を超えるもの)は外れ値として除く
+  int64_t max_oversleep = 0LL;
+  int64_t second_oversleep = 0LL;
+  for (int i = 0; i < oversleep_history_count_; i++) {
+    if (oversleep_history_[i] > max_oversleep) {
+      second_oversleep = max_oversleep;
+      max_oversleep = oversleep_history_[i];
+    } else if (oversleep_history_[i] > second_oversleep) {
+      second_oversleep = oversleep_history_[i];
+    }
+  }
+  const int64_t high_oversleep =
+      max_oversleep > second_oversleep * kOversleepOutlierRatio ?
+          second_oversleep : max_oversleep;
+
+  // 減らすときは一気に減らさない
+  const int64_t target = high_oversleep + kMinSleepMargin;
+  if (target > sleep_margin_) {
+    sleep_margin_ = target;
+  } else {
+    sleep_margin_ -= (sleep_margin_ - target) / 64;
+  }
+  if (sleep_margin_ > GetMaxSleepMargin()) {
+    sleep_margin_ = GetMaxSleepMargin();
+  }
+}
+}   // namespace scff_imaging
@@ -0,0 +1,130 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/frame_scheduler.h
+/// scff_imaging::FrameSchedulerの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_FRAME_SCHEDULER_H_
+#define SCFF_DSF_SCFF_IMAGING_FRAME_SCHEDULER_H_
+
+#include <cstdint>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+class Clock;
+
+/// 起床誤差(締め切りから実際に起きた時刻までの遅れ)の統計
+struct WakeErrorStats {
+  /// ヒストグラムの区間の数
+  static const int kBucketCount = 8;
+
+  /// 計測回数
+  int64_t count;
+  /// 起床誤差の合計(100nSec)
+  int64_t sum;
+  /// 起床誤差の最小値(100nSec)
+  int64_t min;
+  /// 起床誤差の最大値(100nSec)
+  int64_t max;
+  /// 起床誤差のヒストグラム
+  /// @sa FrameScheduler::GetBucketUpperBound
+  int64_t buckets[kBucketCount];
+
+  /// 締め切りを過ぎてから待とうとしたフレームの数
+  int64_t late_frames;
+  /// スキップしたフレームの数
+  int64_t skipped_frames;
+};
+
+/// 絶対時刻の締め切りでフレームの生成間隔を管理する
+/// - 待機はスリープとスピンの組み合わせで行う
+///   (OSの寝過ごしを計測しておき、その分だけ早めに起きてスピンする)
+/// - スピンで待つのはフレーム間隔の1/4まで(タイマの分解能が粗い場合は
+///   起床誤差が大きくなるが、コアを1つ使い切ることはない)
+/// - 時計は差し替え可能(テスト時はFakeClockを使う)
+class FrameScheduler {
+ public:
+  /// コンストラクタ
+  explicit FrameScheduler(Clock *clock);
+  /// デストラクタ
+  ~FrameScheduler();
+
+  /// 現在時刻を基準時刻にしてフレームカウンタと統計をリセット
+  void Reset(double fps);
+
+  /// 現在のフレームの締め切りまで待ち、次のフレームに進む
+  /// @param[out] skip_count  スキップしたフレーム数(nullptr可)
+  /// @retval true  締め切りまで待った
+  /// @retval false すでに締め切りを過ぎていたので待たなかった
+  bool WaitNextFrame(int *skip_count);
+
+  /// 絶対時刻deadlineまで待つ
+  /// @return 起床誤差(100nSec, 遅れが正)
+  int64_t WaitUntil(int64_t deadline);
+
+  /// Getter: 起床誤差の統計
+  const WakeErrorStats& wake_error_stats() const;
+  /// Getter: 現在のスリープの前倒し量(100nSec)
+  int64_t sleep_margin() const;
+
+  /// ヒストグラムの区間の上限(100nSec, この値未満が区間に入る)
+  /// @attention 最後の区間の上限はINT64_MAX
+  static int64_t GetBucketUpperBound(int index);
+
+ private:
+  /// 寝過ごし量の履歴の数
+  static const int kOversleepHistorySize = 64;
+
+  /// スリープの前倒し量の上限(100nSec, フレーム間隔の1/4まで)
+  int64_t GetMaxSleepMargin() const;
+  /// n番目のフレームの締め切り
+  int64_t GetFrameDeadline(int64_t frame_counter) const;
+  /// 起床誤差を統計に追加
+  void RecordWakeError(int64_t wake_error);
+  /// 計測した寝過ごし量からスリープの前倒し量を更新
+  void UpdateSleepMargin(int64_t oversleep);
+
+  /// 時計
+  Clock *clock_;
+
+  /// フレーム間隔(100nSec)
+  double frame_interval_;
+  /// 基準時刻
+  int64_t zero_;
+  /// フレームカウンタ
+  int64_t frame_counter_;
+
+  /// スリープの前倒し量(この時間だけ早めに起きてスピンする)
+  int64_t sleep_margin_;
+  /// 直近の寝過ごし量
+  int64_t oversleep_history_[kOversleepHistorySize];
+  /// 次に寝過ごし量を書き込む位置
+  int oversleep_history_index_;
+  /// 記録済みの寝過ごし量の数
+  int oversleep_history_count_;
+
+  /// 起床誤差の統計
+  WakeErrorStats wake_error_stats_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(FrameScheduler);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_FRAME_SCHEDULER_H_
@@ -21,7 +21,7 @@
 #ifndef SCFF_DSF_SCFF_IMAGING_IMAGE_H_
 #define SCFF_DSF_SCFF_IMAGING_IMAGE_H_
 
-#include <Windows.h>
+#include "scff_imaging/platform.h"
 extern "C" {
 #include <libavcodec/avcodec.h>
 }
@@ -25,5 +25,6 @@
 #include "scff_imaging/engine.h"
 #include "scff_imaging/request.h"
 #include "scff_imaging/imaging_types.h"
+#include "scff_imaging/worker_pool.h"
 
 #endif  // SCFF_DSF_SCFF_IMAGING_IMAGING_H_
@@ -24,9 +24,10 @@
 extern "C" {
 #include <libswscale/swscale.h>
 }
-#include <Windows.h>
 #include <cstdint>
 
+#include "scff_imaging/platform.h"
+
 namespace scff_imaging {
 
 //=====================================================================
@@ -72,6 +73,11 @@ enum class ErrorCodes {
   /// WindowsDDBイメージのメモリ確保に失敗した
   kWindowsDDBImageOutOfMemoryError = 1008,
 
+  /// AVPictureイメージにレンダーターゲットを関連付けられなかった
+  kAVPictureImageInvalidRenderTargetError = 1009,
+  /// AVPictureイメージを親イメージの一部に関連付けられなかった
+  kAVPictureImageInvalidViewError = 1010,
+
   //-------------------------------------------------------------------
   // Processor
   //-------------------------------------------------------------------
@@ -91,6 +97,9 @@ enum class ErrorCodes {
   /// ScreenCapture時、画面の色深度が32bitではなかった
   kScreenCaptureNot32bitColorError= 2005,
 
+  /// Rotate時、出力イメージのサイズが回転後のサイズではなかった
+  kRotateInvalidSizeError = 2006,
+
   //-------------------------------------------------------------------
   // Layout
   //-------------------------------------------------------------------
@@ -112,6 +121,7 @@ enum class ImagePixelFormats {
   kUYVY,                      ///< UYVY(16bit)
   kYUY2,                      ///< YUY2(16bit)
   kRGB0,                      ///< RGB0(32bit)
+  kNV12,                      ///< NV12(12bit)
   kSupportedPixelFormatsCount ///< 対応ピクセルフォーマット数
 };
 
@@ -143,6 +153,35 @@ enum class RotateDirections {
   kDegrees270     ///< 時計回り270度
 };
 
+//---------------------------------------------------------------------
+
+/// Engineの描画方法を表す定数
+enum class RenderingModes {
+  /// キャプチャスレッドでバッファに描画し、サンプルにはコピーする
+  kBuffered = 0,
+  /// サンプルを要求したスレッドでサンプルのバッファに直接描画する
+  kDirect
+};
+
+/// Engineのキャプチャと変換の実行方法を表す定数
+enum class PipelineModes {
+  /// キャプチャと変換を同じスレッドで続けて行う
+  kSerial = 0,
+  /// キャプチャ専用スレッドと変換を並行して行う
+  /// @attention スループットは上がるが、キャプチャが変換待ちになる分だけ
+  ///            遅延が増える(最大で約1フレーム)
+  kPipelined
+};
+
+/// Engineの拡大縮小の品質の決め方を表す定数
+enum class ScaleQualityModes {
+  /// 常にレイアウトパラメータどおりの拡大縮小メソッドを使う
+  kFixed = 0,
+  /// フレームの処理が間に合わない状態が続いたら軽いメソッドに切り替え、
+  /// 余裕が戻ったら元のメソッドに戻す
+  kAdaptive
+};
+
 //=====================================================================
 // タイプ
 //=====================================================================
@@ -229,6 +268,10 @@ struct LayoutParameter {
   bool keep_aspect_ratio;
   /// 回転方向
   RotateDirections rotate_direction;
+  /// 不透明度(0:完全に透明 - 255:不透明)
+  /// - 255未満の場合は下の要素や背景と合成される
+  /// @warning NullLayout,NativeLayoutでは無視される
+  int opacity;
 };
 }   // namespace scff_imaging
 
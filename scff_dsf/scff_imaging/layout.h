@@ -21,6 +21,8 @@
 #ifndef SCFF_DSF_SCFF_IMAGING_LAYOUT_H_
 #define SCFF_DSF_SCFF_IMAGING_LAYOUT_H_
 
+#include <cstdint>
+
 #include "scff_imaging/processor.h"
 #include "scff_imaging/avpicture_image.h"
 
@@ -29,6 +31,77 @@ namespace scff_imaging {
 /// レイアウト: 入力がない特殊なプロセッサ
 typedef Processor<void, AVPictureImage> Layout;
 
+/// 入力が変化していなかったために拡大縮小を省略した回数の統計
+struct UnchangedFrameStats {
+  /// 拡大縮小を省略した回数
+  int64_t hits;
+  /// 拡大縮小を行った回数
+  int64_t misses;
+  /// 拡大縮小を行ったうち、変化した部分だけで済ませた回数
+  int64_t partial_misses;
+};
+
+/// キャプチャと変換を別々のスレッドで実行できるレイアウト
+/// - キャプチャ結果はスロットごとに保持する
+/// - RunCaptureとRunConvertはそれぞれ1スレッドからであれば並行して呼び出せる
+/// - RunCapture/RunConvertは発生したエラーを返すだけで
+///   GetCurrentError()の値は変更しない(呼び出し側で管理すること)
+class StagedLayout : public Layout {
+ public:
+  /// スロットの最大数
+  static const int kMaxSlotCount = 3;
+
+  /// コンストラクタ
+  /// @param slot_count キャプチャ結果を保持するスロットの数
+  explicit StagedLayout(int slot_count)
+      : Layout(),
+        slot_count_(slot_count),
+        persistent_output_(false) {
+    ASSERT(1 <= slot_count && slot_count <= kMaxSlotCount);
+  }
+  /// 仮想デストラクタ
+  virtual ~StagedLayout() {
+    // nop
+  }
+
+  /// スロットにスクリーンキャプチャを行う
+  virtual ErrorCodes RunCapture(int slot) = 0;
+  /// スロットのキャプチャ結果を変換して出力イメージに描画する
+  virtual ErrorCodes RunConvert(int slot) = 0;
+
+  /// Getter: 拡大縮小の品質段階の数(切り替えられなければ1)
+  virtual int scale_quality_level_count() const = 0;
+  /// 拡大縮小の品質段階を切り替える(0が設定どおりの品質)
+  /// @attention Run/RunConvertを呼び出すスレッドからその合間に呼び出すこと
+  virtual void SetScaleQualityLevel(int level) = 0;
+
+  /// Getter: レイアウト内のすべてのScaleの省略回数の合計
+  /// @attention Run/RunConvertを呼び出すスレッドからその合間に呼び出すこと
+  virtual UnchangedFrameStats GetUnchangedFrameStats() const = 0;
+
+  /// Getter: スロットの数
+  int slot_count() const {
+    return slot_count_;
+  }
+
+  /// Setter: 出力イメージのバッファが次の描画まで内容を保持しているか
+  /// - trueなら変化しない部分(背景など)の描画をバッファごとに一度で済ませてよい
+  /// @attention Initの前に呼び出すこと
+  void set_persistent_output(bool persistent_output) {
+    persistent_output_ = persistent_output;
+  }
+  /// Getter: 出力イメージのバッファが次の描画まで内容を保持しているか
+  bool persistent_output() const {
+    return persistent_output_;
+  }
+
+ private:
+  /// スロットの数
+  const int slot_count_;
+  /// 出力イメージのバッファが次の描画まで内容を保持しているか
+  bool persistent_output_;
+};
+
 }   // namespace scff_imaging
 
 #endif  // SCFF_DSF_SCFF_IMAGING_LAYOUT_H_
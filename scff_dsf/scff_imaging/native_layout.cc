@@ -20,11 +20,18 @@
 
 #include "scff_imaging/native_layout.h"
 
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
 #include "scff_imaging/debug.h"
 #include "scff_imaging/utilities.h"
 #include "scff_imaging/screen_capture.h"
+#include "scff_imaging/rotate.h"
 #include "scff_imaging/scale.h"
 #include "scff_imaging/padding.h"
+#include "scff_imaging/background_region.h"
+#include "scff_imaging/trace.h"
 
 namespace scff_imaging {
 
@@ -33,18 +40,31 @@ namespace scff_imaging {
 //=====================================================================
 
 NativeLayout::NativeLayout(
-    const LayoutParameter &parameter)
-    : Layout(),
+    const LayoutParameter &parameter,
+    WorkerPool *worker_pool,
+    ScalerCache *scaler_cache,
+    int slot_count,
+    bool enable_scale_quality_levels)
+    : StagedLayout(slot_count),
       parameter_(parameter),
+      enable_scale_quality_levels_(enable_scale_quality_levels),
+      worker_pool_(worker_pool),
+      scaler_cache_(scaler_cache),
       screen_capture_(nullptr),
+      rotate_(nullptr),
       scale_(nullptr),
-      padding_(nullptr) {
+      padding_(nullptr),
+      scale_in_place_(false),
+      padding_left_(0),
+      padding_top_(0) {
   DbgLog((kLogMemory, kTrace,
-          TEXT("NativeLayout: NEW(%dx%d)"),
+          TEXT("NativeLayout: NEW(%dx%d, %d)"),
           parameter_.clipping_width,
-          parameter_.clipping_height));
+          parameter_.clipping_height,
+          slot_count));
   // 明示的に初期化していない
-  // captured_image_
+  // captured_image_[kMaxSlotCount]
+  // rotated_image_
   // converted_image_
 }
 
@@ -56,6 +76,9 @@ NativeLayout::~NativeLayout() {
   if (screen_capture_ != nullptr) {
     delete screen_capture_;
   }
+  if (rotate_ != nullptr) {
+    delete rotate_;
+  }
   if (scale_ != nullptr) {
     delete scale_;
   }
@@ -75,6 +98,13 @@ ErrorCodes NativeLayout::Init() {
   // あらかじめイメージのサイズを計算しておく
   const int captured_width = parameter_.clipping_width;
   const int captured_height = parameter_.clipping_height;
+  const bool rotate =
+      parameter_.rotate_direction != RotateDirections::kNoRotate;
+  int rotated_width = captured_width;
+  int rotated_height = captured_height;
+  utilities::GetRotatedSize(parameter_.rotate_direction,
+                            captured_width, captured_height,
+                            &rotated_width, &rotated_height);
   int converted_width = GetOutputImage()->width();
   int converted_height = GetOutputImage()->height();
   int padding_top = 0;
@@ -87,8 +117,8 @@ ErrorCodes NativeLayout::Init() {
     utilities::CalculatePaddingSize(
         GetOutputImage()->width(),
         GetOutputImage()->height(),
-        captured_width,
-        captured_height,
+        rotated_width,
+        rotated_height,
         parameter_.stretch,
         parameter_.keep_aspect_ratio,
         &padding_top, &padding_bottom,
@@ -97,6 +127,28 @@ ErrorCodes NativeLayout::Init() {
     // パディング分だけサイズを小さくする
     converted_width -= padding_left + padding_right;
     converted_height -= padding_top + padding_bottom;
+
+    // 拡大縮小で書き換えるバイトがパディングの内側に収まるなら、
+    // 中間のイメージを使わず出力イメージに直接書き込む
+    // (色差の間引き単位にそろっていなければ枠との境界の色差が食い違う)
+    const AVPixFmtDescriptor *descriptor =
+        av_pix_fmt_desc_get(GetOutputImage()->av_pixel_format());
+    ImageRect converted_rect = {
+      padding_left, padding_top, converted_width, converted_height
+    };
+    ImageRect covered;
+    scale_in_place_ =
+        GetCoveredRect(converted_rect,
+                       GetOutputImage()->width(),
+                       GetOutputImage()->height(),
+                       1 << descriptor->log2_chroma_w,
+                       1 << descriptor->log2_chroma_h,
+                       &covered) &&
+        covered.x == converted_rect.x && covered.y == converted_rect.y &&
+        covered.width == converted_rect.width &&
+        covered.height == converted_rect.height;
+    padding_left_ = padding_left;
+    padding_top_ = padding_top;
   }
 
   //-------------------------------------------------------------------
@@ -105,17 +157,33 @@ ErrorCodes NativeLayout::Init() {
   // Image
   //-------------------------------------------------------------------
   // GetDIBits用
-  const ErrorCodes error_captured_image =
-      captured_image_.Create(ImagePixelFormats::kRGB0,
-                             captured_width,
-                             captured_height);
-  if (error_captured_image != ErrorCodes::kNoError) {
-    return ErrorOccured(error_captured_image);
+  for (int slot = 0; slot < slot_count(); slot++) {
+    const ErrorCodes error_captured_image =
+        captured_image_[slot].Create(ImagePixelFormats::kRGB0,
+                                     captured_width,
+                                     captured_height);
+    if (error_captured_image != ErrorCodes::kNoError) {
+      return ErrorOccured(error_captured_image);
+    }
+  }
+
+  // 回転後
+  if (rotate) {
+    const ErrorCodes error_rotated_image =
+        rotated_image_.Create(ImagePixelFormats::kRGB0,
+                              rotated_width,
+                              rotated_height);
+    if (error_rotated_image != ErrorCodes::kNoError) {
+      return ErrorOccured(error_rotated_image);
+    }
   }
 
   // 変換後パディング用
   if (utilities::CanUseDrawUtils(GetOutputImage()->pixel_format())) {
-    const ErrorCodes error_converted_image =
+    const ErrorCodes error_converted_image = scale_in_place_ ?
+        converted_image_.CreateForView(GetOutputImage()->pixel_format(),
+                                       converted_width,
+                                       converted_height) :
         converted_image_.Create(GetOutputImage()->pixel_format(),
                                 converted_width,
                                 converted_height);
@@ -133,7 +201,7 @@ ErrorCodes NativeLayout::Init() {
   ScreenCapture *screen_capture = new ScreenCapture(
       !utilities::IsTopdownPixelFormat(GetOutputImage()->pixel_format()),
       1, parameter_array);
-  screen_capture->SetOutputImage(&captured_image_);
+  screen_capture->SetOutputImage(&(captured_image_[0]));
   const ErrorCodes error_screen_capture = screen_capture->Init();
   if (error_screen_capture != ErrorCodes::kNoError) {
     delete screen_capture;
@@ -141,12 +209,36 @@ ErrorCodes NativeLayout::Init() {
   }
   screen_capture_ = screen_capture;
 
+  // 回転
+  // キャプチャ結果はメモリ上で上下反転している場合がある
+  if (rotate) {
+    Rotate *rotate_processor = new Rotate(
+        parameter_.rotate_direction,
+        !utilities::IsTopdownPixelFormat(GetOutputImage()->pixel_format()));
+    rotate_processor->SetInputImage(&(captured_image_[0]));
+    rotate_processor->SetOutputImage(&rotated_image_);
+    const ErrorCodes error_rotate_init = rotate_processor->Init();
+    if (error_rotate_init != ErrorCodes::kNoError) {
+      delete rotate_processor;
+      return ErrorOccured(error_rotate_init);
+    }
+    rotate_ = rotate_processor;
+  }
+
   // 拡大縮小ピクセルフォーマット変換
-  Scale *scale = new Scale(parameter_.swscale_config);
-  scale->SetInputImage(&captured_image_);
+  // 大きな画像一枚の変換になるのでストライプに分割して並列処理する
+  Scale *scale = new Scale(parameter_.swscale_config, worker_pool_,
+                           scaler_cache_, enable_scale_quality_levels_);
+  scale->SetInputImage(rotate ? &rotated_image_ : &(captured_image_[0]));
   if (utilities::CanUseDrawUtils(GetOutputImage()->pixel_format())) {
-    // パディング可能ならバッファをはさむ
+    // パディング可能ならバッファ(または出力イメージの中央のビュー)をはさむ
+    // バッファは他から書き換えられないので入力が変化しなければ使いまわせる
+    // ビューの場合も枠とは重ならないが、出力イメージのバッファが
+    // 内容を保持しなければ前回の結果が残っていないので毎回全体を書き込む
+    const bool reuse_output = !scale_in_place_ || persistent_output();
     scale->SetOutputImage(&converted_image_);
+    scale->SetSkipUnchangedInput(reuse_output);
+    scale->SetIncrementalUpdate(reuse_output);
   } else {
     scale->SetOutputImage(GetOutputImage());
   }
@@ -163,6 +255,8 @@ ErrorCodes NativeLayout::Init() {
         new Padding(padding_left, padding_right, padding_top, padding_bottom);
     padding->SetInputImage(&converted_image_);
     padding->SetOutputImage(GetOutputImage());
+    // バッファが内容を保持するなら枠はバッファごとに一度だけ描画する
+    padding->set_persistent_output(persistent_output());
     const ErrorCodes error_padding_init = padding->Init();
     if (error_padding_init != ErrorCodes::kNoError) {
       delete padding;
@@ -176,39 +270,115 @@ ErrorCodes NativeLayout::Init() {
 }
 
 ErrorCodes NativeLayout::Run() {
+  SCFF_TRACE_SCOPE("NativeLayout::Run");
+  if (GetCurrentError() != ErrorCodes::kNoError) {
+    // 何かエラーが発生している場合は何もしない
+    return GetCurrentError();
+  }
+
+  // 同じスレッドでキャプチャと変換を続けて行う
+  const ErrorCodes error_capture = RunCapture(0);
+  if (error_capture != ErrorCodes::kNoError) {
+    return ErrorOccured(error_capture);
+  }
+  const ErrorCodes error_convert = RunConvert(0);
+  if (error_convert != ErrorCodes::kNoError) {
+    return ErrorOccured(error_convert);
+  }
+
+  // エラー発生なし
+  return GetCurrentError();
+}
+
+ErrorCodes NativeLayout::RunCapture(int slot) {
+  SCFF_TRACE_SCOPE("NativeLayout::RunCapture");
+  ASSERT(0 <= slot && slot < slot_count());
+  if (GetCurrentError() != ErrorCodes::kNoError) {
+    // 何かエラーが発生している場合は何もしない
+    return GetCurrentError();
+  }
+
+  // スクリーンキャプチャ
+  screen_capture_->SwapOutputImage(&(captured_image_[slot]));
+  return screen_capture_->Run();
+}
+
+ErrorCodes NativeLayout::RunConvert(int slot) {
+  SCFF_TRACE_SCOPE("NativeLayout::RunConvert");
+  ASSERT(0 <= slot && slot < slot_count());
   if (GetCurrentError() != ErrorCodes::kNoError) {
     // 何かエラーが発生している場合は何もしない
     return GetCurrentError();
   }
 
-  // OutputImageを設定しなおす
+  // InputImage/OutputImageを設定しなおす
+  if (rotate_ != nullptr) {
+    rotate_->SwapInputImage(&(captured_image_[slot]));
+  } else {
+    scale_->SwapInputImage(&(captured_image_[slot]));
+  }
   if (utilities::CanUseDrawUtils(GetOutputImage()->pixel_format())) {
     padding_->SwapOutputImage(GetOutputImage());
+    if (scale_in_place_) {
+      // 今回の出力イメージの中央に直接拡大縮小する
+      const ErrorCodes error_view =
+          converted_image_.AttachView(*GetOutputImage(),
+                                      padding_left_, padding_top_);
+      if (error_view != ErrorCodes::kNoError) {
+        return error_view;
+      }
+    }
   } else {
     scale_->SwapOutputImage(GetOutputImage());
   }
 
-  // スクリーンキャプチャ
-  const ErrorCodes error_screen_capture = screen_capture_->Run();
-  if (error_screen_capture != ErrorCodes::kNoError) {
-    return ErrorOccured(error_screen_capture);
+  // Rotateを利用して回転
+  if (rotate_ != nullptr) {
+    const ErrorCodes error_rotate = rotate_->Run();
+    if (error_rotate != ErrorCodes::kNoError) {
+      return error_rotate;
+    }
   }
 
   // Scaleを利用して変換
   const ErrorCodes error_scale = scale_->Run();
   if (error_scale != ErrorCodes::kNoError) {
-    return ErrorOccured(error_scale);
+    return error_scale;
   }
 
   // Paddingを利用してパディングを行う
   if (utilities::CanUseDrawUtils(GetOutputImage()->pixel_format())) {
     const ErrorCodes error_padding = padding_->Run();
     if (error_padding != ErrorCodes::kNoError) {
-      return ErrorOccured(error_padding);
+      return error_padding;
     }
   }
 
   // エラー発生なし
-  return GetCurrentError();
+  return ErrorCodes::kNoError;
+}
+
+int NativeLayout::scale_quality_level_count() const {
+  if (scale_ == nullptr) {
+    return 1;
+  }
+  return scale_->quality_level_count();
+}
+
+void NativeLayout::SetScaleQualityLevel(int level) {
+  if (scale_ == nullptr) {
+    return;
+  }
+  scale_->SetQualityLevel(level);
+}
+
+UnchangedFrameStats NativeLayout::GetUnchangedFrameStats() const {
+  UnchangedFrameStats stats = {0LL, 0LL, 0LL};
+  if (scale_ != nullptr) {
+    stats.hits = scale_->skipped_count();
+    stats.misses = scale_->scaled_count();
+    stats.partial_misses = scale_->partially_scaled_count();
+  }
+  return stats;
 }
 }   // namespace scff_imaging
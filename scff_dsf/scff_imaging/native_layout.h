@@ -28,14 +28,23 @@
 namespace scff_imaging {
 
 class ScreenCapture;
+class Rotate;
 class Scale;
 class Padding;
+class WorkerPool;
+class ScalerCache;
 
 /// スクリーンキャプチャ出力一つだけを処理するレイアウトプロセッサ
-class NativeLayout : public Layout {
+class NativeLayout : public StagedLayout {
  public:
   /// コンストラクタ
-  explicit NativeLayout(const LayoutParameter &parameter);
+  /// @param worker_pool 拡大縮小を並列実行するプール(nullptrなら逐次実行)
+  /// @param scaler_cache SwsContextを借りるキャッシュ(nullptrなら毎回作成)
+  /// @param slot_count キャプチャ結果を保持するスロットの数
+  /// @param enable_scale_quality_levels 拡大縮小の品質段階を切り替え可能にする
+  NativeLayout(const LayoutParameter &parameter, WorkerPool *worker_pool,
+               ScalerCache *scaler_cache, int slot_count,
+      bool enable_scale_quality_levels);
   /// デストラクタ
   ~NativeLayout();
 
@@ -45,6 +54,17 @@ class NativeLayout : public Layout {
   /// @copydoc Processor::Run
   ErrorCodes Run();
   //-------------------------------------------------------------------
+  /// @copydoc StagedLayout::RunCapture
+  ErrorCodes RunCapture(int slot);
+  /// @copydoc StagedLayout::RunConvert
+  ErrorCodes RunConvert(int slot);
+  /// @copydoc StagedLayout::scale_quality_level_count
+  int scale_quality_level_count() const;
+  /// @copydoc StagedLayout::SetScaleQualityLevel
+  void SetScaleQualityLevel(int level);
+  /// @copydoc StagedLayout::GetUnchangedFrameStats
+  UnchangedFrameStats GetUnchangedFrameStats() const;
+  //-------------------------------------------------------------------
 
  private:
   //-------------------------------------------------------------------
@@ -52,6 +72,8 @@ class NativeLayout : public Layout {
   //-------------------------------------------------------------------
   /// スクリーンキャプチャ
   ScreenCapture *screen_capture_;
+  /// 回転(回転しない場合はnullptr)
+  Rotate *rotate_;
   /// 拡大縮小ピクセルフォーマット変換
   Scale *scale_;
   /// パディング
@@ -59,14 +81,31 @@ class NativeLayout : public Layout {
   //-------------------------------------------------------------------
   // Image
   //-------------------------------------------------------------------
-  /// ScreenCaptureから取得した変換処理前のイメージ
-  AVPictureWithFillImage captured_image_;
+  /// ScreenCaptureから取得した変換処理前のイメージ(スロットごと)
+  AVPictureWithFillImage captured_image_[kMaxSlotCount];
+  /// Rotateで回転した後のイメージ(回転しない場合は空)
+  AVPictureWithFillImage rotated_image_;
   /// SWScaleで拡大縮小ピクセルフォーマット変換を行った後のイメージ
+  /// (直接拡大縮小する場合は出力イメージの中央を指すビュー)
   AVPictureImage converted_image_;
   //-------------------------------------------------------------------
 
+  /// パディングの内側に直接拡大縮小するか
+  bool scale_in_place_;
+  /// パディング(left)
+  int padding_left_;
+  /// パディング(top)
+  int padding_top_;
+
+  /// 拡大縮小を並列実行するプール(所有しない)
+  WorkerPool *worker_pool_;
+  /// SwsContextを借りるキャッシュ(所有しない)
+  ScalerCache *scaler_cache_;
+
   /// レイアウトパラメータ
   const LayoutParameter parameter_;
+  /// 拡大縮小の品質段階を切り替えられるようにするか
+  const bool enable_scale_quality_levels_;
 
   // コピー＆代入禁止
   DISALLOW_COPY_AND_ASSIGN(NativeLayout);
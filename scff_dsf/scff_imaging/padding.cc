@@ -20,7 +20,12 @@
 
 #include "scff_imaging/padding.h"
 
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
 #include "scff_imaging/avpicture_image.h"
+#include "scff_imaging/trace.h"
 
 namespace scff_imaging {
 
@@ -33,10 +38,12 @@ Padding::Padding(int padding_left, int padding_right,
     : padding_left_(padding_left),        // ありえない値
       padding_right_(padding_right),      // ありえない値
       padding_top_(padding_top),          // ありえない値
-      padding_bottom_(padding_bottom) {   // ありえない値
+      padding_bottom_(padding_bottom),    // ありえない値
+      persistent_output_(false) {
   // 明示的に初期化していない
   // draw_context_
   // padding_color_
+  // border_region_
 }
 
 Padding::~Padding() {
@@ -47,6 +54,10 @@ Padding::~Padding() {
 
 ErrorCodes Padding::Init() {
   ASSERT(GetInputImage()->pixel_format() == GetOutputImage()->pixel_format());
+  ASSERT(padding_left_ + GetInputImage()->width() + padding_right_ ==
+         GetOutputImage()->width());
+  ASSERT(padding_top_ + GetInputImage()->height() + padding_bottom_ ==
+         GetOutputImage()->height());
 
   // パディング用のコンテキストの初期化
   const int error_init =
@@ -61,58 +72,63 @@ ErrorCodes Padding::Init() {
                 &padding_color_,
                 rgba_padding_color);
 
+  // 枠の領域を求める
+  // 色差の間引き単位にそろえるので、境界の色差は常に中央の画像側で上書きされる
+  ImageRect center_rect = {
+    padding_left_,
+    padding_top_,
+    GetInputImage()->width(),
+    GetInputImage()->height()
+  };
+  border_region_.Build(GetOutputImage()->width(),
+                       GetOutputImage()->height(),
+                       1 << draw_context_.hsub_max,
+                       1 << draw_context_.vsub_max,
+                       1, &center_rect);
+
   return InitDone();
 }
 
+void Padding::set_persistent_output(bool persistent_output) {
+  persistent_output_ = persistent_output;
+  border_region_.ResetFilled();
+}
+
 ErrorCodes Padding::Run() {
-  // 左の枠を書く
-  ff_fill_rectangle(&draw_context_, &padding_color_,
-                    GetOutputImage()->avpicture()->data,
-                    GetOutputImage()->avpicture()->linesize,
-                    0,
-                    padding_top_,
-                    padding_left_,
-                    GetInputImage()->height());
-
-  // 右の枠を書く
-  ff_fill_rectangle(&draw_context_, &padding_color_,
-                    GetOutputImage()->avpicture()->data,
-                    GetOutputImage()->avpicture()->linesize,
-                    padding_left_ + GetInputImage()->width(),
-                    padding_top_,
-                    padding_right_,
-                    GetInputImage()->height());
-
-  // 上の枠を書く
-  ff_fill_rectangle(&draw_context_, &padding_color_,
-                    GetOutputImage()->avpicture()->data,
-                    GetOutputImage()->avpicture()->linesize,
-                    0,
-                    0,
-                    GetOutputImage()->width(),
-                    padding_top_);
+  SCFF_TRACE_SCOPE("Padding::Run");
+  AVPicture *output = GetOutputImage()->avpicture();
+
+  // 枠を書く
+  // バッファが内容を保持する場合(kBuffered)はバッファごとに最初の一度だけでよい
+  // kDirectのサンプルのバッファは下流で書き換えられることがあるので毎回書く
+  if (!persistent_output_ || border_region_.MarkFilled(output->data[0])) {
+    for (int i = 0; i < border_region_.rect_count(); i++) {
+      const ImageRect &rect = border_region_.rect(i);
+      ff_fill_rectangle(&draw_context_, &padding_color_,
+                        output->data, output->linesize,
+                        rect.x, rect.y, rect.width, rect.height);
+    }
+  }
 
   // 中央に画像を配置する
-  ff_copy_rectangle2(&draw_context_,
-                     GetOutputImage()->avpicture()->data,
-                     GetOutputImage()->avpicture()->linesize,
-                     GetInputImage()->avpicture()->data,
-                     GetInputImage()->avpicture()->linesize,
-                     padding_left_,
-                     padding_top_,
-                     0,
-                     0,
-                     GetInputImage()->width(),
-                     GetInputImage()->height());
-
-  // 下の枠を書く
-  ff_fill_rectangle(&draw_context_, &padding_color_,
-                    GetOutputImage()->avpicture()->data,
-                    GetOutputImage()->avpicture()->linesize,
-                    0,
-                    padding_top_ + GetInputImage()->height(),
-                    GetOutputImage()->width(),
-                    padding_bottom_);
+  // 入力が出力イメージの中央を指すビューなら配置済み
+  const uint8_t *center =
+      output->data[0] + padding_top_ * output->linesize[0] +
+      av_image_get_linesize(GetOutputImage()->av_pixel_format(),
+                            padding_left_, 0);
+  if (GetInputImage()->avpicture()->data[0] != center) {
+    ff_copy_rectangle2(&draw_context_,
+                       GetOutputImage()->avpicture()->data,
+                       GetOutputImage()->avpicture()->linesize,
+                       GetInputImage()->avpicture()->data,
+                       GetInputImage()->avpicture()->linesize,
+                       padding_left_,
+                       padding_top_,
+                       0,
+                       0,
+                       GetInputImage()->width(),
+                       GetInputImage()->height());
+  }
 
   return GetCurrentError();
 }
@@ -25,10 +25,14 @@
 
 #include "scff_imaging/common.h"
 #include "scff_imaging/processor.h"
+#include "scff_imaging/background_region.h"
 
 namespace scff_imaging {
 
 /// drawutilsを利用してパディングを行う
+/// - 入力が出力イメージの中央を指すビューなら枠だけを描画する
+/// - 出力イメージのバッファが内容を保持する場合は、
+///   枠はバッファごとに一度だけ描画する
 class Padding : public Processor<AVPictureImage, AVPictureImage> {
  public:
   /// コンストラクタ
@@ -44,11 +48,18 @@ class Padding : public Processor<AVPictureImage, AVPictureImage> {
   ErrorCodes Run();
   //-------------------------------------------------------------------
 
+  /// Setter: 出力イメージのバッファが次の描画まで内容を保持しているか
+  /// - trueなら枠の描画をバッファごとに一度で済ませる
+  /// @attention 出力イメージの枠を他から書き換えない場合のみtrueにすること
+  void set_persistent_output(bool persistent_output);
+
  private:
   /// 描画用コンテキスト
   FFDrawContext draw_context_;
   /// 枠描画用カラー
   FFDrawColor padding_color_;
+  /// 枠の領域(中央の画像に覆われない部分)
+  BackgroundRegion border_region_;
 
   /// パディング(left)
   const int padding_left_;
@@ -58,6 +69,8 @@ class Padding : public Processor<AVPictureImage, AVPictureImage> {
   const int padding_top_;
   /// パディング(bottom)
   const int padding_bottom_;
+  /// 出力イメージのバッファが次の描画まで内容を保持しているか
+  bool persistent_output_;
 
   // コピー＆代入禁止
   DISALLOW_COPY_AND_ASSIGN(Padding);
@@ -0,0 +1,116 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/platform.cc
+/// scff_imagingのプラットフォーム依存部分の定義
+
+#include "scff_imaging/platform.h"
+
+#if defined(SCFF_IMAGING_HEADLESS)
+#include <cstdarg>
+#include <cstdio>
+#include <cwchar>
+#include <functional>
+#include <thread>
+#endif
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::platform
+//=====================================================================
+namespace platform {
+
+uint32_t GetCurrentThreadKey() {
+#if defined(SCFF_IMAGING_HEADLESS)
+  const uint32_t key = static_cast<uint32_t>(
+      std::hash<std::thread::id>()(std::this_thread::get_id()));
+  return key != 0 ? key : 1;
+#else
+  return static_cast<uint32_t>(::GetCurrentThreadId());
+#endif
+}
+}   // namespace platform
+}   // namespace scff_imaging
+
+#if defined(SCFF_IMAGING_HEADLESS)
+
+//=====================================================================
+// デバッグ用定数(値はbase/debug.ccに合わせる)
+//=====================================================================
+
+const int kLogError     = 0x01;
+
+const int kErrorFatal   = 1;
+const int kError        = 2;
+const int kErrorWarn    = 3;
+
+const int kErrorCurrentLevel = kErrorWarn;
+
+//---------------------------------------------------------------------
+
+const int kLogLocking   = 0x02;
+const int kLogMemory    = 0x04;
+const int kLogTiming    = 0x08;
+const int kLogTrace     = 0x10;
+
+const int kTraceInfo    = 1;
+const int kTraceDebug   = 2;
+const int kTrace        = 3;
+
+const int kTraceCurrentLevel = kTraceInfo;
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::platform (ヘッドレスビルドのみ)
+//=====================================================================
+namespace platform {
+
+void DebugLog(int type, int level, const char *format, ...) {
+  const int current_level =
+      type == kLogError ? kErrorCurrentLevel : kTraceCurrentLevel;
+  if (level > current_level) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+#if defined(_WIN32)
+void DebugLog(int type, int level, const wchar_t *format, ...) {
+  const int current_level =
+      type == kLogError ? kErrorCurrentLevel : kTraceCurrentLevel;
+  if (level > current_level) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, format);
+  vfwprintf(stderr, format, args);
+  va_end(args);
+  fputwc(L'\n', stderr);
+}
+#endif
+}   // namespace platform
+}   // namespace scff_imaging
+
+#endif  // defined(SCFF_IMAGING_HEADLESS)
@@ -0,0 +1,133 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/platform.h
+/// scff_imagingのプラットフォーム依存部分の宣言
+/// - 通常はWindows.hとDirectShow BaseClassesのデバッグ機能を使う
+/// - SCFF_IMAGING_HEADLESSが定義されている場合はそれらに依存せず、
+///   必要最小限の型とデバッグ用マクロをここで用意する
+///   (Windowsでのヘッドレスビルド(scff_sandbox)ではWindows.hの型とTEXTを使う)
+/// @attention スレッドとロックはstd::thread/std::mutexを直接使うこと
+
+#ifndef SCFF_DSF_SCFF_IMAGING_PLATFORM_H_
+#define SCFF_DSF_SCFF_IMAGING_PLATFORM_H_
+
+#if defined(SCFF_IMAGING_HEADLESS)
+
+#include <cassert>
+
+//=====================================================================
+// Windows.hの代替
+//=====================================================================
+
+#if defined(_WIN32)
+// D3D11などと一緒に使う場合にWindows.hの定義と衝突しないようにする
+#include <Windows.h>
+#else
+/// ウィンドウハンドル(ヘッドレスビルドでは常にnullptr)
+typedef void* HWND;
+#endif
+
+//=====================================================================
+// base/debug.hの代替
+//=====================================================================
+
+/// DbgOut用: エラー通知
+extern const int kLogError;
+
+/// DbgOut用: アプリケーションを異常終了させるような非常に深刻なイベント
+extern const int kErrorFatal;
+/// DbgOut用: アプリケーションの稼働が継続できる程度のエラー
+extern const int kError;
+/// DbgOut用: 潜在的に害を及ぼすような状況
+extern const int kErrorWarn;
+
+/// DbgOut用: 現在のErrorレベル。この数値より上は表示しない。
+extern const int kErrorCurrentLevel;
+
+/// DbgOut用: クリティカル セクションのロックとアンロック
+extern const int kLogLocking;
+/// DbgOut用: メモリ割り当てと、オブジェクトの作成および破棄
+extern const int kLogMemory;
+/// DbgOut用: タイミングとパフォーマンスの測定
+extern const int kLogTiming;
+/// DbgOut用: 一般的な呼び出しトレース
+extern const int kLogTrace;
+
+/// DbgOut用: アプリケーションの進捗の概要が分かるメッセージ
+extern const int kTraceInfo;
+/// DbgOut用: アプリケーションをデバッグするのに役立つ詳細なイベント情報
+extern const int kTraceDebug;
+/// DbgOut用: kTraceDebugより詳細なイベント情報
+extern const int kTrace;
+
+/// DbgOut用: 現在のTraceレベル。この数値より上は表示しない。
+extern const int kTraceCurrentLevel;
+
+namespace scff_imaging {
+namespace platform {
+
+/// DbgLogの実装: レベルが現在のレベル以下なら標準エラー出力に書き出す
+void DebugLog(int type, int level, const char *format, ...);
+#if defined(_WIN32)
+/// DbgLogの実装(UNICODEが定義されている場合のTEXT用)
+void DebugLog(int type, int level, const wchar_t *format, ...);
+#endif
+}   // namespace platform
+}   // namespace scff_imaging
+
+#if !defined(_WIN32)
+/// 文字列リテラル(ヘッドレスビルドでは常にchar)
+#define TEXT(quote) quote
+#endif
+
+/// DirectShow BaseClassesのDbgLogと同じくDebugビルドでのみ出力する
+#if defined(NDEBUG)
+#define DbgLog(_x) ((void)0)
+#else
+#define DbgLog(_x) ::scff_imaging::platform::DebugLog _x
+#endif
+
+/// DirectShow BaseClassesのASSERTの代替
+#define ASSERT(_x) assert(_x)
+
+#else   // defined(SCFF_IMAGING_HEADLESS)
+
+#include <Windows.h>
+
+#endif  // defined(SCFF_IMAGING_HEADLESS)
+
+#include <cstdint>
+
+/// スレッドローカルな静的変数の宣言に付ける
+/// @attention 定数で初期化できるPOD型のみ(VS2012はthread_localに未対応)
+#if defined(_MSC_VER)
+#define SCFF_THREAD_LOCAL __declspec(thread)
+#else
+#define SCFF_THREAD_LOCAL __thread
+#endif
+
+namespace scff_imaging {
+namespace platform {
+
+/// 現在のスレッドを識別する0以外の値
+/// @attention 終了したスレッドの値は別のスレッドで再利用されることがある
+uint32_t GetCurrentThreadKey();
+}   // namespace platform
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_PLATFORM_H_
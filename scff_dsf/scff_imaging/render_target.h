@@ -0,0 +1,57 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/render_target.h
+/// scff_imaging::RenderTargetの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_RENDER_TARGET_H_
+#define SCFF_DSF_SCFF_IMAGING_RENDER_TARGET_H_
+
+#include <cstdint>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// Engineが描画結果を直接書き込むバッファを表すインターフェース
+/// - DirectShowなどに依存しないようにバッファの先頭とサイズのみを公開する
+/// - バッファにはavpicture_layoutと同じ形式(アライメントなし)で書き込まれる
+class RenderTarget {
+ public:
+  /// 仮想デストラクタ
+  virtual ~RenderTarget() {
+    // nop
+  }
+
+  /// Getter: 書き込み先バッファの先頭
+  virtual uint8_t* buffer() const = 0;
+  /// Getter: 書き込み先バッファのサイズ(Byte)
+  virtual int buffer_size() const = 0;
+
+ protected:
+  /// コンストラクタ
+  RenderTarget() {
+    // nop
+  }
+
+ private:
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(RenderTarget);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_RENDER_TARGET_H_
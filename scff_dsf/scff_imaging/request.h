@@ -94,6 +94,75 @@ class SetLayoutRequest : public Request {
   LayoutParameter parameters_[kMaxProcessorSize];
 };
 
+/// リクエスト: SetRenderingMode
+class SetRenderingModeRequest : public Request {
+ public:
+  /// コンストラクタ
+  explicit SetRenderingModeRequest(RenderingModes rendering_mode)
+      : Request(),
+        rendering_mode_(rendering_mode) {
+    // nop
+  }
+  /// デストラクタ
+  ~SetRenderingModeRequest() {
+    // nop
+  }
+  /// ダブルディスパッチ用
+  void SendTo(Engine *engine) const {
+    engine->SetRenderingMode(rendering_mode_);
+  }
+
+ private:
+  /// 描画方法
+  const RenderingModes rendering_mode_;
+};
+
+/// リクエスト: SetPipelineMode
+class SetPipelineModeRequest : public Request {
+ public:
+  /// コンストラクタ
+  explicit SetPipelineModeRequest(PipelineModes pipeline_mode)
+      : Request(),
+        pipeline_mode_(pipeline_mode) {
+    // nop
+  }
+  /// デストラクタ
+  ~SetPipelineModeRequest() {
+    // nop
+  }
+  /// ダブルディスパッチ用
+  void SendTo(Engine *engine) const {
+    engine->SetPipelineMode(pipeline_mode_);
+  }
+
+ private:
+  /// キャプチャと変換の実行方法
+  const PipelineModes pipeline_mode_;
+};
+
+/// リクエスト: SetScaleQualityMode
+class SetScaleQualityModeRequest : public Request {
+ public:
+  /// コンストラクタ
+  explicit SetScaleQualityModeRequest(ScaleQualityModes scale_quality_mode)
+      : Request(),
+        scale_quality_mode_(scale_quality_mode) {
+    // nop
+  }
+  /// デストラクタ
+  ~SetScaleQualityModeRequest() {
+    // nop
+  }
+  /// ダブルディスパッチ用
+  void SendTo(Engine *engine) const {
+    engine->SetScaleQualityMode(scale_quality_mode_);
+  }
+
+ private:
+  /// 拡大縮小の品質の決め方
+  const ScaleQualityModes scale_quality_mode_;
+};
+
 }   // namespace scff_imaging
 
 #endif  // SCFF_DSF_SCFF_IMAGING_REQUEST_H_
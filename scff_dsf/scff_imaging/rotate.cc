@@ -0,0 +1,283 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/rotate.cc
+/// scff_imaging::Rotateの定義
+
+#include "scff_imaging/rotate.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "scff_imaging/debug.h"
+#include "scff_imaging/utilities.h"
+#include "scff_imaging/avpicture_with_fill_image.h"
+#include "scff_imaging/trace.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+    defined(__SSE2__)
+#define SCFF_ROTATE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+using scff_imaging::RotateDirections;
+
+/// 入力の矩形[x0, x1)x[y0, y1)を1ピクセルずつ回転して書き込む
+/// - 時計回り90度:  (x, y) -> (height - 1 - y, x)
+/// - 時計回り180度: (x, y) -> (width - 1 - x, height - 1 - y)
+/// - 時計回り270度: (x, y) -> (y, width - 1 - x)
+void RotateRectPortable(const uint8_t *src, int src_stride,
+                        uint8_t *dst, int dst_stride,
+                        int width, int height,
+                        RotateDirections direction,
+                        int x0, int y0, int x1, int y1) {
+  for (int y = y0; y < y1; y++) {
+    const uint32_t *src_row =
+        reinterpret_cast<const uint32_t*>(src + y * src_stride);
+    switch (direction) {
+      case RotateDirections::kDegrees90: {
+        uint8_t *dst_column = dst + (height - 1 - y) * 4;
+        for (int x = x0; x < x1; x++) {
+          *reinterpret_cast<uint32_t*>(dst_column + x * dst_stride) =
+              src_row[x];
+        }
+        break;
+      }
+      case RotateDirections::kDegrees180: {
+        uint32_t *dst_row =
+            reinterpret_cast<uint32_t*>(dst + (height - 1 - y) * dst_stride);
+        for (int x = x0; x < x1; x++) {
+          dst_row[width - 1 - x] = src_row[x];
+        }
+        break;
+      }
+      case RotateDirections::kDegrees270: {
+        uint8_t *dst_column = dst + y * 4;
+        for (int x = x0; x < x1; x++) {
+          *reinterpret_cast<uint32_t*>(
+              dst_column + (width - 1 - x) * dst_stride) = src_row[x];
+        }
+        break;
+      }
+      default: {
+        memcpy(dst + y * dst_stride + x0 * 4, src_row + x0, (x1 - x0) * 4);
+        break;
+      }
+    }
+  }
+}
+
+#if defined(SCFF_ROTATE_SSE2)
+/// 4x4ピクセル(32bit)を転置する
+/// - 入力はrow0..row3の4行、出力はcolumn0..column3の4列
+void Transpose4x4(__m128i row0, __m128i row1, __m128i row2, __m128i row3,
+                  __m128i *column0, __m128i *column1,
+                  __m128i *column2, __m128i *column3) {
+  const __m128i t0 = _mm_unpacklo_epi32(row0, row1);
+  const __m128i t1 = _mm_unpacklo_epi32(row2, row3);
+  const __m128i t2 = _mm_unpackhi_epi32(row0, row1);
+  const __m128i t3 = _mm_unpackhi_epi32(row2, row3);
+  *column0 = _mm_unpacklo_epi64(t0, t1);
+  *column1 = _mm_unpackhi_epi64(t0, t1);
+  *column2 = _mm_unpacklo_epi64(t2, t3);
+  *column3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+/// 入力の矩形[x0, x1)x[y0, y1)を4x4ピクセル単位で回転して書き込む
+/// - 4ピクセルにそろわない右端と下端はRotateRectPortableで処理する
+void RotateRectSSE2(const uint8_t *src, int src_stride,
+                    uint8_t *dst, int dst_stride,
+                    int width, int height,
+                    RotateDirections direction,
+                    int x0, int y0, int x1, int y1) {
+  const int quad_x1 = x0 + ((x1 - x0) & ~3);
+  const int quad_y1 = y0 + ((y1 - y0) & ~3);
+
+  if (direction == RotateDirections::kNoRotate) {
+    // 行ごとにコピーするだけ
+    RotateRectPortable(src, src_stride, dst, dst_stride, width, height,
+                       direction, x0, y0, x1, y1);
+    return;
+  }
+  if (direction == RotateDirections::kDegrees180) {
+    // 行ごとに左右を反転するだけなので転置は不要
+    for (int y = y0; y < y1; y++) {
+      const uint8_t *src_row = src + y * src_stride;
+      uint8_t *dst_row = dst + (height - 1 - y) * dst_stride;
+      for (int x = x0; x < quad_x1; x += 4) {
+        const __m128i pixels =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src_row + x * 4));
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(dst_row + (width - 4 - x) * 4),
+            _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 1, 2, 3)));
+      }
+    }
+    RotateRectPortable(src, src_stride, dst, dst_stride, width, height,
+                       direction, quad_x1, y0, x1, y1);
+    return;
+  }
+
+  const bool clockwise = direction == RotateDirections::kDegrees90;
+  for (int y = y0; y < quad_y1; y += 4) {
+    const uint8_t *src_row0 = src + y * src_stride;
+    const uint8_t *src_row1 = src_row0 + src_stride;
+    const uint8_t *src_row2 = src_row1 + src_stride;
+    const uint8_t *src_row3 = src_row2 + src_stride;
+    for (int x = x0; x < quad_x1; x += 4) {
+      __m128i row0 = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src_row0 + x * 4));
+      __m128i row1 = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src_row1 + x * 4));
+      __m128i row2 = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src_row2 + x * 4));
+      __m128i row3 = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src_row3 + x * 4));
+      __m128i column[4];
+      uint8_t *dst_origin;
+      int dst_step;
+      if (clockwise) {
+        // 入力の下の行が出力の左に来るので行を逆順にして転置する
+        Transpose4x4(row3, row2, row1, row0,
+                     &column[0], &column[1], &column[2], &column[3]);
+        dst_origin = dst + x * dst_stride + (height - 4 - y) * 4;
+        dst_step = dst_stride;
+      } else {
+        // 入力の右の列が出力の上に来るので下から順に書き込む
+        Transpose4x4(row0, row1, row2, row3,
+                     &column[0], &column[1], &column[2], &column[3]);
+        dst_origin = dst + (width - 1 - x) * dst_stride + y * 4;
+        dst_step = -dst_stride;
+      }
+      for (int i = 0; i < 4; i++) {
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(dst_origin + i * dst_step), column[i]);
+      }
+    }
+  }
+  // 右端と下端の端数
+  RotateRectPortable(src, src_stride, dst, dst_stride, width, height,
+                     direction, quad_x1, y0, x1, quad_y1);
+  RotateRectPortable(src, src_stride, dst, dst_stride, width, height,
+                     direction, x0, quad_y1, x1, y1);
+}
+#endif  // defined(SCFF_ROTATE_SSE2)
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::Rotate
+//=====================================================================
+
+Rotate::Rotate(RotateDirections direction, bool vertical_invert)
+    : Processor<AVPictureWithFillImage, AVPictureWithFillImage>(),
+      // 上下反転したイメージ上では時計回りと反時計回りが入れ替わる
+      direction_(!vertical_invert ? direction :
+                 direction == RotateDirections::kDegrees90 ?
+                     RotateDirections::kDegrees270 :
+                 direction == RotateDirections::kDegrees270 ?
+                     RotateDirections::kDegrees90 :
+                 direction) {
+  DbgLog((kLogMemory, kTrace,
+          TEXT("Rotate: NEW(%d, %d)"),
+          static_cast<int>(direction), vertical_invert));
+}
+
+Rotate::~Rotate() {
+  DbgLog((kLogMemory, kTrace,
+          TEXT("Rotate: DELETE")));
+}
+
+//-------------------------------------------------------------------
+
+ErrorCodes Rotate::Init() {
+  // 入出力はRGB0限定
+  ASSERT(GetInputImage()->pixel_format() == ImagePixelFormats::kRGB0);
+  ASSERT(GetOutputImage()->pixel_format() == ImagePixelFormats::kRGB0);
+
+  // 出力のサイズは回転後のサイズでなければならない
+  int rotated_width;
+  int rotated_height;
+  utilities::GetRotatedSize(direction_,
+                            GetInputImage()->width(),
+                            GetInputImage()->height(),
+                            &rotated_width, &rotated_height);
+  if (GetOutputImage()->width() != rotated_width ||
+      GetOutputImage()->height() != rotated_height) {
+    return ErrorOccured(ErrorCodes::kRotateInvalidSizeError);
+  }
+
+  return InitDone();
+}
+
+ErrorCodes Rotate::Run() {
+  SCFF_TRACE_SCOPE("Rotate::Run");
+  if (GetCurrentError() != ErrorCodes::kNoError) {
+    // 何かエラーが発生している場合は何もしない
+    return GetCurrentError();
+  }
+
+  const AVPicture *input = GetInputImage()->avpicture();
+  AVPicture *output = GetOutputImage()->avpicture();
+  RotatePlane32(input->data[0], input->linesize[0],
+                output->data[0], output->linesize[0],
+                GetInputImage()->width(), GetInputImage()->height(),
+                direction_);
+
+  // エラー発生なし
+  return GetCurrentError();
+}
+
+//-------------------------------------------------------------------
+
+void Rotate::RotatePlane32Portable(const uint8_t *src, int src_stride,
+                                   uint8_t *dst, int dst_stride,
+                                   int width, int height,
+                                   RotateDirections direction) {
+  for (int y = 0; y < height; y += kBlockSize) {
+    const int y1 = std::min(y + kBlockSize, height);
+    for (int x = 0; x < width; x += kBlockSize) {
+      const int x1 = std::min(x + kBlockSize, width);
+      RotateRectPortable(src, src_stride, dst, dst_stride, width, height,
+                         direction, x, y, x1, y1);
+    }
+  }
+}
+
+void Rotate::RotatePlane32(const uint8_t *src, int src_stride,
+                           uint8_t *dst, int dst_stride,
+                           int width, int height,
+                           RotateDirections direction) {
+#if defined(SCFF_ROTATE_SSE2)
+  // 入力の1ブロック(kBlockSize行)と出力の1ブロック(kBlockSize行)が
+  // 同時にL1/L2キャッシュに収まるようにブロック単位で処理する
+  for (int y = 0; y < height; y += kBlockSize) {
+    const int y1 = std::min(y + kBlockSize, height);
+    for (int x = 0; x < width; x += kBlockSize) {
+      const int x1 = std::min(x + kBlockSize, width);
+      RotateRectSSE2(src, src_stride, dst, dst_stride, width, height,
+                     direction, x, y, x1, y1);
+    }
+  }
+#else
+  RotatePlane32Portable(src, src_stride, dst, dst_stride,
+                        width, height, direction);
+#endif
+}
+}   // namespace scff_imaging
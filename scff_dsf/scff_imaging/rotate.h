@@ -0,0 +1,79 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/rotate.h
+/// scff_imaging::Rotateの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_ROTATE_H_
+#define SCFF_DSF_SCFF_IMAGING_ROTATE_H_
+
+#include <cstdint>
+
+#include "scff_imaging/common.h"
+#include "scff_imaging/processor.h"
+
+namespace scff_imaging {
+
+/// RGB0(32bit)のイメージを時計回りに90/180/270度回転する
+/// - kBlockSize四方のブロックごとに処理してキャッシュに収める
+/// - SSE2が使える場合は4x4ピクセル単位で転置する
+///   (結果はSSE2を使わない場合と完全に一致する)
+class Rotate
+    : public Processor<AVPictureWithFillImage, AVPictureWithFillImage> {
+ public:
+  /// キャッシュブロックの一辺のピクセル数(4の倍数)
+  static const int kBlockSize = 64;
+
+  /// コンストラクタ
+  /// @param direction 回転方向(画面上での向き)
+  /// @param vertical_invert 入出力イメージがメモリ上で上下反転しているか
+  ///                        (90度と270度の回転を入れ替える)
+  Rotate(RotateDirections direction, bool vertical_invert);
+  /// デストラクタ
+  ~Rotate();
+
+  //-------------------------------------------------------------------
+  /// @copydoc Processor::Init
+  ErrorCodes Init();
+  /// @copydoc Processor::Run
+  ErrorCodes Run();
+  //-------------------------------------------------------------------
+
+  /// 32bitピクセルのプレーンを回転する(SSE2が使えれば使う)
+  /// @param width 入力の幅(出力の幅は90/270度なら入力の高さ)
+  /// @param height 入力の高さ
+  /// @param direction メモリ上での回転方向
+  static void RotatePlane32(const uint8_t *src, int src_stride,
+                            uint8_t *dst, int dst_stride,
+                            int width, int height,
+                            RotateDirections direction);
+  /// 32bitピクセルのプレーンをSIMDを使わずに回転する(検証用)
+  static void RotatePlane32Portable(const uint8_t *src, int src_stride,
+                                    uint8_t *dst, int dst_stride,
+                                    int width, int height,
+                                    RotateDirections direction);
+
+ private:
+  /// メモリ上での回転方向
+  const RotateDirections direction_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(Rotate);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_ROTATE_H_
@@ -20,13 +20,48 @@
 
 #include "scff_imaging/scale.h"
 
+#include <algorithm>
+
 extern "C" {
 #include <libswscale/swscale.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 }
 
+#include "scff_imaging/debug.h"
 #include "scff_imaging/utilities.h"
 #include "scff_imaging/avpicture_image.h"
 #include "scff_imaging/avpicture_with_fill_image.h"
+#include "scff_imaging/worker_pool.h"
+#include "scff_imaging/trace.h"
+
+namespace {
+
+/// 色差の縦方向の間引き(log2)
+int GetLog2ChromaH(AVPixelFormat pixel_format) {
+  const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(pixel_format);
+  return descriptor != nullptr ? descriptor->log2_chroma_h : 0;
+}
+
+/// srcのsrc_y行目からheight行をdstのdst_y行目以降にコピーする
+/// @attention src_y, dst_y, heightは色差の間引きの倍数であること
+void CopyRows(const AVPicture *src, int src_y,
+              AVPicture *dst, int dst_y,
+              AVPixelFormat pixel_format, int width, int height) {
+  const int log2_chroma_h = GetLog2ChromaH(pixel_format);
+  const int plane_count = av_pix_fmt_count_planes(pixel_format);
+  for (int plane = 0; plane < plane_count; plane++) {
+    const int shift = (plane == 1 || plane == 2) ? log2_chroma_h : 0;
+    av_image_copy_plane(
+        dst->data[plane] + (dst_y >> shift) * dst->linesize[plane],
+        dst->linesize[plane],
+        src->data[plane] + (src_y >> shift) * src->linesize[plane],
+        src->linesize[plane],
+        av_image_get_linesize(pixel_format, width, plane),
+        height >> shift);
+  }
+}
+}   // namespace
 
 namespace scff_imaging {
 
@@ -34,21 +69,547 @@ namespace scff_imaging {
 // scff_imaging::Scale
 //=====================================================================
 
-Scale::Scale(const SWScaleConfig &swscale_config)
+Scale::Scale(const SWScaleConfig &swscale_config, WorkerPool *worker_pool,
+             ScalerCache *scaler_cache, bool enable_quality_levels)
     : Processor<AVPictureWithFillImage, AVPictureImage>(),
       swscale_config_(swscale_config),
+      worker_pool_(worker_pool),
+      scaler_cache_(scaler_cache),
+      enable_quality_levels_(enable_quality_levels),
+      quality_level_count_(1),
+      quality_level_(0),
       filter_(nullptr),
-      scaler_(nullptr) {
-  // nop
+      pyramid_downscale_(true),
+      pyramid_min_psnr_(kDefaultPyramidMinPsnr),
+      pyramid_pass_count_(0),
+      pyramid_psnr_(0.0),
+      convert_first_(true),
+      skip_unchanged_input_(false),
+      scaled_output_count_(0),
+      next_evicted_output_(0),
+      skipped_count_(0),
+      scaled_count_(0),
+      incremental_update_(false),
+      partially_scaled_count_(0) {
+  // 配列の初期化
+  for (int level = 0; level < kMaxScaleQualityLevelCount; level++) {
+    scalers_[level] = nullptr;
+    for (int i = 0; i < ScaleStripePlan::kMaxStripeCount; i++) {
+      stripe_scalers_[level][i] = nullptr;
+    }
+  }
+  for (int i = 0; i < kMaxScaledOutputCount; i++) {
+    scaled_outputs_[i] = nullptr;
+    scaled_quality_levels_[i] = 0;
+  }
+  filter_parameter_.luma_gblur = 0.0F;
+  filter_parameter_.chroma_gblur = 0.0F;
+  filter_parameter_.luma_sharpen = 0.0F;
+  filter_parameter_.chroma_sharpen = 0.0F;
+  filter_parameter_.chroma_hshift = 0.0F;
+  filter_parameter_.chroma_vshift = 0.0F;
+  // 明示的に初期化していない
+  // stripe_plans_[kMaxScaleQualityLevelCount]
+  // stripe_images_[kMaxScaleQualityLevelCount][kMaxStripeCount]
+  // unscaled_converter_
+  // fixed_ratio_scaler_
+  // changed_blocks_
+  // pyramid_reducers_[BoxReducer::kMaxPassCount]
+  // pyramid_images_[BoxReducer::kMaxPassCount]
+  // order_plan_
+  // input_converter_
+  // converted_input_
+  // input_fingerprint_
+  // scaled_fingerprints_[kMaxScaledOutputCount]
 }
 
 Scale::~Scale() {
+  for (int level = 0; level < kMaxScaleQualityLevelCount; level++) {
+    if (scalers_[level] != nullptr) {
+      FreeContext(scalers_[level]);
+    }
+    for (int i = 0; i < ScaleStripePlan::kMaxStripeCount; i++) {
+      if (stripe_scalers_[level][i] != nullptr) {
+        FreeContext(stripe_scalers_[level][i]);
+      }
+    }
+  }
   if (filter_ != nullptr) {
-    sws_freeFilter(filter_);
+    if (scaler_cache_ != nullptr) {
+      scaler_cache_->ReleaseFilter(filter_);
+    } else {
+      sws_freeFilter(filter_);
+    }
+  }
+}
+
+int Scale::stripe_count() const {
+  return stripe_plans_[0].stripe_count();
+}
+
+int Scale::quality_level_count() const {
+  return quality_level_count_;
+}
+
+void Scale::SetQualityLevel(int level) {
+  // 作成済みのコンテキストを切り替えるだけなので、ここで確保は行わない
+  quality_level_ = std::max(0, std::min(level, quality_level_count_ - 1));
+}
+
+void Scale::SetSkipUnchangedInput(bool skip_unchanged_input) {
+  skip_unchanged_input_ = skip_unchanged_input;
+  for (int i = 0; i < kMaxScaledOutputCount; i++) {
+    scaled_fingerprints_[i].Clear();
+    scaled_outputs_[i] = nullptr;
+  }
+  scaled_output_count_ = 0;
+  next_evicted_output_ = 0;
+}
+
+int64_t Scale::skipped_count() const {
+  return skipped_count_;
+}
+
+int64_t Scale::scaled_count() const {
+  return scaled_count_;
+}
+
+void Scale::SetIncrementalUpdate(bool incremental_update) {
+  incremental_update_ = incremental_update;
+}
+
+int64_t Scale::partially_scaled_count() const {
+  return partially_scaled_count_;
+}
+
+void Scale::SetPyramidDownscale(bool pyramid_downscale) {
+  pyramid_downscale_ = pyramid_downscale;
+}
+
+void Scale::SetPyramidMinPsnr(double pyramid_min_psnr) {
+  pyramid_min_psnr_ = pyramid_min_psnr;
+}
+
+int Scale::pyramid_pass_count() const {
+  return pyramid_pass_count_;
+}
+
+double Scale::pyramid_psnr() const {
+  return pyramid_psnr_;
+}
+
+void Scale::SetConvertFirst(bool convert_first) {
+  convert_first_ = convert_first;
+}
+
+bool Scale::is_converting_first() const {
+  return input_converter_.is_valid();
+}
+
+bool Scale::CanRunStripesInParallel() const {
+  return worker_pool_ != nullptr && worker_pool_->worker_count() > 0;
+}
+
+bool Scale::IsIncrementalUpdate() const {
+  return skip_unchanged_input_ && incremental_update_;
+}
+
+int Scale::FindScaledOutput(const void *buffer) const {
+  for (int i = 0; i < scaled_output_count_; i++) {
+    if (scaled_outputs_[i] == buffer) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const AVPicture* Scale::GetScalerInput() const {
+  if (pyramid_pass_count_ > 0) {
+    return pyramid_images_[pyramid_pass_count_ - 1].avpicture();
+  }
+  if (is_converting_first()) {
+    return converted_input_.avpicture();
+  }
+  return GetInputImage()->avpicture();
+}
+
+int Scale::GetScalerInputWidth() const {
+  if (pyramid_pass_count_ > 0) {
+    return pyramid_images_[pyramid_pass_count_ - 1].width();
+  }
+  return GetInputImage()->width();
+}
+
+int Scale::GetScalerInputHeight() const {
+  if (pyramid_pass_count_ > 0) {
+    return pyramid_images_[pyramid_pass_count_ - 1].height();
+  }
+  return GetInputImage()->height();
+}
+
+bool Scale::IsScalerInputRangeChanged(const FrameFingerprint &previous,
+                                      int y, int height) const {
+  // 縮小した行は入力の2^段数行分(最後の行は入力の範囲に切り詰められる)
+  return input_fingerprint_.IsRangeChanged(previous,
+                                           y << pyramid_pass_count_,
+                                           height << pyramid_pass_count_);
+}
+
+int Scale::AddScaledOutput(const void *buffer) {
+  int index = scaled_output_count_;
+  if (scaled_output_count_ < kMaxScaledOutputCount) {
+    scaled_output_count_++;
+  } else {
+    // バッファの数が多すぎる場合は古いものから忘れる
+    index = next_evicted_output_;
+    next_evicted_output_ = (next_evicted_output_ + 1) % kMaxScaledOutputCount;
+  }
+  scaled_outputs_[index] = buffer;
+  return index;
+}
+
+//-------------------------------------------------------------------
+
+ErrorCodes Scale::InitStripes(int level, AVPixelFormat input_pixel_format,
+                              int flags, SwsFilter *src_filter) {
+  if (!CanRunStripesInParallel() && !IsIncrementalUpdate()) {
+    // 並列化も差分更新もしないので分割しない
+    return ErrorCodes::kNoError;
+  }
+
+  // フィルタのタップが届く範囲を求めて計画を立てる
+  const AVPixelFormat output_pixel_format =
+      GetOutputImage()->av_pixel_format();
+  const int log2_chroma_h = GetLog2ChromaH(output_pixel_format);
+  // 先に変換した場合は入力もYUV420P
+  const int log2_src_chroma_h = GetLog2ChromaH(input_pixel_format);
+  int extra_taps = 0;
+  if (src_filter != nullptr) {
+    if (src_filter->lumV != nullptr) {
+      extra_taps = std::max(extra_taps, src_filter->lumV->length);
+    }
+    if (src_filter->chrV != nullptr) {
+      extra_taps = std::max(extra_taps, src_filter->chrV->length);
+    }
+  }
+  const int filter_radius = ScaleStripePlan::GetFilterRadius(
+      flags,
+      GetScalerInputHeight(),
+      GetOutputImage()->height(),
+      log2_chroma_h,
+      log2_src_chroma_h,
+      extra_taps);
+  // point/bilinearは一枚で処理した場合と完全に一致する場合のみ分割する
+  const bool exact_only =
+      (flags & (SWS_POINT | SWS_BILINEAR | SWS_FAST_BILINEAR)) != 0;
+  // 差分更新では変化した範囲だけを処理できるようにできるだけ細かく分ける
+  // 並列処理ではRunを呼び出したスレッドもストライプを処理する
+  const int max_stripe_count = IsIncrementalUpdate() ?
+      ScaleStripePlan::kMaxStripeCount :
+      worker_pool_->worker_count() + 1;
+  ScaleStripePlan &stripe_plan = stripe_plans_[level];
+  if (!stripe_plan.Build(GetScalerInputHeight(),
+                          GetOutputImage()->height(),
+                          log2_chroma_h,
+                          log2_src_chroma_h,
+                          filter_radius,
+                          max_stripe_count,
+                          exact_only)) {
+    DbgLog((kLogTrace, kTraceInfo,
+            TEXT("Scale: Cannot split into stripes(%d->%d, level:%d)"),
+            GetScalerInputHeight(), GetOutputImage()->height(), level));
+    return ErrorCodes::kNoError;
+  }
+
+  //-------------------------------------------------------------------
+  // 初期化の順番はイメージ→プロセッサの順
+  //-------------------------------------------------------------------
+  for (int i = 0; i < stripe_plan.stripe_count(); i++) {
+    const ScaleStripe &stripe = stripe_plan.stripe(i);
+
+    // ストライプごとの拡大縮小結果
+    const ErrorCodes error_stripe_image =
+        stripe_images_[level][i].Create(GetOutputImage()->pixel_format(),
+                                 GetOutputImage()->width(),
+                                 stripe.scaled_height);
+    if (error_stripe_image != ErrorCodes::kNoError) {
+      return error_stripe_image;
+    }
+
+    // ストライプごとの拡大縮小用のコンテキスト
+    // 入出力の比が全体と同じなのでフィルタ係数も全体と同じになる
+    stripe_scalers_[level][i] = GetContext(
+        GetScalerInputWidth(),
+        stripe.src_height,
+        input_pixel_format,
+        GetOutputImage()->width(),
+        stripe.scaled_height,
+        output_pixel_format,
+        flags, src_filter);
+    if (stripe_scalers_[level][i] == nullptr) {
+      return ErrorCodes::kScaleCannotGetContextError;
+    }
+  }
+
+  DbgLog((kLogTrace, kTraceInfo,
+          TEXT("Scale: Stripes(%d->%d, level:%d, count:%d, radius:%d)"),
+          GetScalerInputHeight(), GetOutputImage()->height(),
+          level, stripe_plan.stripe_count(), filter_radius));
+  return ErrorCodes::kNoError;
+}
+
+SwsContext* Scale::GetContext(int src_width, int src_height,
+                              AVPixelFormat src_format,
+                              int dst_width, int dst_height,
+                              AVPixelFormat dst_format,
+                              int flags, SwsFilter *src_filter) {
+  if (scaler_cache_ == nullptr) {
+    return sws_getCachedContext(nullptr,
+        src_width, src_height, src_format,
+        dst_width, dst_height, dst_format,
+        flags, src_filter, nullptr, nullptr);
+  }
+
+  // フィルタはfilter_だけなのでパラメータで区別できる
+  ASSERT(src_filter == nullptr || src_filter == filter_);
+  ScalerKey key;
+  key.src_width = src_width;
+  key.src_height = src_height;
+  key.src_format = src_format;
+  key.dst_width = dst_width;
+  key.dst_height = dst_height;
+  key.dst_format = dst_format;
+  key.flags = flags;
+  key.filter_enabled = src_filter != nullptr;
+  key.filter = filter_parameter_;
+  return scaler_cache_->AcquireContext(key);
+}
+
+void Scale::FreeContext(SwsContext *context) {
+  if (scaler_cache_ != nullptr) {
+    scaler_cache_->ReleaseContext(context);
+  } else {
+    sws_freeContext(context);
+  }
+}
+
+ErrorCodes Scale::InitPyramid(AVPixelFormat input_pixel_format) {
+  // フィルタは縮小前の入力にかけるものなので使わない
+  // point/fast bilinearは縮小率が大きくても軽いので使わない
+  if (!pyramid_downscale_ ||
+      swscale_config_.is_filter_enabled ||
+      swscale_config_.flags == SWScaleFlags::kPoint ||
+      swscale_config_.flags == SWScaleFlags::kFastBilinear) {
+    return ErrorCodes::kNoError;
+  }
+  const int pass_count = BoxReducer::GetPassCount(
+      GetInputImage()->width(), GetInputImage()->height(),
+      GetOutputImage()->width(), GetOutputImage()->height());
+  if (pass_count == 0) {
+    return ErrorCodes::kNoError;
+  }
+
+  // 使う前に一度だけ、画面らしいパターンで品質を確かめる
+  if (pyramid_min_psnr_ > 0.0) {
+    pyramid_psnr_ = MeasurePyramidPsnr(pass_count, input_pixel_format);
+    if (pyramid_psnr_ < pyramid_min_psnr_) {
+      // 差が大きすぎるのでSWScaleだけで縮小する
+      DbgLog((kLogTrace, kTraceInfo,
+              TEXT("Scale: Pyramid rejected(psnr:%.1fdB < %.1fdB)"),
+              pyramid_psnr_, pyramid_min_psnr_));
+      pyramid_pass_count_ = 0;
+      return ErrorCodes::kNoError;
+    }
+  }
+
+  //-------------------------------------------------------------------
+  // 初期化の順番はイメージ→プロセッサの順
+  //-------------------------------------------------------------------
+  int width = GetInputImage()->width();
+  int height = GetInputImage()->height();
+  for (int pass = 0; pass < pass_count; pass++) {
+    pyramid_reducers_[pass].Init(width, height);
+    width = pyramid_reducers_[pass].output_width();
+    height = pyramid_reducers_[pass].output_height();
+    // 1/2に縮小したRGB0(BGR0)
+    const ErrorCodes error_pyramid_image =
+        pyramid_images_[pass].Create(ImagePixelFormats::kRGB0, width, height);
+    if (error_pyramid_image != ErrorCodes::kNoError) {
+      return error_pyramid_image;
+    }
+  }
+
+  pyramid_pass_count_ = pass_count;
+  DbgLog((kLogTrace, kTraceInfo,
+          TEXT("Scale: Pyramid(%dx%d->%dx%d, passes:%d)"),
+          GetInputImage()->width(), GetInputImage()->height(),
+          width, height, pass_count));
+  return ErrorCodes::kNoError;
+}
+
+double Scale::MeasurePyramidPsnr(int pass_count,
+                                 AVPixelFormat input_pixel_format) {
+  SCFF_TRACE_SCOPE("Scale::MeasurePyramidPsnr");
+  const int input_width = GetInputImage()->width();
+  const int input_height = GetInputImage()->height();
+  const AVPixelFormat output_pixel_format =
+      GetOutputImage()->av_pixel_format();
+  const int output_width = GetOutputImage()->width();
+  const int output_height = GetOutputImage()->height();
+  /// @attention enum->int
+  int flags = static_cast<int>(swscale_config_.flags);
+  if (swscale_config_.accurate_rnd) {
+    flags |= SWS_ACCURATE_RND;
+  }
+
+  // 入力とピラミッドの段ごとの縮小結果(一時的なものなので使い終わったら解放)
+  AVPicture levels[BoxReducer::kMaxPassCount + 1];
+  AVPicture pyramid_output;
+  AVPicture direct_output;
+  int allocated_count = 0;
+  bool allocated =
+      avpicture_alloc(&(levels[0]), input_pixel_format,
+                      input_width, input_height) >= 0;
+  if (allocated) {
+    ++allocated_count;
+    utilities::FillDesktopPattern(&(levels[0]), input_width, input_height);
+  }
+  BoxReducer reducers[BoxReducer::kMaxPassCount];
+  int width = input_width;
+  int height = input_height;
+  for (int pass = 0; allocated && pass < pass_count; pass++) {
+    reducers[pass].Init(width, height);
+    width = reducers[pass].output_width();
+    height = reducers[pass].output_height();
+    allocated = avpicture_alloc(&(levels[pass + 1]), input_pixel_format,
+                                width, height) >= 0;
+    if (allocated) {
+      ++allocated_count;
+      reducers[pass].Reduce(levels[pass], &(levels[pass + 1]), 0, height);
+    }
+  }
+  const bool pyramid_output_allocated = allocated &&
+      avpicture_alloc(&pyramid_output, output_pixel_format,
+                      output_width, output_height) >= 0;
+  const bool direct_output_allocated = pyramid_output_allocated &&
+      avpicture_alloc(&direct_output, output_pixel_format,
+                      output_width, output_height) >= 0;
+
+  // ピラミッドの後の縮小と、SWScaleだけの縮小(どちらも最高品質)を比べる
+  double psnr = 0.0;
+  if (direct_output_allocated) {
+    SwsContext *pyramid_scaler = GetContext(
+        width, height, input_pixel_format,
+        output_width, output_height, output_pixel_format,
+        flags, nullptr);
+    SwsContext *direct_scaler = GetContext(
+        input_width, input_height, input_pixel_format,
+        output_width, output_height, output_pixel_format,
+        flags, nullptr);
+    if (pyramid_scaler != nullptr && direct_scaler != nullptr) {
+      sws_scale(pyramid_scaler,
+                levels[pass_count].data, levels[pass_count].linesize,
+                0, height,
+                pyramid_output.data, pyramid_output.linesize);
+      sws_scale(direct_scaler,
+                levels[0].data, levels[0].linesize,
+                0, input_height,
+                direct_output.data, direct_output.linesize);
+      psnr = utilities::CalculatePsnr(pyramid_output, direct_output,
+                                      output_pixel_format,
+                                      output_width, output_height);
+    }
+    if (pyramid_scaler != nullptr) {
+      FreeContext(pyramid_scaler);
+    }
+    if (direct_scaler != nullptr) {
+      FreeContext(direct_scaler);
+    }
+  }
+
+  // 解放
+  if (direct_output_allocated) {
+    avpicture_free(&direct_output);
+  }
+  if (pyramid_output_allocated) {
+    avpicture_free(&pyramid_output);
   }
-  if (scaler_ != nullptr) {
-    sws_freeContext(scaler_);
+  for (int i = 0; i < allocated_count; i++) {
+    avpicture_free(&(levels[i]));
+  }
+  return psnr;
+}
+
+ErrorCodes Scale::InitConvertFirst(AVPixelFormat input_pixel_format,
+                                   int flags) {
+  // 12bitのプレーンを拡大縮小するのでYUV420P/NV12出力のみ
+  const AVPixelFormat output_pixel_format =
+      GetOutputImage()->av_pixel_format();
+  if (!convert_first_ || pyramid_pass_count_ > 0 ||
+      (output_pixel_format != AV_PIX_FMT_YUV420P &&
+       output_pixel_format != AV_PIX_FMT_NV12)) {
+    return ErrorCodes::kNoError;
+  }
+  const int input_width = GetInputImage()->width();
+  const int input_height = GetInputImage()->height();
+  if (!order_plan_.Build(input_width, input_height,
+                         GetOutputImage()->width(),
+                         GetOutputImage()->height(),
+                         flags)) {
+    return ErrorCodes::kNoError;
+  }
+  // 幅・高さが奇数の場合は変換できない
+  /// @attention UVの入れ替えはSWScaleで直接変換する場合と同じになるよう、
+  ///            入力のピクセルフォーマットはそのまま渡す
+  if (!input_converter_.Init(input_pixel_format, AV_PIX_FMT_YUV420P,
+                             input_width, input_height)) {
+    return ErrorCodes::kNoError;
+  }
+
+  // 入力の大きさのYUV420P
+  const ErrorCodes error_converted_input =
+      converted_input_.Create(ImagePixelFormats::kI420,
+                              input_width, input_height);
+  if (error_converted_input != ErrorCodes::kNoError) {
+    input_converter_.Clear();
+    return error_converted_input;
+  }
+
+  DbgLog((kLogTrace, kTraceInfo,
+          TEXT("Scale: ConvertFirst(%dx%d->%dx%d, cost:%lld<%lld)"),
+          input_width, input_height,
+          GetOutputImage()->width(), GetOutputImage()->height(),
+          order_plan_.convert_first_cost(), order_plan_.scale_first_cost()));
+  return ErrorCodes::kNoError;
+}
+
+ErrorCodes Scale::InitLevel(int level, AVPixelFormat input_pixel_format,
+                            int flags, SwsFilter *src_filter) {
+  // ストライプに分割できる場合はストライプごとのSWScalerを作成
+  const ErrorCodes error_stripes =
+      InitStripes(level, input_pixel_format, flags, src_filter);
+  if (error_stripes != ErrorCodes::kNoError) {
+    return error_stripes;
+  }
+  if (stripe_plans_[level].stripe_count() > 1 && CanRunStripesInParallel()) {
+    return ErrorCodes::kNoError;
+  }
+
+  // SWScalerの作成
+  // 差分更新のみでストライプに分割した場合も、全体が変化したときに
+  // 重なりの分だけ遅くならないよう一枚で処理するためのものを用意する
+  scalers_[level] = GetContext(
+      GetScalerInputWidth(),
+      GetScalerInputHeight(),
+      input_pixel_format,
+      GetOutputImage()->width(),
+      GetOutputImage()->height(),
+      GetOutputImage()->av_pixel_format(),
+      flags, src_filter);
+  if (scalers_[level] == nullptr) {
+    return ErrorCodes::kScaleCannotGetContextError;
   }
+  return ErrorCodes::kNoError;
 }
 
 //-------------------------------------------------------------------
@@ -57,34 +618,47 @@ ErrorCodes Scale::Init() {
   // 入力はRGB0限定
   ASSERT(GetInputImage()->pixel_format() == ImagePixelFormats::kRGB0);
 
-  // 拡大縮小時のフィルタを作成
-
-  /// @warning xxx_sharpenの値は1.00にするとDiv0Errorで落ちるので少しだけずらす
-  /// @todo(me) 要調査
-  /// @attention 浮動小数点数の比較
-  const float epsilon = 0.0001F;
-  float luma_sharpen = swscale_config_.luma_sharpen;
-  float chroma_sharpen = swscale_config_.chroma_sharpen;
-  if (fabs(luma_sharpen - 1.0F) < epsilon) luma_sharpen = 1.0F + epsilon;
-  if (fabs(chroma_sharpen - 1.0F) < epsilon) chroma_sharpen = 1.0F + epsilon;
-
-  SwsFilter *filter = sws_getDefaultFilter(
-      swscale_config_.luma_gblur,
-      swscale_config_.chroma_gblur,
-      luma_sharpen,
-      chroma_sharpen,
-      swscale_config_.chroma_hshift,
-      swscale_config_.chroma_vshift,
-      0);
-  if (filter == nullptr) {
-    return ErrorOccured(ErrorCodes::kScaleCannotGetDefaultFilterError);
-  }
-  filter_ = filter;
+  // 拡大縮小時のフィルタを作成(使わない場合は作成しない)
+  if (swscale_config_.is_filter_enabled) {
+    /// @warning xxx_sharpenの値は1.00にするとDiv0Errorで落ちるので
+    ///          少しだけずらす
+    /// @todo(me) 要調査
+    /// @attention 浮動小数点数の比較
+    const float epsilon = 0.0001F;
+    float luma_sharpen = swscale_config_.luma_sharpen;
+    float chroma_sharpen = swscale_config_.chroma_sharpen;
+    if (fabs(luma_sharpen - 1.0F) < epsilon) luma_sharpen = 1.0F + epsilon;
+    if (fabs(chroma_sharpen - 1.0F) < epsilon) chroma_sharpen = 1.0F + epsilon;
+
+    filter_parameter_.luma_gblur = swscale_config_.luma_gblur;
+    filter_parameter_.chroma_gblur = swscale_config_.chroma_gblur;
+    filter_parameter_.luma_sharpen = luma_sharpen;
+    filter_parameter_.chroma_sharpen = chroma_sharpen;
+    filter_parameter_.chroma_hshift = swscale_config_.chroma_hshift;
+    filter_parameter_.chroma_vshift = swscale_config_.chroma_vshift;
+
+    SwsFilter *filter = nullptr;
+    if (scaler_cache_ != nullptr) {
+      filter = scaler_cache_->AcquireFilter(filter_parameter_);
+    } else {
+      filter = sws_getDefaultFilter(
+          filter_parameter_.luma_gblur,
+          filter_parameter_.chroma_gblur,
+          filter_parameter_.luma_sharpen,
+          filter_parameter_.chroma_sharpen,
+          filter_parameter_.chroma_hshift,
+          filter_parameter_.chroma_vshift,
+          0);
+    }
+    if (filter == nullptr) {
+      return ErrorOccured(ErrorCodes::kScaleCannotGetDefaultFilterError);
+    }
+    filter_ = filter;
+  }
 
   //-------------------------------------------------------------------
   // 拡大縮小用のコンテキストを作成
   //-------------------------------------------------------------------
-  struct SwsContext *scaler = nullptr;
 
   // ピクセルフォーマットの調整
   AVPixelFormat input_pixel_format = AV_PIX_FMT_NONE;
@@ -92,10 +666,11 @@ ErrorCodes Scale::Init() {
     case ImagePixelFormats::kI420:
     case ImagePixelFormats::kIYUV:
     case ImagePixelFormats::kUYVY:
-    case ImagePixelFormats::kYUY2: {
-      // IYUV/I420/YUY2/UYVY:
+    case ImagePixelFormats::kYUY2:
+    case ImagePixelFormats::kNV12: {
+      // IYUV/I420/YUY2/UYVY/NV12:
       //    入力:BGR0(32bit)
-      //    出力:I420(12bit)/IYUV(12bit)/UYVY(16bit)/YUY2(16bit)
+      //    出力:I420(12bit)/IYUV(12bit)/UYVY(16bit)/YUY2(16bit)/NV12(12bit)
       /// @attention RGB->YUV変換時にUVが逆になるのを修正
       /// - RGBデータをBGRデータとしてSwsContextに渡してあります
       input_pixel_format = AV_PIX_FMT_BGR0;
@@ -111,47 +686,403 @@ ErrorCodes Scale::Init() {
     }
   }
 
+  // SWScaleを使わずに済む場合
+  // (どちらも最も軽い品質段階より速いので品質段階は使わない)
+  const int input_width = GetInputImage()->width();
+  const int input_height = GetInputImage()->height();
+  const int output_width = GetOutputImage()->width();
+  const int output_height = GetOutputImage()->height();
+  if (!swscale_config_.is_filter_enabled) {
+    if (input_width == output_width && input_height == output_height &&
+        unscaled_converter_.Init(input_pixel_format,
+                                 GetOutputImage()->av_pixel_format(),
+                                 output_width, output_height)) {
+      // 入出力の大きさが同じなら色空間の変換だけで済む
+      // (拡大縮小メソッドによる違いはほぼない)
+      DbgLog((kLogTrace, kTraceInfo,
+              TEXT("Scale: Unscaled(%dx%d)"), output_width, output_height));
+    } else if ((swscale_config_.flags == SWScaleFlags::kFastBilinear ||
+                swscale_config_.flags == SWScaleFlags::kBilinear ||
+                swscale_config_.flags == SWScaleFlags::kArea) &&
+               fixed_ratio_scaler_.Init(input_pixel_format,
+                                        GetOutputImage()->av_pixel_format(),
+                                        input_width, input_height,
+                                        output_width, output_height)) {
+      // 面積平均で代用できる拡大縮小メソッドなら固定の縮小率のカーネルを使う
+      DbgLog((kLogTrace, kTraceInfo,
+              TEXT("Scale: FixedRatio(%d:%d %dx%d->%dx%d)"),
+              fixed_ratio_scaler_.input_ratio(),
+              fixed_ratio_scaler_.output_ratio(),
+              input_width, input_height, output_width, output_height));
+    }
+    if (IsDirectConversion()) {
+      quality_level_count_ = 1;
+      quality_level_ = 0;
+      changed_blocks_.assign(
+          (output_height + FrameFingerprint::kRowsPerBlock - 1) /
+              FrameFingerprint::kRowsPerBlock,
+          1);
+      return InitDone();
+    }
+  }
+
+  // 大きく縮小する場合はSWScaleの前にピラミッドで縮小しておく
+  const ErrorCodes error_pyramid = InitPyramid(input_pixel_format);
+  if (error_pyramid != ErrorCodes::kNoError) {
+    return ErrorOccured(error_pyramid);
+  }
+
   // フィルタの設定
-  SwsFilter *src_filter = nullptr;
-  if (swscale_config_.is_filter_enabled) {
-    src_filter = filter_;
+  SwsFilter *src_filter = filter_;
+
+  // 品質段階ごとの拡大縮小メソッド
+  SWScaleFlags ladder[kMaxScaleQualityLevelCount];
+  quality_level_count_ = BuildScaleQualityLadder(swscale_config_.flags, ladder);
+  if (!enable_quality_levels_) {
+    quality_level_count_ = 1;
   }
+  quality_level_ = 0;
 
   // 丸め処理
-  /// @attention enum->int
-  int flags = static_cast<int>(swscale_config_.flags);
+  int accurate_rnd_flag = 0;
   if (swscale_config_.accurate_rnd) {
-    flags |= SWS_ACCURATE_RND;
+    accurate_rnd_flag = SWS_ACCURATE_RND;
   }
 
-  // SWScalerの作成
-  scaler = sws_getCachedContext(nullptr,
-      GetInputImage()->width(),
-      GetInputImage()->height(),
-      input_pixel_format,
-      GetOutputImage()->width(),
-      GetOutputImage()->height(),
-      GetOutputImage()->av_pixel_format(),
-      flags, src_filter, nullptr, nullptr);
-  if (scaler == nullptr) {
-    return ErrorOccured(ErrorCodes::kScaleCannotGetContextError);
+  // 変換してから拡大縮小した方が軽ければ先にYUV420Pに変換しておく
+  // (見積もりは設定どおりの拡大縮小メソッドで行う)
+  /// @attention enum->int
+  const ErrorCodes error_convert_first = InitConvertFirst(
+      input_pixel_format, static_cast<int>(ladder[0]) | accurate_rnd_flag);
+  if (error_convert_first != ErrorCodes::kNoError) {
+    return ErrorOccured(error_convert_first);
+  }
+  const AVPixelFormat scaler_input_pixel_format =
+      is_converting_first() ? AV_PIX_FMT_YUV420P : input_pixel_format;
+
+  for (int level = 0; level < quality_level_count_; level++) {
+    /// @attention enum->int
+    const int flags = static_cast<int>(ladder[level]) | accurate_rnd_flag;
+
+    // 切り替え時に詰まらないよう、すべての段階のSWScalerをここで作成
+    const ErrorCodes error_level =
+        InitLevel(level, scaler_input_pixel_format, flags, src_filter);
+    if (error_level != ErrorCodes::kNoError) {
+      return ErrorOccured(error_level);
+    }
   }
-  scaler_ = scaler;
 
   // 初期化は成功
   return InitDone();
 }
 
+bool Scale::IsDirectConversion() const {
+  return unscaled_converter_.is_valid() || fixed_ratio_scaler_.is_valid();
+}
+
+void Scale::RunDirectBlocks(int first, int last) {
+  SCFF_TRACE_SCOPE("Scale::RunDirectBlocks");
+  const int block_rows = FrameFingerprint::kRowsPerBlock;
+  const int height = GetOutputImage()->height();
+  int block = first;
+  while (block < last) {
+    if (!changed_blocks_[block]) {
+      ++block;
+      continue;
+    }
+    // 変化したブロックが続く範囲をまとめて変換する
+    int end = block + 1;
+    while (end < last && changed_blocks_[end]) ++end;
+    const int y = block * block_rows;
+    const int rows = std::min(end * block_rows, height) - y;
+    if (fixed_ratio_scaler_.is_valid()) {
+      fixed_ratio_scaler_.Convert(*GetInputImage()->avpicture(),
+                                  GetOutputImage()->avpicture(),
+                                  y, rows);
+    } else {
+      unscaled_converter_.Convert(*GetInputImage()->avpicture(),
+                                  GetOutputImage()->avpicture(),
+                                  y, rows);
+    }
+    block = end;
+  }
+}
+
+bool Scale::RunDirect(const FrameFingerprint *previous) {
+  // 入力が変化したブロックを選ぶ(前回の指紋がなければすべて)
+  const int block_count = static_cast<int>(changed_blocks_.size());
+  const int block_rows = FrameFingerprint::kRowsPerBlock;
+  int changed_block_count = 0;
+  for (int i = 0; i < block_count; i++) {
+    int input_y = i * block_rows;
+    int input_height = block_rows;
+    if (fixed_ratio_scaler_.is_valid()) {
+      fixed_ratio_scaler_.GetInputRows(i * block_rows, block_rows,
+                                       &input_y, &input_height);
+    }
+    changed_blocks_[i] = previous == nullptr ||
+        input_fingerprint_.IsRangeChanged(*previous, input_y, input_height);
+    if (changed_blocks_[i]) ++changed_block_count;
+  }
+
+  if (CanRunStripesInParallel() && changed_block_count > 1) {
+    // ブロックを連続した範囲に分けて並列に変換する
+    // Runを呼び出したスレッドも1つ分を処理する
+    const int group_count =
+        std::min(worker_pool_->worker_count() + 1, block_count);
+    for (int i = group_count - 1; i >= 1; i--) {
+      const int first = block_count * i / group_count;
+      const int last = block_count * (i + 1) / group_count;
+      worker_pool_->Submit([this, first, last] {
+        RunDirectBlocks(first, last);
+      });
+    }
+    RunDirectBlocks(0, block_count / group_count);
+    worker_pool_->Join();
+  } else {
+    RunDirectBlocks(0, block_count);
+  }
+  return changed_block_count < block_count;
+}
+
+void Scale::RunPyramidRows(int pass, int y, int height) {
+  SCFF_TRACE_SCOPE("Scale::RunPyramidRows");
+  const AVPicture *input = pass == 0 ?
+      GetInputImage()->avpicture() :
+      pyramid_images_[pass - 1].avpicture();
+  pyramid_reducers_[pass].Reduce(*input, pyramid_images_[pass].avpicture(),
+                                 y, height);
+}
+
+void Scale::RunPyramid() {
+  SCFF_TRACE_SCOPE("Scale::RunPyramid");
+  for (int pass = 0; pass < pyramid_pass_count_; pass++) {
+    const int height = pyramid_reducers_[pass].output_height();
+    if (!CanRunStripesInParallel()) {
+      RunPyramidRows(pass, 0, height);
+      continue;
+    }
+    // 行を連続した範囲に分けて並列に縮小する
+    // 次の段は前の段の結果をすべて使うので段ごとに待つ
+    const int group_count =
+        std::min(worker_pool_->worker_count() + 1, height);
+    for (int i = group_count - 1; i >= 1; i--) {
+      const int first = height * i / group_count;
+      const int last = height * (i + 1) / group_count;
+      worker_pool_->Submit([this, pass, first, last] {
+        RunPyramidRows(pass, first, last - first);
+      });
+    }
+    RunPyramidRows(pass, 0, height / group_count);
+    worker_pool_->Join();
+  }
+}
+
+void Scale::RunConvertRows(int y, int height) {
+  SCFF_TRACE_SCOPE("Scale::RunConvertRows");
+  input_converter_.Convert(*GetInputImage()->avpicture(),
+                           converted_input_.avpicture(), y, height);
+}
+
+void Scale::RunConvertFirst(int level, const bool *changed_stripes) {
+  SCFF_TRACE_SCOPE("Scale::RunConvertFirst");
+  // 変換する入力の行の範囲(重なり合うストライプはまとめる)
+  int ranges[ScaleStripePlan::kMaxStripeCount][2];
+  int range_count = 0;
+  if (changed_stripes == nullptr) {
+    ranges[0][0] = 0;
+    ranges[0][1] = GetInputImage()->height();
+    range_count = 1;
+  } else {
+    const ScaleStripePlan &stripe_plan = stripe_plans_[level];
+    for (int i = 0; i < stripe_plan.stripe_count(); i++) {
+      if (!changed_stripes[i]) continue;
+      const ScaleStripe &stripe = stripe_plan.stripe(i);
+      const int first = stripe.src_y;
+      const int last = stripe.src_y + stripe.src_height;
+      if (range_count > 0 && first <= ranges[range_count - 1][1]) {
+        ranges[range_count - 1][1] = std::max(ranges[range_count - 1][1], last);
+      } else {
+        ranges[range_count][0] = first;
+        ranges[range_count][1] = last;
+        ++range_count;
+      }
+    }
+  }
+
+  // YUV420Pの色差は2行単位なので行の範囲は偶数に揃っている
+  // (ストライプの入力の境界はInitStripesで偶数に揃えてある)
+  const int group_count =
+      CanRunStripesInParallel() ? worker_pool_->worker_count() + 1 : 1;
+  for (int r = 0; r < range_count; r++) {
+    const int first = ranges[r][0];
+    const int pair_count = (ranges[r][1] - first) / 2;
+    if (group_count == 1 || pair_count < group_count) {
+      RunConvertRows(first, pair_count * 2);
+      continue;
+    }
+    // 行を連続した範囲に分けて並列に変換する
+    for (int i = group_count - 1; i >= 1; i--) {
+      const int group_first = first + pair_count * i / group_count * 2;
+      const int group_last = first + pair_count * (i + 1) / group_count * 2;
+      worker_pool_->Submit([this, group_first, group_last] {
+        RunConvertRows(group_first, group_last - group_first);
+      });
+    }
+    RunConvertRows(first, pair_count / group_count * 2);
+    worker_pool_->Join();
+  }
+}
+
+void Scale::RunStripe(int level, int index) {
+  SCFF_TRACE_SCOPE("Scale::RunStripe");
+  const ScaleStripe &stripe = stripe_plans_[level].stripe(index);
+
+  // 入力はRGB0(パックド)なら1プレーン分、
+  // 先に変換したYUV420Pなら色差のプレーンは半分の行数だけずらす
+  const AVPicture *input = GetScalerInput();
+  const int log2_src_chroma_h = is_converting_first() ? 1 : 0;
+  const uint8_t *src[4] = {nullptr, nullptr, nullptr, nullptr};
+  for (int plane = 0; plane < 3; plane++) {
+    if (input->data[plane] == nullptr) continue;
+    const int src_y = plane == 0 ?
+        stripe.src_y :
+        stripe.src_y >> log2_src_chroma_h;
+    src[plane] = input->data[plane] + src_y * input->linesize[plane];
+  }
+
+  // SWScaleを使って重なりを含めたストライプを拡大・縮小
+  AVPicture *scaled = stripe_images_[level][index].avpicture();
+  const int scale_height =
+      sws_scale(stripe_scalers_[level][index],
+                src, input->linesize,
+                0, stripe.src_height,
+                scaled->data, scaled->linesize);
+  ASSERT(scale_height == stripe.scaled_height);
+
+  // 重なりを除いた部分だけを出力に書き込む
+  CopyRows(scaled, stripe.dst_y - stripe.scaled_y,
+           GetOutputImage()->avpicture(), stripe.dst_y,
+           GetOutputImage()->av_pixel_format(),
+           GetOutputImage()->width(),
+           stripe.dst_height);
+}
+
 ErrorCodes Scale::Run() {
-  // SWScaleを使って拡大・縮小を行う
-  int scale_height =
-      sws_scale(scaler_,
-                GetInputImage()->avpicture()->data,
-                GetInputImage()->avpicture()->linesize,
-                0, GetInputImage()->height(),
-                GetOutputImage()->avpicture()->data,
-                GetOutputImage()->avpicture()->linesize);
-  ASSERT(scale_height == GetOutputImage()->height());
+  SCFF_TRACE_SCOPE("Scale::Run");
+  const int level = quality_level_;
+  const ScaleStripePlan &stripe_plan = stripe_plans_[level];
+
+  // 拡大縮小が必要なストライプ(差分更新しなければすべて)
+  bool changed_stripes[ScaleStripePlan::kMaxStripeCount];
+  int changed_stripe_count = stripe_plan.stripe_count();
+  // 変化したストライプの重なりを含めた出力の行数の合計
+  int changed_scaled_rows = 0;
+  for (int i = 0; i < stripe_plan.stripe_count(); i++) {
+    changed_stripes[i] = true;
+    changed_scaled_rows += stripe_plan.stripe(i).scaled_height;
+  }
+
+  // 出力イメージのバッファ
+  // (ビューの場合はイメージが同じでも親のバッファが入れ替わる)
+  const void *output_buffer = GetOutputImage()->avpicture()->data[0];
+  int scaled_output = -1;
+  // 差分更新する場合の前回の入力の指紋
+  const FrameFingerprint *previous_fingerprint = nullptr;
+  if (skip_unchanged_input_) {
+    // 入力(RGB0)の指紋を取って、このバッファに前回拡大縮小したものと比べる
+    const AVPicture *input = GetInputImage()->avpicture();
+    {
+      SCFF_TRACE_SCOPE("Scale::Fingerprint");
+      input_fingerprint_.Compute(
+          input->data[0], input->linesize[0],
+          av_image_get_linesize(GetInputImage()->av_pixel_format(),
+                                GetInputImage()->width(), 0),
+          GetInputImage()->height());
+    }
+    scaled_output = FindScaledOutput(output_buffer);
+    const bool has_scaled_output =
+        scaled_output >= 0 && scaled_quality_levels_[scaled_output] == level;
+    if (has_scaled_output &&
+        input_fingerprint_.Equals(scaled_fingerprints_[scaled_output])) {
+      // 出力には前回の結果がそのまま残っている
+      ++skipped_count_;
+      return GetCurrentError();
+    }
+    if (has_scaled_output && IsIncrementalUpdate()) {
+      previous_fingerprint = &scaled_fingerprints_[scaled_output];
+      // 入力(フィルタのタップが届く範囲を含む)が変化したストライプだけを選ぶ
+      changed_stripe_count = 0;
+      changed_scaled_rows = 0;
+      for (int i = 0; i < stripe_plan.stripe_count(); i++) {
+        const ScaleStripe &stripe = stripe_plan.stripe(i);
+        changed_stripes[i] = IsScalerInputRangeChanged(
+            scaled_fingerprints_[scaled_output],
+            stripe.src_y, stripe.src_height);
+        if (changed_stripes[i]) {
+          ++changed_stripe_count;
+          changed_scaled_rows += stripe.scaled_height;
+        }
+      }
+    }
+  }
+
+  // 並列処理しない場合、重なりの分を含めると一枚で処理するより
+  // 重くなるならストライプに分けない
+  const bool partial = changed_stripe_count < stripe_plan.stripe_count();
+  const bool use_stripes =
+      stripe_plan.stripe_count() > 1 &&
+      (CanRunStripesInParallel() ||
+       changed_scaled_rows < GetOutputImage()->height());
+  if (IsDirectConversion()) {
+    // SWScaleを使わずに変換する
+    if (RunDirect(previous_fingerprint)) ++partially_scaled_count_;
+  } else {
+    if (pyramid_pass_count_ > 0) {
+      // SWScaleの前に1/2の縮小を繰り返す
+      RunPyramid();
+    } else if (is_converting_first()) {
+      // SWScaleの前に拡大縮小するストライプが読む行だけをYUV420Pに変換する
+      RunConvertFirst(level, use_stripes ? changed_stripes : nullptr);
+    }
+    if (use_stripes) {
+      if (CanRunStripesInParallel()) {
+        // ストライプごとに並列に拡大・縮小を行う
+        for (int i = stripe_plan.stripe_count() - 1; i >= 0; i--) {
+          if (changed_stripes[i]) {
+            worker_pool_->Submit([this, level, i] { RunStripe(level, i); });
+          }
+        }
+        worker_pool_->Join();
+      } else {
+        // 変化したストライプだけを順番に拡大・縮小する
+        for (int i = 0; i < stripe_plan.stripe_count(); i++) {
+          if (changed_stripes[i]) RunStripe(level, i);
+        }
+      }
+      if (partial) ++partially_scaled_count_;
+    } else {
+      // SWScaleを使って拡大・縮小を行う
+      int scale_height =
+          sws_scale(scalers_[level],
+                    GetScalerInput()->data,
+                    GetScalerInput()->linesize,
+                    0, GetScalerInputHeight(),
+                    GetOutputImage()->avpicture()->data,
+                    GetOutputImage()->avpicture()->linesize);
+      ASSERT(scale_height == GetOutputImage()->height());
+    }
+  }
+  ++scaled_count_;
+
+  if (skip_unchanged_input_) {
+    // 次回の比較用に今回の指紋をバッファごとに残す(確保し直さないよう交換する)
+    if (scaled_output < 0) {
+      scaled_output = AddScaledOutput(output_buffer);
+    }
+    scaled_fingerprints_[scaled_output].Swap(&input_fingerprint_);
+    scaled_quality_levels_[scaled_output] = level;
+  }
 
   // エラー発生なし
   return GetCurrentError();
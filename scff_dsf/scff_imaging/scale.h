@@ -21,18 +21,70 @@
 #ifndef SCFF_DSF_SCFF_IMAGING_SCALE_H_
 #define SCFF_DSF_SCFF_IMAGING_SCALE_H_
 
+#include <vector>
+
 #include "scff_imaging/common.h"
 #include "scff_imaging/processor.h"
+#include "scff_imaging/avpicture_image.h"
+#include "scff_imaging/scale_stripe_plan.h"
+#include "scff_imaging/scale_quality_controller.h"
+#include "scff_imaging/fixed_ratio_scaler.h"
+#include "scff_imaging/frame_fingerprint.h"
+#include "scff_imaging/unscaled_converter.h"
+#include "scff_imaging/scaler_cache.h"
+#include "scff_imaging/box_reducer.h"
+#include "scff_imaging/scale_order_plan.h"
 
 struct SwsContext;
 
 namespace scff_imaging {
 
+class WorkerPool;
+
 /// SWScaleを利用してイメージの拡大・縮小・ピクセルフォーマット変換を行う
+/// - WorkerPoolが与えられた場合は出力を水平方向のストライプに分割し、
+///   ストライプごとのSwsContextで並列に処理する
+/// - 品質段階を有効にした場合は段階ごとのSwsContextをInitで作っておき、
+///   SetQualityLevelでは使うものを切り替えるだけにする
+/// - 入力が前回拡大縮小したものと同じ内容なら拡大縮小を省略できる
+///   (SetSkipUnchangedInput)
+///   出力イメージのバッファごとに記録するので、複数のバッファを
+///   切り替えて使う場合(ビューの親が入れ替わる場合など)も省略できる
+/// - さらに入力の一部だけが変化した場合は、変化した行に関係する
+///   ストライプだけを拡大縮小できる(SetIncrementalUpdate)
+/// - 入出力の大きさが同じでフィルタを使わない場合は、SWScaleを使わず
+///   UnscaledConverterで色空間の変換だけを行う
+/// - 縮小率が2:1か3:2で、フィルタを使わず面積平均で代用できる拡大縮小
+///   メソッド(fast bilinear/bilinear/area)の場合は、SWScaleを使わず
+///   FixedRatioScalerで縮小と色空間の変換をまとめて行う
+/// - SWScaleを使わない場合は、ストライプの代わりに出力の
+///   FrameFingerprint::kRowsPerBlock行ごとのブロック単位で並列化・差分更新する
+/// - ScalerCacheが与えられた場合はSwsContextとフィルタをそこから借りて、
+///   レイアウトを作り直しても同じ条件のものを使いまわす
+/// - 縦横とも2倍を超えて縮小する場合は、SWScaleの前にRGB0のまま
+///   BoxReducerで1/2の縮小を繰り返し(ピラミッド)、SWScaleには残りの
+///   縮小だけをさせる(SetPyramidDownscale)
+///   Initで一度だけ画面らしいパターンをSWScaleだけで縮小した結果と比べ、
+///   PSNRが下限を下回ったらピラミッドを使わない(SetPyramidMinPsnr)
+/// - 出力がYUV420P/NV12で、先に変換した方が軽いとScaleOrderPlanで
+///   見積もられた場合は、入力の大きさのままUnscaledConverterで
+///   YUV420Pに変換してからSWScaleで拡大縮小する(SetConvertFirst)
 class Scale : public Processor<AVPictureWithFillImage, AVPictureImage> {
  public:
+  /// 拡大縮小結果を記録できる出力イメージのバッファの最大数
+  static const int kMaxScaledOutputCount = 4;
+  /// ピラミッドの結果に求めるPSNRのデフォルト(dB)
+  static const int kDefaultPyramidMinPsnr = 28;
+
   /// コンストラクタ
-  explicit Scale(const SWScaleConfig &swscale_config);
+  /// @param worker_pool ストライプを並列処理するプール(nullptrなら分割しない)
+  /// @param scaler_cache SwsContextとフィルタを借りるキャッシュ
+  ///                     (nullptrなら毎回作成する)
+  /// @param enable_quality_levels 軽い拡大縮小メソッドに切り替え可能にする
+  /// @attention worker_poolにタスクを積んでいる最中のスレッドから
+  ///            Runを呼び出す場合はnullptrを渡すこと
+  Scale(const SWScaleConfig &swscale_config, WorkerPool *worker_pool,
+        ScalerCache *scaler_cache, bool enable_quality_levels);
   /// デストラクタ
   ~Scale();
 
@@ -43,14 +95,213 @@ class Scale : public Processor<AVPictureWithFillImage, AVPictureImage> {
   ErrorCodes Run();
   //-------------------------------------------------------------------
 
+  /// Getter: 最高品質でのストライプの数(分割していなければ1)
+  int stripe_count() const;
+
+  /// Getter: 品質段階の数(品質段階が無効なら1)
+  int quality_level_count() const;
+  /// 品質段階を切り替える(0が設定どおりの品質, 範囲外は丸める)
+  /// @attention Runを呼び出すスレッドからRunの合間に呼び出すこと
+  void SetQualityLevel(int level);
+
+  /// 入力が前回拡大縮小したものと同じ内容ならRunで何もしないようにする
+  /// - 出力イメージのバッファに最後に書き込んだときの入力と比べる
+  /// - 初めてのバッファの場合・品質段階が変わった場合は省略しない
+  /// @attention 出力イメージ(のバッファ)を他から書き換えない場合のみ
+  ///            trueにすること
+  void SetSkipUnchangedInput(bool skip_unchanged_input);
+  /// 入力の変化した行に関係するストライプだけを拡大縮小するようにする
+  /// - 出力をできるだけ細かいストライプに分割しておき、
+  ///   入力の指紋のブロックが変化したストライプだけを処理する
+  /// - ストライプの入力はフィルタのタップが届く範囲を含むので、
+  ///   変化した行の影響を受ける出力の行はすべて処理される
+  /// @attention SetSkipUnchangedInput(true)の場合のみ有効
+  /// @attention Initの前に呼び出すこと
+  void SetIncrementalUpdate(bool incremental_update);
+  /// Getter: 入力が変化していなかったので拡大縮小を省略した回数
+  int64_t skipped_count() const;
+  /// Getter: 拡大縮小を行った回数
+  int64_t scaled_count() const;
+  /// Getter: 拡大縮小を行ったうち、一部のストライプだけで済ませた回数
+  int64_t partially_scaled_count() const;
+
+  /// 縦横とも2倍を超えて縮小する場合にSWScaleの前で1/2の縮小を繰り返す
+  /// - フィルタを使う場合とpoint/fast bilinear(縮小率によらず軽い)では
+  ///   使わない
+  /// - 品質段階はすべて縮小した入力から拡大縮小する
+  /// @attention Initの前に呼び出すこと
+  void SetPyramidDownscale(bool pyramid_downscale);
+  /// ピラミッドの結果がSWScaleだけで縮小した結果に対して保つPSNR(dB)
+  /// - Initで一度だけ画面らしいパターンを縮小して比べ、
+  ///   下回ったらピラミッドを使わない(拡大縮小のたびには比べない)
+  /// - 0以下なら比べない
+  /// @attention Initの前に呼び出すこと
+  void SetPyramidMinPsnr(double pyramid_min_psnr);
+  /// Getter: ピラミッドで1/2に縮小する回数(使っていなければ0)
+  int pyramid_pass_count() const;
+  /// Getter: Initで比べたときのPSNR(dB, 比べていなければ0)
+  double pyramid_psnr() const;
+
+  /// 先にYUV420Pに変換した方が軽い場合は変換してから拡大縮小する
+  /// - ピラミッドを使う場合は使わない
+  /// - 品質段階はすべて変換した入力から拡大縮小する
+  /// @attention Initの前に呼び出すこと
+  void SetConvertFirst(bool convert_first);
+  /// Getter: 先にYUV420Pに変換してから拡大縮小しているか
+  bool is_converting_first() const;
+
  private:
+  /// SwsContextを作成する(キャッシュがあれば借りる)
+  SwsContext* GetContext(int src_width, int src_height,
+                         AVPixelFormat src_format,
+                         int dst_width, int dst_height,
+                         AVPixelFormat dst_format,
+                         int flags, SwsFilter *src_filter);
+  /// GetContextで得たSwsContextを解放する(キャッシュがあれば返却する)
+  void FreeContext(SwsContext *context);
+  /// ピラミッドを使えるなら準備する
+  ErrorCodes InitPyramid(AVPixelFormat input_pixel_format);
+  /// 画面らしいパターンをピラミッドを使って縮小した結果の
+  /// SWScaleだけで縮小した結果に対するPSNR(dB)を求める
+  /// - 一時的なイメージとSwsContextは使い終わったら解放する
+  double MeasurePyramidPsnr(int pass_count, AVPixelFormat input_pixel_format);
+  /// 先にYUV420Pに変換した方が軽ければ準備する
+  ErrorCodes InitConvertFirst(AVPixelFormat input_pixel_format, int flags);
+  /// 品質段階ひとつ分のSwsContextを準備する
+  ErrorCodes InitLevel(int level, AVPixelFormat input_pixel_format,
+                       int flags, SwsFilter *src_filter);
+  /// ストライプに分割して処理できるなら準備する
+  ErrorCodes InitStripes(int level, AVPixelFormat input_pixel_format,
+                         int flags, SwsFilter *src_filter);
+  /// インデックスを指定してストライプを処理する
+  void RunStripe(int level, int index);
+  /// ストライプをワーカープールで並列に処理できるか
+  bool CanRunStripesInParallel() const;
+  /// 変化した行に関係するストライプだけを拡大縮小するか
+  bool IsIncrementalUpdate() const;
+  /// SWScaleを使わずに変換するか
+  bool IsDirectConversion() const;
+  /// SWScaleを使わずにUnscaledConverter/FixedRatioScalerで変換する
+  /// @param previous この出力に前回変換した入力の指紋(nullptrならすべて変換)
+  /// @return 一部のブロックだけを変換したか
+  bool RunDirect(const FrameFingerprint *previous);
+  /// 出力のブロック[first, last)のうち入力が変化したものを変換する
+  void RunDirectBlocks(int first, int last);
+  /// SWScaleに渡す入力
+  /// (ピラミッドを使う場合は最後の段、先に変換する場合は変換した入力)
+  const AVPicture* GetScalerInput() const;
+  /// SWScaleに渡す入力の幅
+  int GetScalerInputWidth() const;
+  /// SWScaleに渡す入力の高さ
+  int GetScalerInputHeight() const;
+  /// SWScaleに渡す入力の行[y, y + height)に関係する入力が変化したか
+  bool IsScalerInputRangeChanged(const FrameFingerprint &previous,
+                                 int y, int height) const;
+  /// ピラミッドの段passの出力の行[y, y + height)を縮小する
+  void RunPyramidRows(int pass, int y, int height);
+  /// ピラミッドのすべての段を縮小する
+  void RunPyramid();
+  /// 入力の行[y, y + height)をYUV420Pに変換する
+  void RunConvertRows(int y, int height);
+  /// 拡大縮小するストライプ(nullptrなら全体)が読む入力の行を変換する
+  void RunConvertFirst(int level, const bool *changed_stripes);
+  /// 出力イメージのバッファの記録を探す(なければ-1)
+  int FindScaledOutput(const void *buffer) const;
+  /// 出力イメージのバッファの記録を追加する(あふれたら古いものを忘れる)
+  int AddScaledOutput(const void *buffer);
+
   /// 拡大縮小パラメータ
   const SWScaleConfig swscale_config_;
 
-  /// 拡大縮小時に設定するフィルタ
+  /// ストライプを並列処理するプール(所有しない)
+  WorkerPool *worker_pool_;
+  /// SwsContextとフィルタを借りるキャッシュ(所有しない)
+  ScalerCache *scaler_cache_;
+
+  /// 軽い拡大縮小メソッドに切り替えられるようにするか
+  const bool enable_quality_levels_;
+  /// 品質段階の数
+  int quality_level_count_;
+  /// 現在の品質段階
+  int quality_level_;
+
+  /// 拡大縮小時に設定するフィルタ(フィルタを使わない場合はnullptr)
   SwsFilter *filter_;
-  /// 拡大縮小用のコンテキスト
-  SwsContext *scaler_;
+  /// filter_のパラメータ
+  ScalerFilterParameter filter_parameter_;
+  /// 品質段階ごとの拡大縮小用のコンテキスト(分割しない場合)
+  SwsContext *scalers_[kMaxScaleQualityLevelCount];
+
+  /// 品質段階ごとのストライプ分割の計画
+  /// (フィルタのタップ数が違うので段階ごとに立てる)
+  ScaleStripePlan stripe_plans_[kMaxScaleQualityLevelCount];
+  /// 品質段階・ストライプごとの拡大縮小用のコンテキスト
+  SwsContext *stripe_scalers_
+      [kMaxScaleQualityLevelCount][ScaleStripePlan::kMaxStripeCount];
+  /// 品質段階・ストライプごとの拡大縮小結果(重なりを含む)
+  AVPictureImage stripe_images_
+      [kMaxScaleQualityLevelCount][ScaleStripePlan::kMaxStripeCount];
+
+  /// 拡大縮小が不要な場合の色空間の変換(使わない場合はis_validがfalse)
+  UnscaledConverter unscaled_converter_;
+  /// 固定の縮小率の場合の縮小と色空間の変換(使わない場合はis_validがfalse)
+  FixedRatioScaler fixed_ratio_scaler_;
+  /// SWScaleを使わない場合の出力のブロックごとに今回変換するか
+  std::vector<uint8_t> changed_blocks_;
+
+  //-------------------------------------------------------------------
+  // ピラミッド
+  //-------------------------------------------------------------------
+  /// 大きく縮小する場合にSWScaleの前で1/2の縮小を繰り返すか
+  bool pyramid_downscale_;
+  /// ピラミッドの結果に求めるPSNR(dB, 0以下なら比べない)
+  double pyramid_min_psnr_;
+  /// 1/2に縮小する回数(使わない場合は0)
+  int pyramid_pass_count_;
+  /// 段ごとの縮小
+  BoxReducer pyramid_reducers_[BoxReducer::kMaxPassCount];
+  /// 段ごとの縮小結果
+  AVPictureImage pyramid_images_[BoxReducer::kMaxPassCount];
+  /// Initで比べたときのPSNR(dB)
+  double pyramid_psnr_;
+
+  //-------------------------------------------------------------------
+  // 変換してから拡大縮小
+  //-------------------------------------------------------------------
+  /// 先にYUV420Pに変換した方が軽い場合に変換してから拡大縮小するか
+  bool convert_first_;
+  /// 変換と拡大縮小の順番の見積もり
+  ScaleOrderPlan order_plan_;
+  /// 入力の大きさのままYUV420Pに変換する(使わない場合は無効)
+  UnscaledConverter input_converter_;
+  /// YUV420Pに変換した入力
+  AVPictureImage converted_input_;
+
+  //-------------------------------------------------------------------
+  // 変化していない入力の検出
+  //-------------------------------------------------------------------
+  /// 入力が変化していなければ拡大縮小を省略するか
+  bool skip_unchanged_input_;
+  /// 今回の入力の指紋
+  FrameFingerprint input_fingerprint_;
+  /// 拡大縮小した結果を書き込んだ出力イメージのバッファ(先頭プレーンの先頭)
+  const void *scaled_outputs_[kMaxScaledOutputCount];
+  /// バッファごとの最後に拡大縮小した入力の指紋
+  FrameFingerprint scaled_fingerprints_[kMaxScaledOutputCount];
+  /// バッファごとの最後に拡大縮小したときの品質段階
+  int scaled_quality_levels_[kMaxScaledOutputCount];
+  /// 記録しているバッファの数
+  int scaled_output_count_;
+  /// 記録があふれたときに次に上書きする位置
+  int next_evicted_output_;
+  /// 拡大縮小を省略した回数
+  int64_t skipped_count_;
+  /// 拡大縮小を行った回数
+  int64_t scaled_count_;
+  /// 変化した行に関係するストライプだけを拡大縮小するか
+  bool incremental_update_;
+  /// 一部のストライプだけを拡大縮小した回数
+  int64_t partially_scaled_count_;
 
   // コピー＆代入禁止
   DISALLOW_COPY_AND_ASSIGN(Scale);
@@ -0,0 +1,118 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/scale_order_plan.cc
+/// scff_imaging::ScaleOrderPlanの定義
+
+#include "scff_imaging/scale_order_plan.h"
+
+#include <algorithm>
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+#include "scff_imaging/scale_stripe_plan.h"
+
+namespace {
+
+/// RGB0の1ピクセルのバイト数
+const int64_t kRGB0Bytes = 4;
+/// SWScaleの中間バッファ(15bit)の1サンプルのバイト数
+const int64_t kIntermediateBytes = 2;
+
+/// SWScale(initFilter)のフィルタのタップ数
+/// (pointは縮小率によらず1、それ以外は縮小時に縮小率に比例して広がる)
+int64_t GetTaps(int flags, int src_size, int dst_size) {
+  if ((flags & SWS_POINT) != 0) {
+    return 1;
+  }
+  const int64_t size_factor =
+      scff_imaging::ScaleStripePlan::GetSizeFactor(flags);
+  return (size_factor * std::max(src_size, dst_size) + dst_size - 1) /
+         dst_size;
+}
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::ScaleOrderPlan
+//=====================================================================
+
+ScaleOrderPlan::ScaleOrderPlan()
+    : scale_first_cost_(0),
+      convert_first_cost_(0) {
+  // nop
+}
+
+ScaleOrderPlan::~ScaleOrderPlan() {
+  // nop
+}
+
+bool ScaleOrderPlan::Build(int src_width, int src_height,
+                           int dst_width, int dst_height, int flags) {
+  scale_first_cost_ = 0;
+  convert_first_cost_ = 0;
+  if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) {
+    return false;
+  }
+
+  const int64_t horizontal_taps = GetTaps(flags, src_width, dst_width);
+  const int64_t vertical_taps = GetTaps(flags, src_height, dst_height);
+  // SWScaleは縦のフィルタが届く入力の行だけを読み込んで水平方向に拡大縮小する
+  const int64_t src_rows =
+      std::min(static_cast<int64_t>(src_height), dst_height * vertical_taps);
+  const int64_t src_pixels = static_cast<int64_t>(src_width) * src_height;
+  const int64_t dst_pixels = static_cast<int64_t>(dst_width) * dst_height;
+
+  // 縦方向の拡大縮小はどちらも出力のYUV420P(1.5サンプル/ピクセル)
+  const int64_t vertical_cost =
+      dst_pixels * 3 / 2 * vertical_taps * kIntermediateBytes;
+
+  // scale first:
+  //    RGB0を読み込んでY/U/Vの中間バッファに書き出し(色差は間引かない)、
+  //    行ごとに輝度1+色差0.5x2サンプル/ピクセルを水平方向に拡大縮小する
+  scale_first_cost_ =
+      src_rows * src_width * (kRGB0Bytes + 3 * kIntermediateBytes) +
+      src_rows * dst_width * 2 * horizontal_taps * kIntermediateBytes +
+      vertical_cost;
+
+  // convert first:
+  //    入力のすべての行をYUV420Pに変換してから、YUV420Pを読み込んで
+  //    中間バッファに書き出し、色差は2行に1行だけ水平方向に拡大縮小する
+  convert_first_cost_ =
+      src_pixels * (kRGB0Bytes * 2 + 3) / 2 +
+      src_rows * src_width * 3 / 2 * (1 + kIntermediateBytes) +
+      src_rows * dst_width * 3 / 2 * horizontal_taps * kIntermediateBytes +
+      vertical_cost;
+
+  return convert_first();
+}
+
+bool ScaleOrderPlan::convert_first() const {
+  return convert_first_cost_ > 0 && convert_first_cost_ < scale_first_cost_;
+}
+
+int64_t ScaleOrderPlan::scale_first_cost() const {
+  return scale_first_cost_;
+}
+
+int64_t ScaleOrderPlan::convert_first_cost() const {
+  return convert_first_cost_;
+}
+}   // namespace scff_imaging
@@ -0,0 +1,72 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/scale_order_plan.h
+/// scff_imaging::ScaleOrderPlanの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_SCALE_ORDER_PLAN_H_
+#define SCFF_DSF_SCFF_IMAGING_SCALE_ORDER_PLAN_H_
+
+#include <cstdint>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// RGB0(32bit)からYUV420P/NV12に拡大縮小する場合の変換と拡大縮小の順番の計画
+/// - scale first: SWScaleひとつでRGB0から直接拡大縮小する
+///   (SWScaleは読み込んだ入力の各ピクセルを変換し、入力のすべての行で
+///   色差も輝度と同じ幅だけ水平方向に拡大縮小する)
+/// - convert first: UnscaledConverterで入力の大きさのままYUV420P(12bit)に
+///   変換してから、SWScaleでYUV420Pのプレーンを拡大縮小する
+/// - 読み書きするバイト数(フィルタのタップ数分の読み込みを含む)を
+///   見積もって軽い方を選ぶ
+/// - 縦のフィルタが届く入力の行だけを読むpointの縮小などでは、
+///   入力のすべての行を変換するconvert firstの方が重くなる
+class ScaleOrderPlan {
+ public:
+  /// コンストラクタ
+  ScaleOrderPlan();
+  /// デストラクタ
+  ~ScaleOrderPlan();
+
+  /// 計画を立てる
+  /// @param flags SWScaleに渡すフラグ
+  /// @retval true    convert firstの方が軽い
+  /// @retval false   scale firstの方が軽い(大きさが不正な場合も)
+  bool Build(int src_width, int src_height,
+             int dst_width, int dst_height, int flags);
+
+  /// Getter: convert firstの方が軽いか
+  bool convert_first() const;
+  /// Getter: scale firstの見積もり(バイト)
+  int64_t scale_first_cost() const;
+  /// Getter: convert firstの見積もり(バイト)
+  int64_t convert_first_cost() const;
+
+ private:
+  /// scale firstの見積もり
+  int64_t scale_first_cost_;
+  /// convert firstの見積もり
+  int64_t convert_first_cost_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(ScaleOrderPlan);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_SCALE_ORDER_PLAN_H_
@@ -0,0 +1,164 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/scale_quality_controller.cc
+/// scff_imaging::ScaleQualityControllerの定義
+
+#include "scff_imaging/scale_quality_controller.h"
+
+namespace {
+
+/// 品質を下げるときに順にたどる拡大縮小メソッド(重い順)
+const scff_imaging::SWScaleFlags kLadderFlags[] = {
+  scff_imaging::SWScaleFlags::kBicubic,
+  scff_imaging::SWScaleFlags::kBilinear,
+  scff_imaging::SWScaleFlags::kFastBilinear
+};
+/// kLadderFlagsの要素数
+const int kLadderFlagsCount = sizeof(kLadderFlags) / sizeof(kLadderFlags[0]);
+
+/// 拡大縮小メソッドのおおよその重さ(大きいほど重い)
+int GetCost(scff_imaging::SWScaleFlags flags) {
+  switch (flags) {
+    case scff_imaging::SWScaleFlags::kFastBilinear:
+    case scff_imaging::SWScaleFlags::kPoint:
+      return 0;
+    case scff_imaging::SWScaleFlags::kBilinear:
+    case scff_imaging::SWScaleFlags::kArea:
+      return 1;
+    case scff_imaging::SWScaleFlags::kBicubic:
+    case scff_imaging::SWScaleFlags::kBicublin:
+    case scff_imaging::SWScaleFlags::kX:
+      return 2;
+    case scff_imaging::SWScaleFlags::kGauss:
+    case scff_imaging::SWScaleFlags::kLanczos:
+    case scff_imaging::SWScaleFlags::kSinc:
+    case scff_imaging::SWScaleFlags::kSpline:
+    default:
+      return 3;
+  }
+}
+}   // namespace
+
+namespace scff_imaging {
+
+int BuildScaleQualityLadder(
+    SWScaleFlags flags,
+    SWScaleFlags (&ladder)[kMaxScaleQualityLevelCount]) {
+  int level_count = 0;
+  ladder[level_count++] = flags;
+  for (int i = 0; i < kLadderFlagsCount; i++) {
+    if (GetCost(kLadderFlags[i]) < GetCost(ladder[level_count - 1]) &&
+        level_count < kMaxScaleQualityLevelCount) {
+      ladder[level_count++] = kLadderFlags[i];
+    }
+  }
+  return level_count;
+}
+
+//=====================================================================
+// scff_imaging::ScaleQualityController
+//=====================================================================
+
+ScaleQualityController::ScaleQualityController()
+    : level_count_(1),
+      frame_interval_(0),
+      level_(0),
+      overrun_frames_(0),
+      headroom_frames_(0),
+      step_down_count_(0),
+      step_up_count_(0) {
+  // nop
+}
+
+ScaleQualityController::~ScaleQualityController() {
+  // nop
+}
+
+void ScaleQualityController::Reset(int level_count, int64_t frame_interval) {
+  level_count_ = level_count;
+  frame_interval_ = frame_interval;
+  level_ = 0;
+  overrun_frames_ = 0;
+  headroom_frames_ = 0;
+  step_down_count_ = 0;
+  step_up_count_ = 0;
+}
+
+bool ScaleQualityController::Record(int64_t processing_time) {
+  if (level_count_ <= 1 || frame_interval_ <= 0) {
+    return false;
+  }
+
+  // 割合の比較は整数で行う
+  const int64_t percent = processing_time * 100LL;
+  if (percent > frame_interval_ * kOverrunPercent) {
+    headroom_frames_ = 0;
+    ++overrun_frames_;
+  } else if (percent < frame_interval_ * kHeadroomPercent) {
+    overrun_frames_ = 0;
+    ++headroom_frames_;
+  } else {
+    // どちらでもなければ現在の段階が適切
+    overrun_frames_ = 0;
+    headroom_frames_ = 0;
+  }
+  return UpdateLevel();
+}
+
+bool ScaleQualityController::RecordSkippedFrames(int skip_count) {
+  if (level_count_ <= 1 || frame_interval_ <= 0 || skip_count <= 0) {
+    return false;
+  }
+
+  headroom_frames_ = 0;
+  overrun_frames_ += skip_count;
+  return UpdateLevel();
+}
+
+bool ScaleQualityController::UpdateLevel() {
+  // 段階を変えたら(変えられなくても)数え直す
+  if (overrun_frames_ >= kStepDownFrames) {
+    overrun_frames_ = 0;
+    if (level_ + 1 < level_count_) {
+      ++level_;
+      ++step_down_count_;
+      return true;
+    }
+  } else if (headroom_frames_ >= kStepUpFrames) {
+    headroom_frames_ = 0;
+    if (level_ > 0) {
+      --level_;
+      ++step_up_count_;
+      return true;
+    }
+  }
+  return false;
+}
+
+int ScaleQualityController::level() const {
+  return level_;
+}
+
+int64_t ScaleQualityController::step_down_count() const {
+  return step_down_count_;
+}
+
+int64_t ScaleQualityController::step_up_count() const {
+  return step_up_count_;
+}
+}   // namespace scff_imaging
@@ -0,0 +1,115 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/scale_quality_controller.h
+/// scff_imaging::ScaleQualityControllerの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_SCALE_QUALITY_CONTROLLER_H_
+#define SCFF_DSF_SCFF_IMAGING_SCALE_QUALITY_CONTROLLER_H_
+
+#include <cstdint>
+
+#include "scff_imaging/common.h"
+#include "scff_imaging/imaging_types.h"
+
+namespace scff_imaging {
+
+/// 拡大縮小の品質段階の最大数
+const int kMaxScaleQualityLevelCount = 4;
+
+/// 拡大縮小メソッドの品質段階(0が設定どおりで、数字が大きいほど軽い)を作る
+/// - 設定されたメソッドの後に、それより軽い
+///   Bicubic→Bilinear→FastBilinearを順に並べる
+/// @param flags 設定された拡大縮小メソッド
+/// @param[out] ladder 品質段階ごとの拡大縮小メソッド
+/// @return 品質段階の数(設定されたメソッドより軽いものがなければ1)
+int BuildScaleQualityLadder(
+    SWScaleFlags flags,
+    SWScaleFlags (&ladder)[kMaxScaleQualityLevelCount]);
+
+/// フレームあたりの処理時間から拡大縮小の品質段階を決める
+/// - 処理時間がフレーム間隔の大部分を占める状態が続いたら1段階下げる
+/// - 十分な余裕がある状態がしばらく続いたら1段階上げる
+/// - 上げ下げの条件に差をつけて、境界付近で段階が振動しないようにする
+/// @attention スレッドセーフではない(レイアウトを実行するスレッドで使うこと)
+class ScaleQualityController {
+ public:
+  /// 何フレーム続けて超過したら段階を下げるか
+  static const int kStepDownFrames = 3;
+  /// 何フレーム続けて余裕があったら段階を上げるか
+  static const int kStepUpFrames = 60;
+  /// フレーム間隔に対する処理時間がこの割合(%)を超えたら超過とみなす
+  static const int kOverrunPercent = 90;
+  /// フレーム間隔に対する処理時間がこの割合(%)未満なら余裕があるとみなす
+  static const int kHeadroomPercent = 50;
+
+  /// コンストラクタ
+  ScaleQualityController();
+  /// デストラクタ
+  ~ScaleQualityController();
+
+  /// 最高品質から計測をやり直す
+  /// @param level_count 品質段階の数(1以下なら段階を変えない)
+  /// @param frame_interval フレーム間隔(100nSec)
+  void Reset(int level_count, int64_t frame_interval);
+
+  /// 1フレーム分の処理時間を記録する
+  /// @param processing_time 1フレームの処理にかかった時間(100nSec)
+  /// @retval true 品質段階が変わった(level()で取得して適用すること)
+  /// @retval false 品質段階は変わらない
+  bool Record(int64_t processing_time);
+
+  /// 締め切りに間に合わずスキップしたフレームを記録する
+  /// - スキップしたフレームはすべて超過したフレームとして数える
+  /// @param skip_count スキップしたフレームの数
+  /// @retval true 品質段階が変わった(level()で取得して適用すること)
+  /// @retval false 品質段階は変わらない
+  bool RecordSkippedFrames(int skip_count);
+
+  /// Getter: 現在の品質段階(0が最高品質)
+  int level() const;
+  /// Getter: 段階を下げた回数
+  int64_t step_down_count() const;
+  /// Getter: 段階を上げた回数
+  int64_t step_up_count() const;
+
+ private:
+  /// 連続したフレームの数から品質段階を上げ下げする
+  /// @retval true 品質段階が変わった
+  bool UpdateLevel();
+
+  /// 品質段階の数
+  int level_count_;
+  /// フレーム間隔(100nSec)
+  int64_t frame_interval_;
+  /// 現在の品質段階
+  int level_;
+  /// 連続して超過したフレームの数
+  int overrun_frames_;
+  /// 連続して余裕があったフレームの数
+  int headroom_frames_;
+  /// 段階を下げた回数
+  int64_t step_down_count_;
+  /// 段階を上げた回数
+  int64_t step_up_count_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(ScaleQualityController);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_SCALE_QUALITY_CONTROLLER_H_
@@ -0,0 +1,223 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/scale_stripe_plan.cc
+/// scff_imaging::ScaleStripePlanの定義
+
+#include "scff_imaging/scale_stripe_plan.h"
+
+#include <algorithm>
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+namespace {
+
+/// 最大公約数
+int GreatestCommonDivisor(int a, int b) {
+  while (b != 0) {
+    const int r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+/// 最小公倍数(オーバーフローする場合は-1)
+int LeastCommonMultiple(int a, int b) {
+  const long long lcm =
+      static_cast<long long>(a / GreatestCommonDivisor(a, b)) * b;
+  return lcm > 0x3FFFFFFF ? -1 : static_cast<int>(lcm);
+}
+
+/// a/bの切り上げ
+int DivideRoundUp(int a, int b) {
+  return (a + b - 1) / b;
+}
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::ScaleStripePlan
+//=====================================================================
+
+ScaleStripePlan::ScaleStripePlan()
+    : stripe_count_(1) {
+  for (int i = 0; i < kMaxStripeCount; i++) {
+    stripes_[i].src_y = 0;
+    stripes_[i].src_height = 0;
+    stripes_[i].scaled_y = 0;
+    stripes_[i].scaled_height = 0;
+    stripes_[i].dst_y = 0;
+    stripes_[i].dst_height = 0;
+  }
+}
+
+ScaleStripePlan::~ScaleStripePlan() {
+  // nop
+}
+
+bool ScaleStripePlan::Build(int src_height, int dst_height,
+                            int log2_chroma_h, int log2_src_chroma_h,
+                            int filter_radius,
+                            int max_stripe_count, bool exact_only) {
+  // 分割しない場合は全体で1ストライプ
+  stripe_count_ = 1;
+  stripes_[0].src_y = 0;
+  stripes_[0].src_height = src_height;
+  stripes_[0].scaled_y = 0;
+  stripes_[0].scaled_height = dst_height;
+  stripes_[0].dst_y = 0;
+  stripes_[0].dst_height = dst_height;
+
+  if (src_height <= 0 || dst_height <= 0 || max_stripe_count < 2) {
+    return false;
+  }
+
+  // 色差の高さが切り上げになると比が崩れるので分割しない
+  const int chroma_alignment = 1 << log2_chroma_h;
+  if (dst_height % chroma_alignment != 0) {
+    return false;
+  }
+  const int src_chroma_alignment = 1 << log2_src_chroma_h;
+  if (src_height % src_chroma_alignment != 0) {
+    return false;
+  }
+
+  // 比を既約分数src_unit/dst_unitで表し、
+  // ストライプの境界はdst_unit(とディザ周期、色差の間引き)の倍数に揃える
+  const int gcd = GreatestCommonDivisor(src_height, dst_height);
+  const int src_unit = src_height / gcd;
+  const int dst_unit = dst_height / gcd;
+  if (exact_only && kFixedPointOne % dst_unit != 0) {
+    // ステップに丸め誤差が出るのでストライプ単位ではサンプリング位置がずれる
+    return false;
+  }
+  int alignment = LeastCommonMultiple(dst_unit, kRowAlignment);
+  if (alignment > 0) {
+    alignment = LeastCommonMultiple(alignment, chroma_alignment);
+  }
+  if (alignment > 0 && src_unit % src_chroma_alignment != 0) {
+    // 入力の境界(出力の境界/dst_unit*src_unit)も色差の間引き単位に揃える
+    alignment =
+        LeastCommonMultiple(alignment, dst_unit * src_chroma_alignment);
+  }
+  if (alignment <= 0 || alignment * 2 > dst_height) {
+    return false;
+  }
+
+  // 重なり(出力側)はフィルタ半径を出力の行数に直してalignmentの倍数に切り上げ
+  const long long overlap_rows =
+      (static_cast<long long>(filter_radius) * dst_unit + src_unit - 1) /
+      src_unit;
+  if (overlap_rows > dst_height) {
+    return false;
+  }
+  const int dst_overlap =
+      DivideRoundUp(static_cast<int>(overlap_rows), alignment) * alignment;
+
+  // 境界を決める
+  const int stripe_count =
+      std::min(std::min(max_stripe_count, kMaxStripeCount),
+               dst_height / alignment);
+  if (stripe_count < 2) {
+    return false;
+  }
+  int boundaries[kMaxStripeCount + 1];
+  int boundary_count = 0;
+  boundaries[boundary_count++] = 0;
+  for (int i = 1; i < stripe_count; i++) {
+    const int boundary =
+        (dst_height * i / stripe_count + alignment / 2) / alignment *
+        alignment;
+    if (boundary > boundaries[boundary_count - 1] && boundary < dst_height) {
+      boundaries[boundary_count++] = boundary;
+    }
+  }
+  boundaries[boundary_count++] = dst_height;
+  if (boundary_count - 1 < 2) {
+    return false;
+  }
+
+  // 各ストライプの範囲を求める
+  for (int i = 0; i < boundary_count - 1; i++) {
+    const int dst_begin = boundaries[i];
+    const int dst_end = boundaries[i + 1];
+    const int scaled_begin = std::max(0, dst_begin - dst_overlap);
+    const int scaled_end = std::min(dst_height, dst_end + dst_overlap);
+    // scaled_begin/scaled_endはdst_unitの倍数か両端なので入力側の行は割り切れる
+    const int src_begin = scaled_begin / dst_unit * src_unit;
+    const int src_end = scaled_end == dst_height ?
+        src_height : scaled_end / dst_unit * src_unit;
+
+    ScaleStripe &stripe = stripes_[i];
+    stripe.src_y = src_begin;
+    stripe.src_height = src_end - src_begin;
+    stripe.scaled_y = scaled_begin;
+    stripe.scaled_height = scaled_end - scaled_begin;
+    stripe.dst_y = dst_begin;
+    stripe.dst_height = dst_end - dst_begin;
+  }
+  stripe_count_ = boundary_count - 1;
+  return true;
+}
+
+int ScaleStripePlan::stripe_count() const {
+  return stripe_count_;
+}
+
+const ScaleStripe& ScaleStripePlan::stripe(int index) const {
+  return stripes_[index];
+}
+
+int ScaleStripePlan::GetSizeFactor(int flags) {
+  if (flags & (SWS_BICUBIC | SWS_BICUBLIN)) return 4;
+  if (flags & SWS_X) return 8;
+  if (flags & SWS_AREA) return 2;     // 拡大時はbilinearになる
+  if (flags & SWS_GAUSS) return 8;
+  if (flags & SWS_LANCZOS) return 6;  // param[0]のデフォルトは3
+  if (flags & SWS_SINC) return 20;
+  if (flags & SWS_SPLINE) return 20;
+  if (flags & (SWS_BILINEAR | SWS_FAST_BILINEAR)) return 2;
+  // point
+  return 1;
+}
+
+int ScaleStripePlan::GetFilterRadius(int flags, int src_height,
+                                     int dst_height, int log2_chroma_h,
+                                     int log2_src_chroma_h,
+                                     int extra_taps) {
+  // 縮小時はフィルタ幅が入力の行数に比例して広がる
+  // 色差は間引かれている分だけ縮小率が大きい
+  const int chroma_height = (dst_height >> log2_chroma_h) > 0 ?
+      (dst_height >> log2_chroma_h) : 1;
+  // 入力の色差が間引かれている場合は色差の行単位で求めてから入力の行に直す
+  const int src_chroma_height = (src_height >> log2_src_chroma_h) > 0 ?
+      (src_height >> log2_src_chroma_h) : 1;
+  const int scale_numerator = std::max(src_chroma_height, chroma_height);
+  const int size_factor = GetSizeFactor(flags);
+  const long long radius =
+      (static_cast<long long>(size_factor + extra_taps) * scale_numerator +
+       2 * chroma_height - 1) / (2 * chroma_height);
+  // フィルタ位置の丸めと色差のサンプリング位置のずれの分だけ余裕を持たせる
+  const long long kMargin = 2;
+  return static_cast<int>(std::min((radius + kMargin) << log2_src_chroma_h,
+                                   static_cast<long long>(src_height)));
+}
+}   // namespace scff_imaging
@@ -0,0 +1,117 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/scale_stripe_plan.h
+/// scff_imaging::ScaleStripePlanの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_SCALE_STRIPE_PLAN_H_
+#define SCFF_DSF_SCFF_IMAGING_SCALE_STRIPE_PLAN_H_
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// 縦方向に分割した拡大縮小の1ストライプ分
+/// - 入力[src_y, src_y + src_height)を単独で拡大縮小すると
+///   出力[scaled_y, scaled_y + scaled_height)に相当する画像になる
+/// - そのうち[dst_y, dst_y + dst_height)のみを出力に書き込む
+struct ScaleStripe {
+  /// 入力の開始行(フィルタ用の重なりを含む)
+  int src_y;
+  /// 入力の行数(フィルタ用の重なりを含む)
+  int src_height;
+  /// 拡大縮小結果の開始行(フィルタ用の重なりを含む)
+  int scaled_y;
+  /// 拡大縮小結果の行数(フィルタ用の重なりを含む)
+  int scaled_height;
+  /// 出力に書き込む開始行
+  int dst_y;
+  /// 出力に書き込む行数
+  int dst_height;
+};
+
+/// 出力を水平方向の帯(ストライプ)に分割して拡大縮小するための計画
+/// - 各ストライプの入力と出力の比は全体の比と厳密に一致させる
+/// - ストライプの境界はフィルタのタップが届く範囲だけ重ねて処理し、
+///   重なった部分は捨てる
+/// - 比を既約分数で表したときの分母(出力側)が2の累乗なら、SWScaleの
+///   16.16固定小数点のステップが誤差なしになるので、サンプリング位置と
+///   フィルタ係数は一枚で処理した場合と完全に一致する
+///   (それ以外の比では位置が1/65536行単位でずれ、最下位ビットが変わりうる)
+/// - 入力の色差が縦方向に間引かれている(YUV420P)場合は、入力の境界も
+///   色差の間引き単位に揃える
+class ScaleStripePlan {
+ public:
+  /// ストライプの最大数
+  static const int kMaxStripeCount = 16;
+
+  /// コンストラクタ
+  ScaleStripePlan();
+  /// デストラクタ
+  ~ScaleStripePlan();
+
+  /// 計画を立てる
+  /// @param src_height 入力の高さ
+  /// @param dst_height 出力の高さ
+  /// @param log2_chroma_h 出力の色差の縦方向の間引き(I420なら1)
+  /// @param log2_src_chroma_h 入力の色差の縦方向の間引き(RGB0なら0)
+  /// @param filter_radius フィルタのタップが届く入力の行数
+  /// @param max_stripe_count ストライプ数の上限
+  /// @param exact_only 一枚で処理した場合と完全に一致する比の場合のみ分割する
+  /// @retval true 2つ以上のストライプに分割できた
+  /// @retval false 分割できない(stripe_count()は1になる)
+  bool Build(int src_height, int dst_height, int log2_chroma_h,
+             int log2_src_chroma_h, int filter_radius,
+             int max_stripe_count, bool exact_only);
+
+  /// Getter: ストライプの数
+  int stripe_count() const;
+  /// Getter: ストライプ
+  const ScaleStripe& stripe(int index) const;
+
+  /// SWScaleの縦方向のフィルタのタップが届く入力の行数を(多めに)求める
+  /// @param flags SWScaleに渡すフラグ
+  /// @param src_height 入力の高さ
+  /// @param dst_height 出力の高さ
+  /// @param log2_chroma_h 出力の色差の縦方向の間引き
+  /// @param log2_src_chroma_h 入力の色差の縦方向の間引き
+  /// @param extra_taps 追加のフィルタ(SwsFilter)の長さ
+  static int GetFilterRadius(int flags, int src_height, int dst_height,
+                             int log2_chroma_h, int log2_src_chroma_h,
+                             int extra_taps);
+  /// SWScale(initFilter)のフィルタ幅の係数(拡大時のタップ数)を求める
+  /// @param flags SWScaleに渡すフラグ
+  static int GetSizeFactor(int flags);
+
+ private:
+  /// ストライプの開始行を揃える単位
+  /// (SWScaleのディザパターンは8行周期)
+  static const int kRowAlignment = 8;
+  /// SWScaleのステップの固定小数点の1
+  static const int kFixedPointOne = 1 << 16;
+
+  /// ストライプの数
+  int stripe_count_;
+  /// ストライプ
+  ScaleStripe stripes_[kMaxStripeCount];
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(ScaleStripePlan);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_SCALE_STRIPE_PLAN_H_
@@ -0,0 +1,233 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/scaler_cache.cc
+/// scff_imaging::ScalerCacheの定義
+
+#include "scff_imaging/scaler_cache.h"
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+#include "scff_imaging/debug.h"
+
+namespace {
+
+/// フィルタのパラメータが同じか
+/// @attention 浮動小数点数の比較(同じ設定から作った値どうしを比べる)
+bool IsSameFilterParameter(const scff_imaging::ScalerFilterParameter &a,
+                           const scff_imaging::ScalerFilterParameter &b) {
+  return a.luma_gblur == b.luma_gblur &&
+         a.chroma_gblur == b.chroma_gblur &&
+         a.luma_sharpen == b.luma_sharpen &&
+         a.chroma_sharpen == b.chroma_sharpen &&
+         a.chroma_hshift == b.chroma_hshift &&
+         a.chroma_vshift == b.chroma_vshift;
+}
+
+/// コンテキストの作成条件が同じか
+bool IsSameKey(const scff_imaging::ScalerKey &a,
+               const scff_imaging::ScalerKey &b) {
+  if (a.src_width != b.src_width ||
+      a.src_height != b.src_height ||
+      a.src_format != b.src_format ||
+      a.dst_width != b.dst_width ||
+      a.dst_height != b.dst_height ||
+      a.dst_format != b.dst_format ||
+      a.flags != b.flags ||
+      a.filter_enabled != b.filter_enabled) {
+    return false;
+  }
+  return !a.filter_enabled || IsSameFilterParameter(a.filter, b.filter);
+}
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::ScalerCache
+//=====================================================================
+
+ScalerCache::ScalerCache(int context_capacity, int filter_capacity)
+    : context_capacity_(context_capacity),
+      filter_capacity_(filter_capacity) {
+  stats_.context_hits = 0LL;
+  stats_.context_misses = 0LL;
+  stats_.context_evictions = 0LL;
+  stats_.filter_hits = 0LL;
+  stats_.filter_misses = 0LL;
+  stats_.leased_context_count = 0;
+  stats_.idle_context_count = 0;
+  stats_.filter_count = 0;
+  // 明示的に初期化していない
+  // leased_contexts_
+  // idle_contexts_
+  // filters_
+}
+
+ScalerCache::~ScalerCache() {
+  ASSERT(leased_contexts_.empty());
+  for (auto it = idle_contexts_.begin(); it != idle_contexts_.end(); ++it) {
+    sws_freeContext(it->context);
+  }
+  for (auto it = filters_.begin(); it != filters_.end(); ++it) {
+    ASSERT(it->lease_count == 0);
+    sws_freeFilter(it->filter);
+  }
+}
+
+//-------------------------------------------------------------------
+// コンテキスト
+//-------------------------------------------------------------------
+
+SwsContext* ScalerCache::AcquireContext(const ScalerKey &key) {
+  SwsFilter *filter = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = idle_contexts_.begin(); it != idle_contexts_.end(); ++it) {
+      if (IsSameKey(it->key, key)) {
+        ++stats_.context_hits;
+        leased_contexts_.splice(leased_contexts_.begin(), idle_contexts_, it);
+        return leased_contexts_.front().context;
+      }
+    }
+    ++stats_.context_misses;
+    if (key.filter_enabled) {
+      filter = AcquireFilterLocked(key.filter);
+      if (filter == nullptr) {
+        return nullptr;
+      }
+    }
+  }
+
+  // 作成には時間がかかるのでロックの外で行う
+  SwsContext *context = sws_getCachedContext(nullptr,
+      key.src_width, key.src_height, key.src_format,
+      key.dst_width, key.dst_height, key.dst_format,
+      key.flags, filter, nullptr, nullptr);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (filter != nullptr) {
+    // フィルタは作成時にしか使わない
+    ReleaseFilterLocked(filter);
+  }
+  if (context == nullptr) {
+    return nullptr;
+  }
+  ContextEntry entry;
+  entry.key = key;
+  entry.context = context;
+  leased_contexts_.push_front(entry);
+  return context;
+}
+
+void ScalerCache::ReleaseContext(SwsContext *context) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = leased_contexts_.begin();
+       it != leased_contexts_.end(); ++it) {
+    if (it->context != context) continue;
+    idle_contexts_.splice(idle_contexts_.begin(), leased_contexts_, it);
+    // 容量を超えたら最も長く使われていないものから破棄する
+    while (static_cast<int>(idle_contexts_.size()) > context_capacity_) {
+      sws_freeContext(idle_contexts_.back().context);
+      idle_contexts_.pop_back();
+      ++stats_.context_evictions;
+    }
+    return;
+  }
+  ASSERT(false);
+}
+
+//-------------------------------------------------------------------
+// フィルタ
+//-------------------------------------------------------------------
+
+SwsFilter* ScalerCache::AcquireFilter(
+    const ScalerFilterParameter &parameter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return AcquireFilterLocked(parameter);
+}
+
+void ScalerCache::ReleaseFilter(SwsFilter *filter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReleaseFilterLocked(filter);
+}
+
+SwsFilter* ScalerCache::AcquireFilterLocked(
+    const ScalerFilterParameter &parameter) {
+  for (auto it = filters_.begin(); it != filters_.end(); ++it) {
+    if (IsSameFilterParameter(it->parameter, parameter)) {
+      ++stats_.filter_hits;
+      ++it->lease_count;
+      filters_.splice(filters_.begin(), filters_, it);
+      return filters_.front().filter;
+    }
+  }
+
+  ++stats_.filter_misses;
+  SwsFilter *filter = sws_getDefaultFilter(
+      parameter.luma_gblur,
+      parameter.chroma_gblur,
+      parameter.luma_sharpen,
+      parameter.chroma_sharpen,
+      parameter.chroma_hshift,
+      parameter.chroma_vshift,
+      0);
+  if (filter == nullptr) {
+    return nullptr;
+  }
+  FilterEntry entry;
+  entry.parameter = parameter;
+  entry.filter = filter;
+  entry.lease_count = 1;
+  filters_.push_front(entry);
+  return filter;
+}
+
+void ScalerCache::ReleaseFilterLocked(SwsFilter *filter) {
+  for (auto it = filters_.begin(); it != filters_.end(); ++it) {
+    if (it->filter != filter) continue;
+    ASSERT(it->lease_count > 0);
+    --it->lease_count;
+    break;
+  }
+
+  // 容量を超えたら誰も使っていないものを古い順に破棄する
+  int count = static_cast<int>(filters_.size());
+  auto it = filters_.end();
+  while (count > filter_capacity_ && it != filters_.begin()) {
+    --it;
+    if (it->lease_count == 0) {
+      sws_freeFilter(it->filter);
+      it = filters_.erase(it);
+      --count;
+    }
+  }
+}
+
+//-------------------------------------------------------------------
+
+ScalerCacheStats ScalerCache::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ScalerCacheStats stats = stats_;
+  stats.leased_context_count = static_cast<int>(leased_contexts_.size());
+  stats.idle_context_count = static_cast<int>(idle_contexts_.size());
+  stats.filter_count = static_cast<int>(filters_.size());
+  return stats;
+}
+}   // namespace scff_imaging
@@ -0,0 +1,174 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/scaler_cache.h
+/// scff_imaging::ScalerCacheの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_SCALER_CACHE_H_
+#define SCFF_DSF_SCFF_IMAGING_SCALER_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "scff_imaging/common.h"
+
+struct SwsContext;
+struct SwsFilter;
+
+namespace scff_imaging {
+
+/// SWScaleのフィルタ(sws_getDefaultFilter)のパラメータ
+struct ScalerFilterParameter {
+  /// 輝度のガウスぼかし
+  float luma_gblur;
+  /// 色差のガウスぼかし
+  float chroma_gblur;
+  /// 輝度のシャープ化
+  float luma_sharpen;
+  /// 色差のシャープ化
+  float chroma_sharpen;
+  /// 水平方向のワープ
+  float chroma_hshift;
+  /// 垂直方向のワープ
+  float chroma_vshift;
+};
+
+/// SWScaleのコンテキスト(sws_getContext)の作成条件
+struct ScalerKey {
+  /// 入力の幅
+  int src_width;
+  /// 入力の高さ
+  int src_height;
+  /// 入力のピクセルフォーマット
+  AVPixelFormat src_format;
+  /// 出力の幅
+  int dst_width;
+  /// 出力の高さ
+  int dst_height;
+  /// 出力のピクセルフォーマット
+  AVPixelFormat dst_format;
+  /// 拡大縮小メソッドと丸め処理(SWS_*)
+  int flags;
+  /// 入力にフィルタをかけるか(falseならfilterは比較しない)
+  bool filter_enabled;
+  /// フィルタのパラメータ
+  ScalerFilterParameter filter;
+};
+
+/// ScalerCacheの統計
+struct ScalerCacheStats {
+  /// コンテキストを使いまわした回数
+  int64_t context_hits;
+  /// コンテキストを作成した回数
+  int64_t context_misses;
+  /// 容量を超えたために破棄したコンテキストの数
+  int64_t context_evictions;
+  /// フィルタを使いまわした回数
+  int64_t filter_hits;
+  /// フィルタを作成した回数
+  int64_t filter_misses;
+  /// 貸し出し中のコンテキストの数
+  int leased_context_count;
+  /// 貸し出していない(次に使いまわせる)コンテキストの数
+  int idle_context_count;
+  /// 保持しているフィルタの数(貸し出し中のものを含む)
+  int filter_count;
+};
+
+/// SWScaleのコンテキストとフィルタをレイアウトの作り直しをまたいで使いまわす
+/// - コンテキストは同時に1つのScaleでしか使えないので貸し出し式にする
+///   (同じ条件の要素が並列に動いても別々のコンテキストを貸し出す)
+/// - 返却されたコンテキストは最近使った順に保持し、容量を超えたら
+///   最も長く使われていないものから破棄する
+/// - フィルタは変更されないので貸し出し中でも共有し、誰も使っていない
+///   ものを最近使った順に容量まで保持する
+/// - どのスレッドから呼び出してもよい
+class ScalerCache {
+ public:
+  /// 貸し出していないコンテキストを保持する数のデフォルト
+  static const int kDefaultContextCapacity = 32;
+  /// フィルタを保持する数のデフォルト
+  static const int kDefaultFilterCapacity = 8;
+
+  /// コンストラクタ
+  /// @param context_capacity 貸し出していないコンテキストを保持する数
+  /// @param filter_capacity フィルタを保持する数
+  ScalerCache(int context_capacity, int filter_capacity);
+  /// デストラクタ
+  /// @attention 貸し出したコンテキストはすべて返却されていること
+  ~ScalerCache();
+
+  /// 条件に合うコンテキストを貸し出す(なければ作成する)
+  /// @retval nullptr 作成に失敗した
+  SwsContext* AcquireContext(const ScalerKey &key);
+  /// 貸し出したコンテキストを返却する
+  void ReleaseContext(SwsContext *context);
+  /// 条件に合うフィルタを貸し出す(なければ作成する)
+  /// @retval nullptr 作成に失敗した
+  SwsFilter* AcquireFilter(const ScalerFilterParameter &parameter);
+  /// 貸し出したフィルタを返却する
+  void ReleaseFilter(SwsFilter *filter);
+
+  /// 統計を取得する
+  ScalerCacheStats GetStats() const;
+
+ private:
+  /// コンテキストと作成条件
+  struct ContextEntry {
+    ScalerKey key;
+    SwsContext *context;
+  };
+  /// フィルタと作成条件
+  struct FilterEntry {
+    ScalerFilterParameter parameter;
+    SwsFilter *filter;
+    /// 貸し出している数
+    int lease_count;
+  };
+
+  /// フィルタを貸し出す(ロック済みであること)
+  SwsFilter* AcquireFilterLocked(const ScalerFilterParameter &parameter);
+  /// フィルタを返却する(ロック済みであること)
+  void ReleaseFilterLocked(SwsFilter *filter);
+
+  /// 貸し出していないコンテキストを保持する数
+  const int context_capacity_;
+  /// フィルタを保持する数
+  const int filter_capacity_;
+
+  /// ロック
+  mutable std::mutex mutex_;
+  /// 貸し出し中のコンテキスト
+  std::list<ContextEntry> leased_contexts_;
+  /// 貸し出していないコンテキスト(最近返却された順)
+  std::list<ContextEntry> idle_contexts_;
+  /// フィルタ(最近使われた順)
+  std::list<FilterEntry> filters_;
+  /// 統計(数はGetStatsで数える)
+  ScalerCacheStats stats_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(ScalerCache);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_SCALER_CACHE_H_
@@ -22,6 +22,7 @@
 
 #include "scff_imaging/debug.h"
 #include "scff_imaging/utilities.h"
+#include "scff_imaging/trace.h"
 
 extern OSVERSIONINFO g_osInfo;
 
@@ -207,7 +208,8 @@ void ScreenCapture::DrawCursor(HDC dc, HWND window,
   }
 }
 
-ErrorCodes ScreenCapture::Run() {
+ErrorCodes ScreenCapture::Capture() {
+  SCFF_TRACE_SCOPE("ScreenCapture::Capture");
   // 何かエラーが発生している場合は何もしない
   if (GetCurrentError() != ErrorCodes::kNoError) {
     return GetCurrentError();
@@ -236,20 +238,37 @@ ErrorCodes ScreenCapture::Run() {
     ReleaseDC(parameters_[i].window, window_dc);
   }
 
+  // エラー発生なし
+  return GetCurrentError();
+}
+
+void ScreenCapture::Transfer(int index) {
+  SCFF_TRACE_SCOPE("ScreenCapture::Transfer");
+  ASSERT(0 <= index && index < size());
+
   // 以下オフスクリーンビットマップに対する操作
-  for (int i = 0; i < size(); i++) {
-    if (parameters_[i].show_cursor) {
-      DrawCursor(dc_for_bitblt_[i], parameters_[i].window,
-                 parameters_[i].clipping_x, parameters_[i].clipping_y);
-    }
+  if (parameters_[index].show_cursor) {
+    DrawCursor(dc_for_bitblt_[index], parameters_[index].window,
+               parameters_[index].clipping_x, parameters_[index].clipping_y);
+  }
+
+  // OutputImageへの書き込み
+  GetDIBits(dc_for_bitblt_[index],
+            image_for_bitblt_[index].windows_ddb(),
+            0, parameters_[index].clipping_height,
+            GetOutputImage(index)->raw_bitmap(),
+            &(info_for_getdibits_[index]),
+            DIB_RGB_COLORS);
+}
 
-    // OutputImageへの書き込み
-    GetDIBits(dc_for_bitblt_[i],
-              image_for_bitblt_[i].windows_ddb(),
-              0, parameters_[i].clipping_height,
-              GetOutputImage(i)->raw_bitmap(),
-              &(info_for_getdibits_[i]),
-              DIB_RGB_COLORS);
+ErrorCodes ScreenCapture::Run() {
+  const ErrorCodes error_capture = Capture();
+  if (error_capture != ErrorCodes::kNoError) {
+    return error_capture;
+  }
+
+  for (int i = 0; i < size(); i++) {
+    Transfer(i);
   }
 
   // エラー発生なし
@@ -47,6 +47,13 @@ class ScreenCapture : public Processor<void, AVPictureWithFillImage> {
   ErrorCodes Run();
   //-------------------------------------------------------------------
 
+  /// Runの前半: 全てのウインドウを検証してオフスクリーンにBitBltする
+  ErrorCodes Capture();
+  /// Runの後半: カーソルを描画してOutputImage(index)に書き込む
+  /// @attention オフスクリーンビットマップのみを操作するので、
+  ///            Capture後であればインデックスごとに別スレッドから呼び出してよい
+  void Transfer(int index);
+
  private:
   /// 渡されたDCにカーソルを描画する
   void DrawCursor(HDC dc, HWND window, int clipping_x, int clipping_y);
@@ -25,6 +25,7 @@
 #include "scff_imaging/utilities.h"
 #include "scff_imaging/scale.h"
 #include "scff_imaging/padding.h"
+#include "scff_imaging/trace.h"
 
 namespace scff_imaging {
 
@@ -132,7 +133,7 @@ ErrorCodes SplashScreen::Init() {
   ZeroMemory(&config, sizeof(config));
   config.flags = SWScaleFlags::kArea;
 
-  Scale *scale = new Scale(config);
+  Scale *scale = new Scale(config, nullptr, nullptr, false);
   scale->SetInputImage(&resource_image_);
   if (utilities::CanUseDrawUtils(GetOutputImage()->pixel_format())) {
     // パディング可能ならバッファをはさむ
@@ -172,6 +173,7 @@ ErrorCodes SplashScreen::Init() {
 }
 
 ErrorCodes SplashScreen::Run() {
+  SCFF_TRACE_SCOPE("SplashScreen::Run");
   if (GetCurrentError() != ErrorCodes::kNoError) {
     // 何かエラーが発生している場合は何もしない
     return GetCurrentError();
@@ -0,0 +1,265 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/trace.cc
+/// scff_imaging::traceの定義
+
+#include "scff_imaging/trace.h"
+
+#if defined(SCFF_IMAGING_TRACE)
+
+#include <atomic>
+#include <fstream>
+#include <vector>
+
+#include "scff_imaging/platform.h"
+
+namespace {
+
+/// 記録済みのイベント(出力用のコピー)
+struct TraceEvent {
+  /// 区間の名前
+  const char *name;
+  /// 開始時刻(100nSec)
+  int64_t begin;
+  /// 終了時刻(100nSec)
+  int64_t end;
+};
+
+/// 1スレッド分のイベントを保持するリングバッファ
+/// - 書き込みは所有しているスレッドのみ(単一ライター)
+/// - 読み込み側は書き込み中に上書きされた可能性のあるイベントを捨てる
+class TraceRing {
+ public:
+  /// コンストラクタ
+  TraceRing()
+      : reserved_(0),
+        head_(0) {
+    // nop
+  }
+
+  /// イベントを追加する(所有しているスレッドのみ)
+  void Record(const char *name, int64_t begin, int64_t end) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    Slot &slot = slots_[head % scff_imaging::trace::kEventsPerThread];
+    // 上書きを始める前に予約済みの位置を進めておく
+    reserved_.store(head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  /// 上書きされていないイベントをコピーする(どのスレッドからでも可)
+  void Snapshot(std::vector<TraceEvent> *events) const {
+    const uint64_t kCapacity = scff_imaging::trace::kEventsPerThread;
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    const uint64_t first = head > kCapacity ? head - kCapacity : 0;
+
+    std::vector<TraceEvent> copied;
+    copied.reserve(static_cast<size_t>(head - first));
+    for (uint64_t i = first; i < head; i++) {
+      const Slot &slot = slots_[i % kCapacity];
+      TraceEvent event;
+      event.name = slot.name.load(std::memory_order_relaxed);
+      event.begin = slot.begin.load(std::memory_order_relaxed);
+      event.end = slot.end.load(std::memory_order_relaxed);
+      copied.push_back(event);
+    }
+
+    // コピー中に書き込み側が予約した位置のkCapacity前までは上書きされている
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t reserved = reserved_.load(std::memory_order_relaxed);
+    for (uint64_t i = first; i < head; i++) {
+      if (i + kCapacity >= reserved) {
+        events->push_back(copied[static_cast<size_t>(i - first)]);
+      }
+    }
+  }
+
+ private:
+  /// リングバッファの要素
+  struct Slot {
+    std::atomic<const char*> name;
+    std::atomic<int64_t> begin;
+    std::atomic<int64_t> end;
+  };
+
+  /// 書き込み中のイベントの位置+1
+  std::atomic<uint64_t> reserved_;
+  /// 書き込み済みのイベントの数
+  std::atomic<uint64_t> head_;
+  /// イベント
+  Slot slots_[scff_imaging::trace::kEventsPerThread];
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(TraceRing);
+};
+
+/// スレッドとリングバッファの対応
+/// @attention 静的領域に置くので0で初期化される
+struct ThreadEntry {
+  /// 所有しているスレッド(0なら空き)
+  std::atomic<uint32_t> key;
+  /// リングバッファ(一度確保したらプロセス終了まで解放しない)
+  std::atomic<TraceRing*> ring;
+  /// スレッド名
+  std::atomic<const char*> name;
+};
+
+/// スレッドとリングバッファの対応表
+ThreadEntry g_entries[scff_imaging::trace::kMaxThreadCount];
+/// 記録領域を確保できずに捨てたイベントの数
+std::atomic<int64_t> g_dropped_event_count(0);
+/// 現在のスレッドが所有しているエントリ(まだ探していなければnullptr)
+SCFF_THREAD_LOCAL ThreadEntry *t_current_entry = nullptr;
+
+/// 現在のスレッドが所有しているエントリを取得する
+/// - 対応表を探すのは最初の一度だけで、以後はスレッドローカルな値を返す
+/// @param claim 所有していなければ空きエントリを確保する
+ThreadEntry* GetCurrentEntry(bool claim) {
+  if (t_current_entry != nullptr) {
+    return t_current_entry;
+  }
+
+  const uint32_t key = scff_imaging::platform::GetCurrentThreadKey();
+  for (int i = 0; i < scff_imaging::trace::kMaxThreadCount; i++) {
+    if (g_entries[i].key.load(std::memory_order_relaxed) == key) {
+      t_current_entry = &(g_entries[i]);
+      return t_current_entry;
+    }
+  }
+  if (!claim) {
+    return nullptr;
+  }
+
+  for (int i = 0; i < scff_imaging::trace::kMaxThreadCount; i++) {
+    uint32_t expected = 0;
+    if (g_entries[i].key.compare_exchange_strong(expected, key)) {
+      // 前の所有者のリングバッファがあればそのまま使う
+      g_entries[i].name.store(nullptr, std::memory_order_relaxed);
+      if (g_entries[i].ring.load(std::memory_order_relaxed) == nullptr) {
+        g_entries[i].ring.store(new TraceRing, std::memory_order_release);
+      }
+      t_current_entry = &(g_entries[i]);
+      return t_current_entry;
+    }
+  }
+  return nullptr;
+}
+
+/// 100nSec単位の時刻をマイクロ秒単位の文字列にする
+void AppendMicroseconds(int64_t time, std::string *json) {
+  json->append(std::to_string(static_cast<long long>(time / 10LL)));
+  json->append(".");
+  json->append(std::to_string(static_cast<long long>(time % 10LL)));
+}
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::trace
+//=====================================================================
+namespace trace {
+
+void Record(const char *name, int64_t begin, int64_t end) {
+  ThreadEntry *entry = GetCurrentEntry(true);
+  if (entry == nullptr) {
+    g_dropped_event_count.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  entry->ring.load(std::memory_order_relaxed)->Record(name, begin, end);
+}
+
+void SetCurrentThreadName(const char *name) {
+  ThreadEntry *entry = GetCurrentEntry(true);
+  if (entry != nullptr) {
+    entry->name.store(name, std::memory_order_relaxed);
+  }
+}
+
+void ReleaseCurrentThread() {
+  ThreadEntry *entry = GetCurrentEntry(false);
+  if (entry != nullptr) {
+    // スレッド名は次に再利用されるまで残しておく
+    entry->key.store(0, std::memory_order_release);
+    t_current_entry = nullptr;
+  }
+}
+
+void WriteChromeTrace(std::string *json) {
+  json->assign("{\"traceEvents\":[");
+  bool first = true;
+  std::vector<TraceEvent> events;
+  for (int i = 0; i < kMaxThreadCount; i++) {
+    const TraceRing *ring = g_entries[i].ring.load(std::memory_order_acquire);
+    if (ring == nullptr) {
+      continue;
+    }
+    // tidにはエントリの番号を使う(再利用されたエントリは同じ行に並ぶ)
+    const std::string tid = std::to_string(static_cast<long long>(i + 1));
+
+    const char *thread_name = g_entries[i].name.load(std::memory_order_relaxed);
+    if (thread_name != nullptr) {
+      json->append(first ? "\n" : ",\n");
+      first = false;
+      json->append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+      json->append(tid);
+      json->append(",\"args\":{\"name\":\"");
+      json->append(thread_name);
+      json->append("\"}}");
+    }
+
+    events.clear();
+    ring->Snapshot(&events);
+    for (auto it = events.begin(); it != events.end(); ++it) {
+      json->append(first ? "\n" : ",\n");
+      first = false;
+      json->append("{\"name\":\"");
+      json->append(it->name);
+      json->append("\",\"cat\":\"scff\",\"ph\":\"X\",\"ts\":");
+      AppendMicroseconds(it->begin, json);
+      json->append(",\"dur\":");
+      AppendMicroseconds(it->end - it->begin, json);
+      json->append(",\"pid\":1,\"tid\":");
+      json->append(tid);
+      json->append("}");
+    }
+  }
+  json->append("\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+bool WriteChromeTraceFile(const char *path) {
+  std::string json;
+  WriteChromeTrace(&json);
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(json.data(), static_cast<std::streamsize>(json.size()));
+  return static_cast<bool>(file);
+}
+
+int64_t dropped_event_count() {
+  return g_dropped_event_count.load(std::memory_order_relaxed);
+}
+}   // namespace trace
+}   // namespace scff_imaging
+
+#endif  // defined(SCFF_IMAGING_TRACE)
@@ -0,0 +1,115 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/trace.h
+/// scff_imaging::traceの宣言
+/// - SCFF_IMAGING_TRACEが定義されている場合のみ有効
+/// - 定義されていない場合、SCFF_TRACE_*マクロは何も生成しない
+
+#ifndef SCFF_DSF_SCFF_IMAGING_TRACE_H_
+#define SCFF_DSF_SCFF_IMAGING_TRACE_H_
+
+#if defined(SCFF_IMAGING_TRACE)
+
+#include <cstdint>
+#include <string>
+
+#include "scff_imaging/common.h"
+#include "scff_imaging/clock.h"
+
+namespace scff_imaging {
+
+/// 処理区間の計測結果をスレッドごとのリングバッファに記録する
+/// - 記録はロックフリー(記録中のスレッド同士・出力側とも待ち合わせない)
+/// - 出力はChrome trace-event形式(chrome://tracingで表示できる)
+namespace trace {
+
+/// 記録できるスレッドの最大数(超えた分のイベントは捨てる)
+const int kMaxThreadCount = 64;
+/// スレッドごとに保持するイベントの数(古いものから上書きする)
+const int kEventsPerThread = 4096;
+
+/// 現在のスレッドのイベントとして区間を記録する
+/// @param name 区間の名前(文字列リテラルなどプロセス終了まで有効なもの)
+/// @param begin 開始時刻(GetMonotonicClockTime)
+/// @param end 終了時刻(GetMonotonicClockTime)
+void Record(const char *name, int64_t begin, int64_t end);
+/// 現在のスレッドに名前をつける
+/// @param name スレッド名(文字列リテラルなどプロセス終了まで有効なもの)
+void SetCurrentThreadName(const char *name);
+/// 現在のスレッドの記録領域を他のスレッドが再利用できるようにする
+/// @attention スレッドの終了直前に呼ぶこと(記録済みのイベントは残る)
+void ReleaseCurrentThread();
+
+/// 記録済みのイベントをChrome trace-event形式のJSONで出力する
+/// @attention 記録中のスレッドを止めずにどのスレッドから呼び出してもよい
+void WriteChromeTrace(std::string *json);
+/// 記録済みのイベントをChrome trace-event形式のJSONファイルに出力する
+bool WriteChromeTraceFile(const char *path);
+
+/// 記録領域を確保できずに捨てたイベントの数
+int64_t dropped_event_count();
+
+/// スコープの開始から終了までを記録する
+class ScopedTrace {
+ public:
+  /// コンストラクタ
+  explicit ScopedTrace(const char *name)
+      : name_(name),
+        begin_(GetMonotonicClockTime()) {
+    // nop
+  }
+  /// デストラクタ
+  ~ScopedTrace() {
+    Record(name_, begin_, GetMonotonicClockTime());
+  }
+
+ private:
+  /// 区間の名前
+  const char * const name_;
+  /// 開始時刻
+  const int64_t begin_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(ScopedTrace);
+};
+}   // namespace trace
+}   // namespace scff_imaging
+
+#define SCFF_TRACE_CONCAT_INNER(a, b) a##b
+#define SCFF_TRACE_CONCAT(a, b) SCFF_TRACE_CONCAT_INNER(a, b)
+
+/// スコープの終わりまでを区間として記録する
+#define SCFF_TRACE_SCOPE(name) \
+  ::scff_imaging::trace::ScopedTrace \
+      SCFF_TRACE_CONCAT(scff_trace_scope_, __LINE__)(name)
+/// 現在のスレッドに名前をつける
+#define SCFF_TRACE_THREAD_NAME(name) \
+  ::scff_imaging::trace::SetCurrentThreadName(name)
+/// 現在のスレッドの記録領域を解放する
+#define SCFF_TRACE_THREAD_EXIT() \
+  ::scff_imaging::trace::ReleaseCurrentThread()
+
+#else   // defined(SCFF_IMAGING_TRACE)
+
+#define SCFF_TRACE_SCOPE(name) ((void)0)
+#define SCFF_TRACE_THREAD_NAME(name) ((void)0)
+#define SCFF_TRACE_THREAD_EXIT() ((void)0)
+
+#endif  // defined(SCFF_IMAGING_TRACE)
+
+#endif  // SCFF_DSF_SCFF_IMAGING_TRACE_H_
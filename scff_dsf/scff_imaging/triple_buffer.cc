@@ -0,0 +1,83 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/triple_buffer.cc
+/// scff_imaging::TripleBufferの定義
+
+#include "scff_imaging/triple_buffer.h"
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::TripleBuffer
+//=====================================================================
+
+TripleBuffer::TripleBuffer()
+    : state_(1),
+      write_index_(0),
+      read_index_(2),
+      last_generation_(0) {
+  for (int i = 0; i < kBufferCount; i++) {
+    generation_[i] = 0;
+  }
+}
+
+TripleBuffer::~TripleBuffer() {
+  // nop
+}
+
+//-------------------------------------------------------------------
+// 書き込み側
+//-------------------------------------------------------------------
+
+int TripleBuffer::write_index() const {
+  return write_index_;
+}
+
+uint64_t TripleBuffer::Publish() {
+  // 世代はバッファを所有している間に書き込んでおく
+  generation_[write_index_] = ++last_generation_;
+
+  // 書き込み済みバッファと中間バッファを交換する
+  // release: バッファの内容と世代を読み込み側から見えるようにする
+  // acquire: 読み込み側が手放したバッファの読み込み完了を保証する
+  const int old_state =
+      state_.exchange(write_index_ | kFreshBit, std::memory_order_acq_rel);
+  write_index_ = old_state & kIndexMask;
+
+  return last_generation_;
+}
+
+//-------------------------------------------------------------------
+// 読み込み側
+//-------------------------------------------------------------------
+
+int TripleBuffer::AcquireLatest(uint64_t *generation) {
+  // kFreshBitを落とせるのは読み込み側だけなので、
+  // ここで立っていればexchangeでも必ず新しいフレームが得られる
+  if ((state_.load(std::memory_order_relaxed) & kFreshBit) != 0) {
+    const int old_state =
+        state_.exchange(read_index_, std::memory_order_acq_rel);
+    read_index_ = old_state & kIndexMask;
+  }
+
+  if (generation != nullptr) {
+    *generation = generation_[read_index_];
+  }
+  return read_index_;
+}
+}   // namespace scff_imaging
@@ -0,0 +1,91 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/triple_buffer.h
+/// scff_imaging::TripleBufferの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_TRIPLE_BUFFER_H_
+#define SCFF_DSF_SCFF_IMAGING_TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// ロックフリーなトリプルバッファのインデックスを管理する
+/// - 書き込み側は読み込み側を一切待たない
+/// - 読み込み側は常に書き込みが完了したバッファを受け取る
+/// @attention 書き込み側・読み込み側はそれぞれ1スレッドに限る
+class TripleBuffer {
+ public:
+  /// バッファの数
+  static const int kBufferCount = 3;
+
+  /// コンストラクタ
+  TripleBuffer();
+  /// デストラクタ
+  ~TripleBuffer();
+
+  //-------------------------------------------------------------------
+  // 書き込み側
+  //-------------------------------------------------------------------
+  /// Getter: 書き込み中のバッファのインデックス
+  int write_index() const;
+  /// 書き込みが完了したバッファを最新フレームとして公開し、
+  /// 次に書き込むバッファに切り替える
+  /// @return 公開したフレームの世代(1から始まり単調増加)
+  uint64_t Publish();
+
+  //-------------------------------------------------------------------
+  // 読み込み側
+  //-------------------------------------------------------------------
+  /// 最新の完成済みフレームを持つバッファを取得する
+  /// @attention 次にAcquireLatestを呼ぶまでバッファは書き換えられない
+  /// @param[out] generation 取得したフレームの世代(未公開なら0, nullptr可)
+  /// @return 読み込み用のバッファのインデックス
+  int AcquireLatest(uint64_t *generation);
+  //-------------------------------------------------------------------
+
+ private:
+  /// 中間バッファのインデックスを取り出すマスク
+  static const int kIndexMask = 0x3;
+  /// 中間バッファに未読のフレームがあることを示すビット
+  static const int kFreshBit = 0x4;
+
+  /// 中間バッファのインデックス+kFreshBit
+  /// @attention 書き込み側・読み込み側で共有するのはこの変数のみ
+  std::atomic<int> state_;
+
+  /// 書き込み側が所有するバッファのインデックス
+  int write_index_;
+  /// 読み込み側が所有するバッファのインデックス
+  int read_index_;
+
+  /// 各バッファに格納されているフレームの世代
+  /// @attention バッファを所有しているスレッドのみ読み書きする
+  uint64_t generation_[kBufferCount];
+  /// 最後に公開したフレームの世代(書き込み側のみ)
+  uint64_t last_generation_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(TripleBuffer);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_TRIPLE_BUFFER_H_
@@ -0,0 +1,451 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/unscaled_converter.cc
+/// scff_imaging::UnscaledConverterの定義
+
+#include "scff_imaging/unscaled_converter.h"
+
+#include <cstring>
+
+#include "scff_imaging/debug.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+    defined(__SSE2__)
+#define SCFF_UNSCALED_CONVERTER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+//---------------------------------------------------------------------
+// SWScale(libswscale/input.c)のRGB->YUV変換と同じ係数と丸め
+// - 係数は1<<15を1.0とするBT.601(輝度16-235, 色差16-240)
+// - 入力は一度14bit(8bit<<6)の中間値にしてから8bitに丸める
+// - 色差は横に隣り合う2ピクセルの和から求める
+//---------------------------------------------------------------------
+
+const int kRY = 8414;     // 0.299 * 219 / 255
+const int kGY = 16519;    // 0.587 * 219 / 255
+const int kBY = 3208;     // 0.114 * 219 / 255
+const int kRU = -4865;    // -0.169 * 224 / 255
+const int kGU = -9528;    // -0.331 * 224 / 255
+const int kBU = 14392;    // 0.500 * 224 / 255
+const int kRV = 14392;    // 0.500 * 224 / 255
+const int kGV = -12061;   // -0.419 * 224 / 255
+const int kBV = -2332;    // -0.081 * 224 / 255
+
+/// 輝度の14bit中間値を求めるときのオフセット(16)と丸め
+const int kLumaOffset = (16 << 15) + (1 << 8);
+/// 輝度の14bit中間値を求めるときのシフト量
+const int kLumaShift = 9;
+/// 色差(2ピクセル分の和)の14bit中間値を求めるときのオフセット(128)と丸め
+const int kChromaOffset = (128 << 16) + (1 << 9);
+/// 色差(2ピクセル分の和)の14bit中間値を求めるときのシフト量
+const int kChromaShift = 10;
+
+/// 1ピクセルの輝度の14bit中間値
+inline int Luma14(const uint8_t *pixel, const int *coefficients) {
+  return (coefficients[0] * pixel[0] +
+          coefficients[1] * pixel[1] +
+          coefficients[2] * pixel[2] + kLumaOffset) >> kLumaShift;
+}
+
+/// 横に隣り合う2ピクセルの色差の14bit中間値
+inline int Chroma14(const uint8_t *pixel, const int *coefficients) {
+  return (coefficients[0] * (pixel[0] + pixel[4]) +
+          coefficients[1] * (pixel[1] + pixel[5]) +
+          coefficients[2] * (pixel[2] + pixel[6]) +
+          kChromaOffset) >> kChromaShift;
+}
+
+/// 14bit中間値を8bitに丸める
+inline uint8_t Round14(int value) {
+  return static_cast<uint8_t>((value + 32) >> 6);
+}
+
+/// 上下2行の14bit中間値を平均して8bitに丸める
+inline uint8_t Average14(int value0, int value1) {
+  return static_cast<uint8_t>((value0 + value1 + 64) >> 7);
+}
+
+/// 2行分をYUV420P/NV12に変換する
+/// @param pixel_count 変換するピクセル数(偶数)
+/// @param chroma_step 色差の間隔(YUV420Pでは1, NV12では2)
+void PlanarRowsPortable(const uint8_t *src0, const uint8_t *src1,
+                        uint8_t *dst_y0, uint8_t *dst_y1,
+                        uint8_t *dst_u, uint8_t *dst_v, int chroma_step,
+                        int pixel_count, const int *coefficients) {
+  const int *y = coefficients;
+  const int *u = coefficients + 3;
+  const int *v = coefficients + 6;
+  for (int x = 0; x < pixel_count; x += 2) {
+    const uint8_t *pixel0 = src0 + x * 4;
+    const uint8_t *pixel1 = src1 + x * 4;
+    dst_y0[x] = Round14(Luma14(pixel0, y));
+    dst_y0[x + 1] = Round14(Luma14(pixel0 + 4, y));
+    dst_y1[x] = Round14(Luma14(pixel1, y));
+    dst_y1[x + 1] = Round14(Luma14(pixel1 + 4, y));
+    const int chroma_x = (x / 2) * chroma_step;
+    dst_u[chroma_x] = Average14(Chroma14(pixel0, u), Chroma14(pixel1, u));
+    dst_v[chroma_x] = Average14(Chroma14(pixel0, v), Chroma14(pixel1, v));
+  }
+}
+
+/// 1行分をUYVY/YUY2に変換する
+/// @param pixel_count 変換するピクセル数(偶数)
+void PackedRowPortable(const uint8_t *src, uint8_t *dst,
+                       int pixel_count, const int *coefficients,
+                       bool uyvy) {
+  const int *y = coefficients;
+  const int *u = coefficients + 3;
+  const int *v = coefficients + 6;
+  // UYVYならU Y0 V Y1、YUY2ならY0 U Y1 V
+  const int luma_offset = uyvy ? 1 : 0;
+  const int chroma_offset = uyvy ? 0 : 1;
+  for (int x = 0; x < pixel_count; x += 2) {
+    const uint8_t *pixel = src + x * 4;
+    uint8_t *macropixel = dst + x * 2;
+    macropixel[luma_offset] = Round14(Luma14(pixel, y));
+    macropixel[luma_offset + 2] = Round14(Luma14(pixel + 4, y));
+    macropixel[chroma_offset] = Round14(Chroma14(pixel, u));
+    macropixel[chroma_offset + 2] = Round14(Chroma14(pixel, v));
+  }
+}
+
+#if defined(SCFF_UNSCALED_CONVERTER_SSE2)
+/// 係数(3バイト分)を2ピクセル分の16bit値に並べる(4バイト目の係数は0)
+__m128i LoadCoefficients(const int *coefficients) {
+  return _mm_set_epi16(0, static_cast<int16_t>(coefficients[2]),
+                       static_cast<int16_t>(coefficients[1]),
+                       static_cast<int16_t>(coefficients[0]),
+                       0, static_cast<int16_t>(coefficients[2]),
+                       static_cast<int16_t>(coefficients[1]),
+                       static_cast<int16_t>(coefficients[0]));
+}
+
+/// _mm_madd_epi16の結果(ピクセルごとに2つの部分和)を足し合わせる
+/// - lowの2ピクセル、highの2ピクセルの順に4つの32bit値になる
+__m128i AddPartialSums(__m128i low, __m128i high) {
+  const __m128 low_ps = _mm_castsi128_ps(low);
+  const __m128 high_ps = _mm_castsi128_ps(high);
+  const __m128 even = _mm_shuffle_ps(low_ps, high_ps, _MM_SHUFFLE(2, 0, 2, 0));
+  const __m128 odd = _mm_shuffle_ps(low_ps, high_ps, _MM_SHUFFLE(3, 1, 3, 1));
+  return _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+/// 4ピクセルの輝度の14bit中間値
+__m128i Luma14x4(__m128i pixels, __m128i coefficients) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i sums = AddPartialSums(
+      _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coefficients),
+      _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coefficients));
+  return _mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(kLumaOffset)),
+                        kLumaShift);
+}
+
+/// 4ピクセルを横に隣り合う2ピクセルずつ足した16bit値(2組分)
+__m128i SumPairs(__m128i pixels) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i low = _mm_unpacklo_epi8(pixels, zero);
+  const __m128i high = _mm_unpackhi_epi8(pixels, zero);
+  return _mm_add_epi16(_mm_unpacklo_epi64(low, high),
+                       _mm_unpackhi_epi64(low, high));
+}
+
+/// 2ピクセルずつの和(4組分)の色差の14bit中間値
+__m128i Chroma14x4(__m128i pairs0, __m128i pairs1, __m128i coefficients) {
+  const __m128i sums = AddPartialSums(_mm_madd_epi16(pairs0, coefficients),
+                                      _mm_madd_epi16(pairs1, coefficients));
+  return _mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(kChromaOffset)),
+                        kChromaShift);
+}
+
+/// 14bit中間値(4つ)を8bitに丸める
+__m128i Round14x4(__m128i value) {
+  return _mm_srai_epi32(_mm_add_epi32(value, _mm_set1_epi32(32)), 6);
+}
+
+/// 32bit値(8つ)を8bitに詰めて下位8バイトに置く
+__m128i PackTo8(__m128i value0, __m128i value1) {
+  const __m128i packed = _mm_packs_epi32(value0, value1);
+  return _mm_packus_epi16(packed, packed);
+}
+
+/// 2行分をYUV420P/NV12に変換する(8ピクセル単位、端数はPlanarRowsPortable)
+void PlanarRowsSSE2(const uint8_t *src0, const uint8_t *src1,
+                    uint8_t *dst_y0, uint8_t *dst_y1,
+                    uint8_t *dst_u, uint8_t *dst_v, int chroma_step,
+                    int pixel_count, const int *coefficients) {
+  const __m128i y = LoadCoefficients(coefficients);
+  const __m128i u = LoadCoefficients(coefficients + 3);
+  const __m128i v = LoadCoefficients(coefficients + 6);
+  const __m128i rounding = _mm_set1_epi32(64);
+  int x = 0;
+  for (; x + 8 <= pixel_count; x += 8) {
+    const __m128i *pixels0 = reinterpret_cast<const __m128i*>(src0 + x * 4);
+    const __m128i *pixels1 = reinterpret_cast<const __m128i*>(src1 + x * 4);
+    const __m128i a0 = _mm_loadu_si128(pixels0);
+    const __m128i a1 = _mm_loadu_si128(pixels0 + 1);
+    const __m128i b0 = _mm_loadu_si128(pixels1);
+    const __m128i b1 = _mm_loadu_si128(pixels1 + 1);
+
+    // 輝度
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst_y0 + x),
+                     PackTo8(Round14x4(Luma14x4(a0, y)),
+                             Round14x4(Luma14x4(a1, y))));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst_y1 + x),
+                     PackTo8(Round14x4(Luma14x4(b0, y)),
+                             Round14x4(Luma14x4(b1, y))));
+
+    // 色差(行ごとに14bit中間値にしてから上下を平均する)
+    const __m128i pairs_a0 = SumPairs(a0);
+    const __m128i pairs_a1 = SumPairs(a1);
+    const __m128i pairs_b0 = SumPairs(b0);
+    const __m128i pairs_b1 = SumPairs(b1);
+    const __m128i chroma_u = _mm_srai_epi32(
+        _mm_add_epi32(_mm_add_epi32(Chroma14x4(pairs_a0, pairs_a1, u),
+                                    Chroma14x4(pairs_b0, pairs_b1, u)),
+                      rounding), 7);
+    const __m128i chroma_v = _mm_srai_epi32(
+        _mm_add_epi32(_mm_add_epi32(Chroma14x4(pairs_a0, pairs_a1, v),
+                                    Chroma14x4(pairs_b0, pairs_b1, v)),
+                      rounding), 7);
+    // 下位4バイトがU、次の4バイトがV
+    const __m128i chroma = PackTo8(chroma_u, chroma_v);
+    if (chroma_step == 2) {
+      // U0 V0 U1 V1 ...
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dst_u + x),
+                       _mm_unpacklo_epi8(chroma, _mm_srli_si128(chroma, 4)));
+      continue;
+    }
+    const int32_t packed_u = _mm_cvtsi128_si32(chroma);
+    const int32_t packed_v = _mm_cvtsi128_si32(_mm_srli_si128(chroma, 4));
+    memcpy(dst_u + x / 2, &packed_u, 4);
+    memcpy(dst_v + x / 2, &packed_v, 4);
+  }
+  if (x < pixel_count) {
+    const int chroma_x = (x / 2) * chroma_step;
+    PlanarRowsPortable(src0 + x * 4, src1 + x * 4,
+                       dst_y0 + x, dst_y1 + x,
+                       dst_u + chroma_x, dst_v + chroma_x, chroma_step,
+                       pixel_count - x, coefficients);
+  }
+}
+
+/// 1行分をUYVY/YUY2に変換する(8ピクセル単位、端数はPackedRowPortable)
+void PackedRowSSE2(const uint8_t *src, uint8_t *dst,
+                   int pixel_count, const int *coefficients, bool uyvy) {
+  const __m128i y = LoadCoefficients(coefficients);
+  const __m128i u = LoadCoefficients(coefficients + 3);
+  const __m128i v = LoadCoefficients(coefficients + 6);
+  int x = 0;
+  for (; x + 8 <= pixel_count; x += 8) {
+    const __m128i *pixels = reinterpret_cast<const __m128i*>(src + x * 4);
+    const __m128i a0 = _mm_loadu_si128(pixels);
+    const __m128i a1 = _mm_loadu_si128(pixels + 1);
+
+    // Y0..Y7
+    const __m128i luma = PackTo8(Round14x4(Luma14x4(a0, y)),
+                                 Round14x4(Luma14x4(a1, y)));
+    // U0..U3, V0..V3
+    const __m128i pairs0 = SumPairs(a0);
+    const __m128i pairs1 = SumPairs(a1);
+    const __m128i chroma =
+        PackTo8(Round14x4(Chroma14x4(pairs0, pairs1, u)),
+                Round14x4(Chroma14x4(pairs0, pairs1, v)));
+    // U0 V0 U1 V1 ...
+    const __m128i interleaved_chroma =
+        _mm_unpacklo_epi8(chroma, _mm_srli_si128(chroma, 4));
+    const __m128i macropixels = uyvy ?
+        _mm_unpacklo_epi8(interleaved_chroma, luma) :
+        _mm_unpacklo_epi8(luma, interleaved_chroma);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2), macropixels);
+  }
+  if (x < pixel_count) {
+    PackedRowPortable(src + x * 4, dst + x * 2,
+                      pixel_count - x, coefficients, uyvy);
+  }
+}
+#endif  // defined(SCFF_UNSCALED_CONVERTER_SSE2)
+
+/// 行[y, y + height)を変換する
+/// @param simd SSE2のカーネルを使うか
+void ConvertRows(const AVPicture &input, AVPicture *output,
+                 AVPixelFormat output_pixel_format, int width,
+                 int y, int height, const int *coefficients, bool simd) {
+#if !defined(SCFF_UNSCALED_CONVERTER_SSE2)
+  simd = false;
+#endif
+  if (output_pixel_format == AV_PIX_FMT_YUV420P ||
+      output_pixel_format == AV_PIX_FMT_NV12) {
+    // NV12の色差は1つのプレーンにU, Vの順に交互に並ぶ
+    const bool nv12 = output_pixel_format == AV_PIX_FMT_NV12;
+    const int chroma_step = nv12 ? 2 : 1;
+    for (int row = y; row < y + height; row += 2) {
+      const uint8_t *src0 = input.data[0] + row * input.linesize[0];
+      const uint8_t *src1 = src0 + input.linesize[0];
+      uint8_t *dst_y0 = output->data[0] + row * output->linesize[0];
+      uint8_t *dst_y1 = dst_y0 + output->linesize[0];
+      uint8_t *dst_u = output->data[1] + (row / 2) * output->linesize[1];
+      uint8_t *dst_v = nv12 ?
+          dst_u + 1 :
+          output->data[2] + (row / 2) * output->linesize[2];
+#if defined(SCFF_UNSCALED_CONVERTER_SSE2)
+      if (simd) {
+        PlanarRowsSSE2(src0, src1, dst_y0, dst_y1, dst_u, dst_v, chroma_step,
+                       width, coefficients);
+        continue;
+      }
+#endif
+      PlanarRowsPortable(src0, src1, dst_y0, dst_y1, dst_u, dst_v,
+                         chroma_step, width, coefficients);
+    }
+  } else {
+    const bool uyvy = output_pixel_format == AV_PIX_FMT_UYVY422;
+    for (int row = y; row < y + height; row++) {
+      const uint8_t *src = input.data[0] + row * input.linesize[0];
+      uint8_t *dst = output->data[0] + row * output->linesize[0];
+#if defined(SCFF_UNSCALED_CONVERTER_SSE2)
+      if (simd) {
+        PackedRowSSE2(src, dst, width, coefficients, uyvy);
+        continue;
+      }
+#endif
+      PackedRowPortable(src, dst, width, coefficients, uyvy);
+    }
+  }
+}
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::UnscaledConverter
+//=====================================================================
+
+UnscaledConverter::UnscaledConverter()
+    : output_pixel_format_(AV_PIX_FMT_NONE),
+      width_(0),
+      height_(0) {
+  memset(coefficients_, 0, sizeof(coefficients_));
+}
+
+UnscaledConverter::~UnscaledConverter() {
+  // nop
+}
+
+bool UnscaledConverter::Init(AVPixelFormat input_pixel_format,
+                             AVPixelFormat output_pixel_format,
+                             int width, int height) {
+  Clear();
+
+  // 出力と色差の間引き
+  switch (output_pixel_format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_NV12: {
+      if (height % 2 != 0) return false;
+      break;
+    }
+    case AV_PIX_FMT_UYVY422:
+    case AV_PIX_FMT_YUYV422: {
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+  if (width <= 0 || height <= 0 || width % 2 != 0) {
+    return false;
+  }
+  if (!GetCoefficients(input_pixel_format, coefficients_)) {
+    return false;
+  }
+  output_pixel_format_ = output_pixel_format;
+  width_ = width;
+  height_ = height;
+  return true;
+}
+
+bool UnscaledConverter::GetCoefficients(AVPixelFormat input_pixel_format,
+                                        int coefficients[9]) {
+  // 入力のバイト順(4バイト目は使わない)
+  int r_index = 0;
+  int b_index = 0;
+  switch (input_pixel_format) {
+    case AV_PIX_FMT_BGR0: {
+      r_index = 2;
+      b_index = 0;
+      break;
+    }
+    case AV_PIX_FMT_RGB0: {
+      r_index = 0;
+      b_index = 2;
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+
+  const int table[3][3] = {
+    {kRY, kGY, kBY},
+    {kRU, kGU, kBU},
+    {kRV, kGV, kBV}
+  };
+  for (int i = 0; i < 3; i++) {
+    coefficients[i * 3 + r_index] = table[i][0];
+    coefficients[i * 3 + 1] = table[i][1];
+    coefficients[i * 3 + b_index] = table[i][2];
+  }
+  return true;
+}
+
+void UnscaledConverter::Clear() {
+  output_pixel_format_ = AV_PIX_FMT_NONE;
+  width_ = 0;
+  height_ = 0;
+}
+
+bool UnscaledConverter::is_valid() const {
+  return output_pixel_format_ != AV_PIX_FMT_NONE;
+}
+
+int UnscaledConverter::row_alignment() const {
+  return (output_pixel_format_ == AV_PIX_FMT_YUV420P ||
+          output_pixel_format_ == AV_PIX_FMT_NV12) ? 2 : 1;
+}
+
+void UnscaledConverter::Convert(const AVPicture &input, AVPicture *output,
+                                int y, int height) const {
+  ASSERT(is_valid());
+  ASSERT(0 <= y && y + height <= height_);
+  ASSERT(y % row_alignment() == 0 && height % row_alignment() == 0);
+  ConvertRows(input, output, output_pixel_format_, width_, y, height,
+              coefficients_, true);
+}
+
+void UnscaledConverter::ConvertPortable(const AVPicture &input,
+                                        AVPicture *output,
+                                        int y, int height) const {
+  ASSERT(is_valid());
+  ASSERT(0 <= y && y + height <= height_);
+  ASSERT(y % row_alignment() == 0 && height % row_alignment() == 0);
+  ConvertRows(input, output, output_pixel_format_, width_, y, height,
+              coefficients_, false);
+}
+}   // namespace scff_imaging
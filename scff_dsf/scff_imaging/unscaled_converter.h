@@ -0,0 +1,92 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/unscaled_converter.h
+/// scff_imaging::UnscaledConverterの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_UNSCALED_CONVERTER_H_
+#define SCFF_DSF_SCFF_IMAGING_UNSCALED_CONVERTER_H_
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// 拡大縮小が不要な場合にRGB0(32bit)をYUVに変換する
+/// - 出力はYUV420P(I420/IYUV/YV12)とNV12とUYVY/YUY2
+/// - 係数と丸めはSWScale(Cの実装)のSWS_ACCURATE_RNDと同じで、
+///   輝度とUYVY/YUY2の色差は完全に一致する
+/// - YUV420P/NV12の色差は上下2行の平均で、SWS_AREAと完全に一致する
+///   (他の拡大縮小メソッドでは縦方向の色差のフィルタだけが異なる)
+/// - SSE2が使える場合は8ピクセル単位でまとめて変換する
+///   (結果はSSE2を使わない場合と完全に一致する)
+class UnscaledConverter {
+ public:
+  /// コンストラクタ
+  UnscaledConverter();
+  /// デストラクタ
+  ~UnscaledConverter();
+
+  /// 変換を準備する
+  /// @param input_pixel_format AV_PIX_FMT_BGR0またはAV_PIX_FMT_RGB0
+  /// @retval true    変換できる組み合わせ
+  /// @retval false   対応していない(幅・高さが色差の間引き単位でない場合も)
+  bool Init(AVPixelFormat input_pixel_format,
+            AVPixelFormat output_pixel_format,
+            int width, int height);
+  /// 変換をやめる(Initするまでis_validはfalse)
+  void Clear();
+
+  /// 入力の行[y, y + height)を変換して出力の同じ行に書き込む
+  /// @attention YUV420P/NV12ではyとheightは偶数であること
+  void Convert(const AVPicture &input, AVPicture *output,
+               int y, int height) const;
+  /// SIMDを使わずに変換する(検証用)
+  void ConvertPortable(const AVPicture &input, AVPicture *output,
+                       int y, int height) const;
+
+  /// 入力のバイト順に並べたRGB->YUVの係数を求める
+  /// @param input_pixel_format AV_PIX_FMT_BGR0またはAV_PIX_FMT_RGB0
+  /// @param[out] coefficients Y, U, Vの順に3バイト分ずつ(1<<15が1.0)
+  /// @retval false 対応していない入力ピクセルフォーマット
+  static bool GetCoefficients(AVPixelFormat input_pixel_format,
+                              int coefficients[9]);
+
+  /// Getter: Initに成功したか
+  bool is_valid() const;
+  /// Getter: 出力の縦方向の色差の間引き単位(行数)
+  int row_alignment() const;
+
+ private:
+  /// 出力ピクセルフォーマット
+  AVPixelFormat output_pixel_format_;
+  /// 幅
+  int width_;
+  /// 高さ
+  int height_;
+  /// 入力ピクセルのバイトごとの係数(Y, U, Vの順に3バイト分ずつ)
+  int coefficients_[9];
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(UnscaledConverter);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_UNSCALED_CONVERTER_H_
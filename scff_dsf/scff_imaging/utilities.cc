@@ -22,16 +22,21 @@
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 }
 
 #include <cmath>
+#include <limits>
 
 #include "scff_imaging/debug.h"
 #include "scff_imaging/imaging_types.h"
 #include "scff_imaging/avpicture_image.h"
 
+#if !defined(SCFF_IMAGING_HEADLESS)
 // DLLインスタンスハンドル(DirectShow BaseClassesで定義済み)
 extern HINSTANCE g_hInst;
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 
 namespace scff_imaging {
 
@@ -40,6 +45,7 @@ namespace scff_imaging {
 //=====================================================================
 namespace utilities {
 
+#if !defined(SCFF_IMAGING_HEADLESS)
 //-------------------------------------------------------------------
 // リソースの取得用DLLインスタンスハンドルの取得
 //-------------------------------------------------------------------
@@ -47,6 +53,7 @@ namespace utilities {
 HINSTANCE dll_instance() {
   return g_hInst;
 }
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 
 //-------------------------------------------------------------------
 // イメージの操作
@@ -62,6 +69,7 @@ bool IsTopdownPixelFormat(ImagePixelFormats pixel_format) {
     case ImagePixelFormats::kYV12:
     case ImagePixelFormats::kUYVY:
     case ImagePixelFormats::kYUY2:
+    case ImagePixelFormats::kNV12:
     default: {
       return false;
     }
@@ -69,22 +77,68 @@ bool IsTopdownPixelFormat(ImagePixelFormats pixel_format) {
 }
 
 bool CanUseDrawUtils(ImagePixelFormats pixel_format) {
-  /// @warning 2012/05/08現在drawutilsはPlaner Formatにしか対応していない
+  /// @attention UYVY/YUY2はdrawutils側でPacked 4:2:2として扱う
+  ///            (奇数xでも輝度はピクセル単位で書き込まれる)
+  /// @attention NV12はdrawutils側で色差を2バイト単位のプレーンとして扱う
   switch (pixel_format) {
     case ImagePixelFormats::kI420:
     case ImagePixelFormats::kIYUV:
     case ImagePixelFormats::kYV12:
-    case ImagePixelFormats::kRGB0: {
-      return true;
-    }
     case ImagePixelFormats::kUYVY:
     case ImagePixelFormats::kYUY2:
+    case ImagePixelFormats::kRGB0:
+    case ImagePixelFormats::kNV12: {
+      return true;
+    }
     default: {
       return false;
     }
   }
 }
 
+double CalculatePsnr(const AVPicture &a, const AVPicture &b,
+                     AVPixelFormat pixel_format, int width, int height) {
+  const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(pixel_format);
+  const int plane_count = av_pix_fmt_count_planes(pixel_format);
+  int64_t squared_error = 0;
+  int64_t byte_count = 0;
+  for (int plane = 0; plane < plane_count; plane++) {
+    // 色差のプレーンの行数は切り上げ
+    const int shift =
+        (plane == 1 || plane == 2) ? descriptor->log2_chroma_h : 0;
+    const int rows = -((-height) >> shift);
+    const int bytes = av_image_get_linesize(pixel_format, width, plane);
+    for (int y = 0; y < rows; y++) {
+      const uint8_t *line_a = a.data[plane] + y * a.linesize[plane];
+      const uint8_t *line_b = b.data[plane] + y * b.linesize[plane];
+      for (int x = 0; x < bytes; x++) {
+        const int error = line_a[x] - line_b[x];
+        squared_error += error * error;
+      }
+    }
+    byte_count += static_cast<int64_t>(rows) * bytes;
+  }
+  if (squared_error == 0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return 10.0 * log10(255.0 * 255.0 * byte_count / squared_error);
+}
+
+void FillDesktopPattern(AVPicture *picture, int width, int height) {
+  for (int y = 0; y < height; y++) {
+    uint8_t *line = picture->data[0] + y * picture->linesize[0];
+    for (int x = 0; x < width; x++) {
+      // 64x32ピクセルごとに文字のような縞を入れる
+      const bool text = (x / 64 + y / 32) % 3 == 0 && (x + y / 2) % 5 < 2;
+      line[x * 4 + 0] = text ? 32 : static_cast<uint8_t>(x * 255 / width);
+      line[x * 4 + 1] = text ? 32 : static_cast<uint8_t>(y * 255 / height);
+      line[x * 4 + 2] =
+          text ? 32 : static_cast<uint8_t>((x + y) * 255 / (width + height));
+      line[x * 4 + 3] = 0;
+    }
+  }
+}
+
 //-------------------------------------------------------------------
 // イメージのタイプ
 //-------------------------------------------------------------------
@@ -118,12 +172,16 @@ AVPixelFormat ToAVPicturePixelFormat(ImagePixelFormats pixel_format) {
     case ImagePixelFormats::kRGB0: {
       return AV_PIX_FMT_RGB0;
     }
+    case ImagePixelFormats::kNV12: {
+      return AV_PIX_FMT_NV12;
+    }
   }
 
   ASSERT(false);
   return AV_PIX_FMT_NONE;
 }
 
+#if !defined(SCFF_IMAGING_HEADLESS)
 /// @attention ピクセルフォーマットを追加するときはここを修正すること
 void ToWindowsBitmapInfo(ImagePixelFormats pixel_format,
                          int width,
@@ -174,6 +232,11 @@ void ToWindowsBitmapInfo(ImagePixelFormats pixel_format,
       info->bmiHeader.biCompression = BI_RGB;
       break;
     }
+    case ImagePixelFormats::kNV12: {
+      info->bmiHeader.biBitCount    = 12;
+      info->bmiHeader.biCompression = MAKEFOURCC('N', 'V', '1', '2');
+      break;
+    }
   }
 }
 
@@ -186,6 +249,7 @@ void ImageToWindowsBitmapInfo(const Image &image,
                       vertical_invert,
                       info);
 }
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 
 ImagePixelFormats IndexToPixelFormat(int index) {
   /// @attention enum->int
@@ -195,6 +259,7 @@ ImagePixelFormats IndexToPixelFormat(int index) {
   return static_cast<ImagePixelFormats>(index);
 }
 
+#if !defined(SCFF_IMAGING_HEADLESS)
 ImagePixelFormats WindowsBitmapInfoHeaderToPixelFormat(
     const BITMAPINFOHEADER &info_header) {
   switch (info_header.biCompression) {
@@ -213,6 +278,9 @@ ImagePixelFormats WindowsBitmapInfoHeaderToPixelFormat(
     case MAKEFOURCC('Y', 'U', 'Y', '2'): {
       return ImagePixelFormats::kYUY2;
     }
+    case MAKEFOURCC('N', 'V', '1', '2'): {
+      return ImagePixelFormats::kNV12;
+    }
     case BI_RGB: {
       if (info_header.biBitCount == 32) {
         return ImagePixelFormats::kRGB0;
@@ -228,6 +296,7 @@ bool IsSupportedPixelFormat(const BITMAPINFOHEADER &info_header) {
       WindowsBitmapInfoHeaderToPixelFormat(info_header) !=
           ImagePixelFormats::kInvalidPixelFormat;
 }
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 
 //-------------------------------------------------------------------
 // レイアウト
@@ -428,6 +497,26 @@ void CalculatePaddingSize(int bound_width, int bound_height,
   *padding_bottom = bound_height - (new_y + new_height);
 }
 
+void GetRotatedSize(RotateDirections direction,
+                    int width, int height,
+                    int *rotated_width, int *rotated_height) {
+  switch (direction) {
+    case RotateDirections::kDegrees90:
+    case RotateDirections::kDegrees270: {
+      // 幅と高さが入れ替わる
+      *rotated_width = height;
+      *rotated_height = width;
+      break;
+    }
+    default: {
+      *rotated_width = width;
+      *rotated_height = height;
+      break;
+    }
+  }
+}
+
+#if !defined(SCFF_IMAGING_HEADLESS)
 void GetWindowRectangle(HWND window, int *x, int *y,
                         int *width, int *height) {
   *x = 0;
@@ -448,5 +537,6 @@ void GetWindowRectangle(HWND window, int *x, int *y,
     *height = window_rect.bottom - window_rect.top;
   }
 }
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 }   // namespace utilities
 }   // namespace scff_imaging
@@ -21,7 +21,7 @@
 #ifndef SCFF_DSF_SCFF_IMAGING_UTILITIES_H_
 #define SCFF_DSF_SCFF_IMAGING_UTILITIES_H_
 
-#include <Windows.h>
+#include "scff_imaging/platform.h"
 extern "C" {
 #include <libavcodec/avcodec.h>
 }
@@ -30,18 +30,21 @@ namespace scff_imaging {
 
 enum class ErrorCodes;
 enum class ImagePixelFormats;
+enum class RotateDirections;
 class Image;
 class AVPictureImage;
 
 /// scff_imagingモジュールを使う上で便利な機能を集めた名前空間
 namespace utilities {
 
+#if !defined(SCFF_IMAGING_HEADLESS)
 //-------------------------------------------------------------------
 // リソースの取得用DLLインスタンスハンドルの取得
 //-------------------------------------------------------------------
 
 /// Getter: リソースの取得用DLLインスタンスハンドル
 HINSTANCE dll_instance();
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 
 //-------------------------------------------------------------------
 // イメージの操作
@@ -53,6 +56,15 @@ bool IsTopdownPixelFormat(ImagePixelFormats pixel_format);
 /// drawutilsが使用可能なピクセルフォーマットか
 bool CanUseDrawUtils(ImagePixelFormats pixel_format);
 
+/// 2つのイメージの差のPSNR(dB)を求める
+/// - すべてのプレーンのバイトをまとめて比べる(一致すれば無限大)
+double CalculatePsnr(const AVPicture &a, const AVPicture &b,
+                     AVPixelFormat pixel_format, int width, int height);
+
+/// 画面らしい(なだらかなグラデーションに細かい模様が混じる)パターンを描く
+/// - RGB0(32bit)のイメージのみ
+void FillDesktopPattern(AVPicture *picture, int width, int height);
+
 //-------------------------------------------------------------------
 // イメージのタイプ（サイズ、形式など）
 //-------------------------------------------------------------------
@@ -66,6 +78,7 @@ int CalculateImageSize(const Image &image);
 /// AVPixelFormatを取得
 AVPixelFormat ToAVPicturePixelFormat(ImagePixelFormats pixel_format);
 
+#if !defined(SCFF_IMAGING_HEADLESS)
 /// BITMAPINFOHEADERを取得
 void ToWindowsBitmapInfo(ImagePixelFormats pixel_format,
                          int width,
@@ -76,17 +89,20 @@ void ToWindowsBitmapInfo(ImagePixelFormats pixel_format,
 void ImageToWindowsBitmapInfo(const Image &image,
                               bool vertical_invert,
                               BITMAPINFO *info);
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 
 /// int(index)->enum(ImagePixelFormat)変換
 /// @warning バグの元なので注意して使うこと
 ImagePixelFormats IndexToPixelFormat(int index);
 
+#if !defined(SCFF_IMAGING_HEADLESS)
 /// BITMAPINFOHEADERからImagePixelFormatを取得
 ImagePixelFormats WindowsBitmapInfoHeaderToPixelFormat(
     const BITMAPINFOHEADER &info_header);
 
 /// BITMAPINFOHEADERから対応ピクセルフォーマットかどうかを求める
 bool IsSupportedPixelFormat(const BITMAPINFOHEADER &info_header);
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 
 //-------------------------------------------------------------------
 // レイアウト
@@ -115,9 +131,16 @@ void CalculatePaddingSize(int bound_width, int bound_height,
                           int *padding_top, int *padding_bottom,
                           int *padding_left, int *padding_right);
 
+/// 回転後の幅と高さを求める
+void GetRotatedSize(RotateDirections direction,
+                    int width, int height,
+                    int *rotated_width, int *rotated_height);
+
+#if !defined(SCFF_IMAGING_HEADLESS)
 /// マルチモニタを考慮してウィンドウ領域を求める
 void GetWindowRectangle(HWND window, int *x, int *y,
                         int *width, int *height);
+#endif  // !defined(SCFF_IMAGING_HEADLESS)
 }   // namespace utilities
 }   // namespace scff_imaging
 
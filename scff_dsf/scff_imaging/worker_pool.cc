@@ -0,0 +1,168 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/worker_pool.cc
+/// scff_imaging::WorkerPoolの定義
+
+#include "scff_imaging/worker_pool.h"
+
+#include "scff_imaging/trace.h"
+
+namespace {
+
+/// ワーカースレッドの数を[0, kMaxWorkerCount]に収める
+int ClampWorkerCount(int worker_count) {
+  if (worker_count < 0) return 0;
+  if (worker_count > scff_imaging::WorkerPool::kMaxWorkerCount) {
+    return scff_imaging::WorkerPool::kMaxWorkerCount;
+  }
+  return worker_count;
+}
+}   // namespace
+
+namespace scff_imaging {
+
+//=====================================================================
+// scff_imaging::WorkerPool
+//=====================================================================
+
+WorkerPool::WorkerPool(int worker_count)
+    : worker_count_(ClampWorkerCount(worker_count)),
+      queue_count_(ClampWorkerCount(worker_count) > 0 ?
+                   ClampWorkerCount(worker_count) : 1),
+      next_queue_(0),
+      queued_(0),
+      pending_(0),
+      exiting_(false) {
+  for (int i = 0; i < worker_count_; i++) {
+    workers_.push_back(std::thread(&WorkerPool::WorkerMain, this, i));
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  // 残っているタスクを片付けてから終了させる
+  Join();
+  {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    exiting_ = true;
+  }
+  work_available_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkerPool::Submit(const Task &task) {
+  ++pending_;
+  {
+    TaskQueue &queue = queues_[next_queue_];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  next_queue_ = (next_queue_ + 1) % queue_count_;
+  ++queued_;
+
+  // 寝ているワーカーを1つ起こす
+  if (worker_count_ > 0) {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    work_available_.notify_one();
+  }
+}
+
+void WorkerPool::Join() {
+  while (pending_ > 0) {
+    // 待っている間も手伝う
+    Task task;
+    if (TrySteal(-1, &task)) {
+      Execute(task);
+      continue;
+    }
+    // 盗めるタスクがなければ実行中のタスクの完了を待つ
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    all_done_.wait(lock, [this] { return pending_ == 0 || queued_ > 0; });
+  }
+}
+
+int WorkerPool::worker_count() const {
+  return worker_count_;
+}
+
+int WorkerPool::GetDefaultWorkerCount() {
+  const int processor_count =
+      static_cast<int>(std::thread::hardware_concurrency());
+  // Joinを呼ぶスレッドも1つのワーカーとして働く
+  return ClampWorkerCount(processor_count - 1);
+}
+
+//-------------------------------------------------------------------
+
+void WorkerPool::WorkerMain(int index) {
+  SCFF_TRACE_THREAD_NAME("WorkerPool");
+  while (true) {
+    Task task;
+    if (TryPop(index, &task) || TrySteal(index, &task)) {
+      Execute(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    work_available_.wait(lock, [this] { return exiting_ || queued_ > 0; });
+    if (exiting_ && queued_ == 0) {
+      SCFF_TRACE_THREAD_EXIT();
+      return;
+    }
+  }
+}
+
+bool WorkerPool::TryPop(int index, Task *task) {
+  TaskQueue &queue = queues_[index];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty()) {
+    return false;
+  }
+  *task = queue.tasks.back();
+  queue.tasks.pop_back();
+  --queued_;
+  return true;
+}
+
+bool WorkerPool::TrySteal(int index, Task *task) {
+  for (int i = 1; i <= queue_count_; i++) {
+    const int victim = (index + i + queue_count_) % queue_count_;
+    if (victim == index) continue;
+    TaskQueue &queue = queues_[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    *task = queue.tasks.front();
+    queue.tasks.pop_front();
+    --queued_;
+    return true;
+  }
+  return false;
+}
+
+void WorkerPool::Execute(const Task &task) {
+  task();
+  if (--pending_ == 0) {
+    // Joinしているスレッドを起こす
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    all_done_.notify_all();
+  }
+}
+}   // namespace scff_imaging
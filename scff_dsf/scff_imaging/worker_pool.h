@@ -0,0 +1,117 @@
+﻿// Copyright 2012-2013 Alalf <alalf.iQLc_at_gmail.com>
+//
+// This file is part of SCFF-DirectShow-Filter(SCFF DSF).
+//
+// SCFF DSF is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// SCFF DSF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with SCFF DSF.  If not, see <http://www.gnu.org/licenses/>.
+
+/// @file scff_imaging/worker_pool.h
+/// scff_imaging::WorkerPoolの宣言
+
+#ifndef SCFF_DSF_SCFF_IMAGING_WORKER_POOL_H_
+#define SCFF_DSF_SCFF_IMAGING_WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "scff_imaging/common.h"
+
+namespace scff_imaging {
+
+/// ワークスティーリングを行うワーカースレッドのプール
+/// - タスクはワーカーごとのキューにラウンドロビンで積まれる
+/// - ワーカーは自分のキューの末尾から取り出し、
+///   空になったら他のワーカーのキューの先頭から盗む
+/// - Joinを呼び出したスレッドも盗みに参加する
+/// @attention Submit/Joinは1つのスレッドからのみ呼び出すこと
+class WorkerPool {
+ public:
+  /// タスク
+  typedef std::function<void()> Task;
+
+  /// ワーカースレッドの最大数
+  static const int kMaxWorkerCount = 16;
+
+  /// コンストラクタ
+  /// @param worker_count ワーカースレッドの数(0なら全てJoin内で実行)
+  explicit WorkerPool(int worker_count);
+  /// デストラクタ
+  ~WorkerPool();
+
+  /// タスクを積む
+  void Submit(const Task &task);
+  /// 積んだタスクがすべて終わるまで待つ(合流バリア)
+  void Join();
+
+  /// Getter: ワーカースレッドの数
+  int worker_count() const;
+
+  /// 論理プロセッサ数から求めたワーカースレッドの数
+  /// (Joinを呼ぶスレッドの分を差し引いている)
+  static int GetDefaultWorkerCount();
+
+ private:
+  /// ワーカーごとのタスクキュー
+  struct TaskQueue {
+    /// キューのロック
+    std::mutex mutex;
+    /// タスク
+    std::deque<Task> tasks;
+  };
+
+  /// ワーカースレッドの処理
+  void WorkerMain(int index);
+  /// 自分のキューの末尾からタスクを取り出す
+  bool TryPop(int index, Task *task);
+  /// 他のキューの先頭からタスクを盗む(index == -1なら全キューが対象)
+  bool TrySteal(int index, Task *task);
+  /// タスクを実行して完了を通知する
+  void Execute(const Task &task);
+
+  /// ワーカースレッドの数
+  const int worker_count_;
+  /// キューの数(ワーカースレッドが0でも1つは用意する)
+  const int queue_count_;
+  /// ワーカーごとのタスクキュー
+  TaskQueue queues_[kMaxWorkerCount];
+  /// 次にタスクを積むキュー
+  int next_queue_;
+
+  /// ワーカースレッド
+  std::vector<std::thread> workers_;
+
+  /// キューに積まれていてまだ誰も取り出していないタスクの数
+  std::atomic<int> queued_;
+  /// まだ完了していないタスクの数
+  std::atomic<int> pending_;
+  /// 終了要求
+  bool exiting_;
+
+  /// 待機用のロック
+  std::mutex wait_mutex_;
+  /// ワーカースレッドを起こす
+  std::condition_variable work_available_;
+  /// Joinしているスレッドを起こす
+  std::condition_variable all_done_;
+
+  // コピー＆代入禁止
+  DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+}   // namespace scff_imaging
+
+#endif  // SCFF_DSF_SCFF_IMAGING_WORKER_POOL_H_
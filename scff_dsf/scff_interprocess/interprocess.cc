@@ -358,6 +358,35 @@ bool Interprocess::RemoveEntry(uint32_t process_id) {
   return true;
 }
 
+bool Interprocess::UpdateEntry(const Entry &entry) {
+  // 初期化されていなければ失敗
+  if (!IsDirectoryInitialized()) {
+    return false;
+  }
+
+  // 定期的に呼ばれるのでOutputDebugStringはしない
+
+  // ロック取得
+  WaitForSingleObject(mutex_directory_, INFINITE);
+
+  Directory *directory =
+      static_cast<Directory*>(view_of_directory_);
+  bool success = false;
+  for (int i = 0; i < kMaxEntry; i++) {
+    if (directory->entries[i].process_id == entry.process_id) {
+      // PODなのでコピー可能（のはず）
+      directory->entries[i] = entry;
+      success = true;
+      break;
+    }
+  }
+
+  // ロック解放
+  ReleaseMutex(mutex_directory_);
+
+  return success;
+}
+
 bool Interprocess::ReceiveMessage(Message *message) {
   // 初期化されていなければ失敗
   if (!IsMessageInitialized()) {
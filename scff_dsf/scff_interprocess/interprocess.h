@@ -61,16 +61,18 @@ static const int kMaxComplexLayoutElements = 8;
 //---------------------------------------------------------------------
 
 /// 共有メモリ名: SCFFエントリを格納するディレクトリ
-static const char kDirectoryName[] = "scff_v1_directory";
+/// @attention Entryの構造を変えたらバージョンを上げること
+static const char kDirectoryName[] = "scff_v2_directory";
 
 /// Directoryの保護用Mutex名
-static const char kDirectoryMutexName[] = "mutex_scff_v1_directory";
+static const char kDirectoryMutexName[] = "mutex_scff_v2_directory";
 
 /// 共有メモリ名の接頭辞: SCFFで使うメッセージを格納する
-static const char kMessageNamePrefix[] = "scff_v1_message_";
+/// @attention Messageの構造を変えたらバージョンを上げること
+static const char kMessageNamePrefix[] = "scff_v3_message_";
 
 /// Messageの保護用Mutex名の接頭辞
-static const char kMessageMutexNamePrefix[] = "mutex_scff_v1_message_";
+static const char kMessageMutexNamePrefix[] = "mutex_scff_v3_message_";
 
 /// イベント名の接頭辞
 static const TCHAR kErrorEventNamePrefix[] = TEXT("scff_v1_error_event_");
@@ -97,6 +99,7 @@ enum class ImagePixelFormats {
   kUYVY,                      ///< UYVY(16bit)
   kYUY2,                      ///< YUY2(16bit)
   kRGB0,                      ///< RGB0(32bit)
+  kNV12,                      ///< NV12(12bit)
   kSupportedPixelFormatsCount ///</// 対応ピクセルフォーマット数
 };
 
@@ -127,6 +130,30 @@ enum class RotateDirections {
   kDegrees270       ///< 時計回り270度
 };
 
+/// 描画方法を表す定数
+/// @sa scff_imaging/imaging_types.h
+/// @sa scff_imaging::RenderingModes
+enum class RenderingModes {
+  kBuffered = 0,    ///< バッファに描画してサンプルにコピー
+  kDirect           ///< サンプルのバッファに直接描画
+};
+
+/// キャプチャと変換の実行方法を表す定数
+/// @sa scff_imaging/imaging_types.h
+/// @sa scff_imaging::PipelineModes
+enum class PipelineModes {
+  kSerial = 0,      ///< キャプチャと変換を同じスレッドで続けて行う
+  kPipelined        ///< キャプチャ専用スレッドと変換を並行して行う
+};
+
+/// 拡大縮小の品質の決め方を表す定数
+/// @sa scff_imaging/imaging_types.h
+/// @sa scff_imaging::ScaleQualityModes
+enum class ScaleQualityModes {
+  kFixed = 0,       ///< 常にレイアウトパラメータどおりの拡大縮小メソッドを使う
+  kAdaptive         ///< 処理が間に合わなければ軽いメソッドに切り替える
+};
+
 //---------------------------------------------------------------------
 
 // アラインメントをコンパイラに変えられないように
@@ -147,6 +174,17 @@ struct Entry {
   int32_t sample_image_pixel_format;
   /// 目標fps
   double fps;
+  /// 現在のキャプチャと変換の実行方法
+  /// @attention PipelineModesを操作に使うこと
+  int32_t pipeline_mode;
+  /// kPipelined: キャプチャ完了から変換開始までの遅延の平均(ミリ秒)
+  double pipeline_latency_average;
+  /// kPipelined: キャプチャ完了から変換開始までの遅延の最大(ミリ秒)
+  double pipeline_latency_max;
+  /// kPipelined: 変換されずに捨てられたキャプチャの数
+  int64_t pipeline_dropped_frames;
+  /// kPipelined: 新しいキャプチャが間に合わなかったフレームの数
+  int64_t pipeline_repeated_frames;
 };
 
 /// 共有メモリ(Directory)に格納する構造体
@@ -215,6 +253,9 @@ struct LayoutParameter {
   /// 回転方向
   /// @attention RotateDirectionを操作に使うこと
   int32_t rotate_direction;
+  /// 不透明度(0:完全に透明 - 255:不透明)
+  /// @warning NullLayout,NativeLayoutでは無視される
+  uint8_t opacity;
 };
 
 /// 共有メモリ(Message)に格納する構造体
@@ -231,6 +272,15 @@ struct Message {
   /// レイアウトパラメータの配列
   LayoutParameter
       layout_parameters[kMaxComplexLayoutElements];
+  /// 描画方法
+  /// @attention RenderingModesを操作に使うこと
+  int32_t rendering_mode;
+  /// キャプチャと変換の実行方法
+  /// @attention PipelineModesを操作に使うこと
+  int32_t pipeline_mode;
+  /// 拡大縮小の品質の決め方
+  /// @attention ScaleQualityModesを操作に使うこと
+  int32_t scale_quality_mode;
 };
 #pragma pack(pop)
 
@@ -266,6 +316,8 @@ class Interprocess {
   bool AddEntry(const Entry &entry);
   /// エントリを削除する
   bool RemoveEntry(uint32_t process_id);
+  /// 同じプロセスIDのエントリを書き換える
+  bool UpdateEntry(const Entry &entry);
   /// メッセージを受け取る
   /// @pre 事前にInitMessageが実行されている必要がある
   bool ReceiveMessage(Message *message);
@@ -22,6 +22,35 @@
 #include <dxgi1_2.h>
 #include <d3d11.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "scff_imaging/avpicture_image.h"
+#include "scff_imaging/background_region.h"
+#include "scff_imaging/box_reducer.h"
+#include "scff_imaging/capture_queue.h"
+#include "scff_imaging/compositor.h"
+#include "scff_imaging/fake_clock.h"
+#include "scff_imaging/fixed_ratio_scaler.h"
+#include "scff_imaging/frame_fingerprint.h"
+#include "scff_imaging/frame_scheduler.h"
+#include "scff_imaging/imaging_types.h"
+#include "scff_imaging/render_target.h"
+#include "scff_imaging/rotate.h"
+#include "scff_imaging/scale.h"
+#include "scff_imaging/scale_order_plan.h"
+#include "scff_imaging/scale_quality_controller.h"
+#include "scff_imaging/scale_stripe_plan.h"
+#include "scff_imaging/scaler_cache.h"
+#include "scff_imaging/trace.h"
+#include "scff_imaging/triple_buffer.h"
+#include "scff_imaging/unscaled_converter.h"
+#include "scff_imaging/utilities.h"
+#include "scff_imaging/worker_pool.h"
+
 void TestFFDraw() {
   FFDrawContext* test_context = new FFDrawContext;
   FFDrawColor* test_color = new FFDrawColor;
@@ -36,6 +65,1161 @@ void TestFFDraw() {
   delete test_context;
 }
 
+void TestTripleBuffer() {
+  // 書き込み側と読み込み側を異なるレートで回し、
+  // 読み込み側が書き込み途中のバッファ(破れたフレーム)を見ないこと、
+  // 世代が単調増加することを確認する
+  const int kBufferSize = 1920 * 1080 * 4;
+  const uint64_t kFrameCount = 20000;
+
+  scff_imaging::TripleBuffer triple_buffer;
+  std::vector<std::vector<uint8_t>> buffers(
+      scff_imaging::TripleBuffer::kBufferCount,
+      std::vector<uint8_t>(kBufferSize, 0));
+  std::atomic<bool> done(false);
+
+  std::thread producer([&]() {
+    for (uint64_t generation = 1; generation <= kFrameCount; generation++) {
+      // 世代から決まるパターンでバッファ全体を埋める
+      std::vector<uint8_t> &buffer = buffers[triple_buffer.write_index()];
+      const uint8_t pattern = static_cast<uint8_t>(generation * 31);
+      for (int i = 0; i < kBufferSize; i += 64) {
+        buffer[i] = pattern;
+      }
+      buffer[kBufferSize - 1] = pattern;
+      const uint64_t published = triple_buffer.Publish();
+      if (published != generation) {
+        printf("TripleBuffer: Bad Generation(%llu != %llu)\n",
+               published, generation);
+      }
+      if (generation % 7 == 0) std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  uint64_t last_generation = 0;
+  uint64_t read_count = 0;
+  uint64_t same_count = 0;
+  int torn_count = 0;
+  int reverse_count = 0;
+  while (!done || last_generation < kFrameCount) {
+    uint64_t generation = 0;
+    const int index = triple_buffer.AcquireLatest(&generation);
+    read_count++;
+    if (generation == 0) continue;
+    if (generation < last_generation) {
+      reverse_count++;
+    } else if (generation == last_generation) {
+      same_count++;
+    }
+    last_generation = generation;
+
+    // 読み込み中のバッファが書き換えられていないか
+    const std::vector<uint8_t> &buffer = buffers[index];
+    const uint8_t pattern = static_cast<uint8_t>(generation * 31);
+    for (int i = 0; i < kBufferSize; i += 64) {
+      if (buffer[i] != pattern) {
+        torn_count++;
+        break;
+      }
+    }
+    if (buffer[kBufferSize - 1] != pattern) torn_count++;
+    if (read_count % 3 == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  producer.join();
+
+  printf("TripleBuffer: read=%llu same=%llu torn=%d reverse=%d last=%llu\n",
+         read_count, same_count, torn_count, reverse_count, last_generation);
+  printf("TripleBuffer: %s\n",
+         (torn_count == 0 && reverse_count == 0 &&
+          last_generation == kFrameCount) ? "OK" : "NG");
+}
+
+namespace {
+/// テスト用のメディアサンプル(末尾に書き込み検出用のガードを持つ)
+class MockSample : public scff_imaging::RenderTarget {
+ public:
+  static const uint8_t kGuard = 0xCD;
+  explicit MockSample(int size)
+      : scff_imaging::RenderTarget(),
+        data_(size + 16, kGuard),
+        size_(size) {
+  }
+  uint8_t* buffer() const {
+    return const_cast<uint8_t*>(&(data_[0]));
+  }
+  int buffer_size() const {
+    return size_;
+  }
+  bool IsGuardIntact() const {
+    for (int i = size_; i < static_cast<int>(data_.size()); i++) {
+      if (data_[i] != kGuard) return false;
+    }
+    return true;
+  }
+ private:
+  std::vector<uint8_t> data_;
+  const int size_;
+};
+
+/// テスト用のアロケータ(CSourceStream同様にサンプルを使いまわす)
+class MockSamplePool {
+ public:
+  MockSamplePool(int count, int size) : next_(0) {
+    for (int i = 0; i < count; i++) {
+      samples_.push_back(new MockSample(size));
+    }
+  }
+  ~MockSamplePool() {
+    for (auto sample : samples_) delete sample;
+  }
+  MockSample* GetDeliveryBuffer() {
+    MockSample *sample = samples_[next_];
+    next_ = (next_ + 1) % samples_.size();
+    return sample;
+  }
+ private:
+  std::vector<MockSample*> samples_;
+  size_t next_;
+};
+
+/// レイアウトの代わりに出力全体を描画する
+void DrawTestFrame(AVPixelFormat format, int width, int height, int frame,
+                   AVPicture *picture) {
+  FFDrawContext draw_context;
+  FFDrawColor background;
+  FFDrawColor foreground;
+  ff_draw_init(&draw_context, format, 0);
+  uint8_t background_rgba[4] = {0, 0, 0, 255};
+  uint8_t foreground_rgba[4] = {
+    static_cast<uint8_t>(frame * 40),
+    static_cast<uint8_t>(255 - frame * 20),
+    static_cast<uint8_t>(frame * 7),
+    255
+  };
+  ff_draw_color(&draw_context, &background, background_rgba);
+  ff_draw_color(&draw_context, &foreground, foreground_rgba);
+  ff_fill_rectangle(&draw_context, &background,
+                    picture->data, picture->linesize,
+                    0, 0, width, height);
+  ff_fill_rectangle(&draw_context, &foreground,
+                    picture->data, picture->linesize,
+                    (frame * 16) % (width / 2), (frame * 8) % (height / 2),
+                    width / 2, height / 2);
+}
+}
+
+void TestRenderTarget() {
+  // サンプルのバッファに直接描画した結果(avpicture_fill)と
+  // 従来のイメージからコピーした結果(avpicture_layout)が一致することを確認する
+  const AVPixelFormat kFormats[] = {
+    AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_UYVY422,
+    AV_PIX_FMT_YUYV422,
+    AV_PIX_FMT_RGB0
+  };
+  const int kWidth = 322;
+  const int kHeight = 242;
+  const int kFrameCount = 12;
+
+  int ng_count = 0;
+  for each (auto format in kFormats) {
+    const int size = avpicture_get_size(format, kWidth, kHeight);
+    MockSamplePool pool(5, size);
+    std::vector<uint8_t> expected(size);
+
+    AVPicture buffered;
+    avpicture_alloc(&buffered, format, kWidth, kHeight);
+    for (int frame = 0; frame < kFrameCount; frame++) {
+      // 従来: イメージに描画してサンプルにコピー
+      DrawTestFrame(format, kWidth, kHeight, frame, &buffered);
+      avpicture_layout(&buffered, format, kWidth, kHeight,
+                       &(expected[0]), size);
+
+      // 直接: サンプルのバッファに描画
+      MockSample *sample = pool.GetDeliveryBuffer();
+      AVPicture direct;
+      const int result_fill = avpicture_fill(&direct, sample->buffer(),
+                                             format, kWidth, kHeight);
+      if (result_fill != sample->buffer_size()) {
+        printf("RenderTarget(%d): Bad Fill Size(%d)\n", format, result_fill);
+        ng_count++;
+        continue;
+      }
+      DrawTestFrame(format, kWidth, kHeight, frame, &direct);
+
+      if (memcmp(sample->buffer(), &(expected[0]), size) != 0) {
+        printf("RenderTarget(%d): Mismatch @ frame %d\n", format, frame);
+        ng_count++;
+      }
+      if (!sample->IsGuardIntact()) {
+        printf("RenderTarget(%d): Overrun @ frame %d\n", format, frame);
+        ng_count++;
+      }
+    }
+    avpicture_free(&buffered);
+  }
+
+  printf("RenderTarget: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+namespace {
+/// FakeClockでFrameSchedulerを回して結果を表示する
+bool RunFrameScheduler(const char *name, double fps,
+                       int64_t sleep_granularity, int64_t sleep_overshoot,
+                       int64_t relax_step, int64_t work, int spike_period,
+                       int64_t spike_work, int oversleep_frame,
+                       int64_t oversleep, int frame_count,
+                       bool precise, int64_t max_margin,
+                       int64_t min_skipped_frames,
+                       int64_t max_skipped_frames) {
+  scff_imaging::FakeClock clock(sleep_granularity, sleep_overshoot,
+                                relax_step);
+  scff_imaging::FrameScheduler scheduler(&clock);
+  scheduler.Reset(fps);
+
+  int64_t last_now = clock.Now();
+  bool monotonic = true;
+  int64_t peak_margin = 0LL;
+  int64_t peak_spin = 0LL;
+  for (int frame = 1; frame <= frame_count; frame++) {
+    // Updateの代わりに処理時間だけ時計を進める
+    const bool spike = spike_period > 0 && frame % spike_period == 0;
+    clock.Advance(spike ? spike_work : work);
+    if (frame == oversleep_frame) clock.AddOversleep(oversleep);
+    const int64_t relax_count = clock.relax_count();
+    scheduler.WaitNextFrame(nullptr);
+    if (clock.Now() < last_now) monotonic = false;
+    last_now = clock.Now();
+    // 寝過ごしさせた場合はその後の前倒し量とスピンだけを見る
+    if (frame < oversleep_frame) continue;
+    if (scheduler.sleep_margin() > peak_margin) {
+      peak_margin = scheduler.sleep_margin();
+    }
+    const int64_t spin = (clock.relax_count() - relax_count) * relax_step;
+    if (spin > peak_spin) peak_spin = spin;
+  }
+
+  const scff_imaging::WakeErrorStats &stats = scheduler.wake_error_stats();
+  printf("FrameScheduler[%s]: count=%lld min=%lld mean=%lld max=%lld"
+         " late=%lld skipped=%lld sleeps=%lld relaxes=%lld margin=%lld"
+         " peak_margin=%lld peak_spin=%lld\n",
+         name, stats.count, stats.min,
+         stats.count > 0 ? stats.sum / stats.count : 0LL, stats.max,
+         stats.late_frames, stats.skipped_frames,
+         clock.sleep_count(), clock.relax_count(), scheduler.sleep_margin(),
+         peak_margin, peak_spin);
+  for (int i = 0; i < scff_imaging::WakeErrorStats::kBucketCount; i++) {
+    printf("  < %lld: %lld\n",
+           scff_imaging::FrameScheduler::GetBucketUpperBound(i),
+           stats.buckets[i]);
+  }
+
+  // 寝過ごし量を学習するまでの数フレームを除けば
+  // スピンで待つので起床誤差は50uSec未満に収まるはず
+  // (タイマの分解能が粗い場合は精度よりもスピンしすぎないことを優先する)
+  // 前倒し量(=1フレームでスピンする時間)は上限を超えないはず
+  return monotonic &&
+         stats.min >= 0 &&
+         (!precise || stats.buckets[0] * 100 >= stats.count * 99) &&
+         peak_margin <= max_margin &&
+         peak_spin <= max_margin + relax_step &&
+         (!precise || stats.late_frames == 0) &&
+         stats.skipped_frames >= min_skipped_frames &&
+         stats.skipped_frames <= max_skipped_frames;
+}
+}
+
+void TestFrameScheduler() {
+  // 実時間を使わないので結果は常に同じになる
+  bool ok = true;
+  // 60fps, 15.6mSec分解能のSleep(timeBeginPeriod(1)が効かない),
+  // 処理時間5mSec: フレーム間隔の1/4(4.2mSec)を超えてスピンしない
+  ok &= RunFrameScheduler("60fps/coarse", 60.0, 156250, 0, 100,
+                          50000, 0, 0, 0, 0, 600, false, 41667, 0, 600);
+  // 120fps, 1mSec分解能+0.5mSec寝過ごし, 処理時間3mSec: スキップなし
+  ok &= RunFrameScheduler("120fps/fine", 120.0, 10000, 5000, 50,
+                          30000, 0, 0, 0, 0, 1200, true, 20833, 0, 0);
+  // 60fps, 100フレームごとに50mSecかかる: 毎回2-3フレームスキップ
+  ok &= RunFrameScheduler("60fps/spike", 60.0, 10000, 2000, 50,
+                          50000, 100, 500000, 0, 0, 1000, true, 41667, 20, 30);
+  // 60fps, 300フレーム目だけ10mSec寝過ごす(プリエンプション):
+  // 外れ値なので前倒し量は増えない(1mSec分解能+0.2mSec+最低限の0.2mSec)
+  ok &= RunFrameScheduler("60fps/outlier", 60.0, 10000, 2000, 50,
+                          50000, 0, 0, 300, 100000, 1000, true, 15000, 0, 0);
+  printf("FrameScheduler: %s\n", ok ? "OK" : "NG");
+}
+
+namespace {
+/// ComplexLayoutの1要素分(RGB0->I420の縮小)を模したもの
+struct BenchElement {
+  AVPicture input;
+  AVPicture output;
+  SwsContext *scaler;
+};
+
+/// 全要素をworker_countのプールで変換してフレームあたりの時間(mSec)を返す
+double RunWorkerPool(int worker_count, int frame_count,
+                     std::vector<BenchElement> *elements) {
+  scff_imaging::WorkerPool pool(worker_count);
+  const int kInputHeight = 720;
+
+  const auto start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < frame_count; frame++) {
+    for (int i = static_cast<int>(elements->size()) - 1; i >= 0; i--) {
+      BenchElement *element = &((*elements)[i]);
+      pool.Submit([element, kInputHeight] {
+        sws_scale(element->scaler,
+                  element->input.data, element->input.linesize,
+                  0, kInputHeight,
+                  element->output.data, element->output.linesize);
+      });
+    }
+    pool.Join();
+  }
+  const auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() /
+         frame_count;
+}
+}
+
+void BenchWorkerPool() {
+  // ComplexLayoutと同じく要素ごとにScale相当の処理をプールに投げ、
+  // ワーカースレッドの数を変えてフレームあたりの処理時間を比較する
+  const int kElementCount = 8;
+  const int kInputWidth = 1280;
+  const int kInputHeight = 720;
+  const int kOutputWidth = 640;
+  const int kOutputHeight = 360;
+  const int kFrameCount = 60;
+
+  std::vector<BenchElement> elements(kElementCount);
+  for (int i = 0; i < kElementCount; i++) {
+    BenchElement &element = elements[i];
+    avpicture_alloc(&element.input, AV_PIX_FMT_RGB0,
+                    kInputWidth, kInputHeight);
+    avpicture_alloc(&element.output, AV_PIX_FMT_YUV420P,
+                    kOutputWidth, kOutputHeight);
+    for (int y = 0; y < kInputHeight; y++) {
+      uint8_t *line = element.input.data[0] + y * element.input.linesize[0];
+      for (int x = 0; x < kInputWidth * 4; x++) {
+        line[x] = static_cast<uint8_t>(x * 7 + y * 3 + i * 29);
+      }
+    }
+    element.scaler = sws_getContext(kInputWidth, kInputHeight,
+                                    AV_PIX_FMT_RGB0,
+                                    kOutputWidth, kOutputHeight,
+                                    AV_PIX_FMT_YUV420P,
+                                    SWS_BICUBIC, nullptr, nullptr, nullptr);
+  }
+
+  // 逐次実行(ワーカー0)を基準にする
+  const int processor_count =
+      static_cast<int>(std::thread::hardware_concurrency());
+  const int max_worker_count =
+      std::min(std::max(processor_count - 1, 1),
+               scff_imaging::WorkerPool::kMaxWorkerCount);
+  const double baseline = RunWorkerPool(0, kFrameCount, &elements);
+  printf("WorkerPool: threads=1 %.2fmSec/frame\n", baseline);
+  for (int worker_count = 1; worker_count <= max_worker_count;
+       worker_count++) {
+    const double elapsed = RunWorkerPool(worker_count, kFrameCount,
+                                         &elements);
+    // Joinを呼ぶスレッドも処理に加わる
+    printf("WorkerPool: threads=%d %.2fmSec/frame x%.2f\n",
+           worker_count + 1, elapsed, baseline / elapsed);
+  }
+
+  for (int i = 0; i < kElementCount; i++) {
+    sws_freeContext(elements[i].scaler);
+    avpicture_free(&elements[i].input);
+    avpicture_free(&elements[i].output);
+  }
+}
+
+void TestWorkerPool() {
+  // 大量の小さなタスクを投げ、全て1回ずつ実行されてからJoinが戻ることを確認する
+  const int kTaskCount = 1000;
+  const int kRoundCount = 200;
+
+  scff_imaging::WorkerPool pool(scff_imaging::WorkerPool::kMaxWorkerCount);
+  std::vector<std::atomic<int>> executed(kTaskCount);
+  for (int i = 0; i < kTaskCount; i++) {
+    executed[i].store(0);
+  }
+  int ng_count = 0;
+  for (int round = 1; round <= kRoundCount; round++) {
+    for (int i = 0; i < kTaskCount; i++) {
+      std::atomic<int> *counter = &(executed[i]);
+      pool.Submit([counter] { counter->fetch_add(1); });
+    }
+    pool.Join();
+    for (int i = 0; i < kTaskCount; i++) {
+      if (executed[i].load() != round) {
+        ng_count++;
+        break;
+      }
+    }
+  }
+
+  // ワーカー0でも呼び出し元だけで全て処理できる
+  scff_imaging::WorkerPool serial_pool(0);
+  int serial_count = 0;
+  for (int i = 0; i < kTaskCount; i++) {
+    serial_pool.Submit([&serial_count] { serial_count++; });
+  }
+  serial_pool.Join();
+  if (serial_count != kTaskCount) ng_count++;
+
+  printf("WorkerPool: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void TestScaleStripePlan() {
+  // ストライプが出力を隙間なく覆い、入出力の比が全体と一致し、
+  // 重なりがフィルタ半径以上あることを確認する
+  // 入力がYUV420Pの場合は入力の境界が偶数行であることも確認する
+  const int kHeights[][2] = {
+    {2160, 1080}, {1080, 720}, {768, 720}, {720, 1080},
+    {480, 960}, {1080, 1080}, {1050, 480}, {1200, 1079}, {630, 720}
+  };
+  const int kFlags[] = {
+    SWS_POINT, SWS_BILINEAR, SWS_BICUBIC, SWS_LANCZOS, SWS_SPLINE
+  };
+
+  int ng_count = 0;
+  int split_count = 0;
+  for each (auto heights in kHeights) {
+    const int src_height = heights[0];
+    const int dst_height = heights[1];
+    for each (auto flags in kFlags) {
+      // 出力と入力の色差の縦方向の間引き(0/1)の組み合わせ
+      for (int chroma = 0; chroma < 4; chroma++) {
+        const int log2_chroma_h = chroma & 1;
+        const int log2_src_chroma_h = chroma >> 1;
+        const int radius = scff_imaging::ScaleStripePlan::GetFilterRadius(
+            flags, src_height, dst_height, log2_chroma_h, log2_src_chroma_h,
+            0);
+        scff_imaging::ScaleStripePlan plan;
+        if (!plan.Build(src_height, dst_height, log2_chroma_h,
+                        log2_src_chroma_h, radius, 4, false)) {
+          if (plan.stripe_count() != 1) ng_count++;
+          continue;
+        }
+        split_count++;
+        int next_dst_y = 0;
+        for (int i = 0; i < plan.stripe_count(); i++) {
+          const scff_imaging::ScaleStripe &stripe = plan.stripe(i);
+          // 隙間なく覆う
+          if (stripe.dst_y != next_dst_y || stripe.dst_height <= 0) ng_count++;
+          next_dst_y = stripe.dst_y + stripe.dst_height;
+          // 比が一致する
+          if (static_cast<long long>(stripe.src_height) * dst_height !=
+              static_cast<long long>(stripe.scaled_height) * src_height ||
+              static_cast<long long>(stripe.src_y) * dst_height !=
+              static_cast<long long>(stripe.scaled_y) * src_height) {
+            ng_count++;
+          }
+          // 重なりがフィルタ半径以上(画像の端は除く)
+          const int top = stripe.dst_y - stripe.scaled_y;
+          const int bottom = stripe.scaled_y + stripe.scaled_height -
+                             (stripe.dst_y + stripe.dst_height);
+          if ((stripe.scaled_y > 0 &&
+               static_cast<long long>(top) * src_height <
+                   static_cast<long long>(radius) * dst_height) ||
+              (stripe.scaled_y + stripe.scaled_height < dst_height &&
+               static_cast<long long>(bottom) * src_height <
+                   static_cast<long long>(radius) * dst_height)) {
+            ng_count++;
+          }
+          // 開始行はディザ周期と色差の間引きに揃っている
+          if (stripe.scaled_y % 8 != 0 || stripe.dst_y % 8 != 0) ng_count++;
+          // 入力の境界は入力の色差の間引きに揃っている
+          if (stripe.src_y % (1 << log2_src_chroma_h) != 0 ||
+              stripe.src_height % (1 << log2_src_chroma_h) != 0) {
+            ng_count++;
+          }
+        }
+        if (next_dst_y != dst_height) ng_count++;
+      }
+    }
+  }
+
+  printf("ScaleStripePlan: split=%d %s\n", split_count,
+         ng_count == 0 ? "OK" : "NG");
+}
+
+namespace {
+/// ScaleStripePlanに従ってストライプごとに拡大縮小する(Scale::Runと同じ処理)
+class StripeScaler {
+ public:
+  StripeScaler(int src_width, int src_height, AVPixelFormat src_format,
+               int dst_width, int dst_height, AVPixelFormat dst_format,
+               int flags, int max_stripe_count)
+      : dst_width_(dst_width),
+        dst_format_(dst_format) {
+    const int log2_chroma_h =
+        av_pix_fmt_desc_get(dst_format)->log2_chroma_h;
+    const int radius = scff_imaging::ScaleStripePlan::GetFilterRadius(
+        flags, src_height, dst_height, log2_chroma_h, 0, 0);
+    const bool exact_only =
+        (flags & (SWS_POINT | SWS_BILINEAR | SWS_FAST_BILINEAR)) != 0;
+    plan_.Build(src_height, dst_height, log2_chroma_h, 0, radius,
+                max_stripe_count, exact_only);
+    for (int i = 0; i < plan_.stripe_count(); i++) {
+      const scff_imaging::ScaleStripe &stripe = plan_.stripe(i);
+      scalers_.push_back(sws_getContext(src_width, stripe.src_height,
+                                        src_format,
+                                        dst_width, stripe.scaled_height,
+                                        dst_format,
+                                        flags, nullptr, nullptr, nullptr));
+      AVPicture picture;
+      avpicture_alloc(&picture, dst_format, dst_width, stripe.scaled_height);
+      pictures_.push_back(picture);
+    }
+  }
+  ~StripeScaler() {
+    for (size_t i = 0; i < scalers_.size(); i++) {
+      sws_freeContext(scalers_[i]);
+      avpicture_free(&(pictures_[i]));
+    }
+  }
+  int stripe_count() const {
+    return plan_.stripe_count();
+  }
+  const scff_imaging::ScaleStripe& stripe(int index) const {
+    return plan_.stripe(index);
+  }
+  void Run(scff_imaging::WorkerPool *pool,
+           const AVPicture &input, AVPicture *output) {
+    for (int i = plan_.stripe_count() - 1; i >= 0; i--) {
+      pool->Submit([this, i, &input, output] {
+        RunStripe(i, input, output);
+      });
+    }
+    pool->Join();
+  }
+  void RunStripe(int index, const AVPicture &input, AVPicture *output) {
+    const scff_imaging::ScaleStripe &stripe = plan_.stripe(index);
+    const uint8_t *src[4] = {
+      input.data[0] + stripe.src_y * input.linesize[0],
+      nullptr, nullptr, nullptr
+    };
+    AVPicture *scaled = &(pictures_[index]);
+    sws_scale(scalers_[index], src, input.linesize, 0, stripe.src_height,
+              scaled->data, scaled->linesize);
+    const int log2_chroma_h =
+        av_pix_fmt_desc_get(dst_format_)->log2_chroma_h;
+    const int skip = stripe.dst_y - stripe.scaled_y;
+    for (int plane = 0; plane < av_pix_fmt_count_planes(dst_format_);
+         plane++) {
+      const int shift = (plane == 1 || plane == 2) ? log2_chroma_h : 0;
+      av_image_copy_plane(
+          output->data[plane] +
+              (stripe.dst_y >> shift) * output->linesize[plane],
+          output->linesize[plane],
+          scaled->data[plane] + (skip >> shift) * scaled->linesize[plane],
+          scaled->linesize[plane],
+          av_image_get_linesize(dst_format_, dst_width_, plane),
+          stripe.dst_height >> shift);
+    }
+  }
+ private:
+  scff_imaging::ScaleStripePlan plan_;
+  std::vector<SwsContext*> scalers_;
+  std::vector<AVPicture> pictures_;
+  const int dst_width_;
+  const AVPixelFormat dst_format_;
+};
+
+/// 2つのAVPictureの内容が一致するか
+bool IsSamePicture(const AVPicture &a, const AVPicture &b,
+                   AVPixelFormat format, int width, int height) {
+  const int log2_chroma_h = av_pix_fmt_desc_get(format)->log2_chroma_h;
+  for (int plane = 0; plane < av_pix_fmt_count_planes(format); plane++) {
+    const int shift = (plane == 1 || plane == 2) ? log2_chroma_h : 0;
+    const int bytes = av_image_get_linesize(format, width, plane);
+    for (int y = 0; y < (height >> shift); y++) {
+      if (memcmp(a.data[plane] + y * a.linesize[plane],
+                 b.data[plane] + y * b.linesize[plane], bytes) != 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// 入力をテスト用の模様で埋める
+void FillTestPattern(AVPicture *picture, int width, int height) {
+  for (int y = 0; y < height; y++) {
+    uint8_t *line = picture->data[0] + y * picture->linesize[0];
+    for (int x = 0; x < width * 4; x++) {
+      line[x] = static_cast<uint8_t>((x * 13) ^ (y * 7) ^ ((x + y) >> 3));
+    }
+  }
+}
+}
+
+void BenchScaleStripes() {
+  // SWScaleFlagsごとに一枚で処理した場合とストライプに分割した場合を比較する
+  // point/bilinearは一致しなければならない
+  // (1366x768->1280x720のように比の分母が2の累乗でない場合は分割しない)
+  const struct {
+    const char *name;
+    int flags;
+    bool must_match;
+  } kFlags[] = {
+    {"fast_bilinear", SWS_FAST_BILINEAR, false},
+    {"bilinear", SWS_BILINEAR, true},
+    {"bicubic", SWS_BICUBIC, false},
+    {"x", SWS_X, false},
+    {"point", SWS_POINT, true},
+    {"area", SWS_AREA, false},
+    {"bicublin", SWS_BICUBLIN, false},
+    {"gauss", SWS_GAUSS, false},
+    {"sinc", SWS_SINC, false},
+    {"lanczos", SWS_LANCZOS, false},
+    {"spline", SWS_SPLINE, false}
+  };
+  const struct {
+    int src_width, src_height;
+    int dst_width, dst_height;
+    AVPixelFormat dst_format;
+  } kSizes[] = {
+    {3840, 2160, 1920, 1080, AV_PIX_FMT_YUV420P},
+    {1366, 768, 1280, 720, AV_PIX_FMT_UYVY422},
+    {640, 480, 1280, 960, AV_PIX_FMT_YUV420P}
+  };
+  const int kFrameCount = 10;
+
+  const int processor_count =
+      static_cast<int>(std::thread::hardware_concurrency());
+  const int worker_count =
+      std::min(std::max(processor_count - 1, 1),
+               scff_imaging::ScaleStripePlan::kMaxStripeCount - 1);
+  scff_imaging::WorkerPool pool(worker_count);
+
+  int ng_count = 0;
+  for each (auto size in kSizes) {
+    AVPicture input;
+    AVPicture single_output;
+    AVPicture stripe_output;
+    avpicture_alloc(&input, AV_PIX_FMT_BGR0,
+                    size.src_width, size.src_height);
+    avpicture_alloc(&single_output, size.dst_format,
+                    size.dst_width, size.dst_height);
+    avpicture_alloc(&stripe_output, size.dst_format,
+                    size.dst_width, size.dst_height);
+    FillTestPattern(&input, size.src_width, size.src_height);
+
+    for each (auto flag in kFlags) {
+      SwsContext *scaler = sws_getContext(size.src_width, size.src_height,
+                                          AV_PIX_FMT_BGR0,
+                                          size.dst_width, size.dst_height,
+                                          size.dst_format,
+                                          flag.flags,
+                                          nullptr, nullptr, nullptr);
+      StripeScaler stripe_scaler(size.src_width, size.src_height,
+                                 AV_PIX_FMT_BGR0,
+                                 size.dst_width, size.dst_height,
+                                 size.dst_format,
+                                 flag.flags, worker_count + 1);
+
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < kFrameCount; frame++) {
+        sws_scale(scaler, input.data, input.linesize, 0, size.src_height,
+                  single_output.data, single_output.linesize);
+      }
+      auto end = std::chrono::high_resolution_clock::now();
+      const double single =
+          std::chrono::duration<double, std::milli>(end - start).count() /
+          kFrameCount;
+
+      start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < kFrameCount; frame++) {
+        stripe_scaler.Run(&pool, input, &stripe_output);
+      }
+      end = std::chrono::high_resolution_clock::now();
+      const double striped =
+          std::chrono::duration<double, std::milli>(end - start).count() /
+          kFrameCount;
+
+      const bool same = IsSamePicture(single_output, stripe_output,
+                                      size.dst_format,
+                                      size.dst_width, size.dst_height);
+      if (flag.must_match && !same) ng_count++;
+      printf("ScaleStripes[%dx%d->%dx%d %s]: stripes=%d"
+             " single=%.2fmSec striped=%.2fmSec x%.2f %s\n",
+             size.src_width, size.src_height,
+             size.dst_width, size.dst_height, flag.name,
+             stripe_scaler.stripe_count(), single, striped, single / striped,
+             same ? "identical" : "differ");
+      sws_freeContext(scaler);
+    }
+
+    avpicture_free(&input);
+    avpicture_free(&single_output);
+    avpicture_free(&stripe_output);
+  }
+
+  printf("ScaleStripes: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void TestFrameFingerprint() {
+  using scff_imaging::FrameFingerprint;
+  int ng_count = 0;
+
+  // SSE2版とSIMDを使わない版は端数の有無にかかわらず一致する
+  std::vector<uint8_t> buffer(4096 * 8);
+  for (size_t i = 0; i < buffer.size(); i++) {
+    buffer[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+  }
+  const int kWidths[] = {1, 15, 16, 17, 63, 64, 65, 1000, 4096};
+  for each (auto width in kWidths) {
+    for (int rows = 1; rows <= 8; rows++) {
+      if (FrameFingerprint::HashBlock(&buffer[0], 4096, width, rows) !=
+          FrameFingerprint::HashBlockPortable(&buffer[0], 4096, width, rows)) {
+        ng_count++;
+      }
+    }
+  }
+
+  // 1920x1080(RGB0)
+  const int kWidth = 1920;
+  const int kHeight = 1080;
+  const int kWidthBytes = kWidth * 4;
+  std::vector<uint8_t> frame(kWidthBytes * kHeight);
+  for (size_t i = 0; i < frame.size(); i++) {
+    frame[i] = static_cast<uint8_t>(i * 7 + (i >> 11));
+  }
+  FrameFingerprint previous;
+  FrameFingerprint current;
+  previous.Compute(&frame[0], kWidthBytes, kWidthBytes, kHeight);
+
+  // 同じ内容なら行の間隔が違っても一致する
+  const int kPaddedStride = kWidthBytes + 64;
+  std::vector<uint8_t> padded(kPaddedStride * kHeight, 0xCD);
+  for (int y = 0; y < kHeight; y++) {
+    memcpy(&padded[y * kPaddedStride], &frame[y * kWidthBytes], kWidthBytes);
+  }
+  current.Compute(&padded[0], kPaddedStride, kWidthBytes, kHeight);
+  if (!current.Equals(previous)) ng_count++;
+
+  // どこか1ビットでも変われば一致しない
+  const int kOffsets[] = {0, 15, kWidthBytes - 1, kWidthBytes * 500 + 1234,
+                          kWidthBytes * kHeight - 1};
+  for each (auto offset in kOffsets) {
+    frame[offset] ^= 0x01;
+    current.Compute(&frame[0], kWidthBytes, kWidthBytes, kHeight);
+    if (current.Equals(previous)) ng_count++;
+    frame[offset] ^= 0x01;
+  }
+
+  // 16バイト単位で入れ替えても一致しない(位置に依存する)
+  std::swap_ranges(frame.begin(), frame.begin() + 16, frame.begin() + 16);
+  current.Compute(&frame[0], kWidthBytes, kWidthBytes, kHeight);
+  if (current.Equals(previous)) ng_count++;
+
+  // 大きさが違えば一致しない・Clear後はなにとも一致しない
+  current.Compute(&frame[0], kWidthBytes, kWidthBytes, kHeight - 1);
+  if (current.Equals(previous)) ng_count++;
+  current.Clear();
+  if (current.Equals(current)) ng_count++;
+
+  // 変化したブロックを含む範囲だけが変化したことになる
+  previous.Compute(&frame[0], kWidthBytes, kWidthBytes, kHeight);
+  frame[kWidthBytes * 100] ^= 0x80;
+  current.Compute(&frame[0], kWidthBytes, kWidthBytes, kHeight);
+  frame[kWidthBytes * 100] ^= 0x80;
+  if (!current.IsRangeChanged(previous, 100, 1)) ng_count++;
+  if (!current.IsRangeChanged(previous, 90, 20)) ng_count++;
+  if (!current.IsRangeChanged(previous, 0, kHeight)) ng_count++;
+  if (current.IsRangeChanged(previous, 0, 96)) ng_count++;
+  if (current.IsRangeChanged(previous, 112, kHeight - 112)) ng_count++;
+  if (!current.IsRangeChanged(previous, 0, 97)) ng_count++;
+  current.Compute(&frame[0], kWidthBytes, kWidthBytes, kHeight - 1);
+  if (!current.IsRangeChanged(previous, 0, 1)) ng_count++;
+
+  printf("FrameFingerprint: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void TestBackgroundRegion() {
+  using scff_imaging::BackgroundRegion;
+  using scff_imaging::ImageRect;
+  int ng_count = 0;
+
+  // 全面を覆う要素があれば背景はない
+  BackgroundRegion region;
+  const ImageRect kFullScreen[] = {{0, 0, 1920, 1080}};
+  region.Build(1920, 1080, 2, 2, 1, kFullScreen);
+  if (region.rect_count() != 0) ng_count++;
+
+  // 中央の要素の周りは上・左・右・下の4つ
+  const ImageRect kCenter[] = {{100, 50, 200, 100}};
+  region.Build(400, 200, 2, 2, 1, kCenter);
+  if (region.rect_count() != 4) ng_count++;
+
+  // 要素の配置をいろいろ変えて、背景の矩形が
+  // 重ならず・そろっていて・要素以外をすべて覆うか調べる
+  const int kWidth = 64;
+  const int kHeight = 48;
+  const int kAligns[][2] = {{1, 1}, {2, 1}, {2, 2}};
+  uint32_t seed = 12345;
+  for (int trial = 0; trial < 300; trial++) {
+    const int align_x = kAligns[trial % 3][0];
+    const int align_y = kAligns[trial % 3][1];
+    ImageRect elements[scff_imaging::kMaxProcessorSize];
+    const int element_count = 1 + trial % scff_imaging::kMaxProcessorSize;
+    for (int i = 0; i < element_count; i++) {
+      seed = seed * 1103515245 + 12345;
+      elements[i].x = (seed >> 8) % kWidth;
+      elements[i].y = (seed >> 16) % kHeight;
+      seed = seed * 1103515245 + 12345;
+      elements[i].width = 1 + (seed >> 8) % (kWidth - elements[i].x);
+      elements[i].height = 1 + (seed >> 16) % (kHeight - elements[i].y);
+    }
+    region.Build(kWidth, kHeight, align_x, align_y, element_count, elements);
+
+    std::vector<int> background(kWidth * kHeight, 0);
+    for (int i = 0; i < region.rect_count(); i++) {
+      const ImageRect &rect = region.rect(i);
+      const int right = rect.x + rect.width;
+      const int bottom = rect.y + rect.height;
+      if (rect.x % align_x != 0 || rect.y % align_y != 0 ||
+          (right != kWidth && right % align_x != 0) ||
+          (bottom != kHeight && bottom % align_y != 0)) {
+        ng_count++;
+      }
+      for (int y = rect.y; y < bottom; y++) {
+        for (int x = rect.x; x < right; x++) {
+          background[y * kWidth + x]++;
+        }
+      }
+    }
+    for (int y = 0; y < kHeight; y++) {
+      for (int x = 0; x < kWidth; x++) {
+        bool covered = false;
+        for (int i = 0; i < element_count; i++) {
+          covered = covered ||
+              (elements[i].x <= x && x < elements[i].x + elements[i].width &&
+               elements[i].y <= y && y < elements[i].y + elements[i].height);
+        }
+        const int count = background[y * kWidth + x];
+        if (count > 1 || (!covered && count != 1)) ng_count++;
+      }
+    }
+  }
+
+  // 背景だけを塗る合成(2つのバッファに交互に描画し、塗りつぶしは一度だけ)が
+  // 全面を塗ってから要素を描画する合成とYUV420Pで完全に一致する
+  FFDrawContext context;
+  FFDrawColor color;
+  uint8_t black[4] = {0};
+  ff_draw_init(&context, AV_PIX_FMT_YUV420P, 0);
+  ff_draw_color(&context, &color, black);
+  const ImageRect kOddElements[] = {{3, 5, 21, 17}, {23, 7, 30, 33}};
+  region.Build(kWidth, kHeight,
+               1 << context.hsub_max, 1 << context.vsub_max,
+               2, kOddElements);
+  const int kPlaneSizes[] = {kWidth * kHeight, kWidth * kHeight / 4,
+                             kWidth * kHeight / 4};
+  std::vector<uint8_t> reference[3];
+  std::vector<uint8_t> buffers[2][3];
+  std::vector<uint8_t> element[3];
+  for (int plane = 0; plane < 3; plane++) {
+    reference[plane].resize(kPlaneSizes[plane]);
+    buffers[0][plane].assign(kPlaneSizes[plane], 0xAA);
+    buffers[1][plane].assign(kPlaneSizes[plane], 0x55);
+    element[plane].resize(kPlaneSizes[plane]);
+  }
+  int linesize[4] = {kWidth, kWidth / 2, kWidth / 2, 0};
+  for (int frame = 0; frame < 6; frame++) {
+    for (int plane = 0; plane < 3; plane++) {
+      for (int i = 0; i < kPlaneSizes[plane]; i++) {
+        element[plane][i] = static_cast<uint8_t>(i * 13 + frame * 71 + plane);
+      }
+    }
+    uint8_t *element_data[4] = {&element[0][0], &element[1][0],
+                                &element[2][0], nullptr};
+    uint8_t *reference_data[4] = {&reference[0][0], &reference[1][0],
+                                  &reference[2][0], nullptr};
+    std::vector<uint8_t> (&buffer)[3] = buffers[frame % 2];
+    uint8_t *buffer_data[4] = {&buffer[0][0], &buffer[1][0],
+                               &buffer[2][0], nullptr};
+
+    ff_fill_rectangle(&context, &color, reference_data, linesize,
+                      0, 0, kWidth, kHeight);
+    if (region.MarkFilled(buffer_data[0])) {
+      for (int i = 0; i < region.rect_count(); i++) {
+        const ImageRect &rect = region.rect(i);
+        ff_fill_rectangle(&context, &color, buffer_data, linesize,
+                          rect.x, rect.y, rect.width, rect.height);
+      }
+    }
+    for each (auto rect in kOddElements) {
+      ff_copy_rectangle2(&context, reference_data, linesize,
+                         element_data, linesize,
+                         rect.x, rect.y, 0, 0, rect.width, rect.height);
+      ff_copy_rectangle2(&context, buffer_data, linesize,
+                         element_data, linesize,
+                         rect.x, rect.y, 0, 0, rect.width, rect.height);
+    }
+    for (int plane = 0; plane < 3; plane++) {
+      if (buffer[plane] != reference[plane]) ng_count++;
+    }
+  }
+
+  printf("BackgroundRegion: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void TestVisibleRects() {
+  // Compositorで隠れた要素を取り除き見える部分だけを描画する合成が、
+  // 全要素を全体ずつ描画する合成とYUV420Pで完全に一致する
+  // (奇数の位置・半透明・完全に透明な要素を含む)
+  // IsIsolatedな要素は合成の前に出力へ直接描画しても結果が変わらない
+  using scff_imaging::ImageRect;
+  const int kWidth = 64;
+  const int kHeight = 48;
+  const int kMaxCount = scff_imaging::kMaxProcessorSize;
+  FFDrawContext context;
+  FFDrawColor color;
+  uint8_t black[4] = {0};
+  ff_draw_init(&context, AV_PIX_FMT_YUV420P, 0);
+  ff_draw_color(&context, &color, black);
+  const int align_x = 1 << context.hsub_max;
+  const int align_y = 1 << context.vsub_max;
+
+  AVPicture reference;
+  AVPicture culled;
+  AVPicture elements[kMaxCount];
+  avpicture_alloc(&reference, AV_PIX_FMT_YUV420P, kWidth, kHeight);
+  avpicture_alloc(&culled, AV_PIX_FMT_YUV420P, kWidth, kHeight);
+  for (int i = 0; i < kMaxCount; i++) {
+    avpicture_alloc(&(elements[i]), AV_PIX_FMT_YUV420P, kWidth, kHeight);
+    for (int plane = 0; plane < 3; plane++) {
+      const int rows = plane == 0 ? kHeight : kHeight / 2;
+      for (int j = 0; j < elements[i].linesize[plane] * rows; j++) {
+        elements[i].data[plane][j] = static_cast<uint8_t>(j * 13 + i * 71);
+      }
+    }
+  }
+
+  int ng_count = 0;
+  int hidden_count = 0;
+  int split_count = 0;
+  int isolated_count = 0;
+  uint32_t seed = 4321;
+  for (int trial = 0; trial < 500; trial++) {
+    const int element_count = 1 + trial % kMaxCount;
+    ImageRect rects[kMaxCount];
+    int opacities[kMaxCount];
+    for (int i = 0; i < element_count; i++) {
+      seed = seed * 1103515245 + 12345;
+      rects[i].width = 1 + (seed >> 8) % kWidth;
+      rects[i].height = 1 + (seed >> 16) % kHeight;
+      seed = seed * 1103515245 + 12345;
+      rects[i].x = (seed >> 8) % (kWidth - rects[i].width + 1);
+      rects[i].y = (seed >> 16) % (kHeight - rects[i].height + 1);
+      if (seed % 3 != 0) {
+        rects[i].x &= ~(align_x - 1);
+        rects[i].y &= ~(align_y - 1);
+      }
+      seed = seed * 1103515245 + 12345;
+      const int kind = (seed >> 8) % 6;
+      opacities[i] = kind < 4 ? 255 : kind == 4 ? 0 : 1 + (seed >> 16) % 254;
+    }
+
+    scff_imaging::Compositor compositor;
+    if (!compositor.Init(AV_PIX_FMT_YUV420P, kWidth, kHeight,
+                         element_count, rects, opacities)) {
+      ng_count++;
+      continue;
+    }
+
+    for (int plane = 0; plane < 3; plane++) {
+      const int rows = plane == 0 ? kHeight : kHeight / 2;
+      memset(reference.data[plane], 0xAA, reference.linesize[plane] * rows);
+      memset(culled.data[plane], 0x55, culled.linesize[plane] * rows);
+    }
+    ff_fill_rectangle(&context, &color, reference.data, reference.linesize,
+                      0, 0, kWidth, kHeight);
+    for (int i = 0; i < element_count; i++) {
+      ff_blend_rectangle2(&context, reference.data, reference.linesize,
+                          elements[i].data, elements[i].linesize,
+                          rects[i].x, rects[i].y, 0, 0,
+                          rects[i].width, rects[i].height, opacities[i]);
+    }
+
+    // 直接拡大縮小する要素の代わりに、合成の前に出力へ全体を描画しておく
+    AVPicture *composed[kMaxCount];
+    hidden_count += element_count - compositor.element_count();
+    for (int i = 0; i < compositor.element_count(); i++) {
+      const int source = compositor.source_index(i);
+      const ImageRect &rect = compositor.element_rect(i);
+      const std::vector<ImageRect> &visible_rects =
+          compositor.visible_rects(i);
+      if (visible_rects.size() > 1 ||
+          visible_rects[0].width != rect.width ||
+          visible_rects[0].height != rect.height) {
+        split_count++;
+      }
+      composed[i] = &(elements[source]);
+      if (compositor.IsIsolated(i)) {
+        ff_copy_rectangle2(&context, culled.data, culled.linesize,
+                           elements[source].data, elements[source].linesize,
+                           rect.x, rect.y, 0, 0, rect.width, rect.height);
+        composed[i] = nullptr;
+        isolated_count++;
+      }
+    }
+    compositor.Compose(&culled, composed, false);
+    if (!IsSamePicture(reference, culled, AV_PIX_FMT_YUV420P,
+                       kWidth, kHeight)) {
+      ng_count++;
+    }
+  }
+
+  avpicture_free(&reference);
+  avpicture_free(&culled);
+  for (int i = 0; i < kMaxCount; i++) {
+    avpicture_free(&(elements[i]));
+  }
+  printf("VisibleRects: hidden=%d split=%d isolated=%d %s\n",
+         hidden_count, split_count, isolated_count,
+         ng_count == 0 ? "OK" : "NG");
+}
+
+void TestCompositorBackground() {
+  // 出力イメージのバッファが内容を保持する場合(kBuffered)は背景を
+  // バッファごとに一度だけ塗りつぶし、保持しない場合(kDirect)や
+  // 半透明な要素がある場合は毎回塗りつぶすこと
+  // (背景の左上の画素を書き換えておき、次の合成で元に戻るかで確認する)
+  using scff_imaging::ImageRect;
+  const int kWidth = 64;
+  const int kHeight = 64;
+  const ImageRect kRects[] = {{16, 16, 32, 32}};
+  int ng_count = 0;
+
+  AVPicture element;
+  AVPicture buffers[2];
+  avpicture_alloc(&element, AV_PIX_FMT_YUV420P, 32, 32);
+  avpicture_alloc(&(buffers[0]), AV_PIX_FMT_YUV420P, kWidth, kHeight);
+  avpicture_alloc(&(buffers[1]), AV_PIX_FMT_YUV420P, kWidth, kHeight);
+  memset(element.data[0], 0x80, element.linesize[0] * 32);
+  memset(element.data[1], 0x80, element.linesize[1] * 16);
+  memset(element.data[2], 0x80, element.linesize[2] * 16);
+
+  const struct {
+    bool persistent_output;
+    int opacity;
+    bool fill_every_frame;
+  } kCases[] = {
+    {true, 255, false},
+    {false, 255, true},
+    {true, 128, true}
+  };
+  for each (auto test_case in kCases) {
+    scff_imaging::Compositor compositor;
+    const int opacities[] = {test_case.opacity};
+    compositor.Init(AV_PIX_FMT_YUV420P, kWidth, kHeight, 1, kRects,
+                    opacities);
+    AVPicture *elements[] = {&element};
+
+    // 3フレームを2つのバッファに交互に合成する
+    int filled_count = 0;
+    for (int frame = 0; frame < 3; frame++) {
+      AVPicture *output = &(buffers[frame % 2]);
+      output->data[0][0] = 0xEE;
+      compositor.Compose(output, elements, test_case.persistent_output);
+      if (output->data[0][0] != 0xEE) filled_count++;
+    }
+    // 保持する場合は最初に使ったときだけ(2回)塗りつぶす
+    if (filled_count != (test_case.fill_every_frame ? 3 : 2)) ng_count++;
+  }
+
+  avpicture_free(&element);
+  avpicture_free(&(buffers[0]));
+  avpicture_free(&(buffers[1]));
+  printf("CompositorBackground: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void BenchUnchangedFrames() {
+  // 静止したデスクトップ(1秒に1回だけ時計の部分が変わる)を
+  // 1920x1080(RGB0)->1280x720(I420)に変換し続けたときの1フレームあたりの時間
+  // - always: 毎フレームsws_scaleを呼ぶ
+  // - skip: 指紋が前回と同じならsws_scaleを省略する
+  const int kSrcWidth = 1920;
+  const int kSrcHeight = 1080;
+  const int kDstWidth = 1280;
+  const int kDstHeight = 720;
+  const int kFrameCount = 300;
+  const int kChangeInterval = 60;
+
+  AVPicture input;
+  AVPicture output;
+  avpicture_alloc(&input, AV_PIX_FMT_BGR0, kSrcWidth, kSrcHeight);
+  avpicture_alloc(&output, AV_PIX_FMT_YUV420P, kDstWidth, kDstHeight);
+  FillTestPattern(&input, kSrcWidth, kSrcHeight);
+  SwsContext *scaler = sws_getContext(kSrcWidth, kSrcHeight, AV_PIX_FMT_BGR0,
+                                      kDstWidth, kDstHeight,
+                                      AV_PIX_FMT_YUV420P,
+                                      SWS_BICUBIC, nullptr, nullptr, nullptr);
+
+  // 時計の部分(右下の64x16)だけを書き換える
+  auto tick = [&input](int frame) {
+    for (int y = kSrcHeight - 16; y < kSrcHeight; y++) {
+      uint8_t *line = input.data[0] + y * input.linesize[0];
+      for (int x = (kSrcWidth - 64) * 4; x < kSrcWidth * 4; x++) {
+        line[x] = static_cast<uint8_t>(frame + x);
+      }
+    }
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < kFrameCount; frame++) {
+    if (frame % kChangeInterval == 0) tick(frame);
+    sws_scale(scaler, input.data, input.linesize, 0, kSrcHeight,
+              output.data, output.linesize);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  const double always =
+      std::chrono::duration<double, std::milli>(end - start).count() /
+      kFrameCount;
+
+  scff_imaging::FrameFingerprint current;
+  scff_imaging::FrameFingerprint scaled;
+  int64_t hits = 0;
+  int64_t misses = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < kFrameCount; frame++) {
+    if (frame % kChangeInterval == 0) tick(frame);
+    current.Compute(input.data[0], input.linesize[0],
+                    kSrcWidth * 4, kSrcHeight);
+    if (current.Equals(scaled)) {
+      hits++;
+      continue;
+    }
+    misses++;
+    sws_scale(scaler, input.data, input.linesize, 0, kSrcHeight,
+              output.data, output.linesize);
+    scaled.Swap(&current);
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const double skip =
+      std::chrono::duration<double, std::milli>(end - start).count() /
+      kFrameCount;
+
+  printf("UnchangedFrames[%dx%d->%dx%d bicubic]:"
+         " always=%.2fmSec skip=%.2fmSec saved=%.0f%% (hits:%lld misses:%lld)\n",
+         kSrcWidth, kSrcHeight, kDstWidth, kDstHeight,
+         always, skip, (1.0 - skip / always) * 100.0, hits, misses);
+
+  sws_freeContext(scaler);
+  avpicture_free(&input);
+  avpicture_free(&output);
+}
+
 namespace {
 const D3D_DRIVER_TYPE kDriverTypes[] = {
   D3D_DRIVER_TYPE_HARDWARE,
@@ -81,6 +1265,1346 @@ void SaveBitmapFile(const byte* bitmap, const int width, const int height, LPCWS
   CloseHandle(bmp_file);
 }
 
+void BenchIncrementalScale() {
+  // 1920x1080(RGB0)->1280x720(I420)で、毎フレーム入力の一部の行だけが
+  // 変化する場合の1フレームあたりの時間
+  // - full: 毎フレーム一枚でsws_scaleを呼ぶ
+  // - incremental: 指紋を比べて、変化した行がフィルタのタップごと届く
+  //   ストライプだけをsws_scaleする(ScaleのSetIncrementalUpdateと同じ処理)
+  //   重なりを含めて一枚分より重くなる場合は一枚で処理する
+  // 変化した行数にほぼ比例して時間が減り、結果は一枚で処理した場合と一致する
+  const int kSrcWidth = 1920;
+  const int kSrcHeight = 1080;
+  const int kDstWidth = 1280;
+  const int kDstHeight = 720;
+  const int kFrameCount = 100;
+  const int kChangedRows[] = {16, 64, 256, 540, kSrcHeight};
+
+  AVPicture input;
+  AVPicture full_output;
+  AVPicture incremental_output;
+  avpicture_alloc(&input, AV_PIX_FMT_BGR0, kSrcWidth, kSrcHeight);
+  avpicture_alloc(&full_output, AV_PIX_FMT_YUV420P, kDstWidth, kDstHeight);
+  avpicture_alloc(&incremental_output, AV_PIX_FMT_YUV420P,
+                  kDstWidth, kDstHeight);
+  FillTestPattern(&input, kSrcWidth, kSrcHeight);
+  SwsContext *scaler = sws_getContext(kSrcWidth, kSrcHeight, AV_PIX_FMT_BGR0,
+                                      kDstWidth, kDstHeight,
+                                      AV_PIX_FMT_YUV420P,
+                                      SWS_BICUBIC, nullptr, nullptr, nullptr);
+  StripeScaler stripe_scaler(kSrcWidth, kSrcHeight, AV_PIX_FMT_BGR0,
+                             kDstWidth, kDstHeight, AV_PIX_FMT_YUV420P,
+                             SWS_BICUBIC,
+                             scff_imaging::ScaleStripePlan::kMaxStripeCount);
+
+  // 縦の位置をずらしながらrows行(チャット欄のような横長の領域)を書き換える
+  auto change = [&input](int frame, int rows) {
+    const int top = (frame * 37) % (kSrcHeight - rows + 1);
+    for (int y = top; y < top + rows; y++) {
+      uint8_t *line = input.data[0] + y * input.linesize[0];
+      for (int x = 0; x < kSrcWidth * 4; x++) {
+        line[x] = static_cast<uint8_t>(line[x] + frame + 1);
+      }
+    }
+  };
+
+  int ng_count = 0;
+  for each (auto rows in kChangedRows) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < kFrameCount; frame++) {
+      change(frame, rows);
+      sws_scale(scaler, input.data, input.linesize, 0, kSrcHeight,
+                full_output.data, full_output.linesize);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double full =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        kFrameCount;
+
+    scff_imaging::FrameFingerprint current;
+    scff_imaging::FrameFingerprint scaled;
+    int64_t scaled_stripes = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < kFrameCount; frame++) {
+      change(frame, rows);
+      current.Compute(input.data[0], input.linesize[0],
+                      kSrcWidth * 4, kSrcHeight);
+      bool changed[scff_imaging::ScaleStripePlan::kMaxStripeCount];
+      int changed_scaled_rows = 0;
+      for (int i = 0; i < stripe_scaler.stripe_count(); i++) {
+        const scff_imaging::ScaleStripe &stripe = stripe_scaler.stripe(i);
+        changed[i] =
+            current.IsRangeChanged(scaled, stripe.src_y, stripe.src_height);
+        if (changed[i]) changed_scaled_rows += stripe.scaled_height;
+      }
+      if (changed_scaled_rows < kDstHeight) {
+        for (int i = 0; i < stripe_scaler.stripe_count(); i++) {
+          if (!changed[i]) continue;
+          stripe_scaler.RunStripe(i, input, &incremental_output);
+          scaled_stripes++;
+        }
+      } else {
+        sws_scale(scaler, input.data, input.linesize, 0, kSrcHeight,
+                  incremental_output.data, incremental_output.linesize);
+        scaled_stripes += stripe_scaler.stripe_count();
+      }
+      scaled.Swap(&current);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double incremental =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        kFrameCount;
+
+    // 最後のフレームを一枚で処理した結果と比べる
+    sws_scale(scaler, input.data, input.linesize, 0, kSrcHeight,
+              full_output.data, full_output.linesize);
+    if (!IsSamePicture(full_output, incremental_output, AV_PIX_FMT_YUV420P,
+                       kDstWidth, kDstHeight)) {
+      ng_count++;
+    }
+
+    printf("IncrementalScale[%dx%d->%dx%d bicubic, %4d rows changed]:"
+           " full=%.2fmSec incremental=%.2fmSec (%.1f/%d stripes)\n",
+           kSrcWidth, kSrcHeight, kDstWidth, kDstHeight, rows,
+           full, incremental,
+           static_cast<double>(scaled_stripes) / kFrameCount,
+           stripe_scaler.stripe_count());
+  }
+  printf("IncrementalScale: %s\n", ng_count == 0 ? "OK" : "NG");
+
+  sws_freeContext(scaler);
+  avpicture_free(&input);
+  avpicture_free(&full_output);
+  avpicture_free(&incremental_output);
+}
+
+void BenchScaleInPlace() {
+  // 1920x1080(RGB0)を1280x720に拡大縮小して1920x1080の出力イメージの
+  // (320,180)に配置するときの1フレームあたりの時間
+  // - copy: 中間のイメージに拡大縮小してからff_copy_rectangle2でコピー
+  // - in place: 出力イメージの一部を指すビューに直接拡大縮小
+  // どちらも出力イメージ全体(配置した範囲の外も含む)が一致すること
+  const struct {
+    const char *name;
+    scff_imaging::ImagePixelFormats format;
+  } kFormats[] = {
+    {"I420", scff_imaging::ImagePixelFormats::kI420},
+    {"NV12", scff_imaging::ImagePixelFormats::kNV12},
+    {"UYVY", scff_imaging::ImagePixelFormats::kUYVY},
+    {"RGB0", scff_imaging::ImagePixelFormats::kRGB0}
+  };
+  const int kSrcWidth = 1920;
+  const int kSrcHeight = 1080;
+  const int kDstX = 320;
+  const int kDstY = 180;
+  const int kDstWidth = 1280;
+  const int kDstHeight = 720;
+  const int kOutputWidth = 1920;
+  const int kOutputHeight = 1080;
+  const int kFrameCount = 100;
+
+  AVPicture input;
+  avpicture_alloc(&input, AV_PIX_FMT_BGR0, kSrcWidth, kSrcHeight);
+  FillTestPattern(&input, kSrcWidth, kSrcHeight);
+
+  int ng_count = 0;
+  for each (auto format in kFormats) {
+    scff_imaging::AVPictureImage copied_output;
+    scff_imaging::AVPictureImage in_place_output;
+    scff_imaging::AVPictureImage converted;
+    scff_imaging::AVPictureImage view;
+    copied_output.Create(format.format, kOutputWidth, kOutputHeight);
+    in_place_output.Create(format.format, kOutputWidth, kOutputHeight);
+    converted.Create(format.format, kDstWidth, kDstHeight);
+    view.CreateForView(format.format, kDstWidth, kDstHeight);
+    if (view.AttachView(in_place_output, kDstX, kDstY) !=
+            scff_imaging::ErrorCodes::kNoError) {
+      printf("ScaleInPlace[%s]: Cannot Attach View\n", format.name);
+      ng_count++;
+      continue;
+    }
+    const AVPixelFormat av_format = view.av_pixel_format();
+
+    // 配置した範囲の外も比べられるように両方を同じ色で塗りつぶしておく
+    FFDrawContext context;
+    FFDrawColor color;
+    uint8_t rgba[4] = {12, 34, 56, 255};
+    ff_draw_init(&context, av_format, 0);
+    ff_draw_color(&context, &color, rgba);
+    ff_fill_rectangle(&context, &color,
+                      copied_output.avpicture()->data,
+                      copied_output.avpicture()->linesize,
+                      0, 0, kOutputWidth, kOutputHeight);
+    ff_fill_rectangle(&context, &color,
+                      in_place_output.avpicture()->data,
+                      in_place_output.avpicture()->linesize,
+                      0, 0, kOutputWidth, kOutputHeight);
+
+    SwsContext *scaler = sws_getContext(kSrcWidth, kSrcHeight, AV_PIX_FMT_BGR0,
+                                        kDstWidth, kDstHeight, av_format,
+                                        SWS_BICUBIC, nullptr, nullptr, nullptr);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < kFrameCount; frame++) {
+      sws_scale(scaler, input.data, input.linesize, 0, kSrcHeight,
+                converted.avpicture()->data, converted.avpicture()->linesize);
+      ff_copy_rectangle2(&context,
+                         copied_output.avpicture()->data,
+                         copied_output.avpicture()->linesize,
+                         converted.avpicture()->data,
+                         converted.avpicture()->linesize,
+                         kDstX, kDstY, 0, 0, kDstWidth, kDstHeight);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double copy =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        kFrameCount;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < kFrameCount; frame++) {
+      sws_scale(scaler, input.data, input.linesize, 0, kSrcHeight,
+                view.avpicture()->data, view.avpicture()->linesize);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double in_place =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        kFrameCount;
+
+    if (!IsSamePicture(*copied_output.avpicture(), *in_place_output.avpicture(),
+                       av_format, kOutputWidth, kOutputHeight)) {
+      ng_count++;
+    }
+    printf("ScaleInPlace[%s %dx%d->%dx%d bicubic]:"
+           " copy=%.2fmSec in place=%.2fmSec\n",
+           format.name, kSrcWidth, kSrcHeight, kDstWidth, kDstHeight,
+           copy, in_place);
+    sws_freeContext(scaler);
+  }
+  printf("ScaleInPlace: %s\n", ng_count == 0 ? "OK" : "NG");
+
+  avpicture_free(&input);
+}
+
+void BenchRotate() {
+  // 縦置きモニタ(1080x1920, RGB0)を回転して1280x720(I420)に拡大縮小するときの
+  // 1フレームあたりの時間
+  // - rotate: Rotate::RotatePlane32(SSE2)とRotatePlane32Portable
+  // - scale: 回転後の1920x1080を1280x720に拡大縮小
+  // 検証としてすべての回転方向で端数のある大きさでも両者が一致すること
+  const int kSrcWidth = 1080;
+  const int kSrcHeight = 1920;
+  const int kDstWidth = 1280;
+  const int kDstHeight = 720;
+  const int kFrameCount = 100;
+  const scff_imaging::RotateDirections kDirections[] = {
+    scff_imaging::RotateDirections::kDegrees90,
+    scff_imaging::RotateDirections::kDegrees180,
+    scff_imaging::RotateDirections::kDegrees270
+  };
+
+  int ng_count = 0;
+  const int kSizes[][2] = {{1, 1}, {3, 5}, {64, 64}, {67, 131}, {131, 67}};
+  const int kSizeCount = sizeof(kSizes) / sizeof(kSizes[0]);
+  for each (auto direction in kDirections) {
+    for (int i = 0; i < kSizeCount; i++) {
+      const int width = kSizes[i][0];
+      const int height = kSizes[i][1];
+      int rotated_width;
+      int rotated_height;
+      scff_imaging::utilities::GetRotatedSize(direction, width, height,
+                                              &rotated_width, &rotated_height);
+      std::vector<uint32_t> src(width * height);
+      for (int j = 0; j < width * height; j++) {
+        src[j] = static_cast<uint32_t>(j) * 2654435761U;
+      }
+      std::vector<uint32_t> simd(rotated_width * rotated_height, 0);
+      std::vector<uint32_t> portable(rotated_width * rotated_height, 0);
+      scff_imaging::Rotate::RotatePlane32(
+          reinterpret_cast<uint8_t*>(&src[0]), width * 4,
+          reinterpret_cast<uint8_t*>(&simd[0]), rotated_width * 4,
+          width, height, direction);
+      scff_imaging::Rotate::RotatePlane32Portable(
+          reinterpret_cast<uint8_t*>(&src[0]), width * 4,
+          reinterpret_cast<uint8_t*>(&portable[0]), rotated_width * 4,
+          width, height, direction);
+      if (simd != portable) {
+        printf("Rotate[%d %dx%d]: NG\n",
+               static_cast<int>(direction), width, height);
+        ng_count++;
+      }
+    }
+  }
+
+  AVPicture input;
+  avpicture_alloc(&input, AV_PIX_FMT_BGR0, kSrcWidth, kSrcHeight);
+  FillTestPattern(&input, kSrcWidth, kSrcHeight);
+  AVPicture rotated;
+  avpicture_alloc(&rotated, AV_PIX_FMT_BGR0, kSrcHeight, kSrcWidth);
+  AVPicture output;
+  avpicture_alloc(&output, AV_PIX_FMT_YUV420P, kDstWidth, kDstHeight);
+  SwsContext *scaler = sws_getContext(kSrcHeight, kSrcWidth, AV_PIX_FMT_BGR0,
+                                      kDstWidth, kDstHeight, AV_PIX_FMT_YUV420P,
+                                      SWS_BICUBIC, nullptr, nullptr, nullptr);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < kFrameCount; frame++) {
+    scff_imaging::Rotate::RotatePlane32Portable(
+        input.data[0], input.linesize[0],
+        rotated.data[0], rotated.linesize[0],
+        kSrcWidth, kSrcHeight, scff_imaging::RotateDirections::kDegrees90);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  const double portable =
+      std::chrono::duration<double, std::milli>(end - start).count() /
+      kFrameCount;
+
+  start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < kFrameCount; frame++) {
+    scff_imaging::Rotate::RotatePlane32(
+        input.data[0], input.linesize[0],
+        rotated.data[0], rotated.linesize[0],
+        kSrcWidth, kSrcHeight, scff_imaging::RotateDirections::kDegrees90);
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const double simd =
+      std::chrono::duration<double, std::milli>(end - start).count() /
+      kFrameCount;
+
+  start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < kFrameCount; frame++) {
+    sws_scale(scaler, rotated.data, rotated.linesize, 0, kSrcWidth,
+              output.data, output.linesize);
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const double scale =
+      std::chrono::duration<double, std::milli>(end - start).count() /
+      kFrameCount;
+
+  printf("Rotate[%dx%d 90deg]: portable=%.2fmSec simd=%.2fmSec\n",
+         kSrcWidth, kSrcHeight, portable, simd);
+  printf("Rotate[scale %dx%d->%dx%d bicubic I420]: %.2fmSec"
+         " (rotate/scale=%.1f%%)\n",
+         kSrcHeight, kSrcWidth, kDstWidth, kDstHeight, scale,
+         simd / scale * 100.0);
+  printf("Rotate: %s\n", ng_count == 0 ? "OK" : "NG");
+
+  sws_freeContext(scaler);
+  avpicture_free(&output);
+  avpicture_free(&rotated);
+  avpicture_free(&input);
+}
+
+void BenchUnscaledConvert() {
+  // 1920x1080(BGR0)を拡大縮小せずにYUVに変換するときの1フレームあたりの時間
+  // - convert: UnscaledConverter::Convert(SSE2)とConvertPortable
+  // - sws: 同じ大きさでのsws_scale(bicubic)
+  // 検証として端数のある大きさでも両者が一致し、SWS_AREA|SWS_ACCURATE_RND
+  // (|SWS_BITEXACT)のsws_scaleとも完全に一致すること
+  const int kWidth = 1920;
+  const int kHeight = 1080;
+  const int kFrameCount = 100;
+  const struct {
+    const char *name;
+    AVPixelFormat format;
+  } kFormats[] = {
+    {"I420", AV_PIX_FMT_YUV420P},
+    {"NV12", AV_PIX_FMT_NV12},
+    {"UYVY", AV_PIX_FMT_UYVY422},
+    {"YUY2", AV_PIX_FMT_YUYV422}
+  };
+
+  int ng_count = 0;
+  const int kSizes[][2] = {{2, 2}, {18, 6}, {130, 34}, {kWidth, kHeight}};
+  const int kSizeCount = sizeof(kSizes) / sizeof(kSizes[0]);
+  for each (auto format in kFormats) {
+    for (int i = 0; i < kSizeCount; i++) {
+      const int width = kSizes[i][0];
+      const int height = kSizes[i][1];
+      AVPicture input;
+      avpicture_alloc(&input, AV_PIX_FMT_BGR0, width, height);
+      FillTestPattern(&input, width, height);
+      AVPicture simd;
+      avpicture_alloc(&simd, format.format, width, height);
+      AVPicture portable;
+      avpicture_alloc(&portable, format.format, width, height);
+      AVPicture reference;
+      avpicture_alloc(&reference, format.format, width, height);
+      const int size = avpicture_get_size(format.format, width, height);
+      memset(simd.data[0], 0, size);
+      memset(portable.data[0], 0, size);
+      memset(reference.data[0], 0, size);
+
+      scff_imaging::UnscaledConverter converter;
+      converter.Init(AV_PIX_FMT_BGR0, format.format, width, height);
+      converter.Convert(input, &simd, 0, height);
+      converter.ConvertPortable(input, &portable, 0, height);
+      SwsContext *scaler = sws_getContext(
+          width, height, AV_PIX_FMT_BGR0, width, height, format.format,
+          SWS_AREA | SWS_ACCURATE_RND | SWS_BITEXACT,
+          nullptr, nullptr, nullptr);
+      sws_scale(scaler, input.data, input.linesize, 0, height,
+                reference.data, reference.linesize);
+      sws_freeContext(scaler);
+
+      if (memcmp(simd.data[0], portable.data[0], size) != 0 ||
+          memcmp(simd.data[0], reference.data[0], size) != 0) {
+        printf("UnscaledConvert[%s %dx%d]: NG\n",
+               format.name, width, height);
+        ng_count++;
+      }
+      avpicture_free(&reference);
+      avpicture_free(&portable);
+      avpicture_free(&simd);
+      avpicture_free(&input);
+    }
+  }
+
+  AVPicture input;
+  avpicture_alloc(&input, AV_PIX_FMT_BGR0, kWidth, kHeight);
+  FillTestPattern(&input, kWidth, kHeight);
+  for each (auto format in kFormats) {
+    AVPicture output;
+    avpicture_alloc(&output, format.format, kWidth, kHeight);
+    scff_imaging::UnscaledConverter converter;
+    converter.Init(AV_PIX_FMT_BGR0, format.format, kWidth, kHeight);
+    SwsContext *scaler = sws_getContext(kWidth, kHeight, AV_PIX_FMT_BGR0,
+                                        kWidth, kHeight, format.format,
+                                        SWS_BICUBIC | SWS_ACCURATE_RND,
+                                        nullptr, nullptr, nullptr);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < kFrameCount; frame++) {
+      converter.ConvertPortable(input, &output, 0, kHeight);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double portable =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        kFrameCount;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < kFrameCount; frame++) {
+      converter.Convert(input, &output, 0, kHeight);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double simd =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        kFrameCount;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < kFrameCount; frame++) {
+      sws_scale(scaler, input.data, input.linesize, 0, kHeight,
+                output.data, output.linesize);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double sws =
+        std::chrono::duration<double, std::milli>(end - start).count() /
+        kFrameCount;
+
+    printf("UnscaledConvert[%dx%d %s]: portable=%.2fmSec simd=%.2fmSec"
+           " sws=%.2fmSec\n",
+           kWidth, kHeight, format.name, portable, simd, sws);
+    sws_freeContext(scaler);
+    avpicture_free(&output);
+  }
+  printf("UnscaledConvert: %s\n", ng_count == 0 ? "OK" : "NG");
+  avpicture_free(&input);
+}
+
+void BenchFixedRatioScale() {
+  // 固定の縮小率のカーネルごとの1フレームあたりの時間とスループット
+  // - fixed: FixedRatioScaler::Convert(SSE2)
+  // - sws: 同じ大きさでのsws_scale(fast bilinear/area)
+  // 検証としてSSE2を使わない場合と一致し、行を分けて変換しても
+  // 一度に変換した場合と一致すること
+  const int kFrameCount = 100;
+  const struct {
+    int src_width;
+    int src_height;
+    int dst_width;
+    int dst_height;
+  } kSizes[] = {
+    {1920, 1080, 1280, 720},
+    {2560, 1440, 1280, 720},
+    {3840, 2160, 1920, 1080}
+  };
+  const struct {
+    const char *name;
+    AVPixelFormat format;
+  } kFormats[] = {
+    {"I420", AV_PIX_FMT_YUV420P},
+    {"NV12", AV_PIX_FMT_NV12},
+    {"UYVY", AV_PIX_FMT_UYVY422},
+    {"YUY2", AV_PIX_FMT_YUYV422}
+  };
+
+  int ng_count = 0;
+  for each (auto size in kSizes) {
+    AVPicture input;
+    avpicture_alloc(&input, AV_PIX_FMT_BGR0, size.src_width, size.src_height);
+    FillTestPattern(&input, size.src_width, size.src_height);
+    for each (auto format in kFormats) {
+      scff_imaging::FixedRatioScaler scaler;
+      if (!scaler.Init(AV_PIX_FMT_BGR0, format.format,
+                       size.src_width, size.src_height,
+                       size.dst_width, size.dst_height)) {
+        printf("FixedRatioScale[%s]: Init NG\n", format.name);
+        ng_count++;
+        continue;
+      }
+      AVPicture simd;
+      avpicture_alloc(&simd, format.format, size.dst_width, size.dst_height);
+      AVPicture portable;
+      avpicture_alloc(&portable, format.format,
+                      size.dst_width, size.dst_height);
+      AVPicture split;
+      avpicture_alloc(&split, format.format, size.dst_width, size.dst_height);
+      const int picture_size =
+          avpicture_get_size(format.format, size.dst_width, size.dst_height);
+
+      scaler.Convert(input, &simd, 0, size.dst_height);
+      scaler.ConvertPortable(input, &portable, 0, size.dst_height);
+      for (int y = 0; y < size.dst_height; y += 16) {
+        scaler.Convert(input, &split, y, std::min(16, size.dst_height - y));
+      }
+      if (memcmp(simd.data[0], portable.data[0], picture_size) != 0 ||
+          memcmp(simd.data[0], split.data[0], picture_size) != 0) {
+        printf("FixedRatioScale[%s %dx%d->%dx%d]: NG\n", format.name,
+               size.src_width, size.src_height,
+               size.dst_width, size.dst_height);
+        ng_count++;
+      }
+
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < kFrameCount; frame++) {
+        scaler.Convert(input, &simd, 0, size.dst_height);
+      }
+      auto end = std::chrono::high_resolution_clock::now();
+      const double fixed =
+          std::chrono::duration<double, std::milli>(end - start).count() /
+          kFrameCount;
+
+      double sws[2];
+      const int kFlags[] = {SWS_FAST_BILINEAR, SWS_AREA};
+      for (int i = 0; i < 2; i++) {
+        SwsContext *context = sws_getContext(
+            size.src_width, size.src_height, AV_PIX_FMT_BGR0,
+            size.dst_width, size.dst_height, format.format,
+            kFlags[i], nullptr, nullptr, nullptr);
+        start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < kFrameCount; frame++) {
+          sws_scale(context, input.data, input.linesize, 0, size.src_height,
+                    portable.data, portable.linesize);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        sws[i] =
+            std::chrono::duration<double, std::milli>(end - start).count() /
+            kFrameCount;
+        sws_freeContext(context);
+      }
+
+      // スループットは出力のメガピクセル毎秒
+      const double megapixels =
+          size.dst_width * size.dst_height / 1000000.0;
+      printf("FixedRatioScale[%d:%d %dx%d->%dx%d %s]:"
+             " fixed=%.2fmSec(%.0fMpx/s)"
+             " sws fast_bilinear=%.2fmSec area=%.2fmSec\n",
+             scaler.input_ratio(), scaler.output_ratio(),
+             size.src_width, size.src_height,
+             size.dst_width, size.dst_height, format.name,
+             fixed, megapixels / fixed * 1000.0, sws[0], sws[1]);
+
+      avpicture_free(&split);
+      avpicture_free(&portable);
+      avpicture_free(&simd);
+    }
+    avpicture_free(&input);
+  }
+  printf("FixedRatioScale: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void BenchPyramidScale() {
+  // 大きく縮小する場合の1フレームあたりの時間と品質
+  // - direct: sws_scaleだけで縮小
+  // - pyramid: BoxReducerで1/2の縮小を繰り返してからsws_scale
+  // 品質はdirectに対するPSNRがScale::kDefaultPyramidMinPsnr以上であること
+  // 検証としてBoxReducerが奇数の大きさでもSSE2を使わない場合と一致すること
+  const int kFrameCount = 30;
+  const struct {
+    int src_width;
+    int src_height;
+    int dst_width;
+    int dst_height;
+  } kSizes[] = {
+    {3840, 2160, 640, 360},
+    // 5760x1080(3画面)を1280x720にアスペクト比を保って配置する
+    {5760, 1080, 1280, 240},
+    {2560, 1440, 640, 360}
+  };
+  const struct {
+    const char *name;
+    int flags;
+  } kFlags[] = {
+    {"bilinear", SWS_BILINEAR},
+    {"bicubic", SWS_BICUBIC},
+    {"lanczos", SWS_LANCZOS}
+  };
+
+  int ng_count = 0;
+  const int kOddSizes[][2] = {{7, 5}, {33, 17}, {1366, 769}};
+  for each (auto odd_size in kOddSizes) {
+    scff_imaging::BoxReducer reducer;
+    reducer.Init(odd_size[0], odd_size[1]);
+    AVPicture input;
+    avpicture_alloc(&input, AV_PIX_FMT_BGR0, odd_size[0], odd_size[1]);
+    FillTestPattern(&input, odd_size[0], odd_size[1]);
+    AVPicture simd;
+    avpicture_alloc(&simd, AV_PIX_FMT_BGR0,
+                    reducer.output_width(), reducer.output_height());
+    AVPicture portable;
+    avpicture_alloc(&portable, AV_PIX_FMT_BGR0,
+                    reducer.output_width(), reducer.output_height());
+    reducer.Reduce(input, &simd, 0, reducer.output_height());
+    reducer.ReducePortable(input, &portable, 0, reducer.output_height());
+    if (!IsSamePicture(simd, portable, AV_PIX_FMT_BGR0,
+                       reducer.output_width(), reducer.output_height())) {
+      printf("PyramidScale[reduce %dx%d]: NG\n", odd_size[0], odd_size[1]);
+      ng_count++;
+    }
+    avpicture_free(&portable);
+    avpicture_free(&simd);
+    avpicture_free(&input);
+  }
+
+  for each (auto size in kSizes) {
+    AVPicture input;
+    avpicture_alloc(&input, AV_PIX_FMT_BGR0, size.src_width, size.src_height);
+    scff_imaging::utilities::FillDesktopPattern(&input, size.src_width,
+                                                size.src_height);
+
+    // ピラミッドの段を用意する
+    const int pass_count = scff_imaging::BoxReducer::GetPassCount(
+        size.src_width, size.src_height, size.dst_width, size.dst_height);
+    scff_imaging::BoxReducer reducers[scff_imaging::BoxReducer::kMaxPassCount];
+    AVPicture reduced[scff_imaging::BoxReducer::kMaxPassCount];
+    int width = size.src_width;
+    int height = size.src_height;
+    for (int pass = 0; pass < pass_count; pass++) {
+      reducers[pass].Init(width, height);
+      width = reducers[pass].output_width();
+      height = reducers[pass].output_height();
+      avpicture_alloc(&reduced[pass], AV_PIX_FMT_BGR0, width, height);
+    }
+    const AVPicture &last = pass_count > 0 ? reduced[pass_count - 1] : input;
+
+    for each (auto flag in kFlags) {
+      AVPicture direct_output;
+      avpicture_alloc(&direct_output, AV_PIX_FMT_YUV420P,
+                      size.dst_width, size.dst_height);
+      AVPicture pyramid_output;
+      avpicture_alloc(&pyramid_output, AV_PIX_FMT_YUV420P,
+                      size.dst_width, size.dst_height);
+      SwsContext *direct = sws_getContext(
+          size.src_width, size.src_height, AV_PIX_FMT_BGR0,
+          size.dst_width, size.dst_height, AV_PIX_FMT_YUV420P,
+          flag.flags, nullptr, nullptr, nullptr);
+      SwsContext *pyramid = sws_getContext(
+          width, height, AV_PIX_FMT_BGR0,
+          size.dst_width, size.dst_height, AV_PIX_FMT_YUV420P,
+          flag.flags, nullptr, nullptr, nullptr);
+
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < kFrameCount; frame++) {
+        sws_scale(direct, input.data, input.linesize, 0, size.src_height,
+                  direct_output.data, direct_output.linesize);
+      }
+      auto end = std::chrono::high_resolution_clock::now();
+      const double direct_time =
+          std::chrono::duration<double, std::milli>(end - start).count() /
+          kFrameCount;
+
+      start = std::chrono::high_resolution_clock::now();
+      for (int frame = 0; frame < kFrameCount; frame++) {
+        for (int pass = 0; pass < pass_count; pass++) {
+          reducers[pass].Reduce(pass == 0 ? input : reduced[pass - 1],
+                                &reduced[pass], 0,
+                                reducers[pass].output_height());
+        }
+        sws_scale(pyramid, last.data, last.linesize, 0, height,
+                  pyramid_output.data, pyramid_output.linesize);
+      }
+      end = std::chrono::high_resolution_clock::now();
+      const double pyramid_time =
+          std::chrono::duration<double, std::milli>(end - start).count() /
+          kFrameCount;
+
+      const double psnr = scff_imaging::utilities::CalculatePsnr(
+          direct_output, pyramid_output, AV_PIX_FMT_YUV420P,
+          size.dst_width, size.dst_height);
+      const bool ok = psnr >= scff_imaging::Scale::kDefaultPyramidMinPsnr;
+      if (!ok) ng_count++;
+      printf("PyramidScale[%dx%d->%dx%d %s passes:%d]:"
+             " direct=%.2fmSec pyramid=%.2fmSec psnr=%.1fdB %s\n",
+             size.src_width, size.src_height,
+             size.dst_width, size.dst_height, flag.name, pass_count,
+             direct_time, pyramid_time, psnr, ok ? "OK" : "NG");
+
+      sws_freeContext(pyramid);
+      sws_freeContext(direct);
+      avpicture_free(&pyramid_output);
+      avpicture_free(&direct_output);
+    }
+    for (int pass = 0; pass < pass_count; pass++) {
+      avpicture_free(&reduced[pass]);
+    }
+    avpicture_free(&input);
+  }
+  printf("PyramidScale: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void BenchScaleOrder() {
+  // RGB0からI420に拡大縮小する場合の1フレームあたりの時間
+  // - scale first: sws_scaleでRGB0から直接拡大縮小
+  // - convert first: UnscaledConverterで入力の大きさのままI420に変換してから
+  //   sws_scaleでI420のプレーンを拡大縮小
+  // 倍率を変えて速い方が入れ替わる点(クロスオーバー)を探し、
+  // ScaleOrderPlanの選択と比べる(一致しなくてもNGにはしない)
+  // 品質はscale firstに対するPSNRが30dB以上であること
+  // (convert firstは色差を入力の大きさで間引くので、拡大時は細かい模様の
+  // 色差がscale firstよりぼける)
+  const int kFrameCount = 30;
+  const struct {
+    int width;
+    int height;
+  } kSources[] = {
+    {640, 480},
+    {1280, 720}
+  };
+  // 倍率(%)
+  const int kRatios[] = {50, 60, 75, 90, 110, 125, 150, 200, 250, 300};
+  const struct {
+    const char *name;
+    int flags;
+  } kFlags[] = {
+    {"point", SWS_POINT},
+    {"bilinear", SWS_BILINEAR},
+    {"bicubic", SWS_BICUBIC},
+    {"lanczos", SWS_LANCZOS}
+  };
+  const double kMinPsnr = 30.0;
+
+  int ng_count = 0;
+  int mismatch_count = 0;
+  for each (auto source in kSources) {
+    AVPicture input;
+    avpicture_alloc(&input, AV_PIX_FMT_BGR0, source.width, source.height);
+    scff_imaging::utilities::FillDesktopPattern(&input, source.width,
+                                                source.height);
+    scff_imaging::UnscaledConverter converter;
+    converter.Init(AV_PIX_FMT_BGR0, AV_PIX_FMT_YUV420P,
+                   source.width, source.height);
+    AVPicture converted;
+    avpicture_alloc(&converted, AV_PIX_FMT_YUV420P,
+                    source.width, source.height);
+
+    for each (auto flag in kFlags) {
+      // 最初にconvert firstの方が速くなった倍率
+      int crossover = 0;
+      for each (auto ratio in kRatios) {
+        // I420なので偶数に揃える
+        const int dst_width = source.width * ratio / 100 / 2 * 2;
+        const int dst_height = source.height * ratio / 100 / 2 * 2;
+        AVPicture scale_first_output;
+        avpicture_alloc(&scale_first_output, AV_PIX_FMT_YUV420P,
+                        dst_width, dst_height);
+        AVPicture convert_first_output;
+        avpicture_alloc(&convert_first_output, AV_PIX_FMT_YUV420P,
+                        dst_width, dst_height);
+        SwsContext *scale_first = sws_getContext(
+            source.width, source.height, AV_PIX_FMT_BGR0,
+            dst_width, dst_height, AV_PIX_FMT_YUV420P,
+            flag.flags, nullptr, nullptr, nullptr);
+        SwsContext *convert_first = sws_getContext(
+            source.width, source.height, AV_PIX_FMT_YUV420P,
+            dst_width, dst_height, AV_PIX_FMT_YUV420P,
+            flag.flags, nullptr, nullptr, nullptr);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < kFrameCount; frame++) {
+          sws_scale(scale_first, input.data, input.linesize,
+                    0, source.height,
+                    scale_first_output.data, scale_first_output.linesize);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        const double scale_first_time =
+            std::chrono::duration<double, std::milli>(end - start).count() /
+            kFrameCount;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < kFrameCount; frame++) {
+          converter.Convert(input, &converted, 0, source.height);
+          sws_scale(convert_first, converted.data, converted.linesize,
+                    0, source.height,
+                    convert_first_output.data, convert_first_output.linesize);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        const double convert_first_time =
+            std::chrono::duration<double, std::milli>(end - start).count() /
+            kFrameCount;
+
+        const double psnr = scff_imaging::utilities::CalculatePsnr(
+            scale_first_output, convert_first_output, AV_PIX_FMT_YUV420P,
+            dst_width, dst_height);
+        if (psnr < kMinPsnr) ng_count++;
+        const bool faster = convert_first_time < scale_first_time;
+        if (faster && crossover == 0) crossover = ratio;
+        scff_imaging::ScaleOrderPlan plan;
+        plan.Build(source.width, source.height, dst_width, dst_height,
+                   flag.flags);
+        if (plan.convert_first() != faster) mismatch_count++;
+        printf("ScaleOrder[%dx%d->%dx%d %s]:"
+               " scale first=%.2fmSec convert first=%.2fmSec"
+               " psnr=%.1fdB plan=%s(%.1f:%.1fMB)\n",
+               source.width, source.height, dst_width, dst_height, flag.name,
+               scale_first_time, convert_first_time, psnr,
+               plan.convert_first() ? "convert first" : "scale first",
+               plan.convert_first_cost() / 1000000.0,
+               plan.scale_first_cost() / 1000000.0);
+
+        sws_freeContext(convert_first);
+        sws_freeContext(scale_first);
+        avpicture_free(&convert_first_output);
+        avpicture_free(&scale_first_output);
+      }
+      printf("ScaleOrder[%dx%d %s]: crossover=%d%%\n",
+             source.width, source.height, flag.name, crossover);
+    }
+    avpicture_free(&converted);
+    avpicture_free(&input);
+  }
+  printf("ScaleOrder: mismatch=%d %s\n", mismatch_count,
+         ng_count == 0 ? "OK" : "NG");
+}
+
+void BenchDrawUtils() {
+  // ff_fill_rectangle/ff_copy_rectangle2/ff_blend_rectangle2を
+  // カーネルの段階ごとに比較する
+  // - 1920x1080全体の塗りつぶし・コピー(非テンポラルストア)・半透明合成と
+  //   320x240(通常のストア)の1回あたりの時間
+  // - 端数のある位置・大きさでもC版と完全に一致すること
+  const struct {
+    const char *name;
+    AVPixelFormat format;
+  } kFormats[] = {
+    {"I420", AV_PIX_FMT_YUV420P},
+    {"NV12", AV_PIX_FMT_NV12},
+    {"UYVY", AV_PIX_FMT_UYVY422},
+    {"YUY2", AV_PIX_FMT_YUYV422},
+    {"RGB0", AV_PIX_FMT_RGB0}
+  };
+  const char *kLevelNames[] = {"C", "SSE2", "AVX2"};
+  const int kWidth = 1920;
+  const int kHeight = 1080;
+  const int kFrameCount = 200;
+
+  int ng_count = 0;
+  for each (auto format in kFormats) {
+    FFDrawContext context;
+    FFDrawColor color;
+    uint8_t rgba[4] = {12, 34, 56, 255};
+    ff_draw_init(&context, format.format, 0);
+    ff_draw_color(&context, &color, rgba);
+
+    AVPicture reference;
+    AVPicture source;
+    AVPicture output;
+    avpicture_alloc(&reference, format.format, kWidth, kHeight);
+    avpicture_alloc(&source, format.format, kWidth, kHeight);
+    avpicture_alloc(&output, format.format, kWidth, kHeight);
+    for (int plane = 0; plane < context.nb_planes; plane++) {
+      const int rows = plane == 0 ? kHeight : kHeight >> context.vsub[plane];
+      for (int i = 0; i < source.linesize[plane] * rows; i++) {
+        source.data[plane][i] = static_cast<uint8_t>(i * 7 + plane);
+      }
+    }
+
+    for (int level = FF_DRAW_SIMD_C; level <= FF_DRAW_SIMD_AVX2; level++) {
+      if (ff_draw_force_simd_level(level) != level) {
+        continue;
+      }
+
+      // 端数のある矩形を塗りつぶし・コピー・合成して、C版の結果と比べる
+      AVPicture *target = level == FF_DRAW_SIMD_C ? &reference : &output;
+      for (int plane = 0; plane < context.nb_planes; plane++) {
+        const int rows = plane == 0 ? kHeight : kHeight >> context.vsub[plane];
+        memset(target->data[plane], 0xEE, target->linesize[plane] * rows);
+      }
+      // Packed 4:2:2は輝度をピクセル単位で書くので奇数のxも使える
+      const int x_mask = context.packed_yuv422 ? ~0 : ~context.hsub_max;
+      uint32_t seed = 1;
+      for (int trial = 0; trial < 200; trial++) {
+        seed = seed * 1103515245 + 12345;
+        const int x = ((seed >> 8) % 200) & x_mask;
+        const int y = ((seed >> 16) % 200) & ~context.vsub_max;
+        seed = seed * 1103515245 + 12345;
+        const int w = 1 + (seed >> 8) % (kWidth - x);
+        const int h = 1 + (seed >> 16) % (kHeight - y);
+        if (trial % 4 == 0) {
+          ff_fill_rectangle(&context, &color, target->data, target->linesize,
+                            x, y, w, h);
+        } else if (trial % 4 == 1) {
+          ff_copy_rectangle2(&context, target->data, target->linesize,
+                             source.data, source.linesize,
+                             x, y,
+                             (x / 2) & x_mask,
+                             (y / 2) & ~context.vsub_max,
+                             w, h);
+        } else if (trial % 4 == 2) {
+          ff_blend_rectangle2(&context, target->data, target->linesize,
+                              source.data, source.linesize,
+                              x, y,
+                              (x / 2) & x_mask,
+                              (y / 2) & ~context.vsub_max,
+                              w, h, (seed >> 4) & 0xFF);
+        } else {
+          // 不透明な色は内側をまとめて塗りつぶす(奇数の位置で端も確かめる)
+          ff_blend_rectangle(&context, &color, target->data, target->linesize,
+                             kWidth, kHeight, x + 1, y + 1, w, h);
+        }
+      }
+      if (level != FF_DRAW_SIMD_C &&
+          !IsSamePicture(reference, output, format.format, kWidth, kHeight)) {
+        ng_count++;
+      }
+
+      const int kSizes[][2] = {{kWidth, kHeight}, {320, 240}};
+      for each (auto size in kSizes) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < kFrameCount; frame++) {
+          ff_fill_rectangle(&context, &color, output.data, output.linesize,
+                            0, 0, size[0], size[1]);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        const double fill =
+            std::chrono::duration<double, std::micro>(end - start).count() /
+            kFrameCount;
+        start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < kFrameCount; frame++) {
+          ff_copy_rectangle2(&context, output.data, output.linesize,
+                             source.data, source.linesize,
+                             0, 0, 0, 0, size[0], size[1]);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        const double copy =
+            std::chrono::duration<double, std::micro>(end - start).count() /
+            kFrameCount;
+        start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < kFrameCount; frame++) {
+          ff_blend_rectangle2(&context, output.data, output.linesize,
+                              source.data, source.linesize,
+                              0, 0, 0, 0, size[0], size[1], 128);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        const double blend =
+            std::chrono::duration<double, std::micro>(end - start).count() /
+            kFrameCount;
+        printf("DrawUtils[%s %dx%d %s]: "
+               "fill=%.1fuSec copy=%.1fuSec blend=%.1fuSec\n",
+               format.name, size[0], size[1], kLevelNames[level],
+               fill, copy, blend);
+      }
+    }
+
+    avpicture_free(&reference);
+    avpicture_free(&source);
+    avpicture_free(&output);
+  }
+  ff_draw_force_simd_level(FF_DRAW_SIMD_AVX2);
+  printf("DrawUtils: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void TestCaptureQueue() {
+  // キャプチャ側と変換側を異なるレートで回し、
+  // 変換中のスロットが書き換えられないこと、順序が逆転しないこと、
+  // キャプチャした数=変換した数+捨てた数+残った数になることを確認する
+  const int kSlotCount = 3;
+  const int kSlotSize = 64 * 1024;
+  const int64_t kFrameCount = 20000;
+
+  scff_imaging::CaptureQueue queue(kSlotCount);
+  std::vector<std::vector<int64_t>> slots(
+      kSlotCount, std::vector<int64_t>(kSlotSize, 0));
+  std::atomic<bool> done(false);
+
+  std::thread producer([&]() {
+    for (int64_t frame = 1; frame <= kFrameCount; frame++) {
+      const int slot = queue.AcquireWriteSlot();
+      std::fill(slots[slot].begin(), slots[slot].end(), frame);
+      if (frame % 97 == 0) {
+        // キャプチャ失敗
+        queue.Discard(slot);
+        continue;
+      }
+      queue.Push(slot, frame);
+      if (frame % 5 == 0) std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  int ng_count = 0;
+  int64_t converted_count = 0;
+  int64_t last_frame = 0;
+  const int64_t discarded_count = kFrameCount / 97;
+  while (true) {
+    int slot = -1;
+    int64_t frame = 0;
+    if (!queue.Pop(10, &slot, &frame)) {
+      // タイムアウトしても前回のスロットは保持したまま
+      if (converted_count > 0 && queue.held_slot() == -1) ng_count++;
+      if (done) break;
+      continue;
+    }
+    converted_count++;
+    if (frame <= last_frame) ng_count++;
+    last_frame = frame;
+
+    // 変換に時間がかかってもスロットは書き換えられない
+    for (int pass = 0; pass < 2; pass++) {
+      for (int i = 0; i < kSlotSize; i += 256) {
+        if (slots[slot][i] != frame) {
+          ng_count++;
+          break;
+        }
+      }
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  // 残りを全て取り出す
+  int slot = -1;
+  int64_t frame = 0;
+  while (queue.Pop(0, &slot, &frame)) {
+    converted_count++;
+  }
+  if (converted_count + queue.dropped_count() + discarded_count !=
+      kFrameCount) {
+    ng_count++;
+  }
+
+  // Stopで待機中のPopが起きる
+  std::thread stopper([&queue]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.Stop();
+  });
+  if (queue.Pop(10000, &slot, &frame)) ng_count++;
+  stopper.join();
+
+  printf("CaptureQueue: %s (converted:%lld dropped:%lld)\n",
+         ng_count == 0 ? "OK" : "NG",
+         converted_count, queue.dropped_count());
+}
+
+void TestScaleQualityController() {
+  using scff_imaging::ScaleQualityController;
+  using scff_imaging::SWScaleFlags;
+  int ng_count = 0;
+
+  // 品質段階: 設定より軽いものだけが後ろに並ぶ
+  SWScaleFlags ladder[scff_imaging::kMaxScaleQualityLevelCount];
+  if (scff_imaging::BuildScaleQualityLadder(SWScaleFlags::kLanczos,
+                                            ladder) != 4 ||
+      ladder[0] != SWScaleFlags::kLanczos ||
+      ladder[1] != SWScaleFlags::kBicubic ||
+      ladder[2] != SWScaleFlags::kBilinear ||
+      ladder[3] != SWScaleFlags::kFastBilinear) {
+    ng_count++;
+  }
+  if (scff_imaging::BuildScaleQualityLadder(SWScaleFlags::kArea,
+                                            ladder) != 2 ||
+      ladder[1] != SWScaleFlags::kFastBilinear) {
+    ng_count++;
+  }
+  if (scff_imaging::BuildScaleQualityLadder(SWScaleFlags::kFastBilinear,
+                                            ladder) != 1) {
+    ng_count++;
+  }
+
+  // 60fps: 90%超で超過、50%未満で余裕あり
+  const int64_t kInterval = scff_imaging::kClockUnitsPerSecond / 60;
+  const int64_t kOverrun = kInterval;
+  const int64_t kBusy = kInterval * 7 / 10;
+  const int64_t kIdle = kInterval / 4;
+  ScaleQualityController controller;
+  controller.Reset(4, kInterval);
+
+  // 単発の超過では下げない
+  for (int i = 0; i < 10; i++) {
+    if (controller.Record(kOverrun)) ng_count++;
+    if (controller.Record(kOverrun)) ng_count++;
+    if (controller.Record(kBusy)) ng_count++;
+  }
+  if (controller.level() != 0) ng_count++;
+
+  // 超過が続いたら1段階ずつ下げ、一番下で止まる
+  for (int i = 0; i < 3 * ScaleQualityController::kStepDownFrames; i++) {
+    const bool changed = controller.Record(kOverrun);
+    if (changed != ((i + 1) % ScaleQualityController::kStepDownFrames == 0)) {
+      ng_count++;
+    }
+  }
+  if (controller.level() != 3) ng_count++;
+  for (int i = 0; i < 100; i++) {
+    if (controller.Record(kOverrun)) ng_count++;
+  }
+
+  // 余裕がしばらく続くまで上げない(途中で忙しくなったら数え直す)
+  for (int i = 0; i < ScaleQualityController::kStepUpFrames - 1; i++) {
+    if (controller.Record(kIdle)) ng_count++;
+  }
+  if (controller.Record(kBusy)) ng_count++;
+  for (int i = 0; i < ScaleQualityController::kStepUpFrames - 1; i++) {
+    if (controller.Record(kIdle)) ng_count++;
+  }
+  if (!controller.Record(kIdle) || controller.level() != 2) ng_count++;
+
+  // 忙しいだけ(超過でも余裕ありでもない)なら現在の段階を保つ
+  for (int i = 0; i < 1000; i++) {
+    if (controller.Record(kBusy)) ng_count++;
+  }
+  if (controller.level() != 2) ng_count++;
+  if (controller.step_down_count() != 3 ||
+      controller.step_up_count() != 1) {
+    ng_count++;
+  }
+
+  // スキップしたフレームは超過したフレームとして数える
+  if (controller.RecordSkippedFrames(0)) ng_count++;
+  if (controller.RecordSkippedFrames(1)) ng_count++;
+  if (!controller.RecordSkippedFrames(
+          ScaleQualityController::kStepDownFrames - 1) ||
+      controller.level() != 3) {
+    ng_count++;
+  }
+
+  // 段階が1つしかなければ何もしない
+  controller.Reset(1, kInterval);
+  for (int i = 0; i < 100; i++) {
+    if (controller.Record(kOverrun)) ng_count++;
+    if (controller.RecordSkippedFrames(10)) ng_count++;
+  }
+  if (controller.level() != 0) ng_count++;
+
+  printf("ScaleQualityController: %s\n", ng_count == 0 ? "OK" : "NG");
+}
+
+void TestScalerCache() {
+  // 同じ条件のコンテキストは返却後に使いまわされ、貸し出し中のものは
+  // 別に作成されること、容量を超えたら古いものから破棄されることを確認し、
+  // レイアウトの作り直し(1920x1080->1280x720 bicubicを9分割)1回分の
+  // コンテキストの準備にかかる時間をキャッシュの有無で比べる
+  using scff_imaging::ScalerCache;
+  using scff_imaging::ScalerCacheStats;
+  using scff_imaging::ScalerKey;
+  int ng_count = 0;
+
+  ScalerKey key_a;
+  key_a.src_width = 1920;
+  key_a.src_height = 1080;
+  key_a.src_format = AV_PIX_FMT_BGR0;
+  key_a.dst_width = 1280;
+  key_a.dst_height = 720;
+  key_a.dst_format = AV_PIX_FMT_YUV420P;
+  key_a.flags = SWS_BICUBIC;
+  key_a.filter_enabled = false;
+  key_a.filter.luma_gblur = 0.0F;
+  key_a.filter.chroma_gblur = 0.0F;
+  key_a.filter.luma_sharpen = 0.0F;
+  key_a.filter.chroma_sharpen = 0.0F;
+  key_a.filter.chroma_hshift = 0.0F;
+  key_a.filter.chroma_vshift = 0.0F;
+  ScalerKey key_b = key_a;
+  key_b.flags = SWS_BILINEAR;
+  ScalerKey key_c = key_a;
+  key_c.dst_format = AV_PIX_FMT_UYVY422;
+  // フィルタを使わない場合はフィルタのパラメータを比べない
+  ScalerKey key_a2 = key_a;
+  key_a2.filter.luma_gblur = 1.0F;
+
+  {
+    ScalerCache cache(2, 1);
+
+    // 貸し出し中のものは使いまわさない
+    SwsContext *a0 = cache.AcquireContext(key_a);
+    SwsContext *a1 = cache.AcquireContext(key_a);
+    if (a0 == nullptr || a1 == nullptr || a0 == a1) ng_count++;
+    cache.ReleaseContext(a0);
+    cache.ReleaseContext(a1);
+
+    // 返却されたものを使いまわす
+    SwsContext *a2 = cache.AcquireContext(key_a2);
+    if (a2 != a0 && a2 != a1) ng_count++;
+    cache.ReleaseContext(a2);
+
+    // 容量(2)を超えたら最も長く使われていないものを破棄する
+    SwsContext *b = cache.AcquireContext(key_b);
+    cache.ReleaseContext(b);
+    SwsContext *c = cache.AcquireContext(key_c);
+    cache.ReleaseContext(c);
+    ScalerCacheStats stats = cache.GetStats();
+    if (stats.context_hits != 1LL || stats.context_misses != 4LL ||
+        stats.context_evictions != 2LL || stats.idle_context_count != 2 ||
+        stats.leased_context_count != 0) {
+      ng_count++;
+    }
+    // 最後に使ったbとcが残っている
+    SwsContext *b2 = cache.AcquireContext(key_b);
+    SwsContext *c2 = cache.AcquireContext(key_c);
+    if (b2 != b || c2 != c) ng_count++;
+    cache.ReleaseContext(b2);
+    cache.ReleaseContext(c2);
+
+    // フィルタはパラメータが同じなら共有し、誰も使っていないものだけ破棄する
+    ScalerKey key_f1 = key_a;
+    key_f1.filter_enabled = true;
+    key_f1.filter.luma_gblur = 1.0F;
+    ScalerKey key_f1_bilinear = key_f1;
+    key_f1_bilinear.flags = SWS_BILINEAR;
+    ScalerKey key_f2 = key_f1;
+    key_f2.filter.luma_gblur = 2.0F;
+    SwsFilter *filter = cache.AcquireFilter(key_f1.filter);
+    SwsContext *f1 = cache.AcquireContext(key_f1);
+    SwsContext *f1_bilinear = cache.AcquireContext(key_f1_bilinear);
+    SwsContext *f2 = cache.AcquireContext(key_f2);
+    if (filter == nullptr || f1 == nullptr || f1_bilinear == nullptr ||
+        f2 == nullptr || f1 == f1_bilinear) {
+      ng_count++;
+    }
+    stats = cache.GetStats();
+    if (stats.filter_hits != 2LL || stats.filter_misses != 2LL ||
+        stats.filter_count != 1 || stats.leased_context_count != 3) {
+      ng_count++;
+    }
+    cache.ReleaseFilter(filter);
+    cache.ReleaseContext(f1);
+    cache.ReleaseContext(f1_bilinear);
+    cache.ReleaseContext(f2);
+    stats = cache.GetStats();
+    if (stats.filter_count != 1 || stats.idle_context_count != 2) {
+      ng_count++;
+    }
+  }
+
+  // レイアウトの作り直し1回分の準備時間
+  const int kRebuildCount = 20;
+  scff_imaging::ScaleStripePlan plan;
+  plan.Build(1080, 720, 1, 0,
+             scff_imaging::ScaleStripePlan::GetFilterRadius(
+                 SWS_BICUBIC, 1080, 720, 1, 0, 0),
+             9, false);
+  SwsContext *contexts[scff_imaging::ScaleStripePlan::kMaxStripeCount];
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int rebuild = 0; rebuild < kRebuildCount; rebuild++) {
+    for (int i = 0; i < plan.stripe_count(); i++) {
+      contexts[i] = sws_getContext(1920, plan.stripe(i).src_height,
+                                   AV_PIX_FMT_BGR0,
+                                   1280, plan.stripe(i).scaled_height,
+                                   AV_PIX_FMT_YUV420P,
+                                   SWS_BICUBIC, nullptr, nullptr, nullptr);
+    }
+    for (int i = 0; i < plan.stripe_count(); i++) {
+      sws_freeContext(contexts[i]);
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  const double uncached =
+      std::chrono::duration<double, std::milli>(end - start).count() /
+      kRebuildCount;
+
+  ScalerCache cache(ScalerCache::kDefaultContextCapacity,
+                    ScalerCache::kDefaultFilterCapacity);
+  start = std::chrono::high_resolution_clock::now();
+  for (int rebuild = 0; rebuild < kRebuildCount; rebuild++) {
+    for (int i = 0; i < plan.stripe_count(); i++) {
+      ScalerKey key = key_a;
+      key.src_height = plan.stripe(i).src_height;
+      key.dst_height = plan.stripe(i).scaled_height;
+      contexts[i] = cache.AcquireContext(key);
+    }
+    for (int i = 0; i < plan.stripe_count(); i++) {
+      cache.ReleaseContext(contexts[i]);
+    }
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const double cached =
+      std::chrono::duration<double, std::milli>(end - start).count() /
+      kRebuildCount;
+  const ScalerCacheStats stats = cache.GetStats();
+
+  printf("ScalerCache: %s (rebuild[%d stripes]: uncached=%.3fmSec"
+         " cached=%.3fmSec hits:%lld misses:%lld)\n",
+         ng_count == 0 ? "OK" : "NG", plan.stripe_count(),
+         uncached, cached, stats.context_hits, stats.context_misses);
+}
+
+#if defined(SCFF_IMAGING_TRACE)
+void TestTrace() {
+  // 複数スレッドで記録しながら出力し、出力されたイベントが
+  // 書き込み途中のもの(破れたイベント)を含まないことを確認する
+  // (各イベントは長さ1(=0.1uSec)で記録するので、それ以外は破れている)
+  const int kThreadCount = 4;
+  const int kDumpCount = 100;
+
+  std::atomic<bool> done(false);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; i++) {
+    threads.push_back(std::thread([&done]() {
+      SCFF_TRACE_THREAD_NAME("TestTrace");
+      int64_t time = 0;
+      while (!done) {
+        scff_imaging::trace::Record("TestTrace", time, time + 1);
+        time += 10;
+      }
+      SCFF_TRACE_THREAD_EXIT();
+    }));
+  }
+
+  int ng_count = 0;
+  size_t max_event_count = 0;
+  std::string json;
+  for (int i = 0; i < kDumpCount; i++) {
+    scff_imaging::trace::WriteChromeTrace(&json);
+    size_t event_count = 0;
+    size_t good_count = 0;
+    for (size_t pos = json.find("\"ph\":\"X\""); pos != std::string::npos;
+         pos = json.find("\"ph\":\"X\"", pos + 1)) {
+      event_count++;
+    }
+    for (size_t pos = json.find("\"dur\":0.1,"); pos != std::string::npos;
+         pos = json.find("\"dur\":0.1,", pos + 1)) {
+      good_count++;
+    }
+    if (event_count != good_count) ng_count++;
+    max_event_count = std::max(max_event_count, event_count);
+  }
+  done = true;
+  for (auto it = threads.begin(); it != threads.end(); ++it) {
+    it->join();
+  }
+
+  // 1スレッドあたりのイベント数はリングバッファの大きさを超えない
+  if (max_event_count >
+      static_cast<size_t>(kThreadCount * scff_imaging::trace::kEventsPerThread)) {
+    ng_count++;
+  }
+
+  printf("Trace: %s (max events:%u dropped:%lld)\n",
+         ng_count == 0 ? "OK" : "NG",
+         static_cast<unsigned>(max_event_count),
+         scff_imaging::trace::dropped_event_count());
+}
+#endif  // defined(SCFF_IMAGING_TRACE)
+
 void TestDXGIDesktopDuplication() {
   // 使いまわし用HRESULT
   HRESULT result;
@@ -397,6 +2921,32 @@ RELEASE:
 
 int _tmain(int argc, _TCHAR* argv[]) {
   //TestFFDraw();
+  //TestTripleBuffer();
+  //TestRenderTarget();
+  //TestFrameScheduler();
+  //TestWorkerPool();
+  //BenchWorkerPool();
+  //TestScaleStripePlan();
+  //BenchScaleStripes();
+  //TestFrameFingerprint();
+  //TestBackgroundRegion();
+  //TestVisibleRects();
+  //TestCompositorBackground();
+  //BenchUnchangedFrames();
+  //BenchIncrementalScale();
+  //BenchScaleInPlace();
+  //BenchRotate();
+  //BenchUnscaledConvert();
+  //BenchFixedRatioScale();
+  //BenchPyramidScale();
+  //BenchScaleOrder();
+  //BenchDrawUtils();
+  //TestCaptureQueue();
+  //TestScaleQualityController();
+  //TestScalerCache();
+#if defined(SCFF_IMAGING_TRACE)
+  //TestTrace();
+#endif
   printf("scff_sandbox\n");
   TestDXGIDesktopDuplication();
   getchar();
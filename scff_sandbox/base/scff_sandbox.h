@@ -26,6 +26,8 @@
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 }
 
 #endif  // SCFF_SANDBOX_BASE_SCFF_SANDBOX_H_